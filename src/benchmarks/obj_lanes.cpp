@@ -12,6 +12,7 @@
 #include "benchmark.hpp"
 #include "file.h"
 #include "libpmemobj.h"
+#include "os.h"
 
 /* an internal libpmemobj code */
 #include "lane.h"
@@ -23,6 +24,14 @@
  */
 #define OPERATION_REPEAT_COUNT 10000
 
+/*
+ * prog_args - command line parsed arguments
+ */
+struct prog_args {
+	char *assignment; /* "thread" or "cpu" lane assignment */
+	unsigned nlanes;  /* number of lanes, 0 for the default */
+};
+
 /*
  * obj_bench - variables used in benchmark, passed within functions
  */
@@ -56,6 +65,24 @@ lanes_init(struct benchmark *bench, struct benchmark_args *args)
 	pmembench_set_priv(bench, ob);
 
 	ob->pa = (struct prog_args *)args->opts;
+
+	enum pobj_lane_assignment assignment;
+	if (strcmp(ob->pa->assignment, "thread") == 0) {
+		assignment = POBJ_LANE_ASSIGNMENT_THREAD;
+	} else if (strcmp(ob->pa->assignment, "cpu") == 0) {
+		assignment = POBJ_LANE_ASSIGNMENT_CPU;
+	} else {
+		fprintf(stderr, "invalid lane assignment: %s\n",
+			ob->pa->assignment);
+		goto err;
+	}
+
+	if (ob->pa->nlanes != 0) {
+		char nlanes[16];
+		snprintf(nlanes, sizeof(nlanes), "%u", ob->pa->nlanes);
+		os_setenv("PMEMOBJ_NLANES", nlanes, 1);
+	}
+
 	size_t psize;
 
 	if (args->is_poolset || type == TYPE_DEVDAX)
@@ -70,6 +97,12 @@ lanes_init(struct benchmark *bench, struct benchmark_args *args)
 		goto err;
 	}
 
+	if (pmemobj_ctl_set(ob->pop, "tx.lane.assignment", &assignment)) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		pmemobj_close(ob->pop);
+		goto err;
+	}
+
 	return 0;
 
 err:
@@ -108,12 +141,32 @@ lanes_op(struct benchmark *bench, struct operation_info *info)
 
 	return 0;
 }
+
+static struct benchmark_clo lanes_clo[2];
 static struct benchmark_info lanes_info;
 
 CONSTRUCTOR(obj_lines_constructor)
 void
 obj_lines_constructor(void)
 {
+	lanes_clo[0].opt_short = 'a';
+	lanes_clo[0].opt_long = "assignment";
+	lanes_clo[0].descr = "Lane assignment: thread or cpu";
+	lanes_clo[0].type = CLO_TYPE_STR;
+	lanes_clo[0].off = clo_field_offset(struct prog_args, assignment);
+	lanes_clo[0].def = "thread";
+
+	lanes_clo[1].opt_short = 'l';
+	lanes_clo[1].opt_long = "lanes";
+	lanes_clo[1].descr = "Number of lanes, 0 for the default";
+	lanes_clo[1].def = "0";
+	lanes_clo[1].off = clo_field_offset(struct prog_args, nlanes);
+	lanes_clo[1].type = CLO_TYPE_UINT;
+	lanes_clo[1].type_uint.size = clo_field_size(struct prog_args, nlanes);
+	lanes_clo[1].type_uint.base = CLO_INT_BASE_DEC;
+	lanes_clo[1].type_uint.min = 0;
+	lanes_clo[1].type_uint.max = UINT_MAX;
+
 	lanes_info.name = "obj_lanes";
 	lanes_info.brief = "Benchmark for internal lanes "
 			   "operation";
@@ -123,9 +176,9 @@ obj_lines_constructor(void)
 	lanes_info.multiops = true;
 	lanes_info.operation = lanes_op;
 	lanes_info.measure_time = true;
-	lanes_info.clos = NULL;
-	lanes_info.nclos = 0;
-	lanes_info.opts_size = 0;
+	lanes_info.clos = lanes_clo;
+	lanes_info.nclos = ARRAY_SIZE(lanes_clo);
+	lanes_info.opts_size = sizeof(struct prog_args);
 	lanes_info.rm_file = true;
 	lanes_info.allow_poolset = true;
 	REGISTER_BENCHMARK(lanes_info);
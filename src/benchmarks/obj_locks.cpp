@@ -27,7 +27,7 @@ struct prog_args {
 	bool run_id_increment;	 /* increment run_id after each lock/unlock */
 	uint64_t runid_initial_value; /* initial value of run_id */
 	char *lock_mode;	      /* "1by1" or "all-lock" */
-	char *lock_type;	      /* "mutex", "rwlock" or "ram-mutex" */
+	char *lock_type;	      /* lock type, see "bench_type" */
 	bool use_rdlock;	      /* use read lock, instead of write lock */
 };
 
@@ -46,8 +46,11 @@ typedef union lock_union {
 	PMEMmutex pm_mutex;
 	PMEMrwlock pm_rwlock;
 	PMEM_volatile_mutex pm_vmutex;
+	PMEMspinlock pm_spinlock;
+	PMEMsrwlock pm_srwlock;
 	os_mutex_t pt_mutex;
 	os_rwlock_t pt_rwlock;
+	os_spinlock_t pt_spinlock;
 } lock_t;
 
 POBJ_LAYOUT_BEGIN(pmembench_lock_layout);
@@ -78,6 +81,8 @@ enum benchmark_mode {
 	BENCH_MODE_MUTEX,	   /* PMEMmutex vs. os_mutex_t */
 	BENCH_MODE_RWLOCK,	   /* PMEMrwlock vs. os_rwlock_t */
 	BENCH_MODE_VOLATILE_MUTEX, /* PMEMmutex with os_thread mutex in RAM */
+	BENCH_MODE_SPINLOCK,	   /* PMEMspinlock vs. os_spinlock_t */
+	BENCH_MODE_SRWLOCK,	   /* PMEMsrwlock vs. os_rwlock_t */
 	BENCH_MODE_MAX
 };
 
@@ -342,6 +347,69 @@ volatile_mutex_unlock_wrapper(PMEMobjpool *pop, void *lock)
 	return volatile_mutex_unlock(pop, (PMEM_volatile_mutex *)lock);
 }
 
+/*
+ * os_spin_lock_wrapper -- wrapper for os_spin_lock
+ */
+static int
+os_spin_lock_wrapper(PMEMobjpool *pop, void *lock)
+{
+	return os_spin_lock((os_spinlock_t *)lock);
+}
+
+/*
+ * os_spin_unlock_wrapper -- wrapper for os_spin_unlock
+ */
+static int
+os_spin_unlock_wrapper(PMEMobjpool *pop, void *lock)
+{
+	return os_spin_unlock((os_spinlock_t *)lock);
+}
+
+/*
+ * pmemobj_spinlock_lock_wrapper -- wrapper for pmemobj_spinlock_lock
+ */
+static int
+pmemobj_spinlock_lock_wrapper(PMEMobjpool *pop, void *lock)
+{
+	return pmemobj_spinlock_lock(pop, (PMEMspinlock *)lock);
+}
+
+/*
+ * pmemobj_spinlock_unlock_wrapper -- wrapper for pmemobj_spinlock_unlock
+ */
+static int
+pmemobj_spinlock_unlock_wrapper(PMEMobjpool *pop, void *lock)
+{
+	return pmemobj_spinlock_unlock(pop, (PMEMspinlock *)lock);
+}
+
+/*
+ * pmemobj_srwlock_wrlock_wrapper -- wrapper for pmemobj_srwlock_wrlock
+ */
+static int
+pmemobj_srwlock_wrlock_wrapper(PMEMobjpool *pop, void *lock)
+{
+	return pmemobj_srwlock_wrlock(pop, (PMEMsrwlock *)lock);
+}
+
+/*
+ * pmemobj_srwlock_rdlock_wrapper -- wrapper for pmemobj_srwlock_rdlock
+ */
+static int
+pmemobj_srwlock_rdlock_wrapper(PMEMobjpool *pop, void *lock)
+{
+	return pmemobj_srwlock_rdlock(pop, (PMEMsrwlock *)lock);
+}
+
+/*
+ * pmemobj_srwlock_unlock_wrapper -- wrapper for pmemobj_srwlock_unlock
+ */
+static int
+pmemobj_srwlock_unlock_wrapper(PMEMobjpool *pop, void *lock)
+{
+	return pmemobj_srwlock_unlock(pop, (PMEMsrwlock *)lock);
+}
+
 /*
  * init_bench_mutex -- allocate and initialize mutex objects
  */
@@ -598,10 +666,166 @@ op_bench_vmutex(struct mutex_bench *mb)
 	return 0;
 }
 
+/*
+ * init_bench_spinlock -- allocate and initialize spinlocks
+ */
+static int
+init_bench_spinlock(struct mutex_bench *mb)
+{
+	struct my_root *root = D_RW(mb->root);
+	assert(root != nullptr);
+
+	POBJ_ZALLOC(mb->pop, &root->locks, lock_t,
+		    mb->pa->n_locks * sizeof(lock_t));
+	if (TOID_IS_NULL(root->locks)) {
+		perror("POBJ_ZALLOC");
+		return -1;
+	}
+
+	mb->locks = D_RW(root->locks);
+	assert(mb->locks != nullptr);
+
+	if (!mb->pa->use_system_threads) {
+		/* initialize PMEM spinlocks */
+		for (unsigned i = 0; i < mb->pa->n_locks; i++) {
+			auto *p = (PMEMspinlock_internal *)&mb->locks[i];
+			p->state = mb->pa->runid_initial_value;
+		}
+	} else {
+		/* initialize os_thread spinlocks */
+		for (unsigned i = 0; i < mb->pa->n_locks; i++) {
+			auto *p = (os_spinlock_t *)&mb->locks[i];
+			os_spin_init(p, 0);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * exit_bench_spinlock -- destroy the spinlocks and release memory
+ */
+static int
+exit_bench_spinlock(struct mutex_bench *mb)
+{
+	if (mb->pa->use_system_threads) {
+		/* deinitialize os_thread spinlocks */
+		for (unsigned i = 0; i < mb->pa->n_locks; i++) {
+			auto *p = (os_spinlock_t *)&mb->locks[i];
+			os_spin_destroy(p);
+		}
+	}
+
+	POBJ_FREE(&D_RW(mb->root)->locks);
+
+	return 0;
+}
+
+/*
+ * op_bench_spinlock -- lock and unlock the spinlock
+ *
+ * If requested, increment the run_id of the memory pool.  In case of
+ * PMEMspinlock this makes the next lock operation find a stale state.
+ */
+static int
+op_bench_spinlock(struct mutex_bench *mb)
+{
+	if (!mb->pa->use_system_threads) {
+		if (mb->lock_mode == OP_MODE_1BY1) {
+			bench_operation_1by1(pmemobj_spinlock_lock_wrapper,
+					     pmemobj_spinlock_unlock_wrapper,
+					     mb, mb->pop);
+		} else {
+			bench_operation_all_lock(
+				pmemobj_spinlock_lock_wrapper,
+				pmemobj_spinlock_unlock_wrapper, mb, mb->pop);
+		}
+		if (mb->pa->run_id_increment)
+			mb->pop->run_id += 2; /* must be a multiple of 2 */
+	} else {
+		if (mb->lock_mode == OP_MODE_1BY1) {
+			bench_operation_1by1(os_spin_lock_wrapper,
+					     os_spin_unlock_wrapper, mb,
+					     nullptr);
+		} else {
+			bench_operation_all_lock(os_spin_lock_wrapper,
+						 os_spin_unlock_wrapper, mb,
+						 nullptr);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * init_bench_srwlock -- allocate and initialize scalable rwlocks
+ */
+static int
+init_bench_srwlock(struct mutex_bench *mb)
+{
+	if (mb->pa->use_system_threads)
+		return init_bench_rwlock(mb);
+
+	struct my_root *root = D_RW(mb->root);
+	assert(root != nullptr);
+
+	POBJ_ZALLOC(mb->pop, &root->locks, lock_t,
+		    mb->pa->n_locks * sizeof(lock_t));
+	if (TOID_IS_NULL(root->locks)) {
+		perror("POBJ_ZALLOC");
+		return -1;
+	}
+
+	mb->locks = D_RW(root->locks);
+	assert(mb->locks != nullptr);
+
+	/* initialize PMEM scalable rwlocks */
+	for (unsigned i = 0; i < mb->pa->n_locks; i++) {
+		auto *p = (PMEMsrwlock_internal *)&mb->locks[i];
+		p->pmemsrwlock.runid = mb->pa->runid_initial_value;
+		p->pmemsrwlock.state = 0;
+		p->pmemsrwlock.owner = 0;
+	}
+
+	return 0;
+}
+
+/*
+ * op_bench_srwlock -- lock and unlock the scalable rwlock
+ *
+ * If requested, increment the run_id of the memory pool.  In case of
+ * PMEMsrwlock this will force the lock reinitialization at the lock operation.
+ */
+static int
+op_bench_srwlock(struct mutex_bench *mb)
+{
+	if (mb->pa->use_system_threads)
+		return op_bench_rwlock(mb);
+
+	if (mb->lock_mode == OP_MODE_1BY1) {
+		bench_operation_1by1(!mb->pa->use_rdlock
+					     ? pmemobj_srwlock_wrlock_wrapper
+					     : pmemobj_srwlock_rdlock_wrapper,
+				     pmemobj_srwlock_unlock_wrapper, mb,
+				     mb->pop);
+	} else {
+		bench_operation_all_lock(
+			!mb->pa->use_rdlock ? pmemobj_srwlock_wrlock_wrapper
+					    : pmemobj_srwlock_rdlock_wrapper,
+			pmemobj_srwlock_unlock_wrapper, mb, mb->pop);
+	}
+	if (mb->pa->run_id_increment)
+		mb->pop->run_id += 2; /* must be a multiple of 2 */
+
+	return 0;
+}
+
 struct bench_ops benchmark_ops[BENCH_MODE_MAX] = {
 	{init_bench_mutex, exit_bench_mutex, op_bench_mutex},
 	{init_bench_rwlock, exit_bench_rwlock, op_bench_rwlock},
-	{init_bench_vmutex, exit_bench_vmutex, op_bench_vmutex}};
+	{init_bench_vmutex, exit_bench_vmutex, op_bench_vmutex},
+	{init_bench_spinlock, exit_bench_spinlock, op_bench_spinlock},
+	{init_bench_srwlock, exit_bench_rwlock, op_bench_srwlock}};
 
 /*
  * operation_mode -- parses command line "--mode" and returns
@@ -631,6 +855,10 @@ parse_benchmark_mode(const char *arg)
 		return &benchmark_ops[BENCH_MODE_RWLOCK];
 	else if (strcmp(arg, "volatile-mutex") == 0)
 		return &benchmark_ops[BENCH_MODE_VOLATILE_MUTEX];
+	else if (strcmp(arg, "spinlock") == 0)
+		return &benchmark_ops[BENCH_MODE_SPINLOCK];
+	else if (strcmp(arg, "srwlock") == 0)
+		return &benchmark_ops[BENCH_MODE_SRWLOCK];
 	else
 		return nullptr;
 }
@@ -805,7 +1033,7 @@ pmem_locks_constructor(void)
 	locks_clo[4].opt_short = 'i';
 	locks_clo[4].opt_long = "run_id_init_val";
 	locks_clo[4].descr = "Use this value for initializing the "
-			     "run_id of each PMEMmutex object";
+			     "run_id of each PMEM lock object";
 	locks_clo[4].def = "2";
 	locks_clo[4].off =
 		clo_field_offset(struct prog_args, runid_initial_value);
@@ -820,7 +1048,7 @@ pmem_locks_constructor(void)
 	locks_clo[5].opt_short = 'b';
 	locks_clo[5].opt_long = "bench_type";
 	locks_clo[5].descr = "The Benchmark type: mutex, "
-			     "rwlock or volatile-mutex";
+			     "rwlock, volatile-mutex, spinlock or srwlock";
 	locks_clo[5].type = CLO_TYPE_STR;
 	locks_clo[5].off = clo_field_offset(struct prog_args, lock_type);
 	locks_clo[5].def = "mutex";
@@ -828,7 +1056,8 @@ pmem_locks_constructor(void)
 	locks_clo[6].opt_short = 'R';
 	locks_clo[6].opt_long = "rdlock";
 	locks_clo[6].descr = "Select read over write lock, only "
-			     "valid when lock_type is \"rwlock\"";
+			     "valid when lock_type is \"rwlock\" or "
+			     "\"srwlock\"";
 	locks_clo[6].type = CLO_TYPE_FLAG;
 	locks_clo[6].off = clo_field_offset(struct prog_args, use_rdlock);
 
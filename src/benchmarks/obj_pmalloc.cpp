@@ -35,6 +35,9 @@
 /* OOB and allocation header size */
 #define OOB_HEADER_SIZE 64
 
+/* Number of random reads performed in a single access operation */
+#define ACCESS_READS 64
+
 /*
  * prog_args - command line parsed arguments
  */
@@ -42,6 +45,7 @@ struct prog_args {
 	size_t minsize;	      /* minimum size for random allocation size */
 	bool use_random_size; /* if set, use random size allocations */
 	unsigned seed;	      /* PRNG seed */
+	size_t chunk_align;   /* value of the heap.chunk_align ctl */
 };
 
 POBJ_LAYOUT_BEGIN(pmalloc_layout);
@@ -149,6 +153,13 @@ obj_init(struct benchmark *bench, struct benchmark_args *args)
 		goto free_ob;
 	}
 
+	if (ob->pa->chunk_align != 0 &&
+	    pmemobj_ctl_set(ob->pop, "heap.chunk_align",
+			    &ob->pa->chunk_align) != 0) {
+		fprintf(stderr, "heap.chunk_align: %s\n", pmemobj_errormsg());
+		goto free_pop;
+	}
+
 	ob->root = POBJ_ROOT(ob->pop, struct my_root);
 	if (TOID_IS_NULL(ob->root)) {
 		fprintf(stderr, "POBJ_ROOT: %s\n", pmemobj_errormsg());
@@ -400,8 +411,33 @@ pfree_op(struct benchmark *bench, struct operation_info *info)
 	return 0;
 }
 
+/*
+ * paccess_op -- reads from random offsets of randomly selected objects, the
+ * cost of which is dominated by TLB misses when objects are spread out
+ */
+static int
+paccess_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+	auto *w = (struct pmix_worker *)info->worker->priv;
+
+	size_t n_ops_total =
+		info->args->n_ops_per_thread * info->args->n_threads;
+
+	for (int i = 0; i < ACCESS_READS; ++i) {
+		uint64_t idx = RRAND_R(&w->rng, n_ops_total, 0);
+		size_t off = RRAND_R(&w->rng, ob->sizes[idx], 0) &
+			~(sizeof(uint64_t) - 1);
+
+		(void)*(volatile uint64_t *)((char *)ob->pop + ob->offs[idx] +
+					     off);
+	}
+
+	return 0;
+}
+
 /* command line options definition */
-static struct benchmark_clo pmalloc_clo[3];
+static struct benchmark_clo pmalloc_clo[4];
 /*
  * Stores information about pmalloc benchmark.
  */
@@ -414,6 +450,10 @@ static struct benchmark_info pfree_info;
  * Stores information about pmix benchmark.
  */
 static struct benchmark_info pmix_info;
+/*
+ * Stores information about paccess benchmark.
+ */
+static struct benchmark_info paccess_info;
 
 CONSTRUCTOR(obj_pmalloc_constructor)
 void
@@ -451,6 +491,19 @@ obj_pmalloc_constructor(void)
 	pmalloc_clo[2].type_uint.min = 1;
 	pmalloc_clo[2].type_uint.max = UINT_MAX;
 
+	pmalloc_clo[3].opt_short = 'a';
+	pmalloc_clo[3].opt_long = "chunk-align";
+	pmalloc_clo[3].descr = "Huge page size to which chunk "
+			       "allocations are fitted (0 - disabled)";
+	pmalloc_clo[3].off = clo_field_offset(struct prog_args, chunk_align);
+	pmalloc_clo[3].def = "0";
+	pmalloc_clo[3].type = CLO_TYPE_UINT;
+	pmalloc_clo[3].type_uint.size =
+		clo_field_size(struct prog_args, chunk_align);
+	pmalloc_clo[3].type_uint.base = CLO_INT_BASE_DEC;
+	pmalloc_clo[3].type_uint.min = 0;
+	pmalloc_clo[3].type_uint.max = UINT64_MAX;
+
 	pmalloc_info.name = "pmalloc",
 	pmalloc_info.brief = "Benchmark for internal pmalloc() "
 			     "operation";
@@ -501,4 +554,22 @@ obj_pmalloc_constructor(void)
 	pmix_info.rm_file = true;
 	pmix_info.allow_poolset = true;
 	REGISTER_BENCHMARK(pmix_info);
+
+	paccess_info.name = "paccess";
+	paccess_info.brief = "Benchmark for random reads of allocated objects";
+	paccess_info.init = pfree_init; /* allocates all of the objects */
+
+	paccess_info.exit = pmalloc_exit; /* same as for pmalloc */
+	paccess_info.multithread = true;
+	paccess_info.multiops = true;
+	paccess_info.operation = paccess_op;
+	paccess_info.init_worker = pmix_worker_init;
+	paccess_info.free_worker = pmix_worker_fini;
+	paccess_info.measure_time = true;
+	paccess_info.clos = pmalloc_clo;
+	paccess_info.nclos = ARRAY_SIZE(pmalloc_clo);
+	paccess_info.opts_size = sizeof(struct prog_args);
+	paccess_info.rm_file = true;
+	paccess_info.allow_poolset = true;
+	REGISTER_BENCHMARK(paccess_info);
 };
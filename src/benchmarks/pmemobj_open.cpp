@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * pmemobj_open.cpp -- pool open benchmark definition
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <unistd.h>
+
+#include "benchmark.hpp"
+#include "file.h"
+#include "libpmemobj.h"
+
+#define LAYOUT_NAME "obj_open"
+
+/*
+ * prog_args - command line parsed arguments
+ */
+struct prog_args {
+	size_t pool_size;	   /* size of the created pool */
+	bool no_prefault;	   /* don't prefault the pool on open */
+	unsigned prefault_threads; /* value of the prefault.threads ctl */
+	size_t granularity;	   /* value of the prefault.granularity ctl */
+};
+
+/*
+ * obj_open_init -- benchmark initialization, creates the pool and sets up
+ * the prefault of the pool on open
+ */
+static int
+obj_open_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench != nullptr);
+	assert(args != nullptr);
+	assert(args->opts != nullptr);
+
+	auto *pa = (struct prog_args *)args->opts;
+
+	enum file_type type = util_file_get_type(args->fname);
+	if (type == OTHER_ERROR) {
+		fprintf(stderr, "could not check type of file %s\n",
+			args->fname);
+		return -1;
+	}
+
+	size_t psize = pa->pool_size;
+	if (args->is_poolset || type == TYPE_DEVDAX)
+		psize = 0;
+
+	PMEMobjpool *pop = pmemobj_create(args->fname, LAYOUT_NAME, psize,
+					  args->fmode);
+	if (pop == nullptr) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		return -1;
+	}
+	pmemobj_close(pop);
+
+	int at_open = !pa->no_prefault;
+	int threads = (int)pa->prefault_threads;
+	ssize_t granularity = (ssize_t)pa->granularity;
+
+	if (pmemobj_ctl_set(nullptr, "prefault.at_open", &at_open) != 0 ||
+	    pmemobj_ctl_set(nullptr, "prefault.threads", &threads) != 0 ||
+	    pmemobj_ctl_set(nullptr, "prefault.granularity", &granularity) !=
+		    0) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * obj_open_exit -- benchmark clean up
+ */
+static int
+obj_open_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	int at_open = 0;
+	pmemobj_ctl_set(nullptr, "prefault.at_open", &at_open);
+
+	return 0;
+}
+
+/*
+ * obj_open_op -- opens and closes the pool
+ */
+static int
+obj_open_op(struct benchmark *bench, struct operation_info *info)
+{
+	PMEMobjpool *pop = pmemobj_open(info->args->fname, LAYOUT_NAME);
+	if (pop == nullptr) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		return -1;
+	}
+
+	pmemobj_close(pop);
+
+	return 0;
+}
+
+static struct benchmark_clo obj_open_clo[4];
+static struct benchmark_info obj_open_info;
+
+CONSTRUCTOR(obj_open_constructor)
+void
+obj_open_constructor(void)
+{
+	obj_open_clo[0].opt_short = 's';
+	obj_open_clo[0].opt_long = "pool-size";
+	obj_open_clo[0].descr = "Size of the pool";
+	obj_open_clo[0].def = "1073741824";
+	obj_open_clo[0].off = clo_field_offset(struct prog_args, pool_size);
+	obj_open_clo[0].type = CLO_TYPE_UINT;
+	obj_open_clo[0].type_uint.size =
+		clo_field_size(struct prog_args, pool_size);
+	obj_open_clo[0].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
+	obj_open_clo[0].type_uint.min = PMEMOBJ_MIN_POOL;
+	obj_open_clo[0].type_uint.max = UINT64_MAX;
+
+	obj_open_clo[1].opt_short = 'n';
+	obj_open_clo[1].opt_long = "no-prefault";
+	obj_open_clo[1].descr = "Don't prefault the pool on open";
+	obj_open_clo[1].off = clo_field_offset(struct prog_args, no_prefault);
+	obj_open_clo[1].type = CLO_TYPE_FLAG;
+
+	obj_open_clo[2].opt_short = 't';
+	obj_open_clo[2].opt_long = "prefault-threads";
+	obj_open_clo[2].descr = "Number of threads prefaulting the pool, "
+				"0 for one per CPU";
+	obj_open_clo[2].def = "1";
+	obj_open_clo[2].off =
+		clo_field_offset(struct prog_args, prefault_threads);
+	obj_open_clo[2].type = CLO_TYPE_UINT;
+	obj_open_clo[2].type_uint.size =
+		clo_field_size(struct prog_args, prefault_threads);
+	obj_open_clo[2].type_uint.base = CLO_INT_BASE_DEC;
+	obj_open_clo[2].type_uint.min = 0;
+	obj_open_clo[2].type_uint.max = INT_MAX;
+
+	obj_open_clo[3].opt_short = 'g';
+	obj_open_clo[3].opt_long = "granularity";
+	obj_open_clo[3].descr = "Size of the chunks prefaulted by a thread "
+				"at a time";
+	obj_open_clo[3].def = "67108864";
+	obj_open_clo[3].off = clo_field_offset(struct prog_args, granularity);
+	obj_open_clo[3].type = CLO_TYPE_UINT;
+	obj_open_clo[3].type_uint.size =
+		clo_field_size(struct prog_args, granularity);
+	obj_open_clo[3].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
+	obj_open_clo[3].type_uint.min = 1;
+	obj_open_clo[3].type_uint.max = INT64_MAX;
+
+	obj_open_info.name = "obj_open";
+	obj_open_info.brief = "Benchmark for pmemobj_open() with prefault";
+	obj_open_info.init = obj_open_init;
+	obj_open_info.exit = obj_open_exit;
+	obj_open_info.multithread = false;
+	obj_open_info.multiops = true;
+	obj_open_info.operation = obj_open_op;
+	obj_open_info.measure_time = true;
+	obj_open_info.clos = obj_open_clo;
+	obj_open_info.nclos = ARRAY_SIZE(obj_open_clo);
+	obj_open_info.opts_size = sizeof(struct prog_args);
+	obj_open_info.rm_file = true;
+	obj_open_info.allow_poolset = true;
+	REGISTER_BENCHMARK(obj_open_info);
+}
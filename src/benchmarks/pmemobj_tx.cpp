@@ -56,6 +56,10 @@ enum op_mode {
 	OP_MODE_ONE_OBJ_NESTED,
 	OP_MODE_ONE_OBJ_RANGE,
 	OP_MODE_ONE_OBJ_NESTED_RANGE,
+	OP_MODE_ONE_OBJ_WRITE,
+	OP_MODE_ONE_OBJ_WRITE_REDO,
+	OP_MODE_ONE_OBJ_COMMIT,
+	OP_MODE_ONE_OBJ_GROUP_COMMIT,
 	OP_MODE_ALL_OBJ,
 	OP_MODE_ALL_OBJ_NESTED,
 	OP_MODE_UNKNOWN
@@ -83,7 +87,12 @@ enum nesting_mode {
 /*
  * add_range_mode -- operation type for obj_add_range benchmark
  */
-enum add_range_mode { ADD_RANGE_MODE_ONE_TX, ADD_RANGE_MODE_NESTED_TX };
+enum add_range_mode {
+	ADD_RANGE_MODE_ONE_TX,
+	ADD_RANGE_MODE_NESTED_TX,
+	ADD_RANGE_MODE_WRITE_TX,
+	ADD_RANGE_MODE_COMMIT_TX
+};
 
 /*
  * parse_mode -- parsing function type
@@ -129,6 +138,14 @@ struct obj_tx_args {
 	 *		  times in many nested transactions.
 	 *		- all-obj-nested - all objects are added to undo log in
 	 *		  many separate, nested transactions.
+	 *		- write - fields of one object are modified with
+	 *		  pmemobj_tx_write() in one transaction.
+	 *		- write-redo - same as write, but in a redo-only
+	 *		  transaction.
+	 *		- commit - one object is modified in many separate
+	 *		  transactions.
+	 *		- group-commit - same as commit, but the transactions
+	 *		  of all threads share the drain on commit.
 	 */
 	char *operation;
 
@@ -178,6 +195,8 @@ static struct obj_tx_bench {
 	int nesting_mode;   /* type of nesting in main operation */
 	fn_num_t n_oid;	    /* returns object's number in array */
 	fn_os_off_t fn_off; /* returns offset for proper operation */
+	char *write_buf;    /* source of pmemobj_tx_write() */
+	enum pobj_tx_param tx_param; /* transaction flavor of the writes */
 
 	/*
 	 * fn_type_num gets proper function assigned, depending on the
@@ -444,6 +463,70 @@ add_range_tx(struct obj_tx_bench *obj_bench, struct worker_info *worker,
 	return ret;
 }
 
+/*
+ * add_range_write_tx -- main operations of the obj_tx_add_range benchmark
+ * which modify the ranges through pmemobj_tx_write().
+ */
+static int
+add_range_write_tx(struct obj_tx_bench *obj_bench, struct worker_info *worker,
+		   size_t idx)
+{
+	int ret = 0;
+	size_t i = 0;
+	auto *obj_worker = (struct obj_tx_worker *)worker->priv;
+	TX_BEGIN_PARAM(obj_bench->pop, obj_bench->tx_param, TX_PARAM_NONE)
+	{
+		for (i = 0; i < obj_bench->obj_args->n_ops; i++) {
+			size_t n_oid = obj_bench->n_oid(i);
+			struct offset offset = obj_bench->fn_off(obj_bench, i);
+			auto *ptr = (char *)pmemobj_direct(
+				obj_worker->oids[n_oid].oid);
+			ret = pmemobj_tx_write(ptr + offset.off,
+					       obj_bench->write_buf +
+						       offset.off,
+					       offset.size);
+		}
+	}
+	TX_ONABORT
+	{
+		fprintf(stderr, "transaction failed\n");
+		ret = -1;
+	}
+	TX_END
+	return ret;
+}
+
+/*
+ * add_range_commit_tx -- main operations of the obj_tx_add_range benchmark
+ * which modify one object in many separate transactions.
+ */
+static int
+add_range_commit_tx(struct obj_tx_bench *obj_bench, struct worker_info *worker,
+		    size_t idx)
+{
+	auto *obj_worker = (struct obj_tx_worker *)worker->priv;
+	PMEMoid oid = obj_worker->oids[0].oid;
+	struct offset offset = obj_bench->fn_off(obj_bench, 0);
+	for (size_t i = 0; i < obj_bench->obj_args->n_ops; i++) {
+		volatile int ret = 0;
+		TX_BEGIN(obj_bench->pop)
+		{
+			pmemobj_tx_add_range(oid, offset.off, offset.size);
+			memset((char *)pmemobj_direct(oid) + offset.off,
+			       (int)i, offset.size);
+		}
+		TX_ONABORT
+		{
+			fprintf(stderr, "transaction failed\n");
+			ret = -1;
+		}
+		TX_END
+		if (ret != 0)
+			return ret;
+	}
+	return 0;
+}
+
 /*
  * obj_op_sim -- main function for benchmarks which simulates nested
  * transactions on dram or pmemobj atomic API by calling function recursively.
@@ -546,6 +629,14 @@ parse_op_mode_add_range(const char *arg)
 		return OP_MODE_ONE_OBJ_RANGE;
 	else if (strcmp(arg, "range-nested") == 0)
 		return OP_MODE_ONE_OBJ_NESTED_RANGE;
+	else if (strcmp(arg, "write") == 0)
+		return OP_MODE_ONE_OBJ_WRITE;
+	else if (strcmp(arg, "write-redo") == 0)
+		return OP_MODE_ONE_OBJ_WRITE_REDO;
+	else if (strcmp(arg, "commit") == 0)
+		return OP_MODE_ONE_OBJ_COMMIT;
+	else if (strcmp(arg, "group-commit") == 0)
+		return OP_MODE_ONE_OBJ_GROUP_COMMIT;
 	else if (strcmp(arg, "all-obj") == 0)
 		return OP_MODE_ALL_OBJ;
 	else if (strcmp(arg, "all-obj-nested") == 0)
@@ -577,7 +668,8 @@ static fn_op_t free_op[] = {free_dram, free_tx, free_pmem, no_free};
 
 static fn_op_t realloc_op[] = {realloc_dram, realloc_tx, realloc_pmem};
 
-static fn_op_t add_range_op[] = {add_range_tx, add_range_nested_tx};
+static fn_op_t add_range_op[] = {add_range_tx, add_range_nested_tx,
+				 add_range_write_tx, add_range_commit_tx};
 
 static fn_parse_t parse_op[] = {parse_op_mode, parse_op_mode_add_range};
 
@@ -824,7 +916,9 @@ obj_tx_add_range_init(struct benchmark *bench, struct benchmark_args *args)
 	}
 	obj_bench->fn_off = off_entire;
 	if (obj_bench->op_mode == OP_MODE_ONE_OBJ_RANGE ||
-	    obj_bench->op_mode == OP_MODE_ONE_OBJ_NESTED_RANGE) {
+	    obj_bench->op_mode == OP_MODE_ONE_OBJ_NESTED_RANGE ||
+	    obj_bench->op_mode == OP_MODE_ONE_OBJ_WRITE ||
+	    obj_bench->op_mode == OP_MODE_ONE_OBJ_WRITE_REDO) {
 		obj_bench->fn_off = off_range;
 		if (args->n_ops_per_thread > args->dsize)
 			args->dsize = args->n_ops_per_thread;
@@ -835,6 +929,36 @@ obj_tx_add_range_init(struct benchmark *bench, struct benchmark_args *args)
 			     obj_bench->op_mode == OP_MODE_ALL_OBJ)
 		? ADD_RANGE_MODE_ONE_TX
 		: ADD_RANGE_MODE_NESTED_TX;
+
+	obj_bench->write_buf = nullptr;
+	if (obj_bench->op_mode == OP_MODE_ONE_OBJ_WRITE ||
+	    obj_bench->op_mode == OP_MODE_ONE_OBJ_WRITE_REDO) {
+		obj_bench->lib_op = ADD_RANGE_MODE_WRITE_TX;
+		obj_bench->tx_param = obj_bench->op_mode == OP_MODE_ONE_OBJ_WRITE
+			? TX_PARAM_NONE
+			: TX_PARAM_REDO;
+
+		obj_bench->write_buf = (char *)malloc(args->dsize);
+		if (obj_bench->write_buf == nullptr) {
+			perror("malloc");
+			obj_tx_exit(bench, args);
+			return -1;
+		}
+		memset(obj_bench->write_buf, 0xc5, args->dsize);
+	}
+
+	if (obj_bench->op_mode == OP_MODE_ONE_OBJ_COMMIT ||
+	    obj_bench->op_mode == OP_MODE_ONE_OBJ_GROUP_COMMIT) {
+		obj_bench->lib_op = ADD_RANGE_MODE_COMMIT_TX;
+
+		int group = obj_bench->op_mode == OP_MODE_ONE_OBJ_GROUP_COMMIT;
+		if (pmemobj_ctl_set(obj_bench->pop, "tx.commit.group",
+				    &group) != 0) {
+			perror("pmemobj_ctl_set");
+			obj_tx_exit(bench, args);
+			return -1;
+		}
+	}
 	return 0;
 }
 
@@ -1068,6 +1192,17 @@ obj_tx_realloc_exit(struct benchmark *bench, struct benchmark_args *args)
 	return obj_tx_exit(bench, args);
 }
 
+/*
+ * obj_tx_add_range_exit -- exit function of the obj_tx_add_range benchmark.
+ */
+static int
+obj_tx_add_range_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *obj_bench = (struct obj_tx_bench *)pmembench_get_priv(bench);
+	free(obj_bench->write_buf);
+	return obj_tx_exit(bench, args);
+}
+
 /* Array defining common command line arguments. */
 static struct benchmark_clo obj_tx_clo[8];
 
@@ -1214,7 +1349,7 @@ pmemobj_tx_constructor(void)
 	obj_tx_add_range.name = "obj_tx_add_range";
 	obj_tx_add_range.brief = "pmemobj_tx_add_range() benchmark";
 	obj_tx_add_range.init = obj_tx_add_range_init;
-	obj_tx_add_range.exit = obj_tx_exit;
+	obj_tx_add_range.exit = obj_tx_add_range_exit;
 	obj_tx_add_range.multithread = true;
 	obj_tx_add_range.multiops = false;
 	obj_tx_add_range.init_worker = obj_tx_init_worker_alloc_obj;
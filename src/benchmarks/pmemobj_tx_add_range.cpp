@@ -47,6 +47,8 @@ struct ranged_obj {
 struct obj_bench_args {
 	uint64_t nranges;  /* number of allocated objects */
 	bool shuffle_objs; /* shuffles the array of allocated objects */
+	unsigned repeat;   /* number of times each range is added */
+	uint64_t tracker_threshold; /* tx.snapshot.tracker_threshold value */
 };
 
 /*
@@ -59,6 +61,7 @@ struct obj_bench {
 	uint64_t nranges;	   /* number of ranges */
 	uint64_t nallocs;	   /* number of allocations */
 	bool shuffle_objs;	   /* shuffles array of ranges */
+	unsigned repeat;	   /* number of times each range is added */
 	rng_t rng;		   /* PRNG */
 };
 
@@ -172,6 +175,16 @@ tx_add_range_init(struct benchmark *bench, struct benchmark_args *args)
 	ob->nranges = bargs->nranges;
 	ob->obj_size = args->dsize;
 	ob->shuffle_objs = bargs->shuffle_objs;
+	ob->repeat = bargs->repeat;
+
+	{
+		long long threshold = (long long)bargs->tracker_threshold;
+		if (pmemobj_ctl_set(ob->pop, "tx.snapshot.tracker_threshold",
+				    &threshold)) {
+			fprintf(stderr, "%s\n", pmemobj_errormsg());
+			goto err_pop_close;
+		}
+	}
 	randomize_r(&ob->rng, args->seed);
 
 	if (init_ranges(ob))
@@ -201,7 +214,8 @@ tx_add_range_op(struct benchmark *bench, struct operation_info *info)
 	{
 		for (size_t i = 0; i < ob->nranges; i++) {
 			struct ranged_obj *r = &ob->ranges[i];
-			pmemobj_tx_add_range_direct(r->ptr, r->size);
+			for (unsigned j = 0; j < ob->repeat; j++)
+				pmemobj_tx_add_range_direct(r->ptr, r->size);
 		}
 	}
 	TX_ONABORT
@@ -229,7 +243,7 @@ tx_add_range_exit(struct benchmark *bench, struct benchmark_args *args)
 	return 0;
 }
 
-static struct benchmark_clo tx_add_range_clo[2];
+static struct benchmark_clo tx_add_range_clo[4];
 
 /* Stores information about benchmark. */
 static struct benchmark_info tx_add_range_info;
@@ -260,6 +274,33 @@ tx_add_range_constructor(void)
 		clo_field_offset(struct obj_bench_args, shuffle_objs);
 	tx_add_range_clo[1].type = CLO_TYPE_FLAG;
 
+	tx_add_range_clo[2].opt_short = 0;
+	tx_add_range_clo[2].opt_long = "repeat";
+	tx_add_range_clo[2].descr = "Number of times each range is added";
+	tx_add_range_clo[2].def = "1";
+	tx_add_range_clo[2].off =
+		clo_field_offset(struct obj_bench_args, repeat);
+	tx_add_range_clo[2].type = CLO_TYPE_UINT;
+	tx_add_range_clo[2].type_uint.size =
+		clo_field_size(struct obj_bench_args, repeat);
+	tx_add_range_clo[2].type_uint.base = CLO_INT_BASE_DEC;
+	tx_add_range_clo[2].type_uint.min = 1;
+	tx_add_range_clo[2].type_uint.max = UINT_MAX;
+
+	tx_add_range_clo[3].opt_short = 0;
+	tx_add_range_clo[3].opt_long = "tracker-threshold";
+	tx_add_range_clo[3].descr = "Number of ranges after which the "
+				    "snapshot tracker is used, 0 disables it";
+	tx_add_range_clo[3].def = "64";
+	tx_add_range_clo[3].off =
+		clo_field_offset(struct obj_bench_args, tracker_threshold);
+	tx_add_range_clo[3].type = CLO_TYPE_UINT;
+	tx_add_range_clo[3].type_uint.size =
+		clo_field_size(struct obj_bench_args, tracker_threshold);
+	tx_add_range_clo[3].type_uint.base = CLO_INT_BASE_DEC;
+	tx_add_range_clo[3].type_uint.min = 0;
+	tx_add_range_clo[3].type_uint.max = LLONG_MAX;
+
 	tx_add_range_info.name = "pmemobj_tx_add_range";
 	tx_add_range_info.brief = "Benchmark for pmemobj_tx_add_range() "
 				  "operation";
@@ -43,6 +43,31 @@ void pmdk_asan_memcpy(void* dest_, const void* src_, size_t len) {
         }
 }
 
+// Checks memory which may include redzones or the persistent shadow memory
+__attribute__((no_sanitize("address")))
+int pmdk_asan_is_zeroed(const void* start_, size_t len) {
+	const uint8_t* start = (const uint8_t*)start_;
+	while (len && ((uintptr_t)start % sizeof(uint64_t))) {
+		if (*start)
+			return 0;
+		start++;
+		len--;
+	}
+	while (len >= sizeof(uint64_t)) {
+		if (*(const uint64_t*)start)
+			return 0;
+		start += sizeof(uint64_t);
+		len -= sizeof(uint64_t);
+	}
+	while (len) {
+		if (*start)
+			return 0;
+		start++;
+		len--;
+	}
+	return 1;
+}
+
 // len in bytes
 __attribute__((no_sanitize("address")))
 void pmdk_asan_mark_mem(void* shadow_in_pool_, uint64_t pool_offset, size_t len, uint8_t tag) {
@@ -17,6 +17,7 @@ uint8_t* pmdk_asan_get_shadow_mem_location(void* _p);
 
 void pmdk_asan_memset(void* start, uint8_t byt, size_t len);
 void pmdk_asan_memcpy(void* dest, const void* src, size_t len);
+int pmdk_asan_is_zeroed(const void* start, size_t len);
 
 void pmdk_asan_mark_mem(void* shadow_in_pool_, uint64_t pool_offset, size_t len, uint8_t tag);
 
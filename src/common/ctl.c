@@ -36,6 +36,16 @@ struct ctl {
 	int first_free;
 };
 
+/*
+ * A query name resolved once to its leaf node and the values of the indexes
+ * on the path to it. Neither of them changes between the queries, so they can
+ * be reused for as long as the tree the node was found in exists.
+ */
+struct ctl_handle {
+	const struct ctl_node *n;
+	struct ctl_indexes indexes;
+};
+
 /*
  * ctl_find_node -- (internal) searches for a matching entry point in the
  *	provided nodes
@@ -260,6 +270,27 @@ static int (*ctl_exec_query[MAX_CTL_QUERY_TYPE])(void *ctx,
 	ctl_exec_query_runnable,
 };
 
+/*
+ * ctl_resolve -- (internal) finds the node of the name, first in the global
+ *	tree and then in the tree of the pool
+ *
+ * The caller is responsible for freeing all of the allocated indexes,
+ * regardless of the return value.
+ */
+static const struct ctl_node *
+ctl_resolve(struct ctl *ctl, const char *name, struct ctl_indexes *indexes)
+{
+	const struct ctl_node *n = ctl_find_node(CTL_NODE(global),
+		name, indexes);
+
+	if (n == NULL && ctl) {
+		ctl_delete_indexes(indexes);
+		n = ctl_find_node(ctl->root, name, indexes);
+	}
+
+	return n;
+}
+
 /*
  * ctl_query -- (internal) parses the name and calls the appropriate methods
  *	from the ctl tree
@@ -287,13 +318,7 @@ ctl_query(struct ctl *ctl, void *ctx, enum ctl_query_source source,
 
 	int ret = -1;
 
-	const struct ctl_node *n = ctl_find_node(CTL_NODE(global),
-		name, &indexes);
-
-	if (n == NULL && ctl) {
-		ctl_delete_indexes(&indexes);
-		n = ctl_find_node(ctl->root, name, &indexes);
-	}
+	const struct ctl_node *n = ctl_resolve(ctl, name, &indexes);
 
 	if (n == NULL || n->type != CTL_NODE_LEAF || n->cb[type] == NULL) {
 		ERR("invalid query entry point %s", name);
@@ -309,6 +334,78 @@ out:
 	return ret;
 }
 
+/*
+ * ctl_compile -- resolves the name of the entry point so that it can be
+ *	queried repeatedly without parsing the name again
+ */
+struct ctl_handle *
+ctl_compile(struct ctl *ctl, const char *name)
+{
+	LOG(3, "ctl %p name %s", ctl, name);
+
+	if (name == NULL) {
+		ERR("invalid query");
+		errno = EINVAL;
+		return NULL;
+	}
+
+	struct ctl_handle *h = Malloc(sizeof(*h));
+	if (h == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	PMDK_SLIST_INIT(&h->indexes);
+
+	h->n = ctl_resolve(ctl, name, &h->indexes);
+	if (h->n == NULL || h->n->type != CTL_NODE_LEAF) {
+		ERR("invalid query entry point %s", name);
+		ctl_handle_delete(h);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	return h;
+}
+
+/*
+ * ctl_query_handle -- calls the appropriate method of the compiled entry point
+ */
+int
+ctl_query_handle(struct ctl_handle *h, void *ctx, enum ctl_query_type type,
+	void *arg)
+{
+	LOG(3, "h %p ctx %p type %d arg %p", h, ctx, type, arg);
+
+	if (h == NULL) {
+		ERR("invalid query handle");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (h->n->cb[type] == NULL) {
+		ERR("invalid query entry point %s", h->n->name);
+		errno = EINVAL;
+		return -1;
+	}
+
+	return ctl_exec_query[type](ctx, h->n, CTL_QUERY_PROGRAMMATIC, arg,
+		&h->indexes);
+}
+
+/*
+ * ctl_handle_delete -- frees the compiled entry point
+ */
+void
+ctl_handle_delete(struct ctl_handle *h)
+{
+	if (h == NULL)
+		return;
+
+	ctl_delete_indexes(&h->indexes);
+	Free(h);
+}
+
 /*
  * ctl_register_module_node -- adds a new node to the CTL tree root.
  */
@@ -134,6 +134,13 @@ ctl_node_##__VA_ARGS__##_##name
 int ctl_query(struct ctl *ctl, void *ctx, enum ctl_query_source source,
 		const char *name, enum ctl_query_type type, void *arg);
 
+struct ctl_handle;
+
+struct ctl_handle *ctl_compile(struct ctl *ctl, const char *name);
+int ctl_query_handle(struct ctl_handle *h, void *ctx,
+		enum ctl_query_type type, void *arg);
+void ctl_handle_delete(struct ctl_handle *h);
+
 /* Declaration of a new child node */
 #define CTL_CHILD(name, ...)\
 {CTL_STR(name), CTL_NODE_NAMED, {NULL, NULL, NULL}, NULL,\
@@ -153,8 +160,8 @@ ctl_##__VA_ARGS__##_##name##_write
 #define CTL_RUNNABLE_HANDLER(name, ...)\
 ctl_##__VA_ARGS__##_##name##_runnable
 
-#define CTL_ARG(name)\
-ctl_arg_##name
+#define CTL_ARG(name, ...)\
+ctl_arg_##__VA_ARGS__##_##name
 
 /*
  * Declaration of a new read-only leaf. If used the corresponding read function
@@ -171,7 +178,7 @@ ctl_arg_##name
 #define CTL_LEAF_WO(name, ...)\
 {CTL_STR(name), CTL_NODE_LEAF, \
 	{NULL, CTL_WRITE_HANDLER(name, __VA_ARGS__), NULL},\
-	&CTL_ARG(name), NULL}
+	&CTL_ARG(name, __VA_ARGS__), NULL}
 
 /*
  * Declaration of a new runnable leaf. If used the corresponding run
@@ -186,10 +193,11 @@ ctl_arg_##name
  * Declaration of a new read-write leaf. If used both read and write function
  * must be declared by CTL_READ_HANDLER and CTL_WRITE_HANDLER macros.
  */
-#define CTL_LEAF_RW(name)\
+#define CTL_LEAF_RW(name, ...)\
 {CTL_STR(name), CTL_NODE_LEAF,\
-	{CTL_READ_HANDLER(name), CTL_WRITE_HANDLER(name), NULL},\
-	&CTL_ARG(name), NULL}
+	{CTL_READ_HANDLER(name, __VA_ARGS__),\
+	CTL_WRITE_HANDLER(name, __VA_ARGS__), NULL},\
+	&CTL_ARG(name, __VA_ARGS__), NULL}
 
 #define CTL_REGISTER_MODULE(_ctl, name)\
 ctl_register_module_node((_ctl), CTL_STR(name),\
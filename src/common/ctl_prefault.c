@@ -52,12 +52,70 @@ CTL_WRITE_HANDLER(at_open)(void *ctx, enum ctl_query_source source,
 	return 0;
 }
 
+static int
+CTL_READ_HANDLER(threads)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	int *arg_out = arg;
+	*arg_out = (int)Prefault_threads;
+
+	return 0;
+}
+
+static int
+CTL_WRITE_HANDLER(threads)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	int arg_in = *(int *)arg;
+
+	if (arg_in < 0) {
+		ERR("invalid number of prefault threads, must not be negative");
+		errno = EINVAL;
+		return -1;
+	}
+
+	Prefault_threads = (unsigned)arg_in;
+
+	return 0;
+}
+
+static int
+CTL_READ_HANDLER(granularity)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	ssize_t *arg_out = arg;
+	*arg_out = (ssize_t)Prefault_granularity;
+
+	return 0;
+}
+
+static int
+CTL_WRITE_HANDLER(granularity)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in <= 0) {
+		ERR("invalid prefault granularity, must be positive");
+		errno = EINVAL;
+		return -1;
+	}
+
+	Prefault_granularity = (size_t)arg_in;
+
+	return 0;
+}
+
 static const struct ctl_argument CTL_ARG(at_create) = CTL_ARG_BOOLEAN;
 static const struct ctl_argument CTL_ARG(at_open) = CTL_ARG_BOOLEAN;
+static const struct ctl_argument CTL_ARG(threads) = CTL_ARG_INT;
+static const struct ctl_argument CTL_ARG(granularity) = CTL_ARG_LONG_LONG;
 
 static const struct ctl_node CTL_NODE(prefault)[] = {
 	CTL_LEAF_RW(at_create),
 	CTL_LEAF_RW(at_open),
+	CTL_LEAF_RW(threads),
+	CTL_LEAF_RW(granularity),
 
 	CTL_NODE_END
 };
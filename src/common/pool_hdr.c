@@ -280,6 +280,23 @@ static const char *str_2_pmempool_feature_map[] = {
 
 #define PMEMPOOL_FEATURE_2_STR_MAP_SIZE ARRAY_SIZE(str_2_pmempool_feature_map)
 
+/*
+ * Features set by the libraries themselves, which have no enum
+ * pmempool_feature equivalent and cannot be toggled with libpmempool.
+ * They are known by name only, so that the tools can print them.
+ */
+static const features_t lib_feature_map[] = {
+	FEAT_INCOMPAT(ULOG_FILL),	/* set by libpmemobj */
+};
+
+#define LIB_FEATURE_MAP_SIZE ARRAY_SIZE(lib_feature_map)
+
+static const char *str_2_lib_feature_map[] = {
+	"ULOG_FILL",
+};
+
+#define LIB_FEATURE_2_STR_MAP_SIZE ARRAY_SIZE(str_2_lib_feature_map)
+
 /*
  * util_str2feature -- convert string to feat_flags value
  */
@@ -333,6 +350,8 @@ util_str2pmempool_feature(const char *str)
 const char *
 util_feature2str(features_t features, features_t *found)
 {
+	COMPILE_ERROR_ON(LIB_FEATURE_MAP_SIZE != LIB_FEATURE_2_STR_MAP_SIZE);
+
 	for (uint32_t i = 0; i < FEAT_2_PMEMPOOL_FEATURE_MAP_SIZE; ++i) {
 		const features_t *record = &feature_2_pmempool_feature_map[i];
 		if (util_feature_is_set(features, *record)) {
@@ -341,5 +360,14 @@ util_feature2str(features_t features, features_t *found)
 			return str_2_pmempool_feature_map[i];
 		}
 	}
+
+	for (uint32_t i = 0; i < LIB_FEATURE_MAP_SIZE; ++i) {
+		const features_t *record = &lib_feature_map[i];
+		if (util_feature_is_set(features, *record)) {
+			if (found)
+				memcpy(found, record, sizeof(features_t));
+			return str_2_lib_feature_map[i];
+		}
+	}
 	return NULL;
 }
@@ -103,6 +103,8 @@ static void *Rpmem_handle_remote;
 
 int Prefault_at_open = 0;
 int Prefault_at_create = 0;
+unsigned Prefault_threads = 1;
+size_t Prefault_granularity = PREFAULT_GRANULARITY_DEFAULT;
 int SDS_at_create = POOL_FEAT_INCOMPAT_DEFAULT & POOL_E_FEAT_SDS ? 1 : 0;
 int Fallocate_at_create = 1;
 int COW_at_open = 0;
@@ -341,21 +343,269 @@ static const char *parser_errstr[PARSER_MAX_CODE] = {
 	"" /* format correct */
 };
 
+#if defined(__linux__) && !defined(MADV_POPULATE_WRITE)
+#define MADV_POPULATE_WRITE 23 /* since Linux 5.14 */
+#endif
+
 /*
- * util_replica_force_page_allocation - (internal) forces page allocation for
- * replica
+ * prefault_range -- state of the prefault shared by its threads
+ */
+struct prefault_range {
+	char *addr;
+	size_t size;
+	size_t granularity;
+	uint64_t next; /* offset of the next chunk to be prefaulted */
+};
+
+#ifdef MADV_POPULATE_WRITE
+/* cleared when the kernel turns out not to support MADV_POPULATE_WRITE */
+static int Prefault_populate = 1;
+#endif
+
+/*
+ * util_prefault_chunk -- (internal) forces page allocation for a chunk of
+ * the mapping, with a single madvise if the kernel allows it
  */
 static void
-util_replica_force_page_allocation(struct pool_replica *rep)
+util_prefault_chunk(char *addr, size_t len)
 {
-	volatile char *cur_addr = rep->part[0].addr;
-	char *addr_end = (char *)cur_addr + rep->resvsize;
+#ifdef MADV_POPULATE_WRITE
+	if (Prefault_populate) {
+		if (os_madvise(addr, len, MADV_POPULATE_WRITE) == 0)
+			return;
+
+		if (errno == EINVAL)
+			Prefault_populate = 0;
+	}
+#endif
+
+	volatile char *cur_addr = addr;
+	char *addr_end = addr + len;
 	for (; cur_addr < addr_end; cur_addr += Pagesize) {
 		*cur_addr = *cur_addr;
 		VALGRIND_SET_CLEAN(cur_addr, 1);
 	}
 }
 
+/*
+ * util_prefault_worker -- (internal) prefaults the chunks of the range until
+ * there are none left
+ */
+static void *
+util_prefault_worker(void *arg)
+{
+	struct prefault_range *range = arg;
+
+	uint64_t off;
+	while ((off = util_fetch_and_add64(&range->next,
+			range->granularity)) < range->size) {
+		size_t len = range->size - off;
+		if (len > range->granularity)
+			len = range->granularity;
+
+		util_prefault_chunk(range->addr + off, len);
+	}
+
+	return NULL;
+}
+
+/*
+ * util_replica_force_page_allocation - (internal) forces page allocation for
+ * replica
+ *
+ * The replica is split into chunks of Prefault_granularity bytes, which are
+ * prefaulted by Prefault_threads threads, including the calling one.
+ */
+static void
+util_replica_force_page_allocation(struct pool_replica *rep)
+{
+	struct prefault_range range;
+	range.addr = rep->part[0].addr;
+	range.size = rep->resvsize;
+	range.granularity = PAGE_ALIGNED_UP_SIZE(Prefault_granularity);
+	range.next = 0;
+
+	unsigned nthreads = Prefault_threads;
+	if (nthreads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = cpus > 0 ? (unsigned)cpus : 1;
+	}
+
+	size_t nchunks = (range.size + range.granularity - 1) /
+		range.granularity;
+	if (nthreads > nchunks)
+		nthreads = (unsigned)nchunks;
+
+	os_thread_t *threads = NULL;
+	unsigned started = 0;
+	if (nthreads > 1) {
+		threads = Malloc((nthreads - 1) * sizeof(*threads));
+		if (threads == NULL)
+			LOG(2, "!Malloc, prefaulting in a single thread");
+	}
+
+	/* the calling thread does its share even if no thread started */
+	for (unsigned i = 0; threads != NULL && i < nthreads - 1; ++i) {
+		if (os_thread_create(&threads[i], NULL,
+				util_prefault_worker, &range) != 0) {
+			LOG(2, "cannot create prefault thread %u", i);
+			break;
+		}
+		started++;
+	}
+
+	util_prefault_worker(&range);
+
+	for (unsigned i = 0; i < started; ++i)
+		os_thread_join(&threads[i], NULL);
+
+	Free(threads);
+}
+
+/*
+ * part_task_result -- outcome of a task run on a part
+ */
+struct part_task_result {
+	int ret;
+	int oerrno;
+	struct out_deferred *errors; /* errors to be reported by the caller */
+};
+
+/*
+ * part_tasks -- state of an operation run on many parts at once, shared by
+ * its threads
+ */
+struct part_tasks {
+	int (*task)(void *arg, unsigned idx);
+	void *arg;
+	unsigned ntasks;
+	unsigned next;		/* index of the next task to be run */
+	int failed;		/* no new tasks are started once set */
+	struct part_task_result *results;
+};
+
+/*
+ * util_part_tasks_worker -- (internal) runs the tasks until there are none
+ * left or one of them fails
+ */
+static void *
+util_part_tasks_worker(void *arg)
+{
+	struct part_tasks *tasks = arg;
+
+	while (1) {
+		int failed;
+		util_atomic_load_explicit32(&tasks->failed, &failed,
+			memory_order_acquire);
+		if (failed)
+			break;
+
+		unsigned idx = util_fetch_and_add32(&tasks->next, 1);
+		if (idx >= tasks->ntasks)
+			break;
+
+		struct part_task_result *res = &tasks->results[idx];
+
+		out_defer_start();
+		res->ret = tasks->task(tasks->arg, idx);
+		res->oerrno = errno;
+		res->errors = out_defer_stop();
+
+		if (res->ret != 0)
+			util_atomic_store_explicit32(&tasks->failed, 1,
+				memory_order_release);
+	}
+
+	return NULL;
+}
+
+/*
+ * util_part_tasks_run -- (internal) runs task(arg, idx) for every idx below
+ * ntasks in up to PART_THREADS_MAX threads, including the calling one
+ *
+ * The tasks are started in the order of their indexes and no new task is
+ * started after a failure. The errors of the tasks are reported in the order
+ * of their indexes up to the first failed one, as if the tasks were run one
+ * by one, so the result doesn't depend on timing.
+ */
+static int
+util_part_tasks_run(unsigned ntasks, int (*task)(void *arg, unsigned idx),
+	void *arg)
+{
+	LOG(3, "ntasks %u task %p arg %p", ntasks, task, arg);
+
+	struct part_task_result *results = NULL;
+	if (ntasks > 1) {
+		results = Zalloc(ntasks * sizeof(*results));
+		if (results == NULL)
+			LOG(2, "!Zalloc, processing parts one by one");
+	}
+
+	if (results == NULL) {
+		for (unsigned i = 0; i < ntasks; ++i) {
+			if (task(arg, i))
+				return -1;
+		}
+		return 0;
+	}
+
+	struct part_tasks tasks;
+	tasks.task = task;
+	tasks.arg = arg;
+	tasks.ntasks = ntasks;
+	tasks.next = 0;
+	tasks.failed = 0;
+	tasks.results = results;
+
+	unsigned nthreads = ntasks < PART_THREADS_MAX ?
+		ntasks : PART_THREADS_MAX;
+
+	os_thread_t *threads = Malloc((nthreads - 1) * sizeof(*threads));
+	if (threads == NULL)
+		LOG(2, "!Malloc, processing parts in a single thread");
+
+	/* the calling thread does its share even if no thread started */
+	unsigned started = 0;
+	for (unsigned i = 0; threads != NULL && i < nthreads - 1; ++i) {
+		if (os_thread_create(&threads[i], NULL,
+				util_part_tasks_worker, &tasks) != 0) {
+			LOG(2, "cannot create part thread %u", i);
+			break;
+		}
+		started++;
+	}
+
+	util_part_tasks_worker(&tasks);
+
+	for (unsigned i = 0; i < started; ++i)
+		os_thread_join(&threads[i], NULL);
+
+	Free(threads);
+
+	int ret = 0;
+	int oerrno = 0;
+	for (unsigned i = 0; i < ntasks; ++i) {
+		if (ret != 0) {
+			/* ran after the first failure, ignored */
+			out_deferred_delete(results[i].errors);
+			continue;
+		}
+
+		out_deferred_report(results[i].errors);
+		if (results[i].ret != 0) {
+			ret = -1;
+			oerrno = results[i].oerrno;
+		}
+	}
+
+	Free(results);
+
+	if (ret != 0)
+		errno = oerrno;
+
+	return ret;
+}
+
 /*
  * util_map_hdr -- map a header of a pool set
  */
@@ -1999,6 +2249,27 @@ util_poolset_remote_open(struct pool_replica *rep, unsigned repidx,
 	return 0;
 }
 
+/*
+ * part_open_args -- arguments of util_part_open_task
+ */
+struct part_open_args {
+	struct pool_replica *rep;
+	size_t minpartsize;
+	int create;
+};
+
+/*
+ * util_part_open_task -- (internal) opens or creates a part of the replica
+ */
+static int
+util_part_open_task(void *arg, unsigned p)
+{
+	struct part_open_args *args = arg;
+
+	return util_part_open(&args->rep->part[p], args->minpartsize,
+		args->create);
+}
+
 /*
  * util_poolset_files_local -- (internal) open or create all the local
  *                              part files of a pool set and replica sets
@@ -2008,14 +2279,17 @@ util_poolset_files_local(struct pool_set *set, size_t minpartsize, int create)
 {
 	LOG(3, "set %p minpartsize %zu create %d", set, minpartsize, create);
 
+	struct part_open_args args;
+	args.minpartsize = minpartsize;
+	args.create = create;
+
 	for (unsigned r = 0; r < set->nreplicas; r++) {
 		struct pool_replica *rep = set->replica[r];
 		if (!rep->remote) {
-			for (unsigned p = 0; p < rep->nparts; p++) {
-				if (util_part_open(&rep->part[p], minpartsize,
-						create))
-					return -1;
-			}
+			args.rep = rep;
+			if (util_part_tasks_run(rep->nparts,
+					util_part_open_task, &args))
+				return -1;
 		}
 	}
 
@@ -3675,6 +3949,85 @@ util_unmap_all_hdrs(struct pool_set *set)
 	}
 }
 
+/*
+ * header_check_args -- arguments of util_header_check_task
+ */
+struct header_check_args {
+	struct pool_set *set;
+	unsigned repidx;
+	const struct pool_attr *attr;
+};
+
+/*
+ * util_header_check_task -- (internal) checks a header of the replica
+ */
+static int
+util_header_check_task(void *arg, unsigned p)
+{
+	struct header_check_args *args = arg;
+
+	if (util_header_check(args->set, args->repidx, p, args->attr) != 0) {
+		LOG(2, "header check failed - part #%u", p);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * sds_collect_args -- arguments of util_part_sds_task
+ */
+struct sds_collect_args {
+	struct pool_replica *rep;
+	struct shutdown_state *parts_sds; /* shutdown state of each part */
+};
+
+/*
+ * util_part_sds_task -- (internal) reads the shutdown state of a part of the
+ * replica
+ */
+static int
+util_part_sds_task(void *arg, unsigned p)
+{
+	struct sds_collect_args *args = arg;
+	struct shutdown_state *sds = &args->parts_sds[p];
+
+	shutdown_state_init(sds, NULL);
+
+	return shutdown_state_add_part(sds, PART(args->rep, p)->fd, NULL);
+}
+
+/*
+ * util_replica_sds_collect -- (internal) reads the shutdown state of all the
+ * parts of the replica and sums it up
+ */
+static int
+util_replica_sds_collect(struct pool_replica *rep, struct shutdown_state *sds)
+{
+	LOG(3, "rep %p sds %p", rep, sds);
+
+	struct sds_collect_args args;
+	args.rep = rep;
+	args.parts_sds = Malloc(rep->nparts * sizeof(*args.parts_sds));
+	if (args.parts_sds == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	int ret = util_part_tasks_run(rep->nparts, util_part_sds_task, &args);
+	if (ret == 0) {
+		shutdown_state_init(sds, NULL);
+		for (unsigned p = 0; p < rep->nparts; p++)
+			shutdown_state_merge(sds, &args.parts_sds[p], NULL);
+	}
+
+	int oerrno = errno;
+	Free(args.parts_sds);
+	errno = oerrno;
+
+	return ret;
+}
+
 /*
  * util_replica_check -- check headers, check UUID's, check replicas linkage
  */
@@ -3688,13 +4041,16 @@ util_replica_check(struct pool_set *set, const struct pool_attr *attr)
 
 	for (unsigned r = 0; r < set->nreplicas; r++) {
 		struct pool_replica *rep = set->replica[r];
-		for (unsigned p = 0; p < rep->nhdrs; p++) {
-			if (util_header_check(set, r, p, attr) != 0) {
-				LOG(2, "header check failed - part #%d", p);
-				return -1;
-			}
+		struct header_check_args hargs;
+		hargs.set = set;
+		hargs.repidx = r;
+		hargs.attr = attr;
+		if (util_part_tasks_run(rep->nhdrs, util_header_check_task,
+				&hargs))
+			return -1;
+
+		for (unsigned p = 0; p < rep->nhdrs; p++)
 			set->rdonly |= rep->part[p].rdonly;
-		}
 
 		if (memcmp(HDR(REPP(set, r), 0)->uuid,
 					HDR(REP(set, r), 0)->prev_repl_uuid,
@@ -3708,12 +4064,8 @@ util_replica_check(struct pool_set *set, const struct pool_attr *attr)
 		}
 		if (!set->ignore_sds && !rep->remote && rep->nhdrs) {
 			struct shutdown_state sds;
-			shutdown_state_init(&sds, NULL);
-			for (unsigned p = 0; p < rep->nparts; p++) {
-				if (shutdown_state_add_part(&sds,
-						PART(rep, p)->fd, NULL))
-					return -1;
-			}
+			if (util_replica_sds_collect(rep, &sds))
+				return -1;
 
 			ASSERTne(rep->nhdrs, 0);
 			ASSERTne(rep->nparts, 0);
@@ -329,8 +329,16 @@ HDRP(struct pool_replica *rep, unsigned p)
 	return (struct pool_hdr *)(rep->part[HDRPidx(rep, p)].hdr);
 }
 
+/* size of the chunks of a replica prefaulted by a thread at a time */
+#define PREFAULT_GRANULARITY_DEFAULT (1ULL << 26) /* 64 MiB */
+
+/* maximum number of threads opening and checking the parts of a replica */
+#define PART_THREADS_MAX 16
+
 extern int Prefault_at_open;
 extern int Prefault_at_create;
+extern unsigned Prefault_threads;
+extern size_t Prefault_granularity;
 extern int SDS_at_create;
 extern int Fallocate_at_create;
 extern int COW_at_open;
@@ -120,6 +120,23 @@ err:
 	return 1;
 }
 
+/*
+ * shutdown_state_merge -- adds file uuid and usc gathered in another
+ * shutdown_state struct, e.g. by another thread, to shutdown_state struct
+ */
+void
+shutdown_state_merge(struct shutdown_state *sds,
+	const struct shutdown_state *part_sds, struct pool_replica *rep)
+{
+	LOG(3, "sds %p, part_sds %p", sds, part_sds);
+
+	sds->usc = htole64(le64toh(sds->usc) + le64toh(part_sds->usc));
+	sds->uuid = htole64(le64toh(sds->uuid) + le64toh(part_sds->uuid));
+
+	FLUSH_SDS(sds, rep);
+	shutdown_state_checksum(sds, rep);
+}
+
 /*
  * shutdown_state_set_dirty -- sets dirty pool flag
  */
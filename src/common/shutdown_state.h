@@ -26,6 +26,8 @@ struct shutdown_state {
 int shutdown_state_init(struct shutdown_state *sds, struct pool_replica *rep);
 int shutdown_state_add_part(struct shutdown_state *sds, int fd,
 	struct pool_replica *rep);
+void shutdown_state_merge(struct shutdown_state *sds,
+	const struct shutdown_state *part_sds, struct pool_replica *rep);
 void shutdown_state_set_dirty(struct shutdown_state *sds,
 	struct pool_replica *rep);
 void shutdown_state_clear_dirty(struct shutdown_state *sds,
@@ -11,6 +11,8 @@
 #include <pthread_np.h>
 #endif
 #include <semaphore.h>
+#include <sched.h>
+#include <errno.h>
 
 #include "os_thread.h"
 #include "util.h"
@@ -371,6 +373,20 @@ os_thread_setaffinity_np(os_thread_t *thread, size_t set_size,
 		(cpu_set_t *)set);
 }
 
+/*
+ * os_thread_getcpu -- sched_getcpu abstraction layer
+ */
+int
+os_thread_getcpu(void)
+{
+#ifdef __FreeBSD__
+	errno = ENOTSUP;
+	return -1;
+#else
+	return sched_getcpu();
+#endif
+}
+
 /*
  * os_cpu_zero -- CP_ZERO abstraction layer
  */
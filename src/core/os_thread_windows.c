@@ -538,6 +538,23 @@ os_thread_self(os_thread_t *thread)
 	internal_thread->thread_handle = GetCurrentThread();
 }
 
+/*
+ * os_thread_getcpu -- returns the number of the processor the calling thread
+ *	is running on
+ */
+int
+os_thread_getcpu(void)
+{
+	PROCESSOR_NUMBER proc;
+	GetCurrentProcessorNumberEx(&proc);
+
+	int cpu = (int)proc.Number;
+	for (WORD group = 0; group < proc.Group; ++group)
+		cpu += (int)GetActiveProcessorCount(group);
+
+	return cpu;
+}
+
 /*
  * os_cpu_zero -- clears cpu set
  */
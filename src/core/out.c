@@ -43,10 +43,24 @@ struct errormsg
 #ifdef _WIN32
 	wchar_t wmsg[MAXPRINT];
 #endif
+#ifndef NO_LIBPTHREAD
+	struct out_deferred *deferred; /* set while the errors are deferred */
+#endif
 };
 
 #ifndef NO_LIBPTHREAD
 
+/*
+ * out_deferred -- errors of a thread kept to be reported later, possibly by
+ * another thread
+ */
+struct out_deferred {
+	unsigned nerrors;
+	char *lines;	/* error log lines, in the order they were logged */
+	size_t len;
+	char msg[MAXPRINT]; /* the last error message */
+};
+
 static os_once_t Last_errormsg_key_once = OS_ONCE_INIT;
 static os_tls_key_t Last_errormsg_key;
 
@@ -94,6 +108,7 @@ Last_errormsg_get(void)
 			FATAL("!malloc");
 		/* make sure it contains empty string initially */
 		errormsg->msg[0] = '\0';
+		errormsg->deferred = NULL;
 		int ret = os_tls_set(Last_errormsg_key, errormsg);
 		if (ret)
 			FATAL("!os_tls_set");
@@ -403,6 +418,32 @@ end:
 #endif
 }
 
+#if defined(DEBUG) && !defined(NO_LIBPTHREAD)
+/*
+ * out_defer_line -- (internal) keeps the error log line if the errors of the
+ * calling thread are deferred
+ *
+ * Returns 0 if the line was kept.
+ */
+static int
+out_defer_line(struct out_deferred *deferred, const char *line)
+{
+	if (deferred == NULL)
+		return -1;
+
+	size_t len = strlen(line);
+	char *lines = realloc(deferred->lines, deferred->len + len + 1);
+	if (lines == NULL)
+		return -1;
+
+	memcpy(lines + deferred->len, line, len + 1);
+	deferred->lines = lines;
+	deferred->len += len;
+
+	return 0;
+}
+#endif
+
 /*
  * out_error -- common error output code, all error messages go through here
  */
@@ -422,6 +463,12 @@ out_error(const char *file, int line, const char *func,
 
 	char *errormsg = (char *)out_get_errormsg();
 
+#ifndef NO_LIBPTHREAD
+	struct out_deferred *deferred = Last_errormsg_get()->deferred;
+	if (deferred != NULL)
+		deferred->nerrors++;
+#endif
+
 	if (fmt) {
 		if (*fmt == '!') {
 			sep = ": ";
@@ -472,6 +519,10 @@ out_error(const char *file, int line, const char *func,
 		out_snprintf(&buf[cc], MAXPRINT - cc, "%s%s", errormsg,
 				suffix);
 
+#ifndef NO_LIBPTHREAD
+		if (out_defer_line(deferred, buf) == 0)
+			goto end;
+#endif
 		Print(buf);
 	}
 #endif
@@ -574,6 +625,80 @@ out_get_errormsg(void)
 	return &errormsg->msg[0];
 }
 
+#ifndef NO_LIBPTHREAD
+/*
+ * out_defer_start -- starts keeping the errors of the calling thread, instead
+ * of logging them, until out_defer_stop is called
+ *
+ * It allows a thread working on behalf of another one to hand its errors over
+ * to be reported by that thread, in an order which doesn't depend on timing.
+ */
+void
+out_defer_start(void)
+{
+	struct errormsg *errormsg = Last_errormsg_get();
+	ASSERTeq(errormsg->deferred, NULL);
+
+	/* without the memory, the errors are just logged right away */
+	errormsg->deferred = calloc(1, sizeof(struct out_deferred));
+}
+
+/*
+ * out_defer_stop -- stops keeping the errors of the calling thread and
+ * returns the ones kept since out_defer_start, or NULL if there were none
+ */
+struct out_deferred *
+out_defer_stop(void)
+{
+	int oerrno = errno;
+	struct errormsg *errormsg = Last_errormsg_get();
+	struct out_deferred *deferred = errormsg->deferred;
+	errormsg->deferred = NULL;
+
+	if (deferred != NULL && deferred->nerrors == 0) {
+		free(deferred);
+		deferred = NULL;
+	} else if (deferred != NULL) {
+		memcpy(deferred->msg, errormsg->msg, MAXPRINT);
+	}
+
+	errno = oerrno;
+	return deferred;
+}
+
+/*
+ * out_deferred_report -- logs the errors kept by out_defer_stop and makes
+ * the last of them the last error message of the calling thread
+ */
+void
+out_deferred_report(struct out_deferred *deferred)
+{
+	if (deferred == NULL)
+		return;
+
+	int oerrno = errno;
+	if (deferred->lines != NULL)
+		Print(deferred->lines);
+	memcpy(Last_errormsg_get()->msg, deferred->msg, MAXPRINT);
+
+	out_deferred_delete(deferred);
+	errno = oerrno;
+}
+
+/*
+ * out_deferred_delete -- drops the errors kept by out_defer_stop
+ */
+void
+out_deferred_delete(struct out_deferred *deferred)
+{
+	if (deferred == NULL)
+		return;
+
+	free(deferred->lines);
+	free(deferred);
+}
+#endif
+
 #ifdef _WIN32
 /*
  * out_get_errormsgW -- get the last error message in wchar_t
@@ -224,6 +224,12 @@ const char *out_get_errormsgU(void);
 const wchar_t *out_get_errormsgW(void);
 #endif
 
+struct out_deferred;
+void out_defer_start(void);
+struct out_deferred *out_defer_stop(void);
+void out_deferred_report(struct out_deferred *deferred);
+void out_deferred_delete(struct out_deferred *deferred);
+
 #ifdef __cplusplus
 }
 #endif
@@ -161,19 +161,28 @@ rbtree_map_rotate(TOID(struct rbtree_map) map,
 	TOID(struct tree_map_node) node, enum rb_children c)
 {
 	TOID(struct tree_map_node) child = D_RO(node)->slots[!c];
+	TOID(struct tree_map_node) grandchild = D_RO(child)->slots[c];
+	TOID(struct tree_map_node) parent = NODE_P(node);
 	TOID(struct tree_map_node) s = D_RO(map)->sentinel;
+	int location = NODE_LOCATION(node);
 
-	TX_ADD(node);
-	TX_ADD(child);
+	/* all of the modified fields are snapshotted at once */
+	struct pobj_tx_range ranges[] = {
+		{D_RO(node), sizeof(struct tree_map_node), 0},
+		{D_RO(child), sizeof(struct tree_map_node), 0},
+		{&D_RO(parent)->slots[location], sizeof(parent), 0},
+		{&D_RO(grandchild)->parent, sizeof(parent), 0},
+	};
+	pmemobj_tx_add_ranges(ranges, NODE_IS_NULL(grandchild) ? 3 : 4);
 
-	D_RW(node)->slots[!c] = D_RO(child)->slots[c];
+	D_RW(node)->slots[!c] = grandchild;
 
-	if (!TOID_EQUALS(D_RO(child)->slots[c], s))
-		TX_SET(D_RW(child)->slots[c], parent, node);
+	if (!NODE_IS_NULL(grandchild))
+		D_RW(grandchild)->parent = node;
 
-	NODE_P(child) = NODE_P(node);
+	NODE_P(child) = parent;
 
-	TX_SET(NODE_P(node), slots[NODE_LOCATION(node)], child);
+	D_RW(parent)->slots[location] = child;
 
 	D_RW(child)->slots[c] = node;
 	D_RW(node)->parent = child;
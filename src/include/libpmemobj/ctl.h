@@ -145,11 +145,92 @@ enum pobj_stats_enabled {
 	POBJ_STATS_DISABLED,
 };
 
+/*
+ * Destination of the latency histograms exported by stats.latency.json
+ */
+struct pobj_latency_json {
+	char *buf; /* buffer for the null-terminated document */
+	size_t size; /* size of the buffer */
+
+	/*
+	 * Length of the whole document, set by the query. The document
+	 * is truncated if it's not smaller than the size of the buffer.
+	 */
+	size_t len;
+};
+
+enum pobj_lane_assignment {
+	/* threads keep using the lane they acquired most recently */
+	POBJ_LANE_ASSIGNMENT_THREAD,
+	/* threads use the lanes assigned to the CPU they are running on */
+	POBJ_LANE_ASSIGNMENT_CPU,
+};
+
+/*
+ * Background compaction interface
+ *
+ * The compactor relocates objects out of sparsely used runs so that the
+ * memory can be returned to the heap. An object can only be moved if all of
+ * the persistent pointers to it are known, and so the application has to
+ * register, for every type number that holds pointers, a callback that
+ * enumerates the PMEMoids stored inside of an object of that type.
+ *
+ * The callback is called for every object of the registered type number and
+ * has to call the provided visit function on each PMEMoid that resides inside
+ * of that object. The root object is visited as an object of type number 0.
+ */
+typedef void (*pobj_compactor_visit_fn)(PMEMoid *ptr, void *visit_arg);
+
+typedef void (*pobj_compactor_enum_fn)(PMEMobjpool *pop, PMEMoid oid,
+	pobj_compactor_visit_fn visit, void *visit_arg, void *arg);
+
+/*
+ * Description of a type number handled by the compactor
+ */
+struct pobj_compactor_type_desc {
+	/*
+	 * The pointer enumeration callback, NULL if the type number
+	 * should not be processed by the compactor.
+	 */
+	pobj_compactor_enum_fn enum_ptrs;
+
+	/*
+	 * The argument passed to the enumeration callback.
+	 */
+	void *arg;
+};
+
+enum pobj_snapshot_method {
+	/* reflink the pool file if supported, copy it otherwise */
+	POBJ_SNAPSHOT_METHOD_ANY,
+	/* only reflink the pool file, fail if not supported */
+	POBJ_SNAPSHOT_METHOD_REFLINK,
+	/* always copy the contents of the pool file */
+	POBJ_SNAPSHOT_METHOD_COPY,
+};
+
+/*
+ * Description of a snapshot created by snapshot.create
+ */
+struct pobj_snapshot {
+	const char *path; /* path of the new file, must not exist */
+	enum pobj_snapshot_method method; /* allowed method */
+	enum pobj_snapshot_method used; /* method used, set by the query */
+};
+
+/*
+ * CTL query with the name of the entry point resolved once, created by
+ * pmemobj_ctl_compile
+ */
+struct pobj_ctl_handle;
+
 #ifndef _WIN32
 /* EXPERIMENTAL */
 int pmemobj_ctl_get(PMEMobjpool *pop, const char *name, void *arg);
 int pmemobj_ctl_set(PMEMobjpool *pop, const char *name, void *arg);
 int pmemobj_ctl_exec(PMEMobjpool *pop, const char *name, void *arg);
+struct pobj_ctl_handle *pmemobj_ctl_compile(PMEMobjpool *pop,
+	const char *name);
 #else
 int pmemobj_ctl_getU(PMEMobjpool *pop, const char *name, void *arg);
 int pmemobj_ctl_getW(PMEMobjpool *pop, const wchar_t *name, void *arg);
@@ -157,19 +238,31 @@ int pmemobj_ctl_setU(PMEMobjpool *pop, const char *name, void *arg);
 int pmemobj_ctl_setW(PMEMobjpool *pop, const wchar_t *name, void *arg);
 int pmemobj_ctl_execU(PMEMobjpool *pop, const char *name, void *arg);
 int pmemobj_ctl_execW(PMEMobjpool *pop, const wchar_t *name, void *arg);
+struct pobj_ctl_handle *pmemobj_ctl_compileU(PMEMobjpool *pop,
+	const char *name);
+struct pobj_ctl_handle *pmemobj_ctl_compileW(PMEMobjpool *pop,
+	const wchar_t *name);
 
 #ifndef PMDK_UTF8_API
 #define pmemobj_ctl_get pmemobj_ctl_getW
 #define pmemobj_ctl_set pmemobj_ctl_setW
 #define pmemobj_ctl_exec pmemobj_ctl_execW
+#define pmemobj_ctl_compile pmemobj_ctl_compileW
 #else
 #define pmemobj_ctl_get pmemobj_ctl_getU
 #define pmemobj_ctl_set pmemobj_ctl_setU
 #define pmemobj_ctl_exec pmemobj_ctl_execU
+#define pmemobj_ctl_compile pmemobj_ctl_compileU
 #endif
 
 #endif
 
+/* EXPERIMENTAL */
+int pmemobj_ctl_get_h(struct pobj_ctl_handle *handle, void *arg);
+int pmemobj_ctl_set_h(struct pobj_ctl_handle *handle, void *arg);
+int pmemobj_ctl_exec_h(struct pobj_ctl_handle *handle, void *arg);
+void pmemobj_ctl_handle_free(struct pobj_ctl_handle *handle);
+
 #ifdef __cplusplus
 }
 #endif
@@ -35,6 +35,22 @@ typedef union {
 	char padding[_POBJ_CL_SIZE];
 } PMEMcond;
 
+/*
+ * A single word lock, not padded to the cache line size.
+ */
+typedef union {
+	long long align;
+	char padding[8];
+} PMEMspinlock;
+
+/*
+ * A read/write lock whose readers don't write to it.
+ */
+typedef union {
+	long long align;
+	char padding[_POBJ_CL_SIZE];
+} PMEMsrwlock;
+
 void pmemobj_mutex_zero(PMEMobjpool *pop, PMEMmutex *mutexp);
 int pmemobj_mutex_lock(PMEMobjpool *pop, PMEMmutex *mutexp);
 int pmemobj_mutex_timedlock(PMEMobjpool *pop, PMEMmutex *__restrict mutexp,
@@ -64,6 +80,18 @@ int pmemobj_cond_timedwait(PMEMobjpool *pop, PMEMcond *__restrict condp,
 int pmemobj_cond_wait(PMEMobjpool *pop, PMEMcond *condp,
 	PMEMmutex *__restrict mutexp);
 
+void pmemobj_spinlock_zero(PMEMobjpool *pop, PMEMspinlock *lockp);
+int pmemobj_spinlock_lock(PMEMobjpool *pop, PMEMspinlock *lockp);
+int pmemobj_spinlock_trylock(PMEMobjpool *pop, PMEMspinlock *lockp);
+int pmemobj_spinlock_unlock(PMEMobjpool *pop, PMEMspinlock *lockp);
+
+void pmemobj_srwlock_zero(PMEMobjpool *pop, PMEMsrwlock *srwlockp);
+int pmemobj_srwlock_rdlock(PMEMobjpool *pop, PMEMsrwlock *srwlockp);
+int pmemobj_srwlock_wrlock(PMEMobjpool *pop, PMEMsrwlock *srwlockp);
+int pmemobj_srwlock_tryrdlock(PMEMobjpool *pop, PMEMsrwlock *srwlockp);
+int pmemobj_srwlock_trywrlock(PMEMobjpool *pop, PMEMsrwlock *srwlockp);
+int pmemobj_srwlock_unlock(PMEMobjpool *pop, PMEMsrwlock *srwlockp);
+
 #ifdef __cplusplus
 }
 #endif
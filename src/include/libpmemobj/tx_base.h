@@ -44,6 +44,8 @@ enum pobj_tx_param {
 	TX_PARAM_MUTEX,	 /* PMEMmutex */
 	TX_PARAM_RWLOCK, /* PMEMrwlock */
 	TX_PARAM_CB,	 /* pmemobj_tx_callback cb, void *arg */
+	TX_PARAM_REDO,	 /* no arguments */
+	TX_PARAM_WRITE_COMBINE,	/* no arguments */
 };
 
 enum pobj_log_type {
@@ -163,6 +165,49 @@ void pmemobj_tx_abort(int errnum);
  */
 void pmemobj_tx_commit(void);
 
+/*
+ * Starts the commit of current transaction, whose flush and drain are shared
+ * with the transactions committed concurrently by other threads. Returns
+ * before the transaction is persistent, which allows the thread to overlap
+ * other work with the drain. The commit is completed by pmemobj_tx_wait,
+ * pmemobj_tx_commit or pmemobj_tx_process (TX_END).
+ *
+ * The transaction must not be modified or aborted until the commit is
+ * completed. In a nested transaction it's equivalent to pmemobj_tx_commit.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+void pmemobj_tx_commit_async(void);
+
+/*
+ * Completes the commit started by pmemobj_tx_commit_async, causes transition
+ * to TX_STAGE_ONCOMMIT.
+ *
+ * Has no effect if there's no such commit.
+ */
+void pmemobj_tx_wait(void);
+
+struct pobj_tx_savepoint;
+
+/*
+ * Marks the current state of the transaction, so that the changes made after
+ * this point can be reverted without aborting the whole transaction.
+ *
+ * The savepoint is valid until the outermost transaction ends or until
+ * the transaction is rolled back to an older savepoint.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+struct pobj_tx_savepoint *pmemobj_tx_savepoint(void);
+
+/*
+ * Reverts the snapshotted ranges, allocations and frees made after the given
+ * savepoint. The savepoint remains valid.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_rollback_to(struct pobj_tx_savepoint *sp);
+
 /*
  * Cleanups current transaction. Must always be called after pmemobj_tx_begin,
  * even if starting the transaction failed.
@@ -254,6 +299,47 @@ int safe_pmemobj_tx_xadd_range(SafePMEMoid oid, uint64_t off, size_t size,
  */
 int pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags);
 
+struct pobj_tx_range {
+	const void *ptr;
+	size_t size;
+	uint64_t flags; /* POBJ_XADD_* flags */
+};
+
+/*
+ * Adds all of the given persistent memory ranges into the transaction, like
+ * a series of pmemobj_tx_xadd_range_direct calls would, but with the ranges
+ * sorted and merged first and their snapshots logged all at once.
+ *
+ * If any of the ranges has the POBJ_XADD_NO_ABORT flag, a failure does not
+ * abort the transaction.
+ *
+ * If successful, returns zero.
+ * Otherwise, stage changes to TX_STAGE_ONABORT and an error number is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_add_ranges(const struct pobj_tx_range *ranges, size_t nranges);
+
+/*
+ * Writes 'size' bytes from 'src' to the persistent memory pointed to by 'ptr'.
+ *
+ * In a transaction started with TX_PARAM_REDO, the data is buffered in DRAM
+ * and written to persistent memory, through the redo log, on commit.
+ * Otherwise, the range is snapshotted and modified in place.
+ *
+ * In a transaction started with TX_PARAM_WRITE_COMBINE, writes to objects
+ * allocated by the transaction are staged in DRAM and copied to persistent
+ * memory with non-temporal stores on commit. The staged data is visible
+ * only through pmemobj_tx_read.
+ */
+int pmemobj_tx_write(void *ptr, const void *src, size_t size);
+
+/*
+ * Reads 'size' bytes of the persistent memory pointed to by 'ptr' into 'dst',
+ * including the data buffered by pmemobj_tx_write.
+ */
+int pmemobj_tx_read(const void *ptr, void *dst, size_t size);
+
 /*
  * Transactionally allocates a new object.
  *
@@ -0,0 +1,306 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * addr_map.c -- direct-mapped table of non-overlapping address ranges
+ *
+ * The lookup of the range containing an address is a two-level radix
+ * table walk: the top level is indexed by the GiB of the address, each
+ * leaf by the 2 MiB entry within that GiB.  Unlike the critnib tree, a
+ * lookup costs the same two dependent loads no matter how many ranges are
+ * in the map.
+ *
+ * Every range has to be at least as large as an entry, so at most two
+ * ranges can share one: the one ending in the entry (lo) and the one
+ * starting in it (hi), with the start of the latter stored as the split
+ * point.  A range only partially covering the entry still owns its whole
+ * half, which is why addr_map_get returns a candidate the caller has to
+ * check against the actual bounds of the range.
+ */
+
+/*
+ * CONCURRENCY ISSUES
+ *
+ * Reads are lock-free, writes are serialized by a mutex.  Leaves are never
+ * freed before the whole map is deleted, so a reader racing with a write
+ * never follows a dangling pointer.  An entry updated while it's being read
+ * can yield a value of the range that's being inserted or removed, or no
+ * value at all, but never hides another range sharing the entry.
+ */
+
+#include <errno.h>
+
+#include "addr_map.h"
+#include "alloc.h"
+#include "out.h"
+#include "sys_util.h"
+#include "valgrind_internal.h"
+
+#define ADDR_MAP_ADDR_BITS 48 /* addresses above are never in the map */
+#define ADDR_MAP_LEAF_SHIFT 30 /* 1 GiB per leaf */
+#define ADDR_MAP_ENTRY_SHIFT 21 /* 2 MiB per entry */
+
+#define ADDR_MAP_LEAVES (1ULL << (ADDR_MAP_ADDR_BITS - ADDR_MAP_LEAF_SHIFT))
+#define ADDR_MAP_ENTRIES (1ULL << (ADDR_MAP_LEAF_SHIFT - ADDR_MAP_ENTRY_SHIFT))
+#define ADDR_MAP_ENTRY_SIZE (1ULL << ADDR_MAP_ENTRY_SHIFT)
+
+struct addr_map_entry {
+	uintptr_t split; /* start of the hi range */
+	void *lo; /* range ending in or covering the entry */
+	void *hi; /* range starting in or covering the entry */
+};
+
+struct addr_map_leaf {
+	struct addr_map_entry entries[ADDR_MAP_ENTRIES];
+};
+
+struct addr_map {
+	struct addr_map_leaf **leaves;
+
+	os_mutex_t mutex; /* inserts/removes */
+};
+
+/*
+ * atomic load
+ */
+static void *
+load(void *src)
+{
+	uint64_t v;
+	util_atomic_load_explicit64((uint64_t *)src, &v, memory_order_acquire);
+
+	return (void *)v;
+}
+
+/*
+ * atomic store
+ */
+static void
+store(void *dst, void *src)
+{
+	util_atomic_store_explicit64((uint64_t *)dst, (uint64_t)src,
+		memory_order_release);
+}
+
+/*
+ * addr_map_new -- allocates a new, empty map
+ */
+struct addr_map *
+addr_map_new(void)
+{
+	struct addr_map *m = Malloc(sizeof(struct addr_map));
+	if (m == NULL)
+		return NULL;
+
+	/* only the pages of the table covering used addresses get faulted */
+	m->leaves = Zalloc(ADDR_MAP_LEAVES * sizeof(*m->leaves));
+	if (m->leaves == NULL) {
+		Free(m);
+		return NULL;
+	}
+
+	util_mutex_init(&m->mutex);
+
+	VALGRIND_HG_DRD_DISABLE_CHECKING(m->leaves,
+		ADDR_MAP_LEAVES * sizeof(*m->leaves));
+
+	return m;
+}
+
+/*
+ * addr_map_delete -- destroys and frees a map
+ */
+void
+addr_map_delete(struct addr_map *m)
+{
+	for (uint64_t i = 0; i < ADDR_MAP_LEAVES; ++i)
+		Free(m->leaves[i]);
+
+	util_mutex_destroy(&m->mutex);
+
+	Free(m->leaves);
+	Free(m);
+}
+
+/*
+ * addr_map_entry_get -- (internal) returns the entry of the address, NULL if
+ *	its leaf doesn't exist
+ */
+static struct addr_map_entry *
+addr_map_entry_get(struct addr_map *m, uintptr_t addr)
+{
+	struct addr_map_leaf *leaf =
+		load(&m->leaves[addr >> ADDR_MAP_LEAF_SHIFT]);
+	if (leaf == NULL)
+		return NULL;
+
+	return &leaf->entries[(addr >> ADDR_MAP_ENTRY_SHIFT) &
+		(ADDR_MAP_ENTRIES - 1)];
+}
+
+/*
+ * addr_map_entry_alloc -- (internal) returns the entry of the address,
+ *	allocates its leaf if needed
+ */
+static struct addr_map_entry *
+addr_map_entry_alloc(struct addr_map *m, uintptr_t addr)
+{
+	struct addr_map_entry *e = addr_map_entry_get(m, addr);
+	if (e != NULL)
+		return e;
+
+	struct addr_map_leaf *leaf = Zalloc(sizeof(*leaf));
+	if (leaf == NULL)
+		return NULL;
+
+	VALGRIND_HG_DRD_DISABLE_CHECKING(leaf, sizeof(*leaf));
+
+	store(&m->leaves[addr >> ADDR_MAP_LEAF_SHIFT], leaf);
+
+	return addr_map_entry_get(m, addr);
+}
+
+/*
+ * addr_map_entry_free -- (internal) checks whether the part of the entry
+ *	covered by the range isn't taken by another range
+ */
+static int
+addr_map_entry_free(struct addr_map_entry *e, uintptr_t start, uintptr_t end,
+	uintptr_t entry)
+{
+	if (e == NULL)
+		return 1;
+
+	if (start > entry) /* the range begins in the entry */
+		return e->hi == NULL;
+
+	if (end < entry + ADDR_MAP_ENTRY_SIZE) /* the range ends in the entry */
+		return e->lo == NULL;
+
+	return e->lo == NULL && e->hi == NULL;
+}
+
+/*
+ * addr_map_insert -- inserts the [addr, addr + size) range
+ *
+ * Returns ERANGE if the range can't be represented in the map, in which case
+ * the caller has to look it up elsewhere.
+ */
+int
+addr_map_insert(struct addr_map *m, uintptr_t addr, size_t size, void *value)
+{
+	ASSERTne(value, NULL);
+
+	uintptr_t end = addr + size;
+	if (size < ADDR_MAP_ENTRY_SIZE || end < addr ||
+			end > (1ULL << ADDR_MAP_ADDR_BITS))
+		return ERANGE;
+
+	uintptr_t first = addr & ~(ADDR_MAP_ENTRY_SIZE - 1);
+	int ret = 0;
+
+	util_mutex_lock(&m->mutex);
+
+	for (uintptr_t e = first; e < end; e += ADDR_MAP_ENTRY_SIZE) {
+		if (!addr_map_entry_free(addr_map_entry_get(m, e),
+				addr, end, e)) {
+			ret = EEXIST;
+			goto out;
+		}
+	}
+
+	/* leaves are allocated up front, the map is never partially updated */
+	for (uintptr_t e = first; e < end; e += ADDR_MAP_ENTRY_SIZE) {
+		if (addr_map_entry_alloc(m, e) == NULL) {
+			ret = ENOMEM;
+			goto out;
+		}
+	}
+
+	for (uintptr_t e = first; e < end; e += ADDR_MAP_ENTRY_SIZE) {
+		struct addr_map_entry *entry = addr_map_entry_get(m, e);
+
+		if (addr > e) {
+			store(&entry->split, (void *)addr);
+			store(&entry->hi, value);
+		} else if (end < e + ADDR_MAP_ENTRY_SIZE) {
+			store(&entry->lo, value);
+			if (entry->hi == NULL)
+				store(&entry->split, (void *)end);
+		} else {
+			store(&entry->split, (void *)e);
+			store(&entry->lo, value);
+			store(&entry->hi, value);
+		}
+	}
+
+out:
+	util_mutex_unlock(&m->mutex);
+
+	return ret;
+}
+
+/*
+ * addr_map_remove -- removes the [addr, addr + size) range inserted with the
+ *	value, returns ENOENT if it's not in the map
+ */
+int
+addr_map_remove(struct addr_map *m, uintptr_t addr, size_t size, void *value)
+{
+	uintptr_t end = addr + size;
+	if (size < ADDR_MAP_ENTRY_SIZE || end < addr ||
+			end > (1ULL << ADDR_MAP_ADDR_BITS))
+		return ENOENT;
+
+	uintptr_t first = addr & ~(ADDR_MAP_ENTRY_SIZE - 1);
+	int ret = ENOENT;
+
+	util_mutex_lock(&m->mutex);
+
+	for (uintptr_t e = first; e < end; e += ADDR_MAP_ENTRY_SIZE) {
+		struct addr_map_entry *entry = addr_map_entry_get(m, e);
+		if (entry == NULL)
+			break;
+
+		if (addr > e) {
+			if (entry->hi != value)
+				break;
+			store(&entry->hi, NULL);
+		} else if (end < e + ADDR_MAP_ENTRY_SIZE) {
+			if (entry->lo != value)
+				break;
+			store(&entry->lo, NULL);
+		} else {
+			if (entry->lo != value)
+				break;
+			store(&entry->lo, NULL);
+			store(&entry->hi, NULL);
+		}
+
+		ret = 0;
+	}
+
+	util_mutex_unlock(&m->mutex);
+
+	return ret;
+}
+
+/*
+ * addr_map_get -- returns the value of the range which may contain the
+ *	address, NULL if there's none
+ */
+void *
+addr_map_get(struct addr_map *m, uintptr_t addr)
+{
+	if (addr >= (1ULL << ADDR_MAP_ADDR_BITS))
+		return NULL;
+
+	struct addr_map_entry *e = addr_map_entry_get(m, addr);
+	if (e == NULL)
+		return NULL;
+
+	if (addr < (uintptr_t)load(&e->split))
+		return load(&e->lo);
+
+	return load(&e->hi);
+}
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * addr_map.h -- internal definitions for the direct-mapped address ranges
+ */
+
+#ifndef LIBPMEMOBJ_ADDR_MAP_H
+#define LIBPMEMOBJ_ADDR_MAP_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct addr_map;
+
+struct addr_map *addr_map_new(void);
+void addr_map_delete(struct addr_map *m);
+
+int addr_map_insert(struct addr_map *m, uintptr_t addr, size_t size,
+	void *value);
+int addr_map_remove(struct addr_map *m, uintptr_t addr, size_t size,
+	void *value);
+void *addr_map_get(struct addr_map *m, uintptr_t addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -442,6 +442,25 @@ pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags) {
 	return pmemobj_tx_xadd_range_direct_no_asan(ptr, size, flags);
 }
 
+int
+pmemobj_tx_add_ranges(const struct pobj_tx_range *ranges, size_t nranges) {
+	for (size_t i = 0; i < nranges; ++i)
+		pmemobj_asan_verify_range_addressable((uint8_t*)ranges[i].ptr, ranges[i].size);
+	return pmemobj_tx_add_ranges_no_asan(ranges, nranges);
+}
+
+int
+pmemobj_tx_write(void *ptr, const void *src, size_t size) {
+	pmemobj_asan_verify_range_addressable(ptr, size);
+	return pmemobj_tx_write_no_asan(ptr, src, size);
+}
+
+int
+pmemobj_tx_read(const void *ptr, void *dst, size_t size) {
+	pmemobj_asan_verify_range_addressable((void*)ptr, size);
+	return pmemobj_tx_read_no_asan(ptr, dst, size);
+}
+
 //PMEMoid spmemobj_tx_strdup(const char *s, uint64_t type_num);
 //PMEMoid pmemobj_tx_xstrdup(const char *s, uint64_t type_num, uint64_t flags);
 //PMEMoid pmemobj_tx_wcsdup(const wchar_t *s, uint64_t type_num);
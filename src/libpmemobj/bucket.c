@@ -40,6 +40,8 @@ bucket_new(struct block_container *c, struct alloc_class *aclass)
 
 	b->is_active = 0;
 	b->active_memory_block = NULL;
+	b->nallocs = 0;
+	b->ncontended = 0;
 	if (aclass && aclass->type == CLASS_RUN) {
 		b->active_memory_block =
 			Zalloc(sizeof(struct memory_block_reserved));
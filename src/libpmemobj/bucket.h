@@ -32,6 +32,16 @@ struct bucket {
 
 	struct memory_block_reserved *active_memory_block;
 	int is_active;
+
+	/*
+	 * Statistics of the bucket. Buckets are private to an arena, which
+	 * makes the counters effectively per-thread, and they are only ever
+	 * modified on a cacheline that the thread already owns: the number of
+	 * reservations with the bucket lock held and the number of contended
+	 * acquisitions only after the lock turned out to be busy.
+	 */
+	uint64_t nallocs;
+	uint64_t ncontended;
 };
 
 struct bucket *bucket_new(struct block_container *c,
@@ -0,0 +1,692 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * compactor.c -- implementation of the background heap compactor
+ *
+ * The compactor periodically walks all of the objects in the heap, and for
+ * the ones with a registered type number asks the application to enumerate
+ * the persistent pointers stored inside of them. The pointed-to objects
+ * that reside in sparsely populated runs are then relocated with the same
+ * mechanism that is used by pmemobj_defrag.
+ *
+ * To bound the amount of work (and the size of the resulting redo logs)
+ * performed at once, a single tick processes at most max_runs runs, and the
+ * ticks of the background thread are separated by the configured interval.
+ *
+ * The enumerated pointers are the addresses of the pointer fields inside of
+ * the objects, and they are dereferenced and rewritten by the relocation.
+ * To keep them valid, all of the lanes are held for the whole tick, from
+ * the enumeration to the end of the relocation, so no other thread can
+ * allocate, free or transactionally modify any object in the meantime.
+ * Relocation rewrites the pointer fields inside of the objects of any type
+ * that reported them, not only of the relocated ones.
+ */
+
+#include <stdlib.h>
+
+#include "compactor.h"
+#include "heap.h"
+#include "lane.h"
+#include "obj.h"
+#include "os.h"
+#include "out.h"
+#include "os_thread.h"
+#include "sys_util.h"
+#include "vec.h"
+
+#define COMPACTOR_DEFAULT_INTERVAL_MS 1000
+#define COMPACTOR_DEFAULT_MAX_RUNS 16
+
+/*
+ * Only runs with fill ratio at or below this threshold are compacted, this
+ * matches the heuristic used by palloc_defrag.
+ */
+#define COMPACTOR_RUN_MAX_FILL_PCT 50
+
+#define NSEC_IN_MSEC 1000000ULL
+#define NSEC_IN_SEC 1000000000ULL
+
+struct compactor_type {
+	uint64_t type_num;
+	struct pobj_compactor_type_desc desc;
+};
+
+struct compactor_run {
+	uint32_t zone_id;
+	uint32_t chunk_id;
+	size_t unit_size;
+	size_t free_before; /* free bytes in the run before compaction */
+};
+
+VEC(compactor_types, struct compactor_type);
+VEC(compactor_ptrs, uint64_t *);
+VEC(compactor_runs, struct compactor_run);
+
+struct compactor {
+	PMEMobjpool *pop;
+
+	os_mutex_t lock; /* protects the configuration and the thread state */
+	os_cond_t cond;
+	os_thread_t thread;
+	int running;
+
+	uint64_t interval_ms;
+	unsigned max_runs;
+	struct compactor_types types;
+
+	os_mutex_t run_lock; /* serializes the compaction ticks */
+
+	uint64_t ticks;
+	uint64_t relocated;
+	uint64_t reclaimed;
+};
+
+/*
+ * compactor_visit_ctx -- state of a single pointer enumeration pass
+ */
+struct compactor_visit_ctx {
+	PMEMobjpool *pop;
+	struct compactor_ptrs ptrs;
+	int error;
+};
+
+/*
+ * compactor_new -- allocates a new, disabled, compactor
+ */
+struct compactor *
+compactor_new(PMEMobjpool *pop)
+{
+	struct compactor *c = Zalloc(sizeof(*c));
+	if (c == NULL) {
+		ERR("!Zalloc");
+		return NULL;
+	}
+
+	c->pop = pop;
+	util_mutex_init(&c->lock);
+	util_mutex_init(&c->run_lock);
+	util_cond_init(&c->cond);
+	c->running = 0;
+	c->interval_ms = COMPACTOR_DEFAULT_INTERVAL_MS;
+	c->max_runs = COMPACTOR_DEFAULT_MAX_RUNS;
+	VEC_INIT(&c->types);
+
+	return c;
+}
+
+/*
+ * compactor_delete -- stops the background thread and deletes the compactor
+ */
+void
+compactor_delete(struct compactor *c)
+{
+	if (c == NULL)
+		return;
+
+	compactor_set_enabled(c, 0);
+
+	VEC_DELETE(&c->types);
+	util_cond_destroy(&c->cond);
+	util_mutex_destroy(&c->run_lock);
+	util_mutex_destroy(&c->lock);
+	Free(c);
+}
+
+/*
+ * compactor_visit -- (internal) records a pointer reported by the
+ *	enumeration callback
+ */
+static void
+compactor_visit(PMEMoid *ptr, void *visit_arg)
+{
+	struct compactor_visit_ctx *ctx = visit_arg;
+
+	if (ptr == NULL || OID_IS_NULL(*ptr))
+		return;
+
+	/* pointers to other pools are of no interest to this one */
+	if (ptr->pool_uuid_lo != ctx->pop->uuid_lo)
+		return;
+
+	if (VEC_PUSH_BACK(&ctx->ptrs, &ptr->off) != 0)
+		ctx->error = 1;
+}
+
+/*
+ * compactor_find_type -- (internal) looks for the registration of the type
+ */
+static struct compactor_type *
+compactor_find_type(struct compactor_types *types, uint64_t type_num)
+{
+	struct compactor_type *t;
+	VEC_FOREACH_BY_PTR(t, types) {
+		if (t->type_num == type_num)
+			return t;
+	}
+
+	return NULL;
+}
+
+/*
+ * compactor_enumerate -- (internal) collects the pointers from all of the
+ *	objects with a registered type
+ */
+static int
+compactor_enumerate(struct compactor *c, struct compactor_types *types,
+	struct compactor_visit_ctx *ctx)
+{
+	PMEMobjpool *pop = c->pop;
+	struct palloc_heap *heap = &pop->heap;
+
+	for (uint64_t off = palloc_first(heap); off != 0;
+			off = palloc_next(heap, off)) {
+		/* the root is the only internal object with user pointers */
+		if ((palloc_flags(heap, off) & OBJ_INTERNAL_OBJECT_MASK) &&
+		    off != pop->root_offset)
+			continue;
+
+		struct compactor_type *t =
+			compactor_find_type(types, palloc_extra(heap, off));
+		if (t == NULL)
+			continue;
+
+		PMEMoid oid = {pop->uuid_lo, off};
+		t->desc.enum_ptrs(pop, oid, compactor_visit, ctx, t->desc.arg);
+
+		if (ctx->error) {
+			ERR("!VEC_PUSH_BACK");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * compactor_ptr_compare -- (internal) sorts pointers by the offset of the
+ *	object they point to
+ */
+static int
+compactor_ptr_compare(const void *lhs, const void *rhs)
+{
+	uint64_t l = **(uint64_t * const *)lhs;
+	uint64_t r = **(uint64_t * const *)rhs;
+
+	if (l > r)
+		return 1;
+	if (l < r)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * compactor_run_free -- (internal) calculates the number of free bytes
+ *	inside of a partially used run, returns 0 if the chunk is no longer
+ *	a run or the run is empty
+ */
+static size_t
+compactor_run_free(struct palloc_heap *heap, const struct compactor_run *r)
+{
+	struct memory_block m = MEMORY_BLOCK_NONE;
+	m.zone_id = r->zone_id;
+	m.chunk_id = r->chunk_id;
+
+	size_t free_bytes = 0;
+
+	os_mutex_t *lock = heap_get_run_lock(heap, m.chunk_id);
+	util_mutex_lock(lock);
+
+	if (heap_get_chunk_hdr(heap, &m)->type == CHUNK_TYPE_RUN) {
+		memblock_rebuild_state(heap, &m);
+
+		/*
+		 * Free space inside of an empty run is not fragmented,
+		 * the whole run can be reused by any allocation class.
+		 */
+		if (m.m_ops->fill_pct(&m) != 0) {
+			uint32_t free_space = 0;
+			uint32_t max_free_block = 0;
+			m.m_ops->calc_free(&m, &free_space, &max_free_block);
+			free_bytes = free_space * r->unit_size;
+		}
+	}
+
+	util_mutex_unlock(lock);
+
+	return free_bytes;
+}
+
+/*
+ * compactor_select -- (internal) picks up to max_runs sparsely used runs and
+ *	moves the pointers to the objects inside of them to the front of the
+ *	vector, returns the number of selected pointers
+ */
+static size_t
+compactor_select(struct compactor *c, struct compactor_ptrs *ptrs,
+	struct compactor_runs *runs, unsigned max_runs)
+{
+	struct palloc_heap *heap = &c->pop->heap;
+
+	qsort(VEC_ARR(ptrs), VEC_SIZE(ptrs), sizeof(uint64_t *),
+		compactor_ptr_compare);
+
+	size_t nselected = 0;
+	int selected = 0;
+	uint32_t prev_zone_id = UINT32_MAX;
+	uint32_t prev_chunk_id = UINT32_MAX;
+
+	/*
+	 * Objects inside of a single run occupy a contiguous range of offsets,
+	 * so after sorting all pointers into the same run are next to each
+	 * other and each run has to be examined only once.
+	 */
+	for (size_t i = 0; i < VEC_SIZE(ptrs); ++i) {
+		uint64_t *offp = VEC_ARR(ptrs)[i];
+		struct memory_block m = memblock_from_offset(heap, *offp);
+
+		if (m.type != MEMORY_BLOCK_RUN) {
+			selected = 0;
+			prev_zone_id = UINT32_MAX;
+			prev_chunk_id = UINT32_MAX;
+			continue;
+		}
+
+		if (m.zone_id != prev_zone_id || m.chunk_id != prev_chunk_id) {
+			prev_zone_id = m.zone_id;
+			prev_chunk_id = m.chunk_id;
+			selected = 0;
+
+			if (VEC_SIZE(runs) == max_runs)
+				break;
+
+			os_mutex_t *lock = m.m_ops->get_lock(&m);
+			util_mutex_lock(lock);
+			unsigned fill_pct = m.m_ops->fill_pct(&m);
+			uint32_t free_space = 0;
+			uint32_t max_free_block = 0;
+			m.m_ops->calc_free(&m, &free_space, &max_free_block);
+			util_mutex_unlock(lock);
+
+			if (fill_pct > COMPACTOR_RUN_MAX_FILL_PCT)
+				continue;
+
+			size_t unit_size = m.m_ops->block_size(&m);
+			struct compactor_run r = {m.zone_id, m.chunk_id,
+				unit_size, free_space * unit_size};
+			if (VEC_PUSH_BACK(runs, r) != 0)
+				break;
+
+			selected = 1;
+		}
+
+		if (selected)
+			VEC_ARR(ptrs)[nselected++] = offp;
+	}
+
+	return nselected;
+}
+
+/*
+ * compactor_run -- performs a single compaction pass
+ */
+int
+compactor_run(struct compactor *c, struct pobj_defrag_result *result)
+{
+	PMEMobjpool *pop = c->pop;
+	struct palloc_heap *heap = &pop->heap;
+	int ret = -1;
+
+	if (result) {
+		result->relocated = 0;
+		result->total = 0;
+	}
+
+	util_mutex_lock(&c->run_lock);
+
+	/*
+	 * The registrations are copied so that the enumeration callbacks
+	 * are free to reconfigure the compactor.
+	 */
+	struct compactor_types types;
+	VEC_INIT(&types);
+
+	util_mutex_lock(&c->lock);
+	unsigned max_runs = c->max_runs;
+	int err = VEC_RESERVE(&types, VEC_SIZE(&c->types));
+	if (err == 0) {
+		struct compactor_type *t;
+		VEC_FOREACH_BY_PTR(t, &c->types)
+			VEC_PUSH_BACK(&types, *t);
+	}
+	util_mutex_unlock(&c->lock);
+
+	if (err != 0) {
+		ERR("!VEC_RESERVE");
+		goto err_types;
+	}
+
+	struct compactor_visit_ctx ctx;
+	ctx.pop = pop;
+	ctx.error = 0;
+	VEC_INIT(&ctx.ptrs);
+
+	struct compactor_runs runs;
+	VEC_INIT(&runs);
+
+	/*
+	 * The objects, and the pointer fields inside of them, must not be
+	 * freed or modified between the enumeration and the relocation.
+	 */
+	if (lane_hold_all(pop) != 0)
+		goto out;
+
+	if (compactor_enumerate(c, &types, &ctx) != 0)
+		goto out_lanes;
+
+	size_t nptrs = compactor_select(c, &ctx.ptrs, &runs, max_runs);
+
+	struct pobj_defrag_result res = {0, 0};
+	if (nptrs != 0) {
+		struct operation_context *octx = pmalloc_operation_hold(pop);
+		err = palloc_defrag(heap, VEC_ARR(&ctx.ptrs), nptrs, octx,
+			&res);
+		pmalloc_operation_release(pop);
+
+		if (err != 0)
+			goto out_lanes;
+	}
+
+	/*
+	 * The effectiveness of the pass is measured as the difference in the
+	 * number of free bytes stranded inside of the partially used runs.
+	 */
+	size_t reclaimed = 0;
+	struct compactor_run *r;
+	VEC_FOREACH_BY_PTR(r, &runs) {
+		size_t free_after = compactor_run_free(heap, r);
+		if (r->free_before > free_after)
+			reclaimed += r->free_before - free_after;
+	}
+
+	util_fetch_and_add64(&c->ticks, 1);
+	util_fetch_and_add64(&c->relocated, res.relocated);
+	util_fetch_and_add64(&c->reclaimed, reclaimed);
+
+	LOG(3, "compacted %zu runs, relocated %zu objects, reclaimed %zu bytes",
+		VEC_SIZE(&runs), res.relocated, reclaimed);
+
+	if (result)
+		*result = res;
+
+	ret = 0;
+
+out_lanes:
+	lane_release_all(pop);
+out:
+	VEC_DELETE(&runs);
+	VEC_DELETE(&ctx.ptrs);
+err_types:
+	VEC_DELETE(&types);
+	util_mutex_unlock(&c->run_lock);
+
+	return ret;
+}
+
+/*
+ * compactor_wait -- (internal) sleeps until the next tick is due or until
+ *	the compactor is disabled, must be called with the lock held
+ */
+static void
+compactor_wait(struct compactor *c)
+{
+	struct timespec deadline;
+	os_clock_gettime(CLOCK_REALTIME, &deadline);
+
+	unsigned long long nsec = (unsigned long long)deadline.tv_nsec +
+		c->interval_ms * NSEC_IN_MSEC;
+	deadline.tv_sec += (time_t)(nsec / NSEC_IN_SEC);
+	deadline.tv_nsec = (long)(nsec % NSEC_IN_SEC);
+
+	while (c->running) {
+		if (os_cond_timedwait(&c->cond, &c->lock, &deadline) ==
+				ETIMEDOUT)
+			break;
+	}
+}
+
+/*
+ * compactor_worker -- (internal) the body of the background thread
+ */
+static void *
+compactor_worker(void *arg)
+{
+	struct compactor *c = arg;
+
+	util_mutex_lock(&c->lock);
+	for (;;) {
+		compactor_wait(c);
+		if (!c->running)
+			break;
+
+		util_mutex_unlock(&c->lock);
+		if (compactor_run(c, NULL) != 0)
+			LOG(2, "compaction pass failed");
+		util_mutex_lock(&c->lock);
+	}
+	util_mutex_unlock(&c->lock);
+
+	return NULL;
+}
+
+/*
+ * compactor_get_enabled -- returns whether the background thread is running
+ */
+int
+compactor_get_enabled(struct compactor *c)
+{
+	util_mutex_lock(&c->lock);
+	int enabled = c->running;
+	util_mutex_unlock(&c->lock);
+
+	return enabled;
+}
+
+/*
+ * compactor_set_enabled -- starts or stops the background thread
+ */
+int
+compactor_set_enabled(struct compactor *c, int enabled)
+{
+	util_mutex_lock(&c->lock);
+
+	if (enabled == c->running) {
+		util_mutex_unlock(&c->lock);
+		return 0;
+	}
+
+	if (enabled) {
+		if (c->pop->rdonly) {
+			util_mutex_unlock(&c->lock);
+			ERR("cannot compact a read-only pool");
+			errno = EINVAL;
+			return -1;
+		}
+
+		c->running = 1;
+		int ret = os_thread_create(&c->thread, NULL,
+			compactor_worker, c);
+		if (ret != 0) {
+			c->running = 0;
+			util_mutex_unlock(&c->lock);
+			errno = ret;
+			ERR("!os_thread_create");
+			return -1;
+		}
+
+		util_mutex_unlock(&c->lock);
+	} else {
+		c->running = 0;
+		os_cond_signal(&c->cond);
+		util_mutex_unlock(&c->lock);
+
+		os_thread_join(&c->thread, NULL);
+	}
+
+	return 0;
+}
+
+/*
+ * compactor_get_interval -- returns the time between two background passes
+ */
+uint64_t
+compactor_get_interval(struct compactor *c)
+{
+	util_mutex_lock(&c->lock);
+	uint64_t interval_ms = c->interval_ms;
+	util_mutex_unlock(&c->lock);
+
+	return interval_ms;
+}
+
+/*
+ * compactor_set_interval -- sets the time between two background passes
+ */
+int
+compactor_set_interval(struct compactor *c, uint64_t interval_ms)
+{
+	if (interval_ms == 0) {
+		ERR("compaction interval must be greater than 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	util_mutex_lock(&c->lock);
+	c->interval_ms = interval_ms;
+	util_mutex_unlock(&c->lock);
+
+	return 0;
+}
+
+/*
+ * compactor_get_max_runs -- returns the limit of runs processed in one pass
+ */
+unsigned
+compactor_get_max_runs(struct compactor *c)
+{
+	util_mutex_lock(&c->lock);
+	unsigned max_runs = c->max_runs;
+	util_mutex_unlock(&c->lock);
+
+	return max_runs;
+}
+
+/*
+ * compactor_set_max_runs -- sets the limit of runs processed in one pass
+ */
+int
+compactor_set_max_runs(struct compactor *c, unsigned max_runs)
+{
+	if (max_runs == 0) {
+		ERR("number of runs per pass must be greater than 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	util_mutex_lock(&c->lock);
+	c->max_runs = max_runs;
+	util_mutex_unlock(&c->lock);
+
+	return 0;
+}
+
+/*
+ * compactor_get_type -- reads the registration of the type number
+ */
+void
+compactor_get_type(struct compactor *c, uint64_t type_num,
+	struct pobj_compactor_type_desc *desc)
+{
+	util_mutex_lock(&c->lock);
+
+	struct compactor_type *t = compactor_find_type(&c->types, type_num);
+	if (t != NULL) {
+		*desc = t->desc;
+	} else {
+		desc->enum_ptrs = NULL;
+		desc->arg = NULL;
+	}
+
+	util_mutex_unlock(&c->lock);
+}
+
+/*
+ * compactor_set_type -- registers (or unregisters, if the callback is NULL)
+ *	the pointer enumeration callback of the type number
+ */
+int
+compactor_set_type(struct compactor *c, uint64_t type_num,
+	const struct pobj_compactor_type_desc *desc)
+{
+	int ret = 0;
+
+	util_mutex_lock(&c->lock);
+
+	struct compactor_type *t = compactor_find_type(&c->types, type_num);
+	if (desc->enum_ptrs == NULL) {
+		if (t != NULL)
+			VEC_ERASE_BY_PTR(&c->types, t);
+	} else if (t != NULL) {
+		t->desc = *desc;
+	} else {
+		struct compactor_type nt = {type_num, *desc};
+		if (VEC_PUSH_BACK(&c->types, nt) != 0) {
+			ERR("!VEC_PUSH_BACK");
+			ret = -1;
+		}
+	}
+
+	util_mutex_unlock(&c->lock);
+
+	return ret;
+}
+
+/*
+ * compactor_get_ticks -- returns the number of completed compaction passes
+ */
+uint64_t
+compactor_get_ticks(struct compactor *c)
+{
+	uint64_t ticks;
+	util_atomic_load_explicit64(&c->ticks, &ticks, memory_order_acquire);
+
+	return ticks;
+}
+
+/*
+ * compactor_get_relocated -- returns the number of relocated objects
+ */
+uint64_t
+compactor_get_relocated(struct compactor *c)
+{
+	uint64_t relocated;
+	util_atomic_load_explicit64(&c->relocated, &relocated,
+		memory_order_acquire);
+
+	return relocated;
+}
+
+/*
+ * compactor_get_reclaimed -- returns the number of fragmented bytes that
+ *	were reclaimed by the compaction passes
+ */
+uint64_t
+compactor_get_reclaimed(struct compactor *c)
+{
+	uint64_t reclaimed;
+	util_atomic_load_explicit64(&c->reclaimed, &reclaimed,
+		memory_order_acquire);
+
+	return reclaimed;
+}
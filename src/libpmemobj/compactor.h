@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * compactor.h -- internal definitions of the background heap compactor
+ */
+
+#ifndef LIBPMEMOBJ_COMPACTOR_H
+#define LIBPMEMOBJ_COMPACTOR_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libpmemobj.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct compactor;
+
+struct compactor *compactor_new(PMEMobjpool *pop);
+void compactor_delete(struct compactor *c);
+
+int compactor_get_enabled(struct compactor *c);
+int compactor_set_enabled(struct compactor *c, int enabled);
+
+uint64_t compactor_get_interval(struct compactor *c);
+int compactor_set_interval(struct compactor *c, uint64_t interval_ms);
+
+unsigned compactor_get_max_runs(struct compactor *c);
+int compactor_set_max_runs(struct compactor *c, unsigned max_runs);
+
+void compactor_get_type(struct compactor *c, uint64_t type_num,
+	struct pobj_compactor_type_desc *desc);
+int compactor_set_type(struct compactor *c, uint64_t type_num,
+	const struct pobj_compactor_type_desc *desc);
+
+int compactor_run(struct compactor *c, struct pobj_defrag_result *result);
+
+uint64_t compactor_get_ticks(struct compactor *c);
+uint64_t compactor_get_relocated(struct compactor *c);
+uint64_t compactor_get_reclaimed(struct compactor *c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -3,18 +3,49 @@
 
 /*
  * container_ravl.c -- implementation of ravl-based block container
+ *
+ * The blocks are segregated by size into a number of trees, in a fashion
+ * similar to the two-level index of TLSF: the first level is the most
+ * significant bit of the size, and the second level linearly subdivides
+ * each power of two range. A bitmap of nonempty trees allows to find the
+ * tree that contains the best-fit block in constant time, and keeps the trees
+ * searched and modified on the allocation path small.
  */
 
 #include "container_ravl.h"
 #include "ravl.h"
 #include "out.h"
 #include "sys_util.h"
+#include "util.h"
+
+/* number of bits used for the linear subdivision of a power of two range */
+#define RAVL_BIN_SL_BITS 2U
+#define RAVL_BINS 64U
 
 struct block_container_ravl {
 	struct block_container super;
-	struct ravl *tree;
+	struct ravl *trees[RAVL_BINS];
+	uint64_t nonempty_trees;
 };
 
+/*
+ * container_ravl_bin -- (internal) returns the index of the tree that stores
+ *	blocks of the given size
+ */
+static unsigned
+container_ravl_bin(uint32_t size_idx)
+{
+	if (size_idx < (1U << RAVL_BIN_SL_BITS))
+		return size_idx;
+
+	unsigned fl = util_mssb_index(size_idx);
+	unsigned sl = (size_idx >> (fl - RAVL_BIN_SL_BITS)) &
+		((1U << RAVL_BIN_SL_BITS) - 1);
+	unsigned bin = ((fl - RAVL_BIN_SL_BITS + 1) << RAVL_BIN_SL_BITS) + sl;
+
+	return bin < RAVL_BINS ? bin : RAVL_BINS - 1;
+}
+
 /*
  * container_compare_memblocks -- (internal) compares two memory blocks
  */
@@ -61,7 +92,26 @@ container_ravl_insert_block(struct block_container *bc,
 	VALGRIND_SET_CLEAN(e, sizeof(*e));
 	VALGRIND_REMOVE_FROM_TX(e, sizeof(*e));
 
-	return ravl_insert(c->tree, e);
+	unsigned bin = container_ravl_bin(m->size_idx);
+	if (ravl_insert(c->trees[bin], e) != 0)
+		return -1;
+
+	c->nonempty_trees |= 1ULL << bin;
+
+	return 0;
+}
+
+/*
+ * container_ravl_remove -- (internal) removes the node from the tree and
+ *	marks the tree as empty if necessary
+ */
+static void
+container_ravl_remove(struct block_container_ravl *c, unsigned bin,
+	struct ravl_node *n)
+{
+	ravl_remove(c->trees[bin], n);
+	if (ravl_empty(c->trees[bin]))
+		c->nonempty_trees &= ~(1ULL << bin);
 }
 
 /*
@@ -75,16 +125,30 @@ container_ravl_get_rm_block_bestfit(struct block_container *bc,
 	struct block_container_ravl *c =
 		(struct block_container_ravl *)bc;
 
-	struct ravl_node *n = ravl_find(c->tree, m,
-		RAVL_PREDICATE_GREATER_EQUAL);
-	if (n == NULL)
-		return ENOMEM;
+	/*
+	 * Only the tree that serves the requested size can contain blocks
+	 * that are too small, every block in the subsequent trees fits.
+	 */
+	unsigned bin = container_ravl_bin(m->size_idx);
+	uint64_t v = c->nonempty_trees & ~((1ULL << bin) - 1);
 
-	struct memory_block *e = ravl_data(n);
-	*m = *e;
-	ravl_remove(c->tree, n);
+	while (v != 0) {
+		unsigned i = util_lssb_index64(v);
 
-	return 0;
+		struct ravl_node *n = ravl_find(c->trees[i], m,
+			RAVL_PREDICATE_GREATER_EQUAL);
+		if (n != NULL) {
+			struct memory_block *e = ravl_data(n);
+			*m = *e;
+			container_ravl_remove(c, i, n);
+
+			return 0;
+		}
+
+		v &= ~(1ULL << i);
+	}
+
+	return ENOMEM;
 }
 
 /*
@@ -98,11 +162,13 @@ container_ravl_get_rm_block_exact(struct block_container *bc,
 	struct block_container_ravl *c =
 		(struct block_container_ravl *)bc;
 
-	struct ravl_node *n = ravl_find(c->tree, m, RAVL_PREDICATE_EQUAL);
+	unsigned bin = container_ravl_bin(m->size_idx);
+	struct ravl_node *n = ravl_find(c->trees[bin], m,
+		RAVL_PREDICATE_EQUAL);
 	if (n == NULL)
 		return ENOMEM;
 
-	ravl_remove(c->tree, n);
+	container_ravl_remove(c, bin, n);
 
 	return 0;
 }
@@ -116,7 +182,7 @@ container_ravl_is_empty(struct block_container *bc)
 	struct block_container_ravl *c =
 		(struct block_container_ravl *)bc;
 
-	return ravl_empty(c->tree);
+	return c->nonempty_trees == 0;
 }
 
 /*
@@ -128,7 +194,10 @@ container_ravl_rm_all(struct block_container *bc)
 	struct block_container_ravl *c =
 		(struct block_container_ravl *)bc;
 
-	ravl_clear(c->tree);
+	for (unsigned i = 0; i < RAVL_BINS; ++i)
+		ravl_clear(c->trees[i]);
+
+	c->nonempty_trees = 0;
 }
 
 /*
@@ -140,15 +209,16 @@ container_ravl_destroy(struct block_container *bc)
 	struct block_container_ravl *c =
 		(struct block_container_ravl *)bc;
 
-	ravl_delete(c->tree);
+	for (unsigned i = 0; i < RAVL_BINS; ++i)
+		ravl_delete(c->trees[i]);
 
 	Free(bc);
 }
 
 /*
  * Tree-based block container used to provide best-fit functionality to the
- * bucket. The time complexity for this particular container is O(k) where k is
- * the length of the key.
+ * bucket. Finding the right tree takes constant time, and the time complexity
+ * of the tree operations is O(k) where k is the length of the key.
  *
  * The get methods also guarantee that the block with lowest possible address
  * that best matches the requirements is provided.
@@ -174,9 +244,16 @@ container_new_ravl(struct palloc_heap *heap)
 
 	bc->super.heap = heap;
 	bc->super.c_ops = &container_ravl_ops;
-	bc->tree = ravl_new(container_compare_memblocks);
-	if (bc->tree == NULL)
-		goto error_ravl_new;
+	bc->nonempty_trees = 0;
+
+	for (unsigned i = 0; i < RAVL_BINS; ++i) {
+		bc->trees[i] = ravl_new(container_compare_memblocks);
+		if (bc->trees[i] == NULL) {
+			while (i != 0)
+				ravl_delete(bc->trees[--i]);
+			goto error_ravl_new;
+		}
+	}
 
 	return (struct block_container *)&bc->super;
 
@@ -32,6 +32,12 @@
 #define HEAP_DEFAULT_GROW_SIZE (1 << 27) /* 128 megabytes */
 #define MAX_DEFAULT_ARENAS (1 << 10) /* 1024 arenas */
 
+/*
+ * This is the maximum number of free chunks kept aside in the huge cache of
+ * a single arena. Blocks larger than that always go to the default bucket.
+ */
+#define HEAP_HUGE_CACHE_CHUNKS 256 /* 64 megabytes */
+
 struct arenas {
 	VEC(, struct arena *) vec;
 	size_t nactive;
@@ -42,6 +48,14 @@ struct arenas {
 	 */
 	os_mutex_t lock;
 
+	/*
+	 * Taken in addition to the lock above when the vector is modified.
+	 * This allows to traverse the arenas with buckets already locked,
+	 * as long as no locks other than the huge cache buckets are taken
+	 * during the traversal.
+	 */
+	os_mutex_t vec_lock;
+
 	/* stores a pointer to one of the arenas */
 	os_tls_key_t thread;
 };
@@ -62,6 +76,14 @@ struct arena {
 	int automatic;
 	size_t nthreads;
 	struct arenas *arenas;
+
+	/*
+	 * Free huge blocks kept aside for the threads of this arena, so that
+	 * frequent huge allocations don't contend on the default bucket.
+	 * These blocks are not coalesced until returned to the default bucket.
+	 */
+	struct bucket *huge_cache;
+	size_t huge_cached; /* number of chunks in the huge cache */
 };
 
 struct heap_rt {
@@ -79,6 +101,10 @@ struct heap_rt {
 
 	unsigned nzones;
 	unsigned zones_exhausted;
+	unsigned zones_booted; /* zones already initialized on heap boot */
+
+	/* huge page size to which chunk allocations are fitted, 0 if none */
+	size_t chunk_align;
 };
 
 /*
@@ -88,6 +114,7 @@ static int
 heap_arenas_init(struct arenas *arenas)
 {
 	util_mutex_init(&arenas->lock);
+	util_mutex_init(&arenas->vec_lock);
 	VEC_INIT(&arenas->vec);
 	arenas->nactive = 0;
 
@@ -103,6 +130,7 @@ static void
 heap_arenas_fini(struct arenas *arenas)
 {
 	util_mutex_destroy(&arenas->lock);
+	util_mutex_destroy(&arenas->vec_lock);
 	VEC_DELETE(&arenas->vec);
 }
 
@@ -124,6 +152,8 @@ heap_arena_delete(struct arena *arena)
 	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
 		if (arena->buckets[i] != NULL)
 			bucket_delete(arena->buckets[i]);
+	if (arena->huge_cache != NULL)
+		bucket_delete(arena->huge_cache);
 	Free(arena);
 }
 
@@ -158,6 +188,12 @@ heap_arena_new(struct palloc_heap *heap, int automatic)
 		}
 	}
 
+	arena->huge_cached = 0;
+	arena->huge_cache = bucket_new(container_new_ravl(heap),
+		alloc_class_by_id(rt->alloc_classes, DEFAULT_ALLOC_CLASS_ID));
+	if (arena->huge_cache == NULL)
+		goto error_bucket_create;
+
 	return arena;
 
 error_bucket_create:
@@ -346,7 +382,10 @@ heap_bucket_acquire(struct palloc_heap *heap, uint8_t class_id,
 	}
 
 out:
-	util_mutex_lock(&b->lock);
+	if (util_mutex_trylock(&b->lock) != 0) {
+		util_fetch_and_add64(&b->ncontended, 1);
+		util_mutex_lock(&b->lock);
+	}
 
 	return b;
 }
@@ -360,6 +399,81 @@ heap_bucket_release(struct palloc_heap *heap, struct bucket *b)
 	util_mutex_unlock(&b->lock);
 }
 
+/*
+ * heap_huge_cache_arena -- (internal) returns the arena whose huge cache
+ *	should be used, or NULL if the huge caches are not in use
+ */
+static struct arena *
+heap_huge_cache_arena(struct palloc_heap *heap, uint16_t arena_id)
+{
+	/* the placement of aligned blocks is decided by the default bucket */
+	if (heap->rt->chunk_align != 0)
+		return NULL;
+
+	if (arena_id == HEAP_ARENA_PER_THREAD)
+		return heap_thread_arena(heap);
+
+	return VEC_ARR(&heap->rt->arenas.vec)[arena_id - 1];
+}
+
+/*
+ * heap_huge_cache_drain -- (internal) moves all blocks from the huge cache of
+ *	the arena to the default bucket
+ *
+ * Returns 0 if any block was moved.
+ */
+static int
+heap_huge_cache_drain(struct palloc_heap *heap, struct arena *a,
+	struct bucket *defb)
+{
+	struct bucket *b = a->huge_cache;
+	int ret = ENOMEM;
+
+	util_mutex_lock(&b->lock);
+
+	struct memory_block m = MEMORY_BLOCK_NONE;
+	m.size_idx = 1;
+	while (b->c_ops->get_rm_bestfit(b->container, &m) == 0) {
+		a->huge_cached -= m.size_idx;
+		if (heap_free_chunk_reuse(heap, defb, &m) != 0)
+			LOG(2, "unable to track runtime chunk state");
+		ret = 0;
+
+		m = MEMORY_BLOCK_NONE;
+		m.size_idx = 1;
+	}
+
+	ASSERTeq(a->huge_cached, 0);
+
+	util_mutex_unlock(&b->lock);
+
+	return ret;
+}
+
+/*
+ * heap_huge_caches_drain -- (internal) moves all blocks from the huge caches
+ *	of all arenas to the default bucket, which must be locked by the caller
+ *
+ * Returns 0 if any block was moved.
+ */
+static int
+heap_huge_caches_drain(struct palloc_heap *heap, struct bucket *defb)
+{
+	int ret = ENOMEM;
+
+	util_mutex_lock(&heap->rt->arenas.vec_lock);
+
+	struct arena *a;
+	VEC_FOREACH(a, &heap->rt->arenas.vec) {
+		if (heap_huge_cache_drain(heap, a, defb) == 0)
+			ret = 0;
+	}
+
+	util_mutex_unlock(&heap->rt->arenas.vec_lock);
+
+	return ret;
+}
+
 /*
  * heap_get_run_lock -- returns the lock associated with memory block
  */
@@ -730,6 +844,10 @@ heap_ensure_huge_bucket_filled(struct palloc_heap *heap, struct bucket *bucket)
 	if (heap_populate_bucket(heap, bucket) == 0)
 		return 0;
 
+	/* free chunks set aside by the arenas might be enough */
+	if (heap_huge_caches_drain(heap, bucket) == 0)
+		return 0;
+
 	int extend;
 	if ((extend = heap_extend(heap, bucket, heap->growsize)) < 0)
 		return ENOMEM;
@@ -802,7 +920,12 @@ heap_force_recycle(struct palloc_heap *heap)
 		}
 	}
 	util_mutex_unlock(&heap->rt->arenas.lock);
-	heap_reclaim_garbage(heap, NULL);
+
+	struct bucket *defb = heap_bucket_acquire(heap,
+		DEFAULT_ALLOC_CLASS_ID, HEAP_ARENA_PER_THREAD);
+	heap_huge_caches_drain(heap, defb);
+	heap_reclaim_garbage(heap, defb);
+	heap_bucket_release(heap, defb);
 }
 
 /*
@@ -966,6 +1089,46 @@ heap_split_block(struct palloc_heap *heap, struct bucket *b,
 	m->size_idx = units;
 }
 
+/*
+ * heap_align_block -- (internal) moves the beginning of a free block of chunks
+ *	so that the requested units don't needlessly cross a huge page boundary
+ *
+ * Units smaller than the alignment are placed so that they fit within a single
+ * aligned region, larger ones start at the first chunk of a region. The skipped
+ * chunks are returned to the bucket. The alignment is measured on the virtual
+ * addresses of the chunks, which need not be chunk aligned themselves, so the
+ * block starts at the first chunk that begins at or after the boundary.
+ */
+static void
+heap_align_block(struct palloc_heap *heap, struct bucket *b,
+	struct memory_block *m, uint32_t units)
+{
+	size_t align = heap->rt->chunk_align;
+	uintptr_t first = (uintptr_t)heap_get_chunk(heap, m);
+	uintptr_t last = first + (units - 1) * CHUNKSIZE;
+
+	if (units * CHUNKSIZE >= align) {
+		if (first % align < CHUNKSIZE)
+			return;
+	} else if (first / align == last / align) {
+		return;
+	}
+
+	size_t skip = (ALIGN_UP(first, align) - first + CHUNKSIZE - 1) /
+		CHUNKSIZE;
+	if (skip + units > m->size_idx)
+		return;
+
+	struct memory_block h = memblock_huge_init(heap,
+		m->chunk_id, m->zone_id, (uint32_t)skip);
+
+	*m = memblock_huge_init(heap, m->chunk_id + (uint32_t)skip,
+		m->zone_id, m->size_idx - (uint32_t)skip);
+
+	if (bucket_insert_block(b, &h) != 0)
+		LOG(2, "failed to allocate memory block runtime tracking info");
+}
+
 /*
  * heap_get_bestfit_block --
  *	extracts a memory block of equal size index
@@ -988,6 +1151,10 @@ heap_get_bestfit_block(struct palloc_heap *heap, struct bucket *b,
 
 	ASSERT(m->size_idx >= units);
 
+	if (heap->rt->chunk_align != 0 && b->aclass->type == CLASS_HUGE &&
+	    units != m->size_idx)
+		heap_align_block(heap, b, m, units);
+
 	if (units != m->size_idx)
 		heap_split_block(heap, b, m, units);
 
@@ -997,6 +1164,79 @@ heap_get_bestfit_block(struct palloc_heap *heap, struct bucket *b,
 	return 0;
 }
 
+/*
+ * heap_huge_cache_acquire -- reserves a huge block from the huge cache of
+ *	the arena, returns the locked cache bucket if successful, NULL otherwise
+ *
+ * The returned bucket must be released with heap_bucket_release.
+ */
+struct bucket *
+heap_huge_cache_acquire(struct palloc_heap *heap, uint16_t arena_id,
+	struct memory_block *m)
+{
+	uint32_t units = m->size_idx;
+	if (units > HEAP_HUGE_CACHE_CHUNKS)
+		return NULL;
+
+	struct arena *a = heap_huge_cache_arena(heap, arena_id);
+	if (a == NULL)
+		return NULL;
+
+	struct bucket *b = a->huge_cache;
+
+	util_mutex_lock(&b->lock);
+
+	if (b->c_ops->get_rm_bestfit(b->container, m) != 0) {
+		util_mutex_unlock(&b->lock);
+		return NULL;
+	}
+
+	ASSERT(m->size_idx >= units);
+
+	if (units != m->size_idx)
+		heap_split_block(heap, b, m, units);
+
+	a->huge_cached -= units;
+
+	m->m_ops->ensure_header_type(m, b->aclass->header_type);
+	m->header_type = b->aclass->header_type;
+
+	return b;
+}
+
+/*
+ * heap_huge_cache_put -- puts a free huge block into the huge cache of the
+ *	thread's arena
+ *
+ * Returns 0 if the block was cached, 1 if there's no room for it in the cache,
+ * and -1 on error.
+ */
+int
+heap_huge_cache_put(struct palloc_heap *heap, struct memory_block *m)
+{
+	if (m->size_idx > HEAP_HUGE_CACHE_CHUNKS)
+		return 1;
+
+	struct arena *a = heap_huge_cache_arena(heap, HEAP_ARENA_PER_THREAD);
+	if (a == NULL)
+		return 1;
+
+	struct bucket *b = a->huge_cache;
+	int ret = 1;
+
+	util_mutex_lock(&b->lock);
+
+	if (a->huge_cached + m->size_idx <= HEAP_HUGE_CACHE_CHUNKS) {
+		ret = bucket_insert_block(b, m);
+		if (ret == 0)
+			a->huge_cached += m->size_idx;
+	}
+
+	util_mutex_unlock(&b->lock);
+
+	return ret;
+}
+
 /*
  * heap_get_adjacent_free_block -- locates adjacent free memory block in heap
  */
@@ -1116,16 +1356,19 @@ heap_arena_create(struct palloc_heap *heap)
 		return -1;
 
 	util_mutex_lock(&h->arenas.lock);
+	util_mutex_lock(&h->arenas.vec_lock);
 
 	if (VEC_PUSH_BACK(&h->arenas.vec, arena))
 		goto err_push_back;
 
 	int ret = (int)VEC_SIZE(&h->arenas.vec);
+	util_mutex_unlock(&h->arenas.vec_lock);
 	util_mutex_unlock(&h->arenas.lock);
 
 	return ret;
 
 err_push_back:
+	util_mutex_unlock(&h->arenas.vec_lock);
 	util_mutex_unlock(&h->arenas.lock);
 	heap_arena_delete(arena);
 	return -1;
@@ -1146,6 +1389,34 @@ heap_get_narenas_total(struct palloc_heap *heap)
 	return total;
 }
 
+/*
+ * heap_get_chunk_align -- returns the alignment of chunk allocations
+ */
+size_t
+heap_get_chunk_align(struct palloc_heap *heap)
+{
+	return heap->rt->chunk_align;
+}
+
+/*
+ * heap_set_chunk_align -- sets the alignment of chunk allocations, must be
+ *	either zero or a power of two larger than the chunk size
+ */
+int
+heap_set_chunk_align(struct palloc_heap *heap, size_t align)
+{
+	if (align != 0 && (align <= CHUNKSIZE || !util_is_pow2(align))) {
+		ERR("chunk alignment must be 0 or a power of two larger "
+			"than %zu", CHUNKSIZE);
+		errno = EINVAL;
+		return -1;
+	}
+
+	heap->rt->chunk_align = align;
+
+	return 0;
+}
+
 /*
  * heap_get_narenas_max -- returns the max number of arenas
  */
@@ -1180,7 +1451,9 @@ heap_set_narenas_max(struct palloc_heap *heap, unsigned size)
 		goto out;
 	}
 
+	util_mutex_lock(&h->arenas.vec_lock);
 	ret = VEC_RESERVE(&h->arenas.vec, size);
+	util_mutex_unlock(&h->arenas.vec_lock);
 
 out:
 	util_mutex_unlock(&h->arenas.lock);
@@ -1278,6 +1551,219 @@ heap_set_arena_thread(struct palloc_heap *heap, unsigned arena_id)
 	os_mutex_unlock(&heap->rt->arenas.lock);
 }
 
+/*
+ * heap_bucket_stats_add -- (internal) adds the counters of a bucket to the
+ *	given totals
+ */
+static void
+heap_bucket_stats_add(struct bucket *b, uint64_t *allocs, uint64_t *contention)
+{
+	uint64_t value;
+
+	util_atomic_load_explicit64(&b->nallocs, &value, memory_order_relaxed);
+	*allocs += value;
+
+	util_atomic_load_explicit64(&b->ncontended, &value,
+		memory_order_relaxed);
+	*contention += value;
+}
+
+/*
+ * heap_zones_in_use -- (internal) returns the number of leading zones that
+ *	might contain chunks
+ *
+ * The zones are initialized in order, either in one of the previous sessions
+ * or when they are first needed by this one, the ones past that were never
+ * used and so need not be examined.
+ */
+static unsigned
+heap_zones_in_use(struct palloc_heap *heap)
+{
+	unsigned exhausted;
+	util_atomic_load_explicit32(&heap->rt->zones_exhausted, &exhausted,
+		memory_order_acquire);
+
+	return MAX(exhausted, heap->rt->zones_booted);
+}
+
+/*
+ * heap_class_runs_stats -- (internal) walks the chunks of the heap and sums
+ *	up the occupancy of runs that belong to the given allocation class
+ *
+ * Chunk headers are read without the heap being locked, which means that
+ * the result is only an approximation if there are concurrent allocations.
+ */
+static void
+heap_class_runs_stats(struct palloc_heap *heap, struct alloc_class *c,
+	struct heap_class_stats *s)
+{
+	struct memory_block m = MEMORY_BLOCK_NONE;
+	unsigned nzones = heap_zones_in_use(heap);
+
+	for (m.zone_id = 0; m.zone_id < nzones; ++m.zone_id) {
+		struct zone *z = ZID_TO_ZONE(heap->layout, m.zone_id);
+		if (z->header.magic == 0)
+			continue;
+
+		for (m.chunk_id = 0; m.chunk_id < z->header.size_idx; ) {
+			struct chunk_header *hdr = heap_get_chunk_hdr(heap, &m);
+			uint32_t size_idx = hdr->size_idx;
+
+			if (hdr->type == CHUNK_TYPE_RUN) {
+				os_mutex_t *lock =
+					heap_get_run_lock(heap, m.chunk_id);
+				util_mutex_lock(lock);
+
+				struct chunk_run *run =
+					heap_get_chunk_run(heap, &m);
+				if (hdr->type == CHUNK_TYPE_RUN &&
+				    alloc_class_by_run(heap->rt->alloc_classes,
+					run->hdr.block_size, hdr->flags,
+					hdr->size_idx) == c) {
+					memblock_rebuild_state(heap, &m);
+
+					struct run_bitmap b;
+					m.m_ops->get_bitmap(&m, &b);
+
+					uint32_t free_space = 0;
+					uint32_t max_free_block = 0;
+					m.m_ops->calc_free(&m, &free_space,
+						&max_free_block);
+
+					s->runs++;
+					s->units += b.nbits;
+					s->used += b.nbits - free_space;
+					if (free_space == b.nbits)
+						s->free_runs++;
+				}
+
+				util_mutex_unlock(lock);
+			}
+
+			m.chunk_id += size_idx == 0 ? 1 : size_idx;
+		}
+	}
+}
+
+/*
+ * heap_get_class_stats -- returns the statistics of an allocation class
+ */
+int
+heap_get_class_stats(struct palloc_heap *heap, uint8_t class_id,
+	struct heap_class_stats *s)
+{
+	struct heap_rt *rt = heap->rt;
+
+	struct alloc_class *c = alloc_class_by_id(rt->alloc_classes, class_id);
+	if (c == NULL) {
+		ERR("class with the given id does not exist");
+		errno = ENOENT;
+		return -1;
+	}
+
+	memset(s, 0, sizeof(*s));
+
+	/*
+	 * Huge allocations are served either from the default bucket or
+	 * from the huge caches of the arenas.
+	 */
+	struct arena *a;
+	util_mutex_lock(&rt->arenas.lock);
+	VEC_FOREACH(a, &rt->arenas.vec) {
+		struct bucket *b = class_id == DEFAULT_ALLOC_CLASS_ID ?
+			a->huge_cache : a->buckets[class_id];
+		if (b != NULL)
+			heap_bucket_stats_add(b, &s->allocs, &s->contention);
+	}
+	util_mutex_unlock(&rt->arenas.lock);
+
+	if (class_id == DEFAULT_ALLOC_CLASS_ID)
+		heap_bucket_stats_add(rt->default_bucket,
+			&s->allocs, &s->contention);
+
+	if (c->type != CLASS_RUN)
+		return 0;
+
+	s->recycled_runs = recycler_nruns(rt->recyclers[class_id]);
+
+	heap_class_runs_stats(heap, c, s);
+
+	return 0;
+}
+
+/*
+ * heap_get_arena_stats -- returns the statistics of an arena
+ */
+void
+heap_get_arena_stats(struct palloc_heap *heap, unsigned arena_id,
+	struct heap_arena_stats *s)
+{
+	struct heap_rt *rt = heap->rt;
+
+	memset(s, 0, sizeof(*s));
+
+	util_mutex_lock(&rt->arenas.lock);
+
+	struct arena *a = heap_get_arena_by_id(heap, arena_id);
+	s->nthreads = a->nthreads;
+
+	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		if (i != DEFAULT_ALLOC_CLASS_ID && a->buckets[i] != NULL)
+			heap_bucket_stats_add(a->buckets[i],
+				&s->allocs, &s->contention);
+	}
+	heap_bucket_stats_add(a->huge_cache, &s->allocs, &s->contention);
+
+	util_mutex_lock(&a->huge_cache->lock);
+	s->huge_cached = a->huge_cached * CHUNKSIZE;
+	util_mutex_unlock(&a->huge_cache->lock);
+
+	util_mutex_unlock(&rt->arenas.lock);
+}
+
+/*
+ * heap_get_nzones -- returns the number of zones in the heap
+ */
+unsigned
+heap_get_nzones(struct palloc_heap *heap)
+{
+	return heap->rt->nzones;
+}
+
+/*
+ * heap_get_zone_fill -- returns the percentage of chunks of a zone that are
+ *	not free
+ *
+ * Like the class statistics, this is only an approximation if there are
+ * concurrent allocations.
+ */
+unsigned
+heap_get_zone_fill(struct palloc_heap *heap, uint32_t zone_id)
+{
+	ASSERT(zone_id < heap->rt->nzones);
+
+	if (zone_id >= heap_zones_in_use(heap))
+		return 0;
+
+	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+	if (z->header.magic == 0 || z->header.size_idx == 0)
+		return 0;
+
+	uint64_t used = 0;
+	for (uint32_t i = 0; i < z->header.size_idx; ) {
+		struct chunk_header *hdr = &z->chunk_headers[i];
+		uint32_t size_idx = hdr->size_idx == 0 ? 1 : hdr->size_idx;
+		size_idx = MIN(size_idx, z->header.size_idx - i);
+
+		if (hdr->type != CHUNK_TYPE_FREE)
+			used += size_idx;
+
+		i += size_idx;
+	}
+
+	return (unsigned)(used * 100 / z->header.size_idx);
+}
+
 /*
  * heap_get_procs -- (internal) returns the number of arenas to create
  */
@@ -1486,6 +1972,7 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 	h->nzones = heap_max_zone(heap_size);
 
 	h->zones_exhausted = 0;
+	h->chunk_align = 0;
 
 	h->nlocks = On_valgrind ? MAX_RUN_LOCKS_VG : MAX_RUN_LOCKS;
 	for (unsigned i = 0; i < h->nlocks; ++i)
@@ -1516,6 +2003,13 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 
 	heap_zone_update_if_needed(heap);
 
+	h->zones_booted = 0;
+	for (unsigned i = 0; i < h->nzones; ++i) {
+		if (ZID_TO_ZONE(heap->layout, i)->header.magic ==
+				ZONE_HEADER_MAGIC)
+			h->zones_booted = i + 1;
+	}
+
 	return 0;
 
 error_vec_reserve:
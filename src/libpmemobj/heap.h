@@ -56,6 +56,10 @@ heap_bucket_release(struct palloc_heap *heap, struct bucket *b);
 
 int heap_get_bestfit_block(struct palloc_heap *heap, struct bucket *b,
 	struct memory_block *m);
+struct bucket *
+heap_huge_cache_acquire(struct palloc_heap *heap, uint16_t arena_id,
+	struct memory_block *m);
+int heap_huge_cache_put(struct palloc_heap *heap, struct memory_block *m);
 struct memory_block
 heap_coalesce_huge(struct palloc_heap *heap, struct bucket *b,
 	const struct memory_block *m);
@@ -84,6 +88,10 @@ void *heap_end(struct palloc_heap *heap);
 
 unsigned heap_get_narenas_total(struct palloc_heap *heap);
 
+size_t heap_get_chunk_align(struct palloc_heap *heap);
+
+int heap_set_chunk_align(struct palloc_heap *heap, size_t align);
+
 unsigned heap_get_narenas_max(struct palloc_heap *heap);
 
 int heap_set_narenas_max(struct palloc_heap *heap, unsigned size);
@@ -104,6 +112,33 @@ int heap_set_arena_auto(struct palloc_heap *heap, unsigned arena_id,
 
 void heap_set_arena_thread(struct palloc_heap *heap, unsigned arena_id);
 
+struct heap_class_stats {
+	uint64_t allocs; /* reservations served by the buckets of the class */
+	uint64_t contention; /* contended acquisitions of those buckets */
+	uint64_t runs; /* runs of the class in the heap */
+	uint64_t free_runs; /* runs without any allocated units */
+	uint64_t recycled_runs; /* runs waiting in the recycler */
+	uint64_t units; /* total number of units in the runs */
+	uint64_t used; /* number of allocated units in the runs */
+};
+
+int heap_get_class_stats(struct palloc_heap *heap, uint8_t class_id,
+	struct heap_class_stats *s);
+
+struct heap_arena_stats {
+	uint64_t nthreads; /* threads assigned to the arena */
+	uint64_t allocs; /* reservations served by the buckets of the arena */
+	uint64_t contention; /* contended acquisitions of those buckets */
+	uint64_t huge_cached; /* bytes kept aside in the huge cache */
+};
+
+void heap_get_arena_stats(struct palloc_heap *heap, unsigned arena_id,
+	struct heap_arena_stats *s);
+
+unsigned heap_get_nzones(struct palloc_heap *heap);
+
+unsigned heap_get_zone_fill(struct palloc_heap *heap, uint32_t zone_id);
+
 void heap_vg_open(struct palloc_heap *heap, object_callback cb,
 		void *arg, int objects);
 
@@ -13,9 +13,11 @@
 #include <errno.h>
 #include <limits.h>
 #include <sched.h>
+#include <unistd.h>
 
 #include "libpmemobj.h"
 #include "critnib.h"
+#include "ctl.h"
 #include "lane.h"
 #include "out.h"
 #include "util.h"
@@ -28,6 +30,9 @@
 
 static os_tls_key_t Lane_info_key;
 
+/* number of threads replaying the undo logs of the lanes on pool open */
+static int Lane_recovery_threads = 1;
+
 static __thread struct critnib *Lane_info_ht;
 static __thread struct lane_info *Lane_info_records;
 static __thread struct lane_info *Lane_info_cache;
@@ -173,26 +178,35 @@ lane_ulog_constructor(void *base, void *ptr, size_t usable_size, void *arg)
  * lane_undo_extend -- allocates a new undo log
  */
 static int
-lane_undo_extend(void *base, uint64_t *redo, uint64_t gen_num)
+lane_undo_extend(void *base, uint64_t *redo, uint64_t gen_num, size_t min_size)
 {
 	PMEMobjpool *pop = base;
 	struct tx_parameters *params = pop->tx_params;
-	size_t s = SIZEOF_ALIGNED_ULOG(params->cache_size);
+	size_t s = SIZEOF_ALIGNED_ULOG(MAX(params->cache_size, min_size));
+
+	int ret = pmalloc_construct(base, redo, s, lane_ulog_constructor,
+		&gen_num, 0, OBJ_INTERNAL_OBJECT_MASK, 0);
+	if (ret == 0)
+		STATS_INC(pop->stats, transient, tx_undo_extensions, 1);
 
-	return pmalloc_construct(base, redo, s, lane_ulog_constructor, &gen_num,
-		0, OBJ_INTERNAL_OBJECT_MASK, 0);
+	return ret;
 }
 
 /*
  * lane_redo_extend -- allocates a new redo log
  */
 static int
-lane_redo_extend(void *base, uint64_t *redo, uint64_t gen_num)
+lane_redo_extend(void *base, uint64_t *redo, uint64_t gen_num, size_t min_size)
 {
-	size_t s = SIZEOF_ALIGNED_ULOG(LANE_REDO_EXTERNAL_SIZE);
+	PMEMobjpool *pop = base;
+	size_t s = SIZEOF_ALIGNED_ULOG(MAX(LANE_REDO_EXTERNAL_SIZE, min_size));
 
-	return pmalloc_construct(base, redo, s, lane_ulog_constructor, &gen_num,
-		0, OBJ_INTERNAL_OBJECT_MASK, 0);
+	int ret = pmalloc_construct(base, redo, s, lane_ulog_constructor,
+		&gen_num, 0, OBJ_INTERNAL_OBJECT_MASK, 0);
+	if (ret == 0)
+		STATS_INC(pop->stats, transient, tx_redo_extensions, 1);
+
+	return ret;
 }
 
 /*
@@ -247,6 +261,23 @@ lane_destroy(PMEMobjpool *pop, struct lane *lane)
 	operation_delete(lane->external);
 }
 
+/*
+ * lane_get_ncpu_groups -- (internal) returns the number of groups the lanes
+ *	are divided into when they are assigned by CPU
+ */
+static unsigned
+lane_get_ncpu_groups(unsigned nlanes)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus < 1)
+		cpus = 1;
+
+	unsigned ngroups = (unsigned long)cpus < nlanes ?
+		(unsigned)cpus : nlanes;
+
+	return ngroups == 0 ? 1 : ngroups;
+}
+
 /*
  * lane_boot -- initializes all lanes
  */
@@ -263,6 +294,9 @@ lane_boot(PMEMobjpool *pop)
 	}
 
 	pop->lanes_desc.next_lane_idx = 0;
+	pop->lanes_desc.assignment = POBJ_LANE_ASSIGNMENT_THREAD;
+	pop->lanes_desc.ncpu_groups = lane_get_ncpu_groups(
+		pop->lanes_desc.runtime_nlanes);
 
 	pop->lanes_desc.lane_locks =
 		Zalloc(sizeof(*pop->lanes_desc.lane_locks) * pop->nlanes);
@@ -339,6 +373,77 @@ lane_cleanup(PMEMobjpool *pop)
 	lane_info_cleanup(pop);
 }
 
+/*
+ * lane_undo_recovery -- shared state of the threads replaying the undo logs
+ */
+struct lane_undo_recovery {
+	PMEMobjpool *pop;
+	uint64_t next_lane_idx; /* the first lane not taken by any thread */
+};
+
+/*
+ * lane_undo_recovery_worker -- (internal) replays the undo logs of the lanes
+ *	not yet taken by the other threads
+ */
+static void *
+lane_undo_recovery_worker(void *arg)
+{
+	struct lane_undo_recovery *rec = arg;
+	PMEMobjpool *pop = rec->pop;
+
+	uint64_t i;
+	while ((i = util_fetch_and_add64(&rec->next_lane_idx, 1)) <
+			pop->nlanes) {
+		struct operation_context *ctx = pop->lanes_desc.lane[i].undo;
+		operation_resume(ctx);
+		operation_process(ctx);
+	}
+
+	return NULL;
+}
+
+/*
+ * lane_undo_recover -- (internal) replays the undo logs of all lanes
+ *
+ * The lanes are independent, so their logs are replayed by up to
+ * Lane_recovery_threads threads, each lane with a regular operation_process.
+ * Finishing the operations frees the log extensions, which requires the
+ * lanes, and is left to the caller.
+ */
+static void
+lane_undo_recover(PMEMobjpool *pop)
+{
+	struct lane_undo_recovery rec = {pop, 0};
+
+	uint64_t nthreads = MIN((uint64_t)Lane_recovery_threads, pop->nlanes);
+	os_thread_t *threads = NULL;
+	if (nthreads > 1) {
+		threads = Malloc(sizeof(*threads) * (nthreads - 1));
+		if (threads == NULL) {
+			LOG(2, "!Malloc of recovery threads");
+			nthreads = 1;
+		}
+	}
+
+	/* the calling thread takes part in the recovery as well */
+	uint64_t started;
+	for (started = 0; started < nthreads - 1; ++started) {
+		errno = os_thread_create(&threads[started], NULL,
+			lane_undo_recovery_worker, &rec);
+		if (errno != 0) {
+			LOG(2, "!os_thread_create");
+			break;
+		}
+	}
+
+	lane_undo_recovery_worker(&rec);
+
+	for (uint64_t t = 0; t < started; ++t)
+		os_thread_join(&threads[t], NULL);
+
+	Free(threads);
+}
+
 /*
  * lane_recover_and_section_boot -- performs initialization and recovery of all
  * lanes
@@ -374,10 +479,10 @@ lane_recover_and_section_boot(PMEMobjpool *pop)
 	 * Undo logs must be processed after the heap is initialized since
 	 * a undo recovery might require deallocation of the next ulogs.
 	 */
+	lane_undo_recover(pop);
+
 	for (i = 0; i < pop->nlanes; ++i) {
 		struct operation_context *ctx = pop->lanes_desc.lane[i].undo;
-		operation_resume(ctx);
-		operation_process(ctx);
 		operation_finish(ctx, ULOG_INC_FIRST_GEN_NUM |
 				ULOG_FREE_AFTER_FIRST);
 	}
@@ -452,6 +557,67 @@ get_lane(uint64_t *locks, struct lane_info *info, uint64_t nlocks)
 	}
 }
 
+/*
+ * lane_cpu_group_begin -- (internal) returns the index of the first lane of
+ *	the given CPU group
+ */
+static inline uint64_t
+lane_cpu_group_begin(struct lane_descriptor *desc, unsigned group)
+{
+	return (uint64_t)group * desc->runtime_nlanes / desc->ncpu_groups;
+}
+
+/*
+ * get_lane_by_cpu -- (internal) get free lane index, preferring the lanes
+ *	assigned to the CPU the thread is running on
+ *
+ * Threads running on different CPUs acquire lanes from disjoint parts of the
+ * lane locks array, and so they don't contend on the same locks nor on the
+ * same cachelines. Only once all lanes of the CPU are taken, the lanes of the
+ * other CPUs are stolen, starting from the neighbouring ones.
+ */
+static inline void
+get_lane_by_cpu(struct lane_descriptor *desc, struct lane_info *info)
+{
+	uint64_t *locks = desc->lane_locks;
+	unsigned ngroups = desc->ncpu_groups;
+
+	int cpu = os_thread_getcpu();
+	unsigned group = cpu < 0 ?
+		(unsigned)(info->primary % ngroups) : (unsigned)cpu % ngroups;
+
+	/* the lane used most recently on this CPU has warm caches */
+	uint64_t begin = lane_cpu_group_begin(desc, group);
+	uint64_t end = lane_cpu_group_begin(desc, group + 1);
+	if (info->primary >= begin && info->primary < end &&
+	    util_bool_compare_and_swap64(&locks[info->primary], 0, 1)) {
+		info->lane_idx = info->primary;
+		return;
+	}
+
+	while (1) {
+		for (unsigned i = 0; i < ngroups; ++i) {
+			unsigned g = (group + i) % ngroups;
+			begin = lane_cpu_group_begin(desc, g);
+			end = lane_cpu_group_begin(desc, g + 1);
+
+			for (uint64_t idx = begin; idx < end; ++idx) {
+				/* don't bounce the cacheline of a taken lock */
+				if (locks[idx] != 0 ||
+				    !util_bool_compare_and_swap64(&locks[idx],
+				    0, 1))
+					continue;
+
+				info->lane_idx = idx;
+				info->primary = idx;
+				return;
+			}
+		}
+
+		sched_yield();
+	}
+}
+
 /*
  * get_lane_info_record -- (internal) get lane record attached to memory pool
  *	or first free
@@ -524,7 +690,10 @@ lane_hold(PMEMobjpool *pop, struct lane **lanep)
 	uint64_t *llocks = pop->lanes_desc.lane_locks;
 	/* grab next free lane from lanes available at runtime */
 	if (!lane->nest_count++) {
-		get_lane(llocks, lane, pop->lanes_desc.runtime_nlanes);
+		if (pop->lanes_desc.assignment == POBJ_LANE_ASSIGNMENT_CPU)
+			get_lane_by_cpu(&pop->lanes_desc, lane);
+		else
+			get_lane(llocks, lane, pop->lanes_desc.runtime_nlanes);
 	}
 
 	struct lane *l = &pop->lanes_desc.lane[lane->lane_idx];
@@ -570,3 +739,166 @@ lane_release(PMEMobjpool *pop)
 		}
 	}
 }
+
+/*
+ * lane_prealloc -- extends the undo and external redo logs of all lanes
+ *	to the capacities requested by the transaction parameters
+ *
+ * Every lane is held while its logs are extended, so that the lanes in use
+ * by other threads are extended once they are released. The calling thread
+ * becomes the holder of the lane, and so the allocations of the log
+ * extensions are done in that lane as well.
+ */
+int
+lane_prealloc(PMEMobjpool *pop)
+{
+	struct tx_parameters *params = pop->tx_params;
+	struct lane_info *info = get_lane_info_record(pop);
+	uint64_t *llocks = pop->lanes_desc.lane_locks;
+
+	if (info->nest_count != 0) {
+		ERR("the calling thread holds a lane");
+		errno = EBUSY;
+		return -1;
+	}
+
+	for (unsigned i = 0; i < pop->lanes_desc.runtime_nlanes; ++i) {
+		while (!util_bool_compare_and_swap64(&llocks[i], 0, 1))
+			sched_yield();
+
+		info->lane_idx = i;
+		info->nest_count = 1;
+
+		struct lane *lane = &pop->lanes_desc.lane[i];
+		operation_init(lane->external);
+		operation_init(lane->internal);
+		operation_init(lane->undo);
+
+		int ret = 0;
+		if (operation_prealloc(lane->undo,
+		    params->undo_prealloc) != 0) {
+			ERR("!cannot preallocate the undo log of lane %u", i);
+			ret = -1;
+		} else if (operation_prealloc(lane->external,
+		    params->redo_prealloc) != 0) {
+			ERR("!cannot preallocate the redo log of lane %u", i);
+			ret = -1;
+		}
+
+		lane_release(pop);
+
+		if (ret != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * lane_hold_all -- grabs all of the lanes of the pool, waiting for the
+ *	threads which hold them to release them
+ *
+ * Every operation which modifies the pool holds a lane, so once all of them
+ * are held, the pool is consistent and stays so until lane_release_all.
+ * Fails if the calling thread holds a lane, it would wait for itself.
+ *
+ * The calling thread becomes the holder of the first lane, so that it can
+ * still modify the pool itself, the nested lane_hold calls reuse that lane.
+ */
+int
+lane_hold_all(PMEMobjpool *pop)
+{
+	struct lane_info *lane = get_lane_info_record(pop);
+	if (lane->nest_count != 0) {
+		ERR("the calling thread holds a lane");
+		errno = EBUSY;
+		return -1;
+	}
+
+	uint64_t *llocks = pop->lanes_desc.lane_locks;
+
+	/* the lanes are taken in order, so that the callers can't deadlock */
+	for (unsigned i = 0; i < pop->lanes_desc.runtime_nlanes; ++i) {
+		while (!util_bool_compare_and_swap64(&llocks[i], 0, 1))
+			sched_yield();
+	}
+
+	if (lane->lane_idx == UINT64_MAX) {
+		lane->primary = util_fetch_and_add32(
+			&pop->lanes_desc.next_lane_idx, LANE_JUMP);
+	}
+
+	lane->lane_idx = 0;
+	lane->nest_count = 1;
+
+	struct lane *l = &pop->lanes_desc.lane[0];
+	operation_init(l->external);
+	operation_init(l->internal);
+	operation_init(l->undo);
+
+	return 0;
+}
+
+/*
+ * lane_release_all -- drops all of the lanes taken by lane_hold_all
+ */
+void
+lane_release_all(PMEMobjpool *pop)
+{
+	struct lane_info *lane = get_lane_info_record(pop);
+	ASSERTeq(lane->nest_count, 1);
+	lane->nest_count = 0;
+
+	uint64_t *llocks = pop->lanes_desc.lane_locks;
+
+	for (unsigned i = 0; i < pop->lanes_desc.runtime_nlanes; ++i) {
+		if (unlikely(!util_bool_compare_and_swap64(&llocks[i],
+				1, 0))) {
+			FATAL("util_bool_compare_and_swap64");
+		}
+	}
+}
+
+static int
+CTL_READ_HANDLER(threads)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	int *arg_out = arg;
+	*arg_out = Lane_recovery_threads;
+
+	return 0;
+}
+
+static int
+CTL_WRITE_HANDLER(threads)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	int arg_in = *(int *)arg;
+
+	if (arg_in < 1) {
+		ERR("invalid number of recovery threads");
+		errno = EINVAL;
+		return -1;
+	}
+
+	Lane_recovery_threads = arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(threads) = CTL_ARG_INT;
+
+static const struct ctl_node CTL_NODE(recovery)[] = {
+	CTL_LEAF_RW(threads),
+
+	CTL_NODE_END
+};
+
+/*
+ * lane_ctl_register -- registers the global ctl nodes of the lanes
+ */
+void
+lane_ctl_register(void)
+{
+	CTL_REGISTER_MODULE(NULL, recovery);
+}
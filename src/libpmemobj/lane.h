@@ -97,6 +97,9 @@ struct lane_descriptor {
 	unsigned next_lane_idx;
 	uint64_t *lane_locks;
 	struct lane *lane;
+
+	enum pobj_lane_assignment assignment;
+	unsigned ncpu_groups; /* number of groups of lanes, one per CPU */
 };
 
 typedef int (*section_layout_op)(PMEMobjpool *pop, void *data, unsigned length);
@@ -138,10 +141,15 @@ void lane_cleanup(PMEMobjpool *pop);
 int lane_recover_and_section_boot(PMEMobjpool *pop);
 int lane_section_cleanup(PMEMobjpool *pop);
 int lane_check(PMEMobjpool *pop);
+int lane_prealloc(PMEMobjpool *pop);
+void lane_ctl_register(void);
 
 unsigned lane_hold(PMEMobjpool *pop, struct lane **lane);
 void lane_release(PMEMobjpool *pop);
 
+int lane_hold_all(PMEMobjpool *pop);
+void lane_release_all(PMEMobjpool *pop);
+
 #ifdef __cplusplus
 }
 #endif
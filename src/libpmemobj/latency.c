@@ -0,0 +1,225 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * latency.c -- implementation of the latency histograms
+ *
+ * The latencies are counted in log-linear histograms: every power of two
+ * range of nanoseconds is split into LATENCY_SUB_BUCKETS equal buckets, so a
+ * value is known with the precision of 1/LATENCY_SUB_BUCKETS of its
+ * magnitude, no matter how large it is.
+ *
+ * To keep the threads recording the latencies from fighting over the same
+ * cache lines, every thread records into the shard it was assigned for the
+ * statistics counters, each of them is allocated separately. The shards are
+ * summed up when the histograms are read.
+ */
+
+#include <time.h>
+
+#include "alloc.h"
+#include "latency.h"
+#include "os.h"
+#include "out.h"
+#include "stats.h"
+#include "util.h"
+
+#define LATENCY_SUB_BITS 3
+#define LATENCY_SUB_BUCKETS (1U << LATENCY_SUB_BITS)
+
+/* latencies of 2^LATENCY_MAX_BIT ns (~18 minutes) or more share a bucket */
+#define LATENCY_MAX_BIT 40
+#define LATENCY_BUCKETS\
+	((LATENCY_MAX_BIT - LATENCY_SUB_BITS + 2) * LATENCY_SUB_BUCKETS)
+
+#define NSEC_IN_SEC 1000000000ULL
+
+struct latency_histogram {
+	uint64_t sum;
+	uint64_t max;
+	uint64_t buckets[LATENCY_BUCKETS];
+};
+
+struct latency_shard {
+	struct latency_histogram ops[MAX_LATENCY_OP];
+};
+
+struct latency {
+	struct latency_shard *shards[STATS_SHARDS];
+};
+
+/*
+ * latency_bucket -- (internal) returns the bucket of the value
+ */
+static unsigned
+latency_bucket(uint64_t v)
+{
+	if (v < LATENCY_SUB_BUCKETS)
+		return (unsigned)v;
+
+	unsigned bit = util_mssb_index64(v);
+	if (bit > LATENCY_MAX_BIT)
+		return LATENCY_BUCKETS - 1;
+
+	unsigned sub = (unsigned)(v >> (bit - LATENCY_SUB_BITS)) &
+		(LATENCY_SUB_BUCKETS - 1);
+
+	return (bit - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS + sub;
+}
+
+/*
+ * latency_bucket_max -- (internal) returns the largest value of the bucket
+ */
+static uint64_t
+latency_bucket_max(unsigned b)
+{
+	if (b < LATENCY_SUB_BUCKETS)
+		return b;
+
+	unsigned bit = b / LATENCY_SUB_BUCKETS + LATENCY_SUB_BITS - 1;
+	uint64_t sub = b % LATENCY_SUB_BUCKETS;
+	unsigned shift = bit - LATENCY_SUB_BITS;
+
+	return ((LATENCY_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+/*
+ * latency_new -- allocates the latency histograms
+ */
+struct latency *
+latency_new(void)
+{
+	struct latency *l = Zalloc(sizeof(*l));
+	if (l == NULL) {
+		ERR("!Zalloc");
+		return NULL;
+	}
+
+	for (unsigned i = 0; i < STATS_SHARDS; ++i) {
+		l->shards[i] = Zalloc(sizeof(struct latency_shard));
+		if (l->shards[i] == NULL) {
+			ERR("!Zalloc");
+			latency_delete(l);
+			return NULL;
+		}
+	}
+
+	return l;
+}
+
+/*
+ * latency_delete -- frees the latency histograms
+ */
+void
+latency_delete(struct latency *l)
+{
+	for (unsigned i = 0; i < STATS_SHARDS; ++i)
+		Free(l->shards[i]);
+
+	Free(l);
+}
+
+/*
+ * latency_now -- returns the current time in nanoseconds, never zero
+ */
+uint64_t
+latency_now(void)
+{
+	struct timespec ts;
+	os_clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * NSEC_IN_SEC + (uint64_t)ts.tv_nsec + 1;
+}
+
+/*
+ * latency_record -- counts the latency of the operation which started at the
+ *	time returned by latency_now
+ */
+void
+latency_record(struct latency *l, enum latency_op op, uint64_t start)
+{
+	uint64_t now = latency_now();
+	uint64_t v = now > start ? now - start : 0;
+
+	struct latency_histogram *h =
+		&l->shards[stats_thread_shard()]->ops[op];
+
+	/* the shard is shared when there are more threads than shards */
+	util_fetch_and_add64(&h->buckets[latency_bucket(v)], 1);
+	util_fetch_and_add64(&h->sum, v);
+
+	uint64_t max;
+	util_atomic_load_explicit64(&h->max, &max, memory_order_relaxed);
+	while (v > max && !util_bool_compare_and_swap64(&h->max, max, v))
+		util_atomic_load_explicit64(&h->max, &max,
+			memory_order_relaxed);
+}
+
+/*
+ * latency_percentile -- (internal) returns the value below which lies the
+ *	given number of per mille of the counted latencies
+ */
+static uint64_t
+latency_percentile(const uint64_t *buckets, uint64_t count, uint64_t max,
+	unsigned permille)
+{
+	if (count == 0)
+		return 0;
+
+	/* rank of the value, rounded up */
+	uint64_t rank = (count * permille + 999) / 1000;
+	if (rank == 0)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (unsigned b = 0; b < LATENCY_BUCKETS; ++b) {
+		seen += buckets[b];
+		if (seen >= rank) {
+			uint64_t v = latency_bucket_max(b);
+			return v < max ? v : max;
+		}
+	}
+
+	return max;
+}
+
+/*
+ * latency_summarize -- sums up the histograms of the operation from all of
+ *	the shards
+ */
+void
+latency_summarize(struct latency *l, enum latency_op op,
+	struct latency_summary *s)
+{
+	uint64_t buckets[LATENCY_BUCKETS] = {0};
+	uint64_t count = 0;
+	uint64_t sum = 0;
+	uint64_t max = 0;
+
+	for (unsigned i = 0; i < STATS_SHARDS; ++i) {
+		struct latency_histogram *h = &l->shards[i]->ops[op];
+		uint64_t v;
+
+		for (unsigned b = 0; b < LATENCY_BUCKETS; ++b) {
+			util_atomic_load_explicit64(&h->buckets[b], &v,
+				memory_order_relaxed);
+			buckets[b] += v;
+			count += v;
+		}
+
+		util_atomic_load_explicit64(&h->sum, &v, memory_order_relaxed);
+		sum += v;
+
+		util_atomic_load_explicit64(&h->max, &v, memory_order_relaxed);
+		if (v > max)
+			max = v;
+	}
+
+	s->count = count;
+	s->mean = count == 0 ? 0 : sum / count;
+	s->max = max;
+	s->p50 = latency_percentile(buckets, count, max, 500);
+	s->p90 = latency_percentile(buckets, count, max, 900);
+	s->p99 = latency_percentile(buckets, count, max, 990);
+	s->p999 = latency_percentile(buckets, count, max, 999);
+}
@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * latency.h -- internal definitions for the latency histograms
+ */
+
+#ifndef LIBPMEMOBJ_LATENCY_H
+#define LIBPMEMOBJ_LATENCY_H 1
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum latency_op {
+	LATENCY_TX_COMMIT, /* outermost pmemobj_tx_begin to its commit */
+	LATENCY_ALLOC, /* atomic and transactional allocations */
+	LATENCY_FREE, /* atomic and transactional frees */
+	LATENCY_PERSIST, /* pmemobj_persist and pmemobj_xpersist */
+
+	MAX_LATENCY_OP
+};
+
+/* latencies of an operation, all of the values are in nanoseconds */
+struct latency_summary {
+	uint64_t count;
+	uint64_t mean;
+	uint64_t max;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t p999;
+};
+
+struct latency;
+
+struct latency *latency_new(void);
+void latency_delete(struct latency *l);
+
+uint64_t latency_now(void);
+void latency_record(struct latency *l, enum latency_op op, uint64_t start);
+void latency_summarize(struct latency *l, enum latency_op op,
+	struct latency_summary *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
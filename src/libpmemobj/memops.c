@@ -19,6 +19,7 @@
 #include "out.h"
 #include "ravl.h"
 #include "valgrind_internal.h"
+#include "vec.h"
 #include "vecq.h"
 #include "sys_util.h"
 
@@ -59,6 +60,7 @@ struct operation_context {
 	struct ulog *ulog; /* pointer to the persistent ulog log */
 	size_t ulog_base_nbytes; /* available bytes in initial ulog log */
 	size_t ulog_capacity; /* sum of capacity, incl all next ulog logs */
+	size_t ulog_prealloc; /* capacity of the logs kept between operations */
 	int ulog_auto_reserve; /* allow or do not to auto ulog reservation */
 	int ulog_any_user_buffer; /* set if any user buffer is added */
 
@@ -412,71 +414,301 @@ operation_add_entry(struct operation_context *ctx, void *ptr, uint64_t value,
 		from_pool ? LOG_PERSISTENT : LOG_TRANSIENT);
 }
 
+/*
+ * operation_redo_space -- (internal) returns the number of bytes left until
+ *	the end of the persistent ulog into which the given offset of the shadow
+ *	log is going to be stored
+ */
+static size_t
+operation_redo_space(struct operation_context *ctx, size_t offset)
+{
+	size_t end = ctx->ulog_base_nbytes;
+
+	uint64_t next;
+	VEC_FOREACH(next, &ctx->next) {
+		if (offset < end)
+			break;
+
+		struct ulog *u = ulog_by_offset(next, ctx->p_ops);
+		ASSERTne(u, NULL);
+		end += u->capacity;
+	}
+
+	return offset < end ? end - offset : 0;
+}
+
+/*
+ * operation_add_buffer_redo -- (internal) adds a buffer operation to the
+ *	shadow copy of the persistent redo log
+ *
+ * A buffer entry cannot cross the boundary of a ulog, and so the buffer is
+ * split into as many entries as there are ulogs it spans. The boundaries are
+ * only known for cacheline aligned offsets, which is why all buffers have to
+ * be added before any value entries.
+ *
+ * A fill entry stores only its fill byte, so it always fits in a single
+ * cacheline and is never split.
+ */
+static int
+operation_add_buffer_redo(struct operation_context *ctx,
+	void *dest, void *src, size_t size, ulog_operation_type type)
+{
+	struct operation_log *oplog = &ctx->pshadow_ops;
+	size_t hsize = sizeof(struct ulog_entry_buf);
+	int fill = type == ULOG_OPERATION_BUF_SET;
+
+	ASSERTeq(oplog->offset % CACHELINE_SIZE, 0);
+
+	while (size != 0) {
+		size_t space = operation_redo_space(ctx, oplog->offset);
+		if (space == 0) {
+			if (operation_reserve(ctx, oplog->offset +
+			    ALIGN_UP(hsize + (fill ? 1 : size),
+			    CACHELINE_SIZE)) != 0)
+				return -1;
+			continue;
+		}
+
+		size_t data_size = fill ? size : MIN(size, space - hsize);
+		size_t entry_size = ALIGN_UP(hsize + (fill ? 1 : data_size),
+			CACHELINE_SIZE);
+		ASSERT(entry_size <= space);
+
+		/* keep a spare cacheline for the header of the next entry */
+		size_t ncapacity = oplog->capacity;
+		while (oplog->offset + entry_size + CACHELINE_SIZE > ncapacity)
+			ncapacity += ULOG_BASE_SIZE;
+
+		if (ncapacity != oplog->capacity) {
+			struct ulog *ulog = Realloc(oplog->ulog,
+				SIZEOF_ULOG(ncapacity));
+			if (ulog == NULL)
+				return -1;
+			oplog->capacity = ncapacity;
+			oplog->ulog = ulog;
+			oplog->ulog->capacity = oplog->capacity;
+
+			VECQ_CLEAR(&ctx->merge_entries);
+		}
+
+		ulog_entry_buf_create_transient(oplog->ulog, oplog->offset,
+			oplog->ulog->gen_num, dest, src, data_size, type,
+			&ctx->s_ops);
+
+		oplog->offset += entry_size;
+		dest = (char *)dest + data_size;
+		if (!fill)
+			src = (char *)src + data_size;
+		size -= data_size;
+	}
+
+	return 0;
+}
+
+/*
+ * operation_set_marker -- moves the end of the undo log back to the marker,
+ *	without touching the entries
+ */
+static void
+operation_set_marker(struct operation_context *ctx,
+	const struct operation_marker *m)
+{
+	ctx->ulog_curr = m->ulog_curr;
+	ctx->ulog_curr_offset = m->ulog_curr_offset;
+	ctx->ulog_curr_capacity = m->ulog_curr_capacity;
+	ctx->ulog_curr_gen_num = m->ulog_curr_gen_num;
+	ctx->total_logged = m->total_logged;
+}
+
+/*
+ * the passes of operation_add_buffer_undo, a regular addition of a buffer
+ * performs both of them, with each step drained separately
+ */
+#define OPERATION_BUFFER_CLOBBER (1 << 0) /* clobber the following headers */
+#define OPERATION_BUFFER_CREATE (1 << 1) /* create the entries */
+
+/*
+ * operation_add_buffer_undo -- (internal) adds a buffer operation to the
+ *	persistent undo log, in as many entries as there are ulogs it spans
+ *
+ * To make sure that the log is consistent and contiguous, the header of the
+ * entry that would be located immediately after each created one is zeroed
+ * beforehand. If only one of the passes is requested, nothing is drained.
+ */
+static int
+operation_add_buffer_undo(struct operation_context *ctx,
+	void *dest, void *src, size_t size, ulog_operation_type type,
+	unsigned passes)
+{
+	unsigned flags = passes == (OPERATION_BUFFER_CLOBBER |
+		OPERATION_BUFFER_CREATE) ? 0 : PMEMOBJ_F_MEM_NODRAIN;
+
+	/* a fill entry stores one byte, no matter how large the buffer is */
+	int fill = type == ULOG_OPERATION_BUF_SET;
+
+	do {
+		size_t real_size = (fill ? 1 : size) +
+			sizeof(struct ulog_entry_buf);
+
+		/* if there's no space left in the log, reserve some more */
+		if (ctx->ulog_curr_capacity == 0) {
+			ctx->ulog_curr_gen_num = ctx->ulog->gen_num;
+			if (operation_reserve(ctx,
+			    ctx->total_logged + real_size) != 0)
+				return -1;
+
+			ctx->ulog_curr = ctx->ulog_curr == NULL ? ctx->ulog :
+				ulog_next(ctx->ulog_curr, ctx->p_ops);
+			ASSERTne(ctx->ulog_curr, NULL);
+			ctx->ulog_curr_offset = 0;
+			ctx->ulog_curr_capacity = ctx->ulog_curr->capacity;
+		}
+
+		size_t curr_size = MIN(real_size, ctx->ulog_curr_capacity);
+		size_t data_size = fill ? size :
+			curr_size - sizeof(struct ulog_entry_buf);
+		size_t entry_size = ALIGN_UP(curr_size, CACHELINE_SIZE);
+		ASSERT(!fill || curr_size == real_size);
+
+		if (passes & OPERATION_BUFFER_CLOBBER) {
+			struct ulog_entry_base *next_entry = NULL;
+			if (entry_size == ctx->ulog_curr_capacity) {
+				struct ulog *u = ulog_next(ctx->ulog_curr,
+					ctx->p_ops);
+				if (u != NULL)
+					next_entry =
+					(struct ulog_entry_base *)u->data;
+			} else {
+				size_t next_entry_offset =
+					ctx->ulog_curr_offset + entry_size;
+				next_entry = (struct ulog_entry_base *)
+					(ctx->ulog_curr->data +
+					next_entry_offset);
+			}
+			if (next_entry != NULL)
+				ulog_clobber_entry(next_entry, ctx->p_ops,
+					flags);
+		}
+
+		if (passes & OPERATION_BUFFER_CREATE) {
+			/* create a persistent log entry */
+			struct ulog_entry_buf *e = ulog_entry_buf_create(
+				ctx->ulog_curr,
+				ctx->ulog_curr_offset,
+				ctx->ulog_curr_gen_num,
+				dest, src, data_size,
+				type, ctx->p_ops, flags);
+			ASSERT(entry_size == ulog_entry_size(&e->base));
+			ASSERT(entry_size <= ctx->ulog_curr_capacity);
+		}
+
+		ctx->total_logged += entry_size;
+		ctx->ulog_curr_offset += entry_size;
+		ctx->ulog_curr_capacity -= entry_size;
+
+		dest = (char *)dest + data_size;
+		if (!fill)
+			src = (char *)src + data_size;
+		size -= data_size;
+	} while (size != 0);
+
+	return 0;
+}
+
 /*
  * operation_add_buffer -- adds a buffer operation to the log
+ *
+ * Undo log buffers are written directly to the persistent log, redo log ones
+ * are stored in the shadow log, together with the rest of its entries.
  */
 int
 operation_add_buffer(struct operation_context *ctx,
 	void *dest, void *src, size_t size, ulog_operation_type type)
 {
-	size_t real_size = size + sizeof(struct ulog_entry_buf);
+	if (ctx->type == LOG_TYPE_REDO)
+		return operation_add_buffer_redo(ctx, dest, src, size, type);
 
-	/* if there's no space left in the log, reserve some more */
-	if (ctx->ulog_curr_capacity == 0) {
-		ctx->ulog_curr_gen_num = ctx->ulog->gen_num;
-		if (operation_reserve(ctx, ctx->total_logged + real_size) != 0)
-			return -1;
+	return operation_add_buffer_undo(ctx, dest, src, size, type,
+		OPERATION_BUFFER_CLOBBER | OPERATION_BUFFER_CREATE);
+}
+
+/*
+ * operation_add_fill -- adds an operation which fills the buffer with the
+ *	byte to the undo log
+ *
+ * Unlike a copy of a buffer with the same contents, the entry takes up just
+ * a single cacheline of the log.
+ */
+int
+operation_add_fill(struct operation_context *ctx, void *dest, int c,
+	size_t size)
+{
+	ASSERTeq(ctx->type, LOG_TYPE_UNDO);
+
+	uint8_t byte = (uint8_t)c;
+
+	return operation_add_buffer_undo(ctx, dest, &byte, size,
+		ULOG_OPERATION_BUF_SET,
+		OPERATION_BUFFER_CLOBBER | OPERATION_BUFFER_CREATE);
+}
+
+/*
+ * operation_add_buffers -- adds a series of buffer operations to the log,
+ *	with the contents of each buffer logged in place
+ *
+ * The space for all of the entries of an undo log is reserved up front. The
+ * headers of all of the entries are then zeroed, which lets the entries
+ * themselves be written in any order, and so the whole series costs two
+ * drains instead of two per buffer.
+ */
+int
+operation_add_buffers(struct operation_context *ctx,
+	const struct user_buffer_def *bufs, size_t nbufs,
+	ulog_operation_type type)
+{
+	if (ctx->type == LOG_TYPE_REDO) {
+		for (size_t i = 0; i < nbufs; ++i) {
+			if (operation_add_buffer_redo(ctx, bufs[i].addr,
+			    bufs[i].addr, bufs[i].size, type) != 0)
+				return -1;
+		}
+		return 0;
+	}
+
+	/* buffers split between ulogs may still need a little more space */
+	size_t nbytes = 0;
+	for (size_t i = 0; i < nbufs; ++i)
+		nbytes += ALIGN_UP(bufs[i].size +
+			sizeof(struct ulog_entry_buf), CACHELINE_SIZE);
+
+	ctx->ulog_curr_gen_num = ctx->ulog->gen_num;
+	if (operation_reserve(ctx, ctx->total_logged + nbytes) != 0)
+		return -1;
+
+	struct operation_marker m;
+	operation_get_marker(ctx, &m);
 
-		ctx->ulog_curr = ctx->ulog_curr == NULL ? ctx->ulog :
-			ulog_next(ctx->ulog_curr, ctx->p_ops);
-		ASSERTne(ctx->ulog_curr, NULL);
-		ctx->ulog_curr_offset = 0;
-		ctx->ulog_curr_capacity = ctx->ulog_curr->capacity;
+	for (size_t i = 0; i < nbufs; ++i) {
+		if (operation_add_buffer_undo(ctx, bufs[i].addr,
+		    bufs[i].addr, bufs[i].size, type,
+		    OPERATION_BUFFER_CLOBBER) != 0) {
+			operation_set_marker(ctx, &m);
+			return -1;
+		}
 	}
+	pmemops_drain(ctx->p_ops);
 
-	size_t curr_size = MIN(real_size, ctx->ulog_curr_capacity);
-	size_t data_size = curr_size - sizeof(struct ulog_entry_buf);
-	size_t entry_size = ALIGN_UP(curr_size, CACHELINE_SIZE);
+	operation_set_marker(ctx, &m);
 
-	/*
-	 * To make sure that the log is consistent and contiguous, we need
-	 * make sure that the header of the entry that would be located
-	 * immediately after this one is zeroed.
-	 */
-	struct ulog_entry_base *next_entry = NULL;
-	if (entry_size == ctx->ulog_curr_capacity) {
-		struct ulog *u = ulog_next(ctx->ulog_curr, ctx->p_ops);
-		if (u != NULL)
-			next_entry = (struct ulog_entry_base *)u->data;
-	} else {
-		size_t next_entry_offset = ctx->ulog_curr_offset + entry_size;
-		next_entry = (struct ulog_entry_base *)(ctx->ulog_curr->data +
-			next_entry_offset);
+	for (size_t i = 0; i < nbufs; ++i) {
+		int ret = operation_add_buffer_undo(ctx, bufs[i].addr,
+			bufs[i].addr, bufs[i].size, type,
+			OPERATION_BUFFER_CREATE);
+		ASSERTeq(ret, 0); /* the first pass reserved the space */
 	}
-	if (next_entry != NULL)
-		ulog_clobber_entry(next_entry, ctx->p_ops);
-
-	/* create a persistent log entry */
-	struct ulog_entry_buf *e = ulog_entry_buf_create(ctx->ulog_curr,
-		ctx->ulog_curr_offset,
-		ctx->ulog_curr_gen_num,
-		dest, src, data_size,
-		type, ctx->p_ops);
-	ASSERT(entry_size == ulog_entry_size(&e->base));
-	ASSERT(entry_size <= ctx->ulog_curr_capacity);
-
-	ctx->total_logged += entry_size;
-	ctx->ulog_curr_offset += entry_size;
-	ctx->ulog_curr_capacity -= entry_size;
+	pmemops_drain(ctx->p_ops);
 
-	/*
-	 * Recursively add the data to the log until the entire buffer is
-	 * processed.
-	 */
-	return size - data_size == 0 ? 0 : operation_add_buffer(ctx,
-			(char *)dest + data_size,
-			(char *)src + data_size,
-			size - data_size, type);
+	return 0;
 }
 
 /*
@@ -610,6 +842,16 @@ operation_add_user_buffer(struct operation_context *ctx,
 	operation_set_any_user_buffer(ctx, 1);
 }
 
+/*
+ * operation_get_persistent_size -- returns the number of bytes taken by the
+ *	persistent entries of a redo operation
+ */
+size_t
+operation_get_persistent_size(struct operation_context *ctx)
+{
+	return ctx->pshadow_ops.offset;
+}
+
 /*
  * operation_set_auto_reserve -- set auto reserve value for context
  */
@@ -684,7 +926,7 @@ operation_reserve(struct operation_context *ctx, size_t new_capacity)
 		    ctx->ulog_base_nbytes,
 		    ctx->ulog_curr_gen_num,
 		    ctx->ulog_auto_reserve,
-		    &new_capacity, ctx->extend,
+		    &new_capacity, ctx->extend, 0,
 		    &ctx->next, ctx->p_ops) != 0)
 			return -1;
 		ctx->ulog_capacity = new_capacity;
@@ -693,6 +935,123 @@ operation_reserve(struct operation_context *ctx, size_t new_capacity)
 	return 0;
 }
 
+/*
+ * operation_prealloc -- reserves the given capacity of the persistent log and
+ *	keeps it between operations, instead of freeing the log extensions once
+ *	the operation is finished
+ */
+int
+operation_prealloc(struct operation_context *ctx, size_t capacity)
+{
+	ASSERTeq(ctx->state, OPERATION_IDLE);
+
+	ctx->ulog_prealloc = capacity;
+
+	if (capacity <= ctx->ulog_capacity)
+		return 0;
+
+	if (ctx->extend == NULL) {
+		ERR("no extend function present");
+		return -1;
+	}
+
+	/* the missing capacity is allocated in a single log */
+	size_t extend_size = ALIGN_UP(capacity - ctx->ulog_capacity,
+		CACHELINE_SIZE);
+
+	if (ulog_reserve(ctx->ulog, ctx->ulog_base_nbytes,
+	    ctx->ulog->gen_num, 1, &capacity, ctx->extend, extend_size,
+	    &ctx->next, ctx->p_ops) != 0)
+		return -1;
+
+	ctx->ulog_capacity = capacity;
+
+	return 0;
+}
+
+/*
+ * operation_get_capacity -- returns the total capacity of the persistent log
+ */
+size_t
+operation_get_capacity(struct operation_context *ctx)
+{
+	return ctx->ulog_capacity;
+}
+
+/*
+ * operation_get_marker -- returns the current end of the undo log
+ */
+void
+operation_get_marker(struct operation_context *ctx, struct operation_marker *m)
+{
+	ASSERTeq(ctx->type, LOG_TYPE_UNDO);
+
+	m->ulog_curr = ctx->ulog_curr;
+	m->ulog_curr_offset = ctx->ulog_curr_offset;
+	m->ulog_curr_capacity = ctx->ulog_curr_capacity;
+	m->ulog_curr_gen_num = ctx->ulog_curr_gen_num;
+	m->total_logged = ctx->total_logged;
+}
+
+/*
+ * operation_rollback_to -- calls the given callback for every entry added to
+ *	the undo log after the marker, from the newest one to the oldest, and
+ *	truncates the log back to it
+ *
+ * The entries can only be walked from the marker forward, so they are
+ * collected first, and nothing is applied if that fails. The entry at the
+ * marker is clobbered only once all of the callbacks have returned, so that
+ * an interrupted rollback is completed by the recovery.
+ */
+int
+operation_rollback_to(struct operation_context *ctx,
+	const struct operation_marker *m, ulog_entry_cb cb, void *arg)
+{
+	ASSERTeq(ctx->type, LOG_TYPE_UNDO);
+	ASSERT(m->total_logged <= ctx->total_logged);
+
+	struct ulog *u = m->ulog_curr == NULL ? ctx->ulog : m->ulog_curr;
+	size_t offset = m->ulog_curr == NULL ? 0 : m->ulog_curr_offset;
+	VEC(, struct ulog_entry_base *) entries = VEC_INITIALIZER;
+
+	for (size_t n = m->total_logged; n < ctx->total_logged; ) {
+		if (offset == u->capacity) {
+			u = ulog_next(u, ctx->p_ops);
+			ASSERTne(u, NULL);
+			offset = 0;
+		}
+
+		struct ulog_entry_base *e =
+			(struct ulog_entry_base *)(u->data + offset);
+		if (VEC_PUSH_BACK(&entries, e) != 0) {
+			VEC_DELETE(&entries);
+			return -1;
+		}
+
+		size_t size = ulog_entry_size(e);
+		offset += size;
+		n += size;
+	}
+
+	if (VEC_SIZE(&entries) == 0)
+		return 0;
+
+	struct ulog_entry_base *e;
+	VEC_FOREACH_REVERSE(e, &entries) {
+		cb(e, arg, ctx->p_ops);
+	}
+
+	pmemops_drain(ctx->p_ops);
+
+	/* the log ends at the marker from now on */
+	ulog_clobber_entry(*VEC_GET(&entries, 0), ctx->p_ops, 0);
+	VEC_DELETE(&entries);
+
+	operation_set_marker(ctx, m);
+
+	return 0;
+}
+
 /*
  * operation_init -- initializes runtime state of an operation
  */
@@ -813,13 +1172,18 @@ operation_finish(struct operation_context *ctx, unsigned flags)
 	if (ctx->type == LOG_TYPE_UNDO) {
 		int ret = ulog_clobber_data(ctx->ulog,
 			ctx->total_logged, ctx->ulog_base_nbytes,
+			ctx->ulog_prealloc,
 			&ctx->next, ctx->ulog_free,
 			operation_user_buffer_remove,
 			ctx->p_ops, flags);
 		if (ret == 0)
 			goto out;
 	} else if (ctx->type == LOG_TYPE_REDO) {
-		int ret = ulog_free_next(ctx->ulog, ctx->p_ops,
+		/* user buffers are unpinned starting from the first log */
+		struct ulog *u = (flags & ULOG_ANY_USER_BUFFER) ? ctx->ulog :
+			ulog_by_capacity(ctx->ulog, ctx->ulog_base_nbytes,
+				ctx->ulog_prealloc, ctx->p_ops);
+		int ret = ulog_free_next(u, ctx->p_ops,
 			ctx->ulog_free, operation_user_buffer_remove,
 			flags);
 		if (ret == 0)
@@ -41,6 +41,17 @@ struct user_buffer_def {
 
 struct operation_context;
 
+/*
+ * operation_marker -- a position in the undo log of an operation
+ */
+struct operation_marker {
+	struct ulog *ulog_curr;
+	size_t ulog_curr_offset;
+	size_t ulog_curr_capacity;
+	size_t ulog_curr_gen_num;
+	size_t total_logged;
+};
+
 struct operation_context *
 operation_new(struct ulog *redo, size_t ulog_base_nbytes,
 	ulog_extend_fn extend, ulog_free_fn ulog_free,
@@ -55,6 +66,11 @@ void operation_free_logs(struct operation_context *ctx, uint64_t flags);
 
 int operation_add_buffer(struct operation_context *ctx,
 	void *dest, void *src, size_t size, ulog_operation_type type);
+int operation_add_buffers(struct operation_context *ctx,
+	const struct user_buffer_def *bufs, size_t nbufs,
+	ulog_operation_type type);
+int operation_add_fill(struct operation_context *ctx, void *dest, int c,
+	size_t size);
 
 int operation_add_entry(struct operation_context *ctx,
 	void *ptr, uint64_t value, ulog_operation_type type);
@@ -70,9 +86,16 @@ void operation_set_auto_reserve(struct operation_context *ctx,
 void operation_set_any_user_buffer(struct operation_context *ctx,
 	int any_user_buffer);
 int operation_get_any_user_buffer(struct operation_context *ctx);
+size_t operation_get_persistent_size(struct operation_context *ctx);
 int operation_user_buffer_range_cmp(const void *lhs, const void *rhs);
 
 int operation_reserve(struct operation_context *ctx, size_t new_capacity);
+int operation_prealloc(struct operation_context *ctx, size_t capacity);
+size_t operation_get_capacity(struct operation_context *ctx);
+void operation_get_marker(struct operation_context *ctx,
+	struct operation_marker *m);
+int operation_rollback_to(struct operation_context *ctx,
+	const struct operation_marker *m, ulog_entry_cb cb, void *arg);
 void operation_process(struct operation_context *ctx);
 void operation_finish(struct operation_context *ctx, unsigned flags);
 void operation_cancel(struct operation_context *ctx);
@@ -13,12 +13,15 @@
 #include "valgrind_internal.h"
 #include "libpmem.h"
 #include "memblock.h"
+#include "addr_map.h"
 #include "critnib.h"
 #include "list.h"
 #include "mmap.h"
 #include "obj.h"
 #include "ctl_global.h"
 #include "ravl.h"
+#include "rep_writer.h"
+#include "snapshot.h"
 
 #include "heap_layout.h"
 #include "os.h"
@@ -64,6 +67,8 @@ static const struct pool_attr Obj_open_attr = {
 
 static struct critnib *pools_ht; /* hash table used for searching by UUID */
 static struct critnib *pools_tree; /* tree used for searching by address */
+static struct addr_map *pools_map; /* table used for searching by address */
+static unsigned pools_unmapped; /* pools that are only in pools_tree */
 
 int _pobj_cache_invalidate;
 
@@ -71,6 +76,18 @@ int _pobj_cache_invalidate;
 
 __thread struct _pobj_pcache _pobj_cached_pool;
 
+/*
+ * the pool last found by pmemobj_pool_by_ptr, valid as long as the invalidate
+ * counter doesn't change, the bounds are cached so that checking an address
+ * doesn't touch the header of a pool that's being closed
+ */
+static __thread struct {
+	PMEMobjpool *pop;
+	uintptr_t start;
+	uintptr_t end;
+	int invalidate;
+} Pool_by_ptr_cache;
+
 /*
  * pmemobj_direct -- returns the direct pointer of an object
  */
@@ -166,6 +183,7 @@ obj_ctl_init_and_load(PMEMobjpool *pop)
 		pmalloc_ctl_register(pop);
 		stats_ctl_register(pop);
 		debug_ctl_register(pop);
+		snapshot_ctl_register(pop);
 	}
 
 	char *env_config = os_getenv(OBJ_CONFIG_ENV_VARIABLE);
@@ -228,6 +246,14 @@ obj_pool_init(void)
 		if (!util_bool_compare_and_swap64(&pools_tree, NULL, c))
 			critnib_delete(c);
 	}
+
+	if (pools_map == NULL) {
+		struct addr_map *m = addr_map_new();
+		if (m == NULL)
+			FATAL("!addr_map_new for pools_map");
+		if (!util_bool_compare_and_swap64(&pools_map, NULL, m))
+			addr_map_delete(m);
+	}
 }
 
 /*
@@ -278,6 +304,8 @@ obj_init(void)
 	 * subsequent call to this function for individual pools.
 	 */
 	ctl_global_register();
+	lane_ctl_register();
+	rep_writer_ctl_register();
 
 	if (obj_ctl_init_and_load(NULL))
 		FATAL("error: %s", pmemobj_errormsg());
@@ -301,6 +329,8 @@ obj_fini(void)
 		critnib_delete(pools_ht);
 	if (pools_tree)
 		critnib_delete(pools_tree);
+	if (pools_map)
+		addr_map_delete(pools_map);
 	lane_info_destroy();
 	util_remote_fini();
 
@@ -709,6 +739,151 @@ obj_rep_drain(void *ctx)
 	}
 }
 
+/*
+ * obj_arep_push -- (internal) hands the range of the master replica over to
+ *	the writers of the local replicas
+ *
+ * The range is copied right away to the replicas without a writer, or whose
+ * writer can't take any more ranges.
+ */
+static void
+obj_arep_push(PMEMobjpool *pop, const void *addr, size_t len)
+{
+	uint64_t off = (uintptr_t)addr - (uintptr_t)pop;
+
+	PMEMobjpool *rep = pop->replica;
+	while (rep) {
+		if (rep->rep_writer == NULL ||
+				rep_writer_push(rep->rep_writer, off, len) != 0)
+			rep->memcpy_local((char *)rep + off, addr, len,
+				PMEM_F_MEM_NODRAIN);
+		rep = rep->replica;
+	}
+}
+
+/*
+ * obj_arep_wait -- (internal) waits until all of the ranges handed over to
+ *	the writers are copied and drained
+ */
+static void
+obj_arep_wait(PMEMobjpool *pop)
+{
+	PMEMobjpool *rep = pop->replica;
+	while (rep) {
+		if (rep->rep_writer != NULL)
+			rep_writer_wait(rep->rep_writer);
+		/* the ranges copied by this thread */
+		rep->drain_local();
+		rep = rep->replica;
+	}
+}
+
+/*
+ * obj_arep_memcpy -- (internal) memcpy with asynchronous replication
+ */
+static void *
+obj_arep_memcpy(void *ctx, void *dest, const void *src, size_t len,
+		unsigned flags)
+{
+	PMEMobjpool *pop = ctx;
+	LOG(15, "pop %p dest %p src %p len %zu flags 0x%x", pop, dest, src, len,
+			flags);
+
+	void *ret = pop->memcpy_local(dest, src, len, flags);
+
+	obj_arep_push(pop, dest, len);
+	if (!(flags & (PMEM_F_MEM_NODRAIN | PMEM_F_MEM_NOFLUSH)))
+		obj_arep_wait(pop);
+
+	return ret;
+}
+
+/*
+ * obj_arep_memmove -- (internal) memmove with asynchronous replication
+ */
+static void *
+obj_arep_memmove(void *ctx, void *dest, const void *src, size_t len,
+		unsigned flags)
+{
+	PMEMobjpool *pop = ctx;
+	LOG(15, "pop %p dest %p src %p len %zu flags 0x%x", pop, dest, src, len,
+			flags);
+
+	void *ret = pop->memmove_local(dest, src, len, flags);
+
+	obj_arep_push(pop, dest, len);
+	if (!(flags & (PMEM_F_MEM_NODRAIN | PMEM_F_MEM_NOFLUSH)))
+		obj_arep_wait(pop);
+
+	return ret;
+}
+
+/*
+ * obj_arep_memset -- (internal) memset with asynchronous replication
+ */
+static void *
+obj_arep_memset(void *ctx, void *dest, int c, size_t len, unsigned flags)
+{
+	PMEMobjpool *pop = ctx;
+	LOG(15, "pop %p dest %p c 0x%02x len %zu flags 0x%x", pop, dest, c, len,
+			flags);
+
+	void *ret = pop->memset_local(dest, c, len, flags);
+
+	obj_arep_push(pop, dest, len);
+	if (!(flags & (PMEM_F_MEM_NODRAIN | PMEM_F_MEM_NOFLUSH)))
+		obj_arep_wait(pop);
+
+	return ret;
+}
+
+/*
+ * obj_arep_persist -- (internal) persist with asynchronous replication
+ *
+ * The range is handed over to the writers first, so that the master replica
+ * is flushed while the replicas are being written.
+ */
+static int
+obj_arep_persist(void *ctx, const void *addr, size_t len, unsigned flags)
+{
+	PMEMobjpool *pop = ctx;
+	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
+
+	obj_arep_push(pop, addr, len);
+	pop->persist_local(addr, len);
+	obj_arep_wait(pop);
+
+	return 0;
+}
+
+/*
+ * obj_arep_flush -- (internal) flush with asynchronous replication
+ */
+static int
+obj_arep_flush(void *ctx, const void *addr, size_t len, unsigned flags)
+{
+	PMEMobjpool *pop = ctx;
+	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
+
+	obj_arep_push(pop, addr, len);
+	pop->flush_local(addr, len);
+
+	return 0;
+}
+
+/*
+ * obj_arep_drain -- (internal) drain with asynchronous replication
+ */
+static void
+obj_arep_drain(void *ctx)
+{
+	PMEMobjpool *pop = ctx;
+	LOG(15, "pop %p", pop);
+
+	pop->drain_local();
+	obj_arep_wait(pop);
+}
+
 #if VG_MEMCHECK_ENABLED
 /*
  * Arbitrary value. When there's more undefined regions than MAX_UNDEFS, it's
@@ -1101,7 +1276,15 @@ obj_replica_init(PMEMobjpool *rep, struct pool_set *set, unsigned repidx,
 		rep->is_master_replica = 1;
 		rep->has_remote_replicas = set->remote;
 
-		if (set->nreplicas > 1) {
+		if (set->nreplicas > 1 && !set->remote &&
+				rep_writer_enabled()) {
+			rep->p_ops.persist = obj_arep_persist;
+			rep->p_ops.flush = obj_arep_flush;
+			rep->p_ops.drain = obj_arep_drain;
+			rep->p_ops.memcpy = obj_arep_memcpy;
+			rep->p_ops.memmove = obj_arep_memmove;
+			rep->p_ops.memset = obj_arep_memset;
+		} else if (set->nreplicas > 1) {
 			rep->p_ops.persist = obj_rep_persist;
 			rep->p_ops.flush = obj_rep_flush;
 			rep->p_ops.drain = obj_rep_drain;
@@ -1158,6 +1341,57 @@ obj_replica_fini(struct pool_replica *repset)
 		obj_cleanup_remote(rep);
 }
 
+/*
+ * obj_pool_unmap -- (internal) remove the pool from the table of addresses
+ */
+static void
+obj_pool_unmap(PMEMobjpool *pop)
+{
+	if (addr_map_remove(pools_map, (uintptr_t)pop, pop->set->poolsize,
+			pop) != 0)
+		util_fetch_and_sub32(&pools_unmapped, 1);
+}
+
+/*
+ * obj_rep_writers_start -- (internal) starts the writers of the local replicas
+ *	if the pool is replicated asynchronously
+ *
+ * A replica whose writer can't be started is written synchronously.
+ */
+static void
+obj_rep_writers_start(PMEMobjpool *pop)
+{
+	if (pop->p_ops.persist != obj_arep_persist)
+		return;
+
+	for (PMEMobjpool *rep = pop->replica; rep; rep = rep->replica) {
+		struct rep_writer *w = rep_writer_new(pop, rep);
+		if (w == NULL) {
+			LOG(2, "replica %p is written synchronously", rep);
+			continue;
+		}
+
+		util_atomic_store_explicit64(&rep->rep_writer, w,
+			memory_order_release);
+	}
+}
+
+/*
+ * obj_rep_writers_stop -- (internal) waits for the writers of the replicas
+ *	to copy all of the pending ranges and stops them
+ */
+static void
+obj_rep_writers_stop(PMEMobjpool *pop)
+{
+	for (PMEMobjpool *rep = pop->replica; rep; rep = rep->replica) {
+		if (rep->rep_writer == NULL)
+			continue;
+
+		rep_writer_delete(rep->rep_writer);
+		rep->rep_writer = NULL;
+	}
+}
+
 /*
  * obj_runtime_init -- (internal) initialize runtime part of the pool header
  */
@@ -1192,6 +1426,10 @@ obj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 	if (pop->stats == NULL)
 		goto err_stat;
 
+	pop->compactor = compactor_new(pop);
+	if (pop->compactor == NULL)
+		goto err_compactor;
+
 	pop->user_data = NULL;
 
 	VALGRIND_REMOVE_PMEM_MAPPING(&pop->mutex_head,
@@ -1204,6 +1442,10 @@ obj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 	pop->rwlock_head = NULL;
 	pop->cond_head = NULL;
 
+	VALGRIND_REMOVE_PMEM_MAPPING(&pop->srwlock_readers,
+		sizeof(pop->srwlock_readers));
+	pop->srwlock_readers = NULL;
+
 	if (boot) {
 		if ((errno = obj_runtime_init_common(pop)) != 0)
 			goto err_boot;
@@ -1228,6 +1470,11 @@ obj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 			ERR("!critnib_insert to pools_tree");
 			goto err_tree_insert;
 		}
+
+		/* pools that don't fit in the table are found in the tree */
+		if (addr_map_insert(pools_map, (uintptr_t)pop,
+				pop->set->poolsize, pop) != 0)
+			util_fetch_and_add32(&pools_unmapped, 1);
 	}
 
 	if (obj_ctl_init_and_load(pop) != 0) {
@@ -1245,6 +1492,10 @@ obj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 	}
 	pop->ulog_user_buffers.verify = 0;
 
+	/* the logs requested by the configuration are preallocated upfront */
+	if (boot && lane_prealloc(pop) != 0)
+		goto err_lane_prealloc;
+
 	/*
 	 * If possible, turn off all permissions on the pool header page.
 	 *
@@ -1258,12 +1509,20 @@ obj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 	pop->peak_user_size = 0;
 #endif
 
+	if (boot)
+		obj_rep_writers_start(pop);
+
 	return 0;
 
+err_lane_prealloc:
+	ravl_delete(pop->ulog_user_buffers.map);
 err_user_buffers_map:
 	util_mutex_destroy(&pop->ulog_user_buffers.lock);
+	compactor_set_enabled(pop->compactor, 0);
 	ctl_delete(pop->ctl);
-err_ctl:;
+err_ctl:
+	obj_pool_unmap(pop);
+	_pobj_cache_invalidate++;
 	void *n = critnib_remove(pools_tree, (uint64_t)pop);
 	ASSERTne(n, NULL);
 err_tree_insert:
@@ -1271,6 +1530,8 @@ err_tree_insert:
 err_critnib_insert:
 	obj_runtime_cleanup_common(pop);
 err_boot:
+	compactor_delete(pop->compactor);
+err_compactor:
 	stats_delete(pop, pop->stats);
 err_stat:
 	tx_params_delete(pop->tx_params);
@@ -1520,6 +1781,48 @@ obj_read_remote(void *ctx, uintptr_t base, void *dest, void *addr,
 	return 0;
 }
 
+/*
+ * obj_feature_enable -- marks the pool as using an incompat feature
+ *
+ * Versions of the library which don't know the feature refuse to open the
+ * pool from then on. The headers of the other parts and replicas are no longer
+ * mapped at runtime, so this is only supported for single-file pools.
+ */
+int
+obj_feature_enable(PMEMobjpool *pop, features_t feature)
+{
+	LOG(3, "pop %p incompat %#x", pop, feature.incompat);
+
+	struct pool_set *set = pop->set;
+	if (set->nreplicas != 1 || set->replica[0]->nparts != 1 ||
+	    set->replica[0]->remote) {
+		ERR("enabling pool features at runtime is supported only "
+			"for single-file pools");
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	/* the header isn't addressable from the sanitizer's point of view */
+	struct pool_hdr hdr;
+	RANGE_RW(&pop->hdr, sizeof(hdr), pop->is_dev_dax);
+	pmdk_asan_memcpy(&hdr, &pop->hdr, sizeof(hdr));
+	util_convert2h_hdr_nocheck(&hdr);
+
+	if (!util_feature_is_set(hdr.features, feature)) {
+		util_feature_enable(&hdr.features, feature);
+		util_convert2le_hdr(&hdr);
+		util_checksum(&hdr, sizeof(hdr), &hdr.checksum, 1,
+			POOL_HDR_CSUM_END_OFF(&hdr));
+
+		pmdk_asan_memcpy(&pop->hdr, &hdr, sizeof(hdr));
+		pmemops_persist(&pop->p_ops, &pop->hdr, sizeof(hdr));
+	}
+
+	RANGE_NONE(&pop->hdr, sizeof(hdr), pop->is_dev_dax);
+
+	return 0;
+}
+
 /*
  * obj_check_basic_remote -- (internal) basic pool consistency check
  *                               of a remote replica
@@ -1742,6 +2045,7 @@ obj_open_common(const char *path, const char *layout, unsigned flags, int boot)
 	}
 
 	pop->set = set;
+	pop->is_cow = (flags & POOL_OPEN_COW) != 0;
 
 	if (boot) {
 		/* check consistency of 'master' replica */
@@ -1922,6 +2226,8 @@ obj_pool_cleanup(PMEMobjpool *pop)
 {
 	LOG(3, "pop %p", pop);
 
+	compactor_delete(pop->compactor);
+
 	ravl_delete(pop->ulog_user_buffers.map);
 	util_mutex_destroy(&pop->ulog_user_buffers.lock);
 
@@ -1930,10 +2236,13 @@ obj_pool_cleanup(PMEMobjpool *pop)
 	ctl_delete(pop->ctl);
 
 	obj_pool_lock_cleanup(pop);
+	srwlock_readers_delete(pop->srwlock_readers);
 
 	lane_section_cleanup(pop);
 	lane_cleanup(pop);
 
+	obj_rep_writers_stop(pop);
+
 	/* unmap all the replicas */
 	obj_replicas_cleanup(pop->set);
 	util_poolset_close(pop->set, DO_NOT_DELETE_PARTS);
@@ -1966,12 +2275,17 @@ pmemobj_close_no_asan(PMEMobjpool *pop)
 	printf("Peak    estimated pool usage (wo/ the PSM): %lu\n", pop->peak_user_size-psm_size);
 #endif
 
+	/* the compactor must not observe the pool being torn down */
+	compactor_set_enabled(pop->compactor, 0);
+
 	_pobj_cache_invalidate++;
 
 	if (critnib_remove(pools_ht, pop->uuid_lo) != pop) {
 		ERR("critnib_remove for pools_ht");
 	}
 
+	obj_pool_unmap(pop);
+
 	if (critnib_remove(pools_tree, (uint64_t)pop) != pop)
 		ERR("critnib_remove for pools_tree");
 
@@ -2030,6 +2344,7 @@ pmemobj_checkU(const char *path, const char *layout)
 	if (consistent) {
 		obj_pool_cleanup(pop);
 	} else {
+		compactor_delete(pop->compactor);
 		stats_delete(pop, pop->stats);
 		tx_params_delete(pop->tx_params);
 		ctl_delete(pop->ctl);
@@ -2117,18 +2432,33 @@ pmemobj_pool_by_ptr(const void *addr)
 	if ((pop != NULL) && OBJ_PTR_FROM_POOL(pop, addr))
 		return pop;
 
+#ifndef _WIN32
+	if (Pool_by_ptr_cache.invalidate == _pobj_cache_invalidate &&
+	    (uintptr_t)addr >= Pool_by_ptr_cache.start &&
+	    (uintptr_t)addr < Pool_by_ptr_cache.end)
+		return Pool_by_ptr_cache.pop;
+#endif
+
 	/* XXX this is a temporary fix, to be fixed properly later */
-	if (pools_tree == NULL)
+	if (pools_map == NULL)
 		return NULL;
 
-	pop = critnib_find_le(pools_tree, (uint64_t)addr);
-	if (pop == NULL)
-		return NULL;
+	int invalidate = _pobj_cache_invalidate;
 
-	size_t pool_size = pop->heap_offset + pop->heap_size;
-	if ((char *)addr >= (char *)pop + pool_size)
+	pop = addr_map_get(pools_map, (uintptr_t)addr);
+	if (pop == NULL && pools_unmapped != 0)
+		pop = critnib_find_le(pools_tree, (uint64_t)addr);
+	if (pop == NULL || !OBJ_PTR_FROM_POOL(pop, addr))
 		return NULL;
 
+#ifndef _WIN32
+	Pool_by_ptr_cache.pop = pop;
+	Pool_by_ptr_cache.start = (uintptr_t)pop;
+	Pool_by_ptr_cache.end = (uintptr_t)pop + pop->heap_offset +
+		pop->heap_size;
+	Pool_by_ptr_cache.invalidate = invalidate;
+#endif
+
 	return pop;
 }
 
@@ -2202,6 +2532,8 @@ obj_alloc_construct(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 		return -1;
 	}
 
+	uint64_t start = STATS_LATENCY_START(pop->stats);
+
 	struct constr_args carg;
 
 	carg.zero_init = flags & POBJ_FLAG_ZERO;
@@ -2222,6 +2554,9 @@ obj_alloc_construct(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 
 	pmalloc_operation_release(pop);
 
+	if (ret == 0)
+		STATS_LATENCY_END(pop->stats, LATENCY_ALLOC, start);
+
 	return ret;
 }
 
@@ -2754,7 +3089,11 @@ pmemobj_persist(PMEMobjpool *pop, const void *addr, size_t len)
 {
 	LOG(15, "pop %p addr %p len %zu", pop, addr, len);
 
+	uint64_t start = STATS_LATENCY_START(pop->stats);
+
 	pmemops_persist(&pop->p_ops, addr, len);
+
+	STATS_LATENCY_END(pop->stats, LATENCY_PERSIST, start);
 }
 
 /*
@@ -2783,7 +3122,13 @@ pmemobj_xpersist(PMEMobjpool *pop, const void *addr, size_t len, unsigned flags)
 		return -1;
 	}
 
-	return pmemops_xpersist(&pop->p_ops, addr, len, flags);
+	uint64_t start = STATS_LATENCY_START(pop->stats);
+
+	int ret = pmemops_xpersist(&pop->p_ops, addr, len, flags);
+
+	STATS_LATENCY_END(pop->stats, LATENCY_PERSIST, start);
+
+	return ret;
 }
 
 /*
@@ -3079,6 +3424,48 @@ pmemobj_xreserve(PMEMobjpool *pop, struct pobj_action *act,
 	return oid;
 }
 
+/*
+ * pmemobj_xreserve_bulk -- reserves multiple objects of the same size
+ */
+int
+pmemobj_xreserve_bulk(PMEMobjpool *pop, struct pobj_action *actv,
+	PMEMoid *oidv, size_t actvcnt, size_t size, uint64_t type_num,
+	uint64_t flags)
+{
+	LOG(3, "pop %p actv %p oidv %p actvcnt %zu size %zu type_num %llx "
+		"flags %llx", pop, actv, oidv, actvcnt, size,
+		(unsigned long long)type_num, (unsigned long long)flags);
+
+	if (flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS) {
+		ERR("unknown flags 0x%" PRIx64,
+				flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS);
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+	struct constr_args carg;
+
+	carg.zero_init = flags & POBJ_FLAG_ZERO;
+	carg.constructor = NULL;
+	carg.arg = NULL;
+
+	if (palloc_reserve_bulk(&pop->heap, size, constructor_alloc, &carg,
+		type_num, 0, CLASS_ID_FROM_FLAG(flags),
+		ARENA_ID_FROM_FLAG(flags), actv, actvcnt) != 0) {
+		PMEMOBJ_API_END();
+		return -1;
+	}
+
+	for (size_t i = 0; oidv != NULL && i < actvcnt; ++i) {
+		oidv[i].off = actv[i].heap.offset;
+		oidv[i].pool_uuid_lo = pop->uuid_lo;
+	}
+
+	PMEMOBJ_API_END();
+	return 0;
+}
+
 /*
  * pmemobj_set_value -- creates an action to set a value
  */
@@ -3445,6 +3832,149 @@ pmemobj_ctl_execW(PMEMobjpool *pop, const wchar_t *name, void *arg)
 }
 #endif
 
+/*
+ * CTL query compiled by pmemobj_ctl_compile, bound to the pool it was
+ * compiled for
+ */
+struct pobj_ctl_handle {
+	PMEMobjpool *pop;
+	struct ctl_handle *h;
+};
+
+/*
+ * pmemobj_ctl_compileU -- resolves the name of a ctl entry point once, so
+ *	that it can be queried without parsing the name on every call
+ */
+#ifndef _WIN32
+static inline
+#endif
+struct pobj_ctl_handle *
+pmemobj_ctl_compileU(PMEMobjpool *pop, const char *name)
+{
+	LOG(3, "pop %p name %s", pop, name);
+
+	struct pobj_ctl_handle *handle = Malloc(sizeof(*handle));
+	if (handle == NULL) {
+		ERR("!Malloc");
+		return NULL;
+	}
+
+	handle->pop = pop;
+	handle->h = ctl_compile(pop == NULL ? NULL : pop->ctl, name);
+	if (handle->h == NULL) {
+		Free(handle);
+		return NULL;
+	}
+
+	return handle;
+}
+
+#ifndef _WIN32
+/*
+ * pmemobj_ctl_compile -- resolves the name of a ctl entry point once
+ */
+struct pobj_ctl_handle *
+pmemobj_ctl_compile(PMEMobjpool *pop, const char *name)
+{
+	return pmemobj_ctl_compileU(pop, name);
+}
+#else
+/*
+ * pmemobj_ctl_compileW -- resolves the name of a ctl entry point once
+ */
+struct pobj_ctl_handle *
+pmemobj_ctl_compileW(PMEMobjpool *pop, const wchar_t *name)
+{
+	char *uname = util_toUTF8(name);
+	if (uname == NULL)
+		return NULL;
+
+	struct pobj_ctl_handle *handle = pmemobj_ctl_compileU(pop, uname);
+	util_free_UTF8(uname);
+
+	return handle;
+}
+#endif
+
+/*
+ * pmemobj_ctl_get_h -- executes a read ctl query of the compiled entry point
+ */
+int
+pmemobj_ctl_get_h(struct pobj_ctl_handle *handle, void *arg)
+{
+	LOG(3, "handle %p arg %p", handle, arg);
+
+	if (handle == NULL) {
+		ERR("invalid ctl handle");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return ctl_query_handle(handle->h, handle->pop, CTL_QUERY_READ, arg);
+}
+
+/*
+ * pmemobj_ctl_set_h -- executes a write ctl query of the compiled entry point
+ */
+int
+pmemobj_ctl_set_h(struct pobj_ctl_handle *handle, void *arg)
+{
+	LOG(3, "handle %p arg %p", handle, arg);
+
+	if (handle == NULL) {
+		ERR("invalid ctl handle");
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+
+	int ret = ctl_query_handle(handle->h, handle->pop, CTL_QUERY_WRITE,
+		arg);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_ctl_exec_h -- executes a runnable ctl query of the compiled entry
+ *	point
+ */
+int
+pmemobj_ctl_exec_h(struct pobj_ctl_handle *handle, void *arg)
+{
+	LOG(3, "handle %p arg %p", handle, arg);
+
+	if (handle == NULL) {
+		ERR("invalid ctl handle");
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+
+	int ret = ctl_query_handle(handle->h, handle->pop, CTL_QUERY_RUNNABLE,
+		arg);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_ctl_handle_free -- frees the compiled ctl entry point
+ */
+void
+pmemobj_ctl_handle_free(struct pobj_ctl_handle *handle)
+{
+	LOG(3, "handle %p", handle);
+
+	if (handle == NULL)
+		return;
+
+	ctl_handle_delete(handle->h);
+	Free(handle);
+}
+
 /*
  * _pobj_debug_notice -- logs notice message if used inside a transaction
  */
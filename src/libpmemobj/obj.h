@@ -17,6 +17,7 @@
 #include "ctl.h"
 #include "sync.h"
 #include "stats.h"
+#include "compactor.h"
 #include "ctl_debug.h"
 #include "page_size.h"
 
@@ -96,9 +97,9 @@ typedef uint64_t type_num_t;
 
 /* PMEM_OBJ_POOL_HEAD_SIZE Without the unused and unused2 arrays */
 #if PMASAN_TRACK_SPACE_USAGE
-#define PMEM_OBJ_POOL_HEAD_SIZE (2196+16)
+#define PMEM_OBJ_POOL_HEAD_SIZE (2228+16)
 #else
-#define PMEM_OBJ_POOL_HEAD_SIZE 2196
+#define PMEM_OBJ_POOL_HEAD_SIZE 2228
 #endif
 #define PMEM_OBJ_POOL_UNUSED2_SIZE (PMEM_PAGESIZE \
 					- OBJ_DSC_P_UNUSED\
@@ -143,9 +144,11 @@ struct pmemobjpool {
 	struct lane_descriptor lanes_desc;
 	uint64_t uuid_lo;
 	int is_dev_dax;		/* true if mapped on device dax */
+	int is_cow;		/* true if changes aren't written to the file */
 
 	struct ctl *ctl;	/* top level node of the ctl tree structure */
 	struct stats *stats;
+	struct compactor *compactor;	/* background heap compactor */
 
 	struct pool_set *set;		/* pool set info */
 	struct pmemobjpool *replica;	/* next replica */
@@ -186,6 +189,12 @@ struct pmemobjpool {
 	PMEMrwlock_internal *rwlock_head;
 	PMEMcond_internal *cond_head;
 
+	/* reader indicators of PMEMsrwlocks */
+	struct srwlock_readers *srwlock_readers;
+
+	/* asynchronous writer of this replica, NULL if written synchronously */
+	struct rep_writer *rep_writer;
+
 	struct {
 		struct ravl *map;
 		os_mutex_t lock;
@@ -256,6 +265,7 @@ void obj_init(void);
 void obj_fini(void);
 int obj_read_remote(void *ctx, uintptr_t base, void *dest, void *addr,
 		size_t length);
+int obj_feature_enable(PMEMobjpool *pop, features_t feature);
 
 /*
  * (debug helper macro) logs notice message if used inside a transaction
@@ -155,33 +155,42 @@ alloc_prep_block(struct palloc_heap *heap, const struct memory_block *m,
 }
 
 /*
- * palloc_reservation_create -- creates a volatile reservation of a
- *	memory block.
- *
- * The first step in the allocation of a new block is reserving it in
- * the transient heap - which is represented by the bucket abstraction.
- *
- * To provide optimal scaling for multi-threaded applications and reduce
- * fragmentation the appropriate bucket is chosen depending on the
- * current thread context and to which allocation class the requested
- * size falls into.
+ * palloc_restore_free_chunk_state -- updates the runtime state of a free chunk.
  *
- * Once the bucket is selected, just enough memory is reserved for the
- * requested size. The underlying block allocation algorithm
- * (best-fit, next-fit, ...) varies depending on the bucket container.
+ * This function also takes care of coalescing of huge chunks.
  */
-static int
-palloc_reservation_create(struct palloc_heap *heap, size_t size,
-	palloc_constr constructor, void *arg,
-	uint64_t extra_field, uint16_t object_flags,
-	uint16_t class_id, uint16_t arena_id,
-	struct pobj_action_internal *out)
+static void
+palloc_restore_free_chunk_state(struct palloc_heap *heap,
+	struct memory_block *m)
 {
-	int err = 0;
-
-	struct memory_block *new_block = &out->m;
-	out->type = POBJ_ACTION_TYPE_HEAP;
+	if (m->type == MEMORY_BLOCK_HUGE) {
+		int ret = heap_huge_cache_put(heap, m);
+		if (ret > 0) {
+			struct bucket *b = heap_bucket_acquire(heap,
+				DEFAULT_ALLOC_CLASS_ID,
+				HEAP_ARENA_PER_THREAD);
+			ret = heap_free_chunk_reuse(heap, b, m);
+			heap_bucket_release(heap, b);
+		}
+		if (ret != 0) {
+			if (errno == EEXIST) {
+				FATAL(
+					"duplicate runtime chunk state, possible double free");
+			} else {
+				LOG(2, "unable to track runtime chunk state");
+			}
+		}
+	}
+}
 
+/*
+ * palloc_reservation_class -- (internal) finds the allocation class for
+ *	a reservation and calculates the number of units it requires
+ */
+static struct alloc_class *
+palloc_reservation_class(struct palloc_heap *heap, size_t size,
+	uint16_t class_id, uint32_t *size_idx)
+{
 	ASSERT(class_id < UINT8_MAX);
 	struct alloc_class *c = class_id == 0 ?
 		heap_get_best_class(heap, size) :
@@ -191,7 +200,7 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 	if (c == NULL) {
 		ERR("no allocation class for size %lu bytes", size);
 		errno = EINVAL;
-		return -1;
+		return NULL;
 	}
 
 	/*
@@ -202,22 +211,33 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 	 * For example, to allocate 500 bytes from a bucket that
 	 * provides 256 byte blocks two memory 'units' are required.
 	 */
-	ssize_t size_idx = alloc_class_calc_size_idx(c, size);
-	if (size_idx < 0) {
+	ssize_t idx = alloc_class_calc_size_idx(c, size);
+	if (idx < 0) {
 		ERR("allocation class not suitable for size %lu bytes",
 			size);
 		errno = EINVAL;
-		return -1;
+		return NULL;
 	}
-	ASSERT(size_idx <= UINT32_MAX);
-	*new_block = MEMORY_BLOCK_NONE;
-	new_block->size_idx = (uint32_t)size_idx;
+	ASSERT(idx <= UINT32_MAX);
+	*size_idx = (uint32_t)idx;
 
-	struct bucket *b = heap_bucket_acquire(heap, c->id, arena_id);
+	return c;
+}
 
-	err = heap_get_bestfit_block(heap, b, new_block);
-	if (err != 0)
-		goto out;
+/*
+ * palloc_reservation_prep -- (internal) prepares a memory block, reserved
+ *	from the given bucket, for use and tracks the reservation in the runtime
+ *	state, returns an error number on failure
+ *
+ * Must be called with the bucket lock taken.
+ */
+static int
+palloc_reservation_prep(struct palloc_heap *heap, struct bucket *b,
+	palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags,
+	struct pobj_action_internal *out)
+{
+	struct memory_block *new_block = &out->m;
 
 	if (alloc_prep_block(heap, new_block, constructor, arg,
 		extra_field, object_flags, out) != 0) {
@@ -225,11 +245,7 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 		 * Constructor returned non-zero value which means
 		 * the memory block reservation has to be rolled back.
 		 */
-		if (new_block->type == MEMORY_BLOCK_HUGE) {
-			bucket_insert_block(b, new_block);
-		}
-		err = ECANCELED;
-		goto out;
+		return ECANCELED;
 	}
 
 	/*
@@ -244,12 +260,77 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 	out->lock = new_block->m_ops->get_lock(new_block);
 	out->new_state = MEMBLOCK_ALLOCATED;
 
+	util_atomic_store_explicit64(&b->nallocs, b->nallocs + 1,
+		memory_order_relaxed);
+
+	return 0;
+}
+
+/*
+ * palloc_reservation_create -- creates a volatile reservation of a
+ *	memory block.
+ *
+ * The first step in the allocation of a new block is reserving it in
+ * the transient heap - which is represented by the bucket abstraction.
+ *
+ * To provide optimal scaling for multi-threaded applications and reduce
+ * fragmentation the appropriate bucket is chosen depending on the
+ * current thread context and to which allocation class the requested
+ * size falls into.
+ *
+ * Once the bucket is selected, just enough memory is reserved for the
+ * requested size. The underlying block allocation algorithm
+ * (best-fit, next-fit, ...) varies depending on the bucket container.
+ */
+static int
+palloc_reservation_create(struct palloc_heap *heap, size_t size,
+	palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags,
+	uint16_t class_id, uint16_t arena_id,
+	struct pobj_action_internal *out)
+{
+	int err = 0;
+
+	struct memory_block *new_block = &out->m;
+	out->type = POBJ_ACTION_TYPE_HEAP;
+
+	uint32_t size_idx;
+	struct alloc_class *c = palloc_reservation_class(heap, size,
+		class_id, &size_idx);
+	if (c == NULL)
+		return -1;
+
+	*new_block = MEMORY_BLOCK_NONE;
+	new_block->size_idx = size_idx;
+
+	/*
+	 * Huge blocks are first looked for in the cache of the arena, which
+	 * avoids taking the global lock of the default bucket.
+	 */
+	struct bucket *b = NULL;
+	if (c->id == DEFAULT_ALLOC_CLASS_ID)
+		b = heap_huge_cache_acquire(heap, arena_id, new_block);
+
+	if (b == NULL) {
+		b = heap_bucket_acquire(heap, c->id, arena_id);
+
+		err = heap_get_bestfit_block(heap, b, new_block);
+		if (err != 0)
+			goto out;
+	}
+
+	err = palloc_reservation_prep(heap, b, constructor, arg,
+		extra_field, object_flags, out);
+
 out:
 	heap_bucket_release(heap, b);
 
 	if (err == 0)
 		return 0;
 
+	if (err == ECANCELED && new_block->type == MEMORY_BLOCK_HUGE)
+		palloc_restore_free_chunk_state(heap, new_block);
+
 	errno = err;
 	return -1;
 }
@@ -278,31 +359,6 @@ palloc_heap_action_exec(struct palloc_heap *heap,
 	act->m.m_ops->prep_hdr(&act->m, act->new_state, ctx);
 }
 
-/*
- * palloc_restore_free_chunk_state -- updates the runtime state of a free chunk.
- *
- * This function also takes care of coalescing of huge chunks.
- */
-static void
-palloc_restore_free_chunk_state(struct palloc_heap *heap,
-	struct memory_block *m)
-{
-	if (m->type == MEMORY_BLOCK_HUGE) {
-		struct bucket *b = heap_bucket_acquire(heap,
-			DEFAULT_ALLOC_CLASS_ID,
-			HEAP_ARENA_PER_THREAD);
-		if (heap_free_chunk_reuse(heap, b, m) != 0) {
-			if (errno == EEXIST) {
-				FATAL(
-					"duplicate runtime chunk state, possible double free");
-			} else {
-				LOG(2, "unable to track runtime chunk state");
-			}
-		}
-		heap_bucket_release(heap, b);
-	}
-}
-
 /*
  * palloc_mem_action_noop -- empty handler for unused memory action funcs
  */
@@ -498,6 +554,10 @@ static const struct {
 
 /*
  * palloc_action_compare -- compares two actions based on lock address
+ *
+ * Actions that share a lock are ordered by their destination, which places
+ * modifications of the same run bitmap value next to each other and allows
+ * them to be merged into a single redo log entry.
  */
 static int
 palloc_action_compare(const void *lhs, const void *rhs)
@@ -507,6 +567,19 @@ palloc_action_compare(const void *lhs, const void *rhs)
 	uintptr_t vlhs = (uintptr_t)(mlhs->lock);
 	uintptr_t vrhs = (uintptr_t)(mrhs->lock);
 
+	if (vlhs < vrhs)
+		return -1;
+	if (vlhs > vrhs)
+		return 1;
+
+	if (mlhs->type != mrhs->type)
+		return mlhs->type < mrhs->type ? -1 : 1;
+
+	vlhs = mlhs->type == POBJ_ACTION_TYPE_HEAP ?
+		mlhs->offset : (uintptr_t)mlhs->ptr;
+	vrhs = mrhs->type == POBJ_ACTION_TYPE_HEAP ?
+		mrhs->offset : (uintptr_t)mrhs->ptr;
+
 	if (vlhs < vrhs)
 		return -1;
 	if (vlhs > vrhs)
@@ -515,6 +588,25 @@ palloc_action_compare(const void *lhs, const void *rhs)
 	return 0;
 }
 
+/*
+ * palloc_actions_sorted -- (internal) checks whether the actions are already
+ *	in the order required by palloc_exec_actions
+ *
+ * This is always true for homogeneous batches of reservations, such as
+ * the ones created by palloc_reserve_bulk, which can then skip sorting.
+ */
+static int
+palloc_actions_sorted(const struct pobj_action_internal *actv,
+	size_t actvcnt)
+{
+	for (size_t i = 1; i < actvcnt; ++i) {
+		if (palloc_action_compare(&actv[i - 1], &actv[i]) > 0)
+			return 0;
+	}
+
+	return 1;
+}
+
 /*
  * palloc_exec_actions -- perform the provided free/alloc operations
  */
@@ -529,8 +621,10 @@ palloc_exec_actions(struct palloc_heap *heap,
 	 * ensured.
 	 */
 	if (actv) {
-		qsort(actv, actvcnt, sizeof(struct pobj_action_internal),
-			palloc_action_compare);
+		if (!palloc_actions_sorted(actv, actvcnt))
+			qsort(actv, actvcnt,
+				sizeof(struct pobj_action_internal),
+				palloc_action_compare);
 	} else {
 		ASSERTeq(actvcnt, 0);
 	}
@@ -599,6 +693,80 @@ palloc_reserve(struct palloc_heap *heap, size_t size,
 		(struct pobj_action_internal *)act);
 }
 
+/*
+ * palloc_reserve_bulk -- creates reservations of multiple objects of the same
+ *	size and allocation class
+ *
+ * All of the memory blocks are taken from the bucket under a single lock
+ * acquisition and, as long as the active run of the bucket is large enough,
+ * are adjacent to each other. This means that the resulting actions are
+ * already sorted for palloc_publish and that the run bitmap modifications
+ * of the entire batch are merged into a few redo log entries.
+ *
+ * Either all of the reservations are created or none of them.
+ */
+int
+palloc_reserve_bulk(struct palloc_heap *heap, size_t size,
+	palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags,
+	uint16_t class_id, uint16_t arena_id,
+	struct pobj_action *actv, size_t actvcnt)
+{
+	struct pobj_action_internal *acts =
+		(struct pobj_action_internal *)actv;
+
+	uint32_t size_idx;
+	struct alloc_class *c = palloc_reservation_class(heap, size,
+		class_id, &size_idx);
+	if (c == NULL)
+		return -1;
+
+	size_t i;
+
+	/* huge blocks are reserved one by one, there's no run to batch from */
+	if (c->type != CLASS_RUN) {
+		for (i = 0; i < actvcnt; ++i) {
+			if (palloc_reservation_create(heap, size,
+				constructor, arg, extra_field, object_flags,
+				class_id, arena_id, &acts[i]) != 0) {
+				int oerrno = errno;
+				palloc_cancel(heap, actv, i);
+				errno = oerrno;
+				return -1;
+			}
+		}
+
+		return 0;
+	}
+
+	int err = 0;
+	struct bucket *b = heap_bucket_acquire(heap, c->id, arena_id);
+
+	for (i = 0; i < actvcnt; ++i) {
+		struct pobj_action_internal *out = &acts[i];
+		out->type = POBJ_ACTION_TYPE_HEAP;
+		out->m = MEMORY_BLOCK_NONE;
+		out->m.size_idx = size_idx;
+
+		if ((err = heap_get_bestfit_block(heap, b, &out->m)) != 0)
+			break;
+
+		if ((err = palloc_reservation_prep(heap, b, constructor, arg,
+			extra_field, object_flags, out)) != 0)
+			break;
+	}
+
+	heap_bucket_release(heap, b);
+
+	if (err == 0)
+		return 0;
+
+	palloc_cancel(heap, actv, i);
+
+	errno = err;
+	return -1;
+}
+
 /*
  * palloc_defer_free -- creates an internal deferred free action
  */
@@ -56,6 +56,13 @@ palloc_reserve(struct palloc_heap *heap, size_t size,
 	uint16_t class_id, uint16_t arena_id,
 	struct pobj_action *act);
 
+int
+palloc_reserve_bulk(struct palloc_heap *heap, size_t size,
+	palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags,
+	uint16_t class_id, uint16_t arena_id,
+	struct pobj_action *actv, size_t actvcnt);
+
 void
 palloc_defer_free(struct palloc_heap *heap, uint64_t off,
 	struct pobj_action *act);
@@ -492,6 +492,43 @@ CTL_WRITE_HANDLER(granularity)(void *ctx,
 
 static const struct ctl_argument CTL_ARG(granularity) = CTL_ARG_LONG_LONG;
 
+/*
+ * CTL_READ_HANDLER(chunk_align) -- reads the alignment of chunk allocations
+ */
+static int
+CTL_READ_HANDLER(chunk_align)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)heap_get_chunk_align(&pop->heap);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(chunk_align) -- changes the alignment of chunk allocations
+ */
+static int
+CTL_WRITE_HANDLER(chunk_align)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t arg_in = *(ssize_t *)arg;
+	if (arg_in < 0) {
+		ERR("chunk alignment cannot be negative");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return heap_set_chunk_align(&pop->heap, (size_t)arg_in);
+}
+
+static const struct ctl_argument CTL_ARG(chunk_align) = CTL_ARG_LONG_LONG;
+
 /*
  * CTL_READ_HANDLER(total) -- reads a number of the arenas
  */
@@ -777,12 +814,273 @@ static const struct ctl_node CTL_NODE(thread)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * CTL_READ_HANDLER(enabled) -- reads whether the background compactor runs
+ */
+static int
+CTL_READ_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = compactor_get_enabled(pop->compactor);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled) -- starts or stops the background compactor
+ */
+static int
+CTL_WRITE_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	return compactor_set_enabled(pop->compactor, arg_in);
+}
+
+static const struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
+
+/*
+ * CTL_READ_HANDLER(interval_ms) -- reads the time between compaction passes
+ */
+static int
+CTL_READ_HANDLER(interval_ms)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)compactor_get_interval(pop->compactor);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(interval_ms) -- changes the time between compaction passes
+ */
+static int
+CTL_WRITE_HANDLER(interval_ms)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t arg_in = *(ssize_t *)arg;
+	if (arg_in <= 0) {
+		ERR("compaction interval must be greater than 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return compactor_set_interval(pop->compactor, (uint64_t)arg_in);
+}
+
+static const struct ctl_argument CTL_ARG(interval_ms) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(max_runs) -- reads the number of runs compacted per pass
+ */
+static int
+CTL_READ_HANDLER(max_runs)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)compactor_get_max_runs(pop->compactor);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(max_runs) -- changes the number of runs compacted per pass
+ */
+static int
+CTL_WRITE_HANDLER(max_runs)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t arg_in = *(ssize_t *)arg;
+	if (arg_in <= 0 || arg_in > UINT_MAX) {
+		ERR("number of runs per pass must be in the range <1,%u>",
+			UINT_MAX);
+		errno = EINVAL;
+		return -1;
+	}
+
+	return compactor_set_max_runs(pop->compactor, (unsigned)arg_in);
+}
+
+static const struct ctl_argument CTL_ARG(max_runs) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(handler) -- reads the pointer enumeration callback
+ *	registered for the type number
+ */
+static int
+CTL_READ_HANDLER(handler)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "type_num"), 0);
+
+	if (idx->value < 0) {
+		ERR("type number cannot be negative");
+		errno = EINVAL;
+		return -1;
+	}
+
+	compactor_get_type(pop->compactor, (uint64_t)idx->value, arg);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(handler) -- registers the pointer enumeration callback
+ *	for the type number
+ */
+static int
+CTL_WRITE_HANDLER(handler)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	/* function pointers cannot be provided through a config string */
+	if (source != CTL_QUERY_PROGRAMMATIC) {
+		ERR("compactor handlers can only be set programmatically");
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "type_num"), 0);
+
+	if (idx->value < 0) {
+		ERR("type number cannot be negative");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return compactor_set_type(pop->compactor, (uint64_t)idx->value, arg);
+}
+
+static const struct ctl_argument CTL_ARG(handler) = {
+	.dest_size = sizeof(struct pobj_compactor_type_desc),
+	.parsers = {
+		CTL_ARG_PARSER_END
+	}
+};
+
+/*
+ * CTL_RUNNABLE_HANDLER(run) -- performs a single compaction pass
+ */
+static int
+CTL_RUNNABLE_HANDLER(run)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	if (pop->rdonly) {
+		ERR("cannot compact a read-only pool");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return compactor_run(pop->compactor, arg);
+}
+
+/*
+ * CTL_READ_HANDLER(ticks) -- reads the number of completed compaction passes
+ */
+static int
+CTL_READ_HANDLER(ticks)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	uint64_t *arg_out = arg;
+
+	*arg_out = compactor_get_ticks(pop->compactor);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(relocated) -- reads the number of relocated objects
+ */
+static int
+CTL_READ_HANDLER(relocated)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	uint64_t *arg_out = arg;
+
+	*arg_out = compactor_get_relocated(pop->compactor);
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(reclaimed) -- reads the number of fragmented bytes
+ *	reclaimed by the compactor
+ */
+static int
+CTL_READ_HANDLER(reclaimed)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	uint64_t *arg_out = arg;
+
+	*arg_out = compactor_get_reclaimed(pop->compactor);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(type_num)[] = {
+	CTL_LEAF_RW(handler),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(type)[] = {
+	CTL_INDEXED(type_num),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(compactor)[] = {
+	CTL_LEAF_RW(enabled),
+	CTL_LEAF_RW(interval_ms),
+	CTL_LEAF_RW(max_runs),
+	CTL_CHILD(type),
+	CTL_LEAF_RUNNABLE(run),
+	CTL_LEAF_RO(ticks),
+	CTL_LEAF_RO(relocated),
+	CTL_LEAF_RO(reclaimed),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(heap)[] = {
 	CTL_CHILD(alloc_class),
 	CTL_CHILD(arena),
 	CTL_CHILD(size),
 	CTL_CHILD(thread),
 	CTL_CHILD(narenas),
+	CTL_LEAF_RW(chunk_align),
+	CTL_CHILD(compactor),
 
 	CTL_NODE_END
 };
@@ -62,6 +62,9 @@ struct recycler {
 	size_t nallocs;
 	size_t *peak_arenas;
 
+	/* number of runs in the tree, modified only with the lock held */
+	uint64_t nruns;
+
 	VEC(, struct recycler_element) recalc;
 
 	os_mutex_t lock;
@@ -86,6 +89,7 @@ recycler_new(struct palloc_heap *heap, size_t nallocs, size_t *peak_arenas)
 	r->nallocs = nallocs;
 	r->peak_arenas = peak_arenas;
 	r->unaccounted_total = 0;
+	r->nruns = 0;
 	memset(&r->unaccounted_units, 0, sizeof(r->unaccounted_units));
 
 	VEC_INIT(&r->recalc);
@@ -144,6 +148,30 @@ recycler_element_new(struct palloc_heap *heap, const struct memory_block *m)
 	return e;
 }
 
+/*
+ * recycler_nruns_add -- (internal) updates the number of runs in the recycler
+ *
+ * Must be called with the recycler lock taken.
+ */
+static void
+recycler_nruns_add(struct recycler *r, int64_t diff)
+{
+	util_atomic_store_explicit64(&r->nruns, r->nruns + (uint64_t)diff,
+		memory_order_relaxed);
+}
+
+/*
+ * recycler_nruns -- returns the number of runs stored in the recycler
+ */
+uint64_t
+recycler_nruns(struct recycler *r)
+{
+	uint64_t nruns;
+	util_atomic_load_explicit64(&r->nruns, &nruns, memory_order_relaxed);
+
+	return nruns;
+}
+
 /*
  * recycler_put -- inserts new run into the recycler
  */
@@ -156,6 +184,8 @@ recycler_put(struct recycler *r, const struct memory_block *m,
 	util_mutex_lock(&r->lock);
 
 	ret = ravl_emplace_copy(r->runs, &element);
+	if (ret == 0)
+		recycler_nruns_add(r, 1);
 
 	util_mutex_unlock(&r->lock);
 
@@ -185,6 +215,7 @@ recycler_get(struct recycler *r, struct memory_block *m)
 	m->zone_id = ne->zone_id;
 
 	ravl_remove(r->runs, n);
+	recycler_nruns_add(r, -1);
 
 	struct chunk_header *hdr = heap_get_chunk_hdr(r->heap, m);
 	m->size_idx = hdr->size_idx;
@@ -268,6 +299,7 @@ recycler_recalc(struct recycler *r, int force)
 		ravl_remove(r->runs, n);
 
 		if (e.free_space == r->nallocs) {
+			recycler_nruns_add(r, -1);
 			memblock_rebuild_state(r->heap, &nm);
 			if (VEC_PUSH_BACK(&runs, nm) != 0)
 				ASSERT(0); /* XXX: fix after refactoring */
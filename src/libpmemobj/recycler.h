@@ -45,6 +45,8 @@ struct empty_runs recycler_recalc(struct recycler *r, int force);
 void recycler_inc_unaccounted(struct recycler *r,
 	const struct memory_block *m);
 
+uint64_t recycler_nruns(struct recycler *r);
+
 #ifdef __cplusplus
 }
 #endif
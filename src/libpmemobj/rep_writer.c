@@ -0,0 +1,376 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * rep_writer.c -- implementation of the asynchronous replica writers
+ *
+ * Every local replica of a pool opened with replica.async enabled has its
+ * own writer thread. The threads modifying the master replica push the
+ * modified ranges to the rings of the writers, which copy them from the
+ * master replica to their replicas in the background, so that the copies to
+ * all of the replicas proceed in parallel.
+ *
+ * A range is always copied from the master replica, never from the buffer
+ * passed to the original operation. The copy therefore reflects the current
+ * contents of the master, and the writes of the ranges can be applied in any
+ * order, at any time after they were made to the master. Once the writer
+ * processed all of the ranges pushed before rep_writer_wait was called, the
+ * replica matches the master replica in all of them.
+ */
+
+#include <sched.h>
+
+#include "ctl.h"
+#include "libpmem.h"
+#include "obj.h"
+#include "os_thread.h"
+#include "out.h"
+#include "rep_writer.h"
+#include "sys_util.h"
+#include "util.h"
+
+#define REP_WRITER_RING_SIZE 1024ULL /* must be a power of two */
+#define REP_WRITER_RING_MASK (REP_WRITER_RING_SIZE - 1)
+
+/* number of copied ranges after which the writer drains its stores */
+#define REP_WRITER_BATCH 64
+
+/* number of times a waiting thread yields before it goes to sleep */
+#define REP_WRITER_SPINS 128
+
+static int Replica_async;
+
+struct rep_writer_entry {
+	uint64_t seq; /* position of the entry, see rep_writer_push */
+	uint64_t off;
+	uint64_t len;
+};
+
+struct rep_writer {
+	PMEMobjpool *master;
+	PMEMobjpool *rep;
+
+	struct rep_writer_entry *ring;
+
+	/* next position to be reserved by the pushing threads */
+	uint64_t head;
+	char padding0[CACHELINE_SIZE - sizeof(uint64_t)];
+
+	/* next position to be copied, accessed only by the writer thread */
+	uint64_t tail;
+	/* positions below are copied to the replica and drained */
+	uint64_t done;
+	char padding1[CACHELINE_SIZE - 2 * sizeof(uint64_t)];
+
+	os_mutex_t lock;
+	os_cond_t cond; /* signaled when an entry is pushed or on stop */
+	os_cond_t done_cond; /* signaled when done advances */
+	int sleeping; /* the writer waits on cond */
+	unsigned waiters; /* number of threads waiting on done_cond */
+	int stop;
+
+	os_thread_t thread;
+};
+
+/*
+ * rep_writer_entry_ready -- (internal) checks whether the entry at the tail
+ *	was pushed
+ */
+static int
+rep_writer_entry_ready(struct rep_writer *w)
+{
+	struct rep_writer_entry *e = &w->ring[w->tail & REP_WRITER_RING_MASK];
+
+	uint64_t seq;
+	util_atomic_load_explicit64(&e->seq, &seq, memory_order_acquire);
+
+	return seq == w->tail + 1;
+}
+
+/*
+ * rep_writer_complete -- (internal) drains the copied ranges and wakes up
+ *	the threads waiting for them
+ */
+static void
+rep_writer_complete(struct rep_writer *w)
+{
+	w->rep->drain_local();
+
+	util_atomic_store_explicit64(&w->done, w->tail, memory_order_release);
+
+	/* pairs with the barrier in rep_writer_wait */
+	util_synchronize();
+
+	if (w->waiters != 0) {
+		util_mutex_lock(&w->lock);
+		os_cond_broadcast(&w->done_cond);
+		util_mutex_unlock(&w->lock);
+	}
+}
+
+/*
+ * rep_writer_worker -- (internal) copies the pushed ranges from the master
+ *	replica until stopped
+ */
+static void *
+rep_writer_worker(void *arg)
+{
+	struct rep_writer *w = arg;
+	unsigned pending = 0; /* ranges copied, but not drained yet */
+
+	while (1) {
+		if (rep_writer_entry_ready(w)) {
+			struct rep_writer_entry *e =
+				&w->ring[w->tail & REP_WRITER_RING_MASK];
+
+			w->rep->memcpy_local((char *)w->rep + e->off,
+				(char *)w->master + e->off, e->len,
+				PMEM_F_MEM_NODRAIN);
+
+			util_atomic_store_explicit64(&e->seq,
+				w->tail + REP_WRITER_RING_SIZE,
+				memory_order_release);
+			w->tail++;
+
+			if (++pending < REP_WRITER_BATCH)
+				continue;
+		}
+
+		if (pending != 0) {
+			rep_writer_complete(w);
+			pending = 0;
+			continue;
+		}
+
+		util_mutex_lock(&w->lock);
+
+		w->sleeping = 1;
+		/* pairs with the barrier in rep_writer_push */
+		util_synchronize();
+
+		if (!rep_writer_entry_ready(w)) {
+			if (w->stop) {
+				util_mutex_unlock(&w->lock);
+				break;
+			}
+			os_cond_wait(&w->cond, &w->lock);
+		}
+
+		w->sleeping = 0;
+
+		util_mutex_unlock(&w->lock);
+	}
+
+	return NULL;
+}
+
+/*
+ * rep_writer_new -- creates the writer of the replica and starts its thread
+ */
+struct rep_writer *
+rep_writer_new(PMEMobjpool *master, PMEMobjpool *rep)
+{
+	struct rep_writer *w = Zalloc(sizeof(*w));
+	if (w == NULL)
+		goto err_alloc;
+
+	w->ring = Malloc(REP_WRITER_RING_SIZE * sizeof(*w->ring));
+	if (w->ring == NULL)
+		goto err_ring;
+
+	for (uint64_t i = 0; i < REP_WRITER_RING_SIZE; ++i)
+		w->ring[i].seq = i;
+
+	w->master = master;
+	w->rep = rep;
+
+	util_mutex_init(&w->lock);
+	util_cond_init(&w->cond);
+	util_cond_init(&w->done_cond);
+
+	int ret = os_thread_create(&w->thread, NULL, rep_writer_worker, w);
+	if (ret != 0) {
+		errno = ret;
+		ERR("!os_thread_create");
+		goto err_thread;
+	}
+
+	return w;
+
+err_thread:
+	util_cond_destroy(&w->done_cond);
+	util_cond_destroy(&w->cond);
+	util_mutex_destroy(&w->lock);
+	Free(w->ring);
+err_ring:
+	Free(w);
+err_alloc:
+	return NULL;
+}
+
+/*
+ * rep_writer_delete -- copies the remaining ranges, stops the writer thread
+ *	and frees the writer
+ */
+void
+rep_writer_delete(struct rep_writer *w)
+{
+	util_mutex_lock(&w->lock);
+	w->stop = 1;
+	os_cond_signal(&w->cond);
+	util_mutex_unlock(&w->lock);
+
+	os_thread_join(&w->thread, NULL);
+
+	util_cond_destroy(&w->done_cond);
+	util_cond_destroy(&w->cond);
+	util_mutex_destroy(&w->lock);
+
+	Free(w->ring);
+	Free(w);
+}
+
+/*
+ * rep_writer_push -- queues the copy of the range at the offset from the
+ *	master replica
+ *
+ * Returns -1 if the ring is full, in which case the caller has to copy the
+ * range by itself.
+ */
+int
+rep_writer_push(struct rep_writer *w, uint64_t off, size_t len)
+{
+	struct rep_writer_entry *e;
+	uint64_t pos;
+	util_atomic_load_explicit64(&w->head, &pos, memory_order_relaxed);
+
+	/*
+	 * The entry at the position is free once its sequence number equals
+	 * the position, it's ready to be copied once it equals the position
+	 * plus one, and it becomes free for the next lap of the ring once it's
+	 * copied by the writer.
+	 */
+	while (1) {
+		e = &w->ring[pos & REP_WRITER_RING_MASK];
+
+		uint64_t seq;
+		util_atomic_load_explicit64(&e->seq, &seq,
+			memory_order_acquire);
+
+		int64_t diff = (int64_t)(seq - pos);
+		if (diff == 0) {
+			if (util_bool_compare_and_swap64(&w->head, pos,
+					pos + 1))
+				break;
+		} else if (diff < 0) {
+			return -1;
+		}
+
+		util_atomic_load_explicit64(&w->head, &pos,
+			memory_order_relaxed);
+	}
+
+	e->off = off;
+	e->len = len;
+	util_atomic_store_explicit64(&e->seq, pos + 1, memory_order_release);
+
+	/* pairs with the barrier in rep_writer_worker */
+	util_synchronize();
+
+	if (w->sleeping) {
+		util_mutex_lock(&w->lock);
+		os_cond_signal(&w->cond);
+		util_mutex_unlock(&w->lock);
+	}
+
+	return 0;
+}
+
+/*
+ * rep_writer_wait -- waits until all of the ranges pushed so far are copied
+ *	to the replica and drained
+ */
+void
+rep_writer_wait(struct rep_writer *w)
+{
+	uint64_t target;
+	util_atomic_load_explicit64(&w->head, &target, memory_order_acquire);
+
+	uint64_t done;
+	for (unsigned spins = 0; spins < REP_WRITER_SPINS; ++spins) {
+		util_atomic_load_explicit64(&w->done, &done,
+			memory_order_acquire);
+		if (done >= target)
+			return;
+
+		sched_yield();
+	}
+
+	util_mutex_lock(&w->lock);
+
+	util_fetch_and_add32(&w->waiters, 1);
+	/* pairs with the barrier in rep_writer_complete */
+	util_synchronize();
+
+	while (1) {
+		util_atomic_load_explicit64(&w->done, &done,
+			memory_order_acquire);
+		if (done >= target)
+			break;
+
+		os_cond_wait(&w->done_cond, &w->lock);
+	}
+
+	util_fetch_and_sub32(&w->waiters, 1);
+
+	util_mutex_unlock(&w->lock);
+}
+
+/*
+ * rep_writer_enabled -- returns whether the pools opened from now on get
+ *	the asynchronous replica writers
+ */
+int
+rep_writer_enabled(void)
+{
+	return Replica_async;
+}
+
+static int
+CTL_READ_HANDLER(async)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	int *arg_out = arg;
+	*arg_out = Replica_async;
+
+	return 0;
+}
+
+static int
+CTL_WRITE_HANDLER(async)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	int arg_in = *(int *)arg;
+
+	Replica_async = arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(async) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(replica)[] = {
+	CTL_LEAF_RW(async),
+
+	CTL_NODE_END
+};
+
+/*
+ * rep_writer_ctl_register -- registers the global ctl nodes of the replica
+ *	writers
+ */
+void
+rep_writer_ctl_register(void)
+{
+	CTL_REGISTER_MODULE(NULL, replica);
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * rep_writer.h -- internal definitions of the asynchronous replica writers
+ */
+
+#ifndef LIBPMEMOBJ_REP_WRITER_H
+#define LIBPMEMOBJ_REP_WRITER_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libpmemobj.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rep_writer;
+
+struct rep_writer *rep_writer_new(PMEMobjpool *master, PMEMobjpool *rep);
+void rep_writer_delete(struct rep_writer *w);
+
+int rep_writer_push(struct rep_writer *w, uint64_t off, size_t len);
+void rep_writer_wait(struct rep_writer *w);
+
+int rep_writer_enabled(void);
+void rep_writer_ctl_register(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,251 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * snapshot.c -- implementation of the point-in-time snapshots of a pool
+ *
+ * A snapshot is a new pool file with the contents the pool had at the moment
+ * the snapshot was taken. To make that moment consistent, all of the lanes
+ * are held while the file is duplicated, which waits for the transactions and
+ * the other operations in progress to finish and keeps new ones from starting.
+ *
+ * Where the file system supports it, the file is duplicated with a reflink
+ * (FICLONE), which only shares the extents of the files and takes time
+ * proportional to the metadata of the file, not to its size. Otherwise, the
+ * contents of the file are copied, and the writers are stalled for the whole
+ * copy.
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+#include "alloc.h"
+#include "ctl.h"
+#include "lane.h"
+#include "obj.h"
+#include "os.h"
+#include "out.h"
+#include "set.h"
+#include "snapshot.h"
+
+#define SNAPSHOT_COPY_BUF_SIZE (1 << 20) /* 1 megabyte */
+
+/*
+ * snapshot_reflink -- (internal) shares the extents of the source file with
+ *	the destination file
+ */
+static int
+snapshot_reflink(int src, int dst)
+{
+#ifdef FICLONE
+	if (ioctl(dst, FICLONE, src) == 0)
+		return 0;
+#else
+	errno = ENOTSUP;
+#endif
+	return -1;
+}
+
+/*
+ * snapshot_copy -- (internal) copies the contents of the source file to the
+ *	destination file
+ */
+static int
+snapshot_copy(int src, int dst, size_t size)
+{
+	char *buf = Malloc(SNAPSHOT_COPY_BUF_SIZE);
+	if (buf == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	int ret = -1;
+	size_t off = 0;
+	while (off < size) {
+		size_t len = size - off;
+		if (len > SNAPSHOT_COPY_BUF_SIZE)
+			len = SNAPSHOT_COPY_BUF_SIZE;
+
+		ssize_t rlen = pread(src, buf, len, (os_off_t)off);
+		if (rlen <= 0) {
+			if (rlen == 0)
+				errno = EIO;
+			ERR("!pread");
+			goto out;
+		}
+
+		for (ssize_t wtotal = 0; wtotal < rlen; ) {
+			ssize_t wlen = write(dst, buf + wtotal,
+				(size_t)(rlen - wtotal));
+			if (wlen < 0) {
+				ERR("!write");
+				goto out;
+			}
+			wtotal += wlen;
+		}
+
+		off += (size_t)rlen;
+	}
+
+	ret = 0;
+
+out:
+	Free(buf);
+	return ret;
+}
+
+/*
+ * snapshot_duplicate -- (internal) duplicates the pool file, which must not
+ *	be modified in the meantime, using the allowed method
+ */
+static int
+snapshot_duplicate(int src, int dst, size_t size,
+	struct pobj_snapshot *snapshot)
+{
+	if (snapshot->method != POBJ_SNAPSHOT_METHOD_COPY) {
+		if (snapshot_reflink(src, dst) == 0) {
+			snapshot->used = POBJ_SNAPSHOT_METHOD_REFLINK;
+			return 0;
+		}
+
+		if (snapshot->method == POBJ_SNAPSHOT_METHOD_REFLINK) {
+			ERR("!cannot reflink the pool file");
+			return -1;
+		}
+
+		LOG(3, "reflink not supported, copying the pool file");
+	}
+
+	if (snapshot_copy(src, dst, size) != 0)
+		return -1;
+
+	snapshot->used = POBJ_SNAPSHOT_METHOD_COPY;
+	return 0;
+}
+
+/*
+ * snapshot_create -- (internal) creates the snapshot of the pool
+ */
+static int
+snapshot_create(PMEMobjpool *pop, struct pobj_snapshot *snapshot)
+{
+	struct pool_set *set = pop->set;
+
+	if (set->nreplicas != 1 || set->replica[0]->nparts != 1 ||
+	    set->remote || set->replica[0]->part[0].is_dev_dax) {
+		ERR("snapshots are supported only for pools in a single file");
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	/* the file doesn't contain the changes made since the pool opened */
+	if (pop->is_cow) {
+		ERR("snapshots are not supported for pools opened with "
+			"copy_on_write.at_open");
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	const char *path = set->replica[0]->part[0].path;
+	os_stat_t st;
+	int oerrno;
+	int dst;
+	int ret;
+
+	int src = os_open(path, O_RDONLY);
+	if (src < 0) {
+		ERR("!open %s", path);
+		return -1;
+	}
+
+	if (os_fstat(src, &st) != 0) {
+		ERR("!fstat %s", path);
+		goto err_close_src;
+	}
+
+	dst = os_open(snapshot->path, O_WRONLY | O_CREAT | O_EXCL,
+		st.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO));
+	if (dst < 0) {
+		ERR("!open %s", snapshot->path);
+		goto err_close_src;
+	}
+
+	if (lane_hold_all(pop) != 0)
+		goto err_unlink;
+
+	ret = snapshot_duplicate(src, dst, (size_t)st.st_size, snapshot);
+
+	lane_release_all(pop);
+
+	if (ret != 0)
+		goto err_unlink;
+
+	if (os_fsync(dst) != 0) {
+		ERR("!fsync %s", snapshot->path);
+		goto err_unlink;
+	}
+
+	os_close(dst);
+	os_close(src);
+
+	return 0;
+
+err_unlink:
+	oerrno = errno;
+	os_close(dst);
+	os_unlink(snapshot->path);
+	errno = oerrno;
+err_close_src:
+	oerrno = errno;
+	os_close(src);
+	errno = oerrno;
+	return -1;
+}
+
+/*
+ * CTL_RUNNABLE_HANDLER(create) -- creates a point-in-time snapshot of the
+ *	pool in a new file
+ */
+static int
+CTL_RUNNABLE_HANDLER(create)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct pobj_snapshot *snapshot = arg;
+
+	if (source != CTL_QUERY_PROGRAMMATIC) {
+		ERR("snapshots can only be created programmatically");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (snapshot == NULL || snapshot->path == NULL ||
+	    (unsigned)snapshot->method > POBJ_SNAPSHOT_METHOD_COPY) {
+		ERR("invalid snapshot description");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return snapshot_create(pop, snapshot);
+}
+
+static const struct ctl_node CTL_NODE(snapshot)[] = {
+	CTL_LEAF_RUNNABLE(create),
+
+	CTL_NODE_END
+};
+
+/*
+ * snapshot_ctl_register -- registers ctl nodes for "snapshot" module
+ */
+void
+snapshot_ctl_register(PMEMobjpool *pop)
+{
+	CTL_REGISTER_MODULE(pop->ctl, snapshot);
+}
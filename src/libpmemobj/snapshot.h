@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * snapshot.h -- definitions for the snapshot CTL namespace
+ */
+#ifndef LIBPMEMOBJ_SNAPSHOT_H
+#define LIBPMEMOBJ_SNAPSHOT_H 1
+
+#include "libpmemobj.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void snapshot_ctl_register(PMEMobjpool *pop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBPMEMOBJ_SNAPSHOT_H */
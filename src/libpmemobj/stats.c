@@ -5,18 +5,185 @@
  * stats.c -- implementation of statistics
  */
 
+#include <inttypes.h>
+
+#include "alloc_class.h"
+#include "heap.h"
 #include "obj.h"
 #include "stats.h"
 
+/* number of threads that were assigned a shard so far */
+static unsigned Stats_nthreads;
+
+__thread unsigned Stats_thread_shard;
+
+/*
+ * stats_thread_shard_assign -- assigns a shard to the calling thread, the
+ *	shards are shared once there are more threads than shards
+ */
+unsigned
+stats_thread_shard_assign(void)
+{
+	unsigned shard = util_fetch_and_add32(&Stats_nthreads, 1) %
+		STATS_SHARDS;
+
+	Stats_thread_shard = shard + 1;
+
+	return shard;
+}
+
 STATS_CTL_HANDLER(persistent, curr_allocated, heap_curr_allocated);
 
 STATS_CTL_HANDLER(transient, run_allocated, heap_run_allocated);
 STATS_CTL_HANDLER(transient, run_active, heap_run_active);
 
+STATS_CTL_HANDLER(transient, undo_extensions, tx_undo_extensions);
+STATS_CTL_HANDLER(transient, redo_extensions, tx_redo_extensions);
+
+/*
+ * stats_heap_class -- (internal) calculates the statistics of the allocation
+ *	class selected by the index of the query
+ */
+static int
+stats_heap_class(PMEMobjpool *pop, struct ctl_indexes *indexes,
+	struct heap_class_stats *s)
+{
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "class_id"), 0);
+
+	if (idx->value < 0 || idx->value >= MAX_ALLOCATION_CLASSES) {
+		ERR("class id outside of the allowed range");
+		errno = ERANGE;
+		return -1;
+	}
+
+	return heap_get_class_stats(&pop->heap, (uint8_t)idx->value, s);
+}
+
+/*
+ * stats_heap_arena -- (internal) retrieves the statistics of the arena
+ *	selected by the index of the query
+ */
+static int
+stats_heap_arena(PMEMobjpool *pop, struct ctl_indexes *indexes,
+	struct heap_arena_stats *s)
+{
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "arena_id"), 0);
+
+	unsigned narenas = heap_get_narenas_total(&pop->heap);
+	if (idx->value < 1 || (unsigned long long)idx->value > narenas) {
+		ERR("arena id outside of the allowed range: <1,%u>", narenas);
+		errno = ERANGE;
+		return -1;
+	}
+
+	heap_get_arena_stats(&pop->heap, (unsigned)idx->value, s);
+
+	return 0;
+}
+
+#define STATS_HEAP_CTL_HANDLER(node, name, type, expr)\
+static int CTL_READ_HANDLER(name, heap_##node)(void *ctx,\
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)\
+{\
+	struct type s;\
+	if (stats_heap_##node(ctx, indexes, &s) != 0)\
+		return -1;\
+	*(uint64_t *)arg = (expr);\
+	return 0;\
+}
+
+STATS_HEAP_CTL_HANDLER(class, allocs, heap_class_stats, s.allocs);
+STATS_HEAP_CTL_HANDLER(class, contention, heap_class_stats, s.contention);
+STATS_HEAP_CTL_HANDLER(class, runs, heap_class_stats, s.runs);
+STATS_HEAP_CTL_HANDLER(class, free_runs, heap_class_stats, s.free_runs);
+STATS_HEAP_CTL_HANDLER(class, recycler_runs, heap_class_stats,
+	s.recycled_runs);
+STATS_HEAP_CTL_HANDLER(class, fill, heap_class_stats,
+	s.units == 0 ? 0 : s.used * 100 / s.units);
+
+static const struct ctl_node CTL_NODE(class_id, heap_class)[] = {
+	CTL_LEAF_RO(allocs, heap_class),
+	CTL_LEAF_RO(contention, heap_class),
+	CTL_LEAF_RO(runs, heap_class),
+	CTL_LEAF_RO(free_runs, heap_class),
+	CTL_LEAF_RO(recycler_runs, heap_class),
+	CTL_LEAF_RO(fill, heap_class),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(class, heap)[] = {
+	CTL_INDEXED(class_id, heap_class),
+
+	CTL_NODE_END
+};
+
+STATS_HEAP_CTL_HANDLER(arena, threads, heap_arena_stats, s.nthreads);
+STATS_HEAP_CTL_HANDLER(arena, allocs, heap_arena_stats, s.allocs);
+STATS_HEAP_CTL_HANDLER(arena, contention, heap_arena_stats, s.contention);
+STATS_HEAP_CTL_HANDLER(arena, huge_cached, heap_arena_stats, s.huge_cached);
+
+static const struct ctl_node CTL_NODE(arena_id, heap_arena)[] = {
+	CTL_LEAF_RO(threads, heap_arena),
+	CTL_LEAF_RO(allocs, heap_arena),
+	CTL_LEAF_RO(contention, heap_arena),
+	CTL_LEAF_RO(huge_cached, heap_arena),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(arena, heap)[] = {
+	CTL_INDEXED(arena_id, heap_arena),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(fill) -- returns the percentage of used chunks of a zone
+ */
+static int
+CTL_READ_HANDLER(fill, heap_zone)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	struct ctl_index *idx = PMDK_SLIST_FIRST(indexes);
+	ASSERTeq(strcmp(idx->name, "zone_id"), 0);
+
+	unsigned nzones = heap_get_nzones(&pop->heap);
+	if (idx->value < 0 || (unsigned long long)idx->value >= nzones) {
+		ERR("zone id outside of the allowed range: <0,%u)", nzones);
+		errno = ERANGE;
+		return -1;
+	}
+
+	*(uint64_t *)arg = heap_get_zone_fill(&pop->heap,
+		(uint32_t)idx->value);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(zone_id, heap_zone)[] = {
+	CTL_LEAF_RO(fill, heap_zone),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(zone, heap)[] = {
+	CTL_INDEXED(zone_id, heap_zone),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(heap)[] = {
 	STATS_CTL_LEAF(persistent, curr_allocated),
 	STATS_CTL_LEAF(transient, run_allocated),
 	STATS_CTL_LEAF(transient, run_active),
+	CTL_CHILD(class, heap),
+	CTL_CHILD(arena, heap),
+	CTL_CHILD(zone, heap),
 
 	CTL_NODE_END
 };
@@ -96,8 +263,197 @@ static const struct ctl_argument CTL_ARG(enabled) = {
 	}
 };
 
+/*
+ * stats_latency_summarize -- (internal) sums up the latency histograms of the
+ *	operation, all zeroes if the latencies were never recorded
+ */
+static void
+stats_latency_summarize(PMEMobjpool *pop, enum latency_op op,
+	struct latency_summary *s)
+{
+	if (pop->stats->latency == NULL) {
+		memset(s, 0, sizeof(*s));
+		return;
+	}
+
+	latency_summarize(pop->stats->latency, op, s);
+}
+
+#define STATS_LATENCY_CTL_HANDLER(node, op, name)\
+static int CTL_READ_HANDLER(name, latency_##node)(void *ctx,\
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)\
+{\
+	struct latency_summary s;\
+	stats_latency_summarize(ctx, (op), &s);\
+	*(uint64_t *)arg = s.name;\
+	return 0;\
+}
+
+#define STATS_LATENCY_CTL_NODE(node, op)\
+STATS_LATENCY_CTL_HANDLER(node, op, count)\
+STATS_LATENCY_CTL_HANDLER(node, op, mean)\
+STATS_LATENCY_CTL_HANDLER(node, op, max)\
+STATS_LATENCY_CTL_HANDLER(node, op, p50)\
+STATS_LATENCY_CTL_HANDLER(node, op, p90)\
+STATS_LATENCY_CTL_HANDLER(node, op, p99)\
+STATS_LATENCY_CTL_HANDLER(node, op, p999)\
+static const struct ctl_node CTL_NODE(node, latency)[] = {\
+	CTL_LEAF_RO(count, latency_##node),\
+	CTL_LEAF_RO(mean, latency_##node),\
+	CTL_LEAF_RO(max, latency_##node),\
+	CTL_LEAF_RO(p50, latency_##node),\
+	CTL_LEAF_RO(p90, latency_##node),\
+	CTL_LEAF_RO(p99, latency_##node),\
+	CTL_LEAF_RO(p999, latency_##node),\
+	CTL_NODE_END\
+}
+
+STATS_LATENCY_CTL_NODE(tx_commit, LATENCY_TX_COMMIT);
+STATS_LATENCY_CTL_NODE(alloc, LATENCY_ALLOC);
+STATS_LATENCY_CTL_NODE(free, LATENCY_FREE);
+STATS_LATENCY_CTL_NODE(persist, LATENCY_PERSIST);
+
+/* names of the operations in the exported document */
+static const char *Latency_op_names[MAX_LATENCY_OP] = {
+	[LATENCY_TX_COMMIT] = "tx_commit",
+	[LATENCY_ALLOC] = "alloc",
+	[LATENCY_FREE] = "free",
+	[LATENCY_PERSIST] = "persist",
+};
+
+/*
+ * stats_latency_json_append -- (internal) appends the string to the document,
+ *	truncating it once the buffer is full
+ */
+static void
+stats_latency_json_append(struct pobj_latency_json *j, const char *str)
+{
+	size_t len = strlen(str);
+
+	if (j->len + 1 < j->size) {
+		size_t n = j->size - j->len - 1;
+		if (n > len)
+			n = len;
+		memcpy(j->buf + j->len, str, n);
+		j->buf[j->len + n] = '\0';
+	}
+
+	j->len += len;
+}
+
+/*
+ * CTL_READ_HANDLER(json) -- exports the summaries of all of the latency
+ *	histograms as a JSON document
+ */
+static int
+CTL_READ_HANDLER(json, latency)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct pobj_latency_json *j = arg;
+	char str[256];
+
+	if (j->buf == NULL && j->size != 0) {
+		ERR("invalid buffer for the latency document");
+		errno = EINVAL;
+		return -1;
+	}
+
+	j->len = 0;
+	if (j->size != 0)
+		j->buf[0] = '\0';
+
+	for (int op = 0; op < MAX_LATENCY_OP; ++op) {
+		struct latency_summary s;
+		stats_latency_summarize(pop, (enum latency_op)op, &s);
+
+		int ret = util_snprintf(str, sizeof(str),
+			"%s\"%s\":{\"count\":%" PRIu64 ",\"mean\":%" PRIu64
+			",\"max\":%" PRIu64 ",\"p50\":%" PRIu64
+			",\"p90\":%" PRIu64 ",\"p99\":%" PRIu64
+			",\"p999\":%" PRIu64 "}",
+			op == 0 ? "{" : ",", Latency_op_names[op],
+			s.count, s.mean, s.max, s.p50, s.p90, s.p99, s.p999);
+		if (ret < 0) {
+			ERR("!snprintf");
+			return -1;
+		}
+
+		stats_latency_json_append(j, str);
+	}
+
+	stats_latency_json_append(j, "}");
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(enabled) -- returns whether or not the latencies are
+ *	recorded
+ */
+static int
+CTL_READ_HANDLER(enabled, latency)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	*(int *)arg = pop->stats->latency_enabled;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled) -- starts or stops recording the latencies, the
+ *	histograms are kept when stopped
+ */
+static int
+CTL_WRITE_HANDLER(enabled, latency)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct stats *s = pop->stats;
+	int arg_in = *(int *)arg;
+
+	if (arg_in && s->latency == NULL) {
+		s->latency = latency_new();
+		if (s->latency == NULL)
+			return -1;
+	}
+
+	/* the histograms have to be visible before anyone records into them */
+	util_atomic_store_explicit32(&s->latency_enabled, arg_in,
+		memory_order_release);
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(enabled, latency) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(latency)[] = {
+	CTL_CHILD(tx_commit, latency),
+	CTL_CHILD(alloc, latency),
+	CTL_CHILD(free, latency),
+	CTL_CHILD(persist, latency),
+	CTL_LEAF_RO(json, latency),
+	CTL_LEAF_RW(enabled, latency),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(tx)[] = {
+	STATS_CTL_LEAF(transient, undo_extensions),
+	STATS_CTL_LEAF(transient, redo_extensions),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(stats)[] = {
 	CTL_CHILD(heap),
+	CTL_CHILD(tx),
+	CTL_CHILD(latency),
 	CTL_LEAF_RW(enabled),
 
 	CTL_NODE_END
@@ -116,14 +472,26 @@ stats_new(PMEMobjpool *pop)
 	}
 
 	s->enabled = POBJ_STATS_ENABLED_TRANSIENT;
+	s->latency_enabled = 0;
+	s->latency = NULL;
 	s->persistent = &pop->stats_persistent;
 	VALGRIND_ADD_TO_GLOBAL_TX_IGNORE(s->persistent, sizeof(*s->persistent));
 	s->transient = Zalloc(sizeof(struct stats_transient));
 	if (s->transient == NULL)
 		goto error_transient_alloc;
 
+	s->shards = util_aligned_malloc(CACHELINE_SIZE,
+		STATS_SHARDS * sizeof(struct stats_shard));
+	if (s->shards == NULL) {
+		ERR("!util_aligned_malloc");
+		goto error_shards_alloc;
+	}
+	memset(s->shards, 0, STATS_SHARDS * sizeof(struct stats_shard));
+
 	return s;
 
+error_shards_alloc:
+	Free(s->transient);
 error_transient_alloc:
 	Free(s);
 	return NULL;
@@ -135,8 +503,19 @@ error_transient_alloc:
 void
 stats_delete(PMEMobjpool *pop, struct stats *s)
 {
+	/* folds the shards of the persistent counters into the pool */
+	uint64_t curr_allocated = 0;
+	for (unsigned i = 0; i < STATS_SHARDS; ++i)
+		curr_allocated += s->shards[i].persistent.heap_curr_allocated;
+
+	if (curr_allocated != 0)
+		s->persistent->heap_curr_allocated += curr_allocated;
+
 	pmemops_persist(&pop->p_ops, s->persistent,
 	sizeof(struct stats_persistent));
+	if (s->latency != NULL)
+		latency_delete(s->latency);
+	util_aligned_free(s->shards);
 	Free(s->transient);
 	Free(s);
 }
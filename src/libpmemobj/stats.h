@@ -9,7 +9,9 @@
 #define LIBPMEMOBJ_STATS_H 1
 
 #include "ctl.h"
+#include "latency.h"
 #include "libpmemobj/ctl.h"
+#include "util.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,18 +20,59 @@ extern "C" {
 struct stats_transient {
 	uint64_t heap_run_allocated;
 	uint64_t heap_run_active;
+	uint64_t tx_undo_extensions;
+	uint64_t tx_redo_extensions;
 };
 
 struct stats_persistent {
 	uint64_t heap_curr_allocated;
 };
 
+/*
+ * The counters are updated by many threads at once, and so, instead of all of
+ * them hitting the same cache line, every thread adds to its own shard of the
+ * counters, which are summed up with the base values when read. The shards of
+ * the persistent counters are folded into the pool when it's closed.
+ */
+#define STATS_SHARDS 16
+
+struct stats_shard {
+	struct stats_transient transient;
+	struct stats_persistent persistent;
+	char padding[CACHELINE_SIZE - sizeof(struct stats_transient) -
+		sizeof(struct stats_persistent)];
+};
+
 struct stats {
 	enum pobj_stats_enabled enabled;
 	struct stats_transient *transient;
 	struct stats_persistent *persistent;
+	struct stats_shard *shards;
+
+	int latency_enabled; /* latencies of the operations are recorded */
+	struct latency *latency; /* allocated once they are first enabled */
 };
 
+/* shard of the thread plus one, zero if not assigned yet */
+extern __thread unsigned Stats_thread_shard;
+
+unsigned stats_thread_shard_assign(void);
+
+/*
+ * stats_thread_shard -- returns the index of the shard of the calling thread
+ */
+static inline unsigned
+stats_thread_shard(void)
+{
+	if (unlikely(Stats_thread_shard == 0))
+		return stats_thread_shard_assign();
+
+	return Stats_thread_shard - 1;
+}
+
+#define STATS_SHARD(stats)\
+	(&(stats)->shards[stats_thread_shard()])
+
 #define STATS_INC(stats, type, name, value) do {\
 	STATS_INC_##type(stats, name, value);\
 } while (0)
@@ -37,13 +80,15 @@ struct stats {
 #define STATS_INC_transient(stats, name, value) do {\
 	if ((stats)->enabled == POBJ_STATS_ENABLED_TRANSIENT ||\
 	(stats)->enabled == POBJ_STATS_ENABLED_BOTH)\
-		util_fetch_and_add64((&(stats)->transient->name), (value));\
+		util_fetch_and_add64((&STATS_SHARD(stats)->transient.name),\
+		(value));\
 } while (0)
 
 #define STATS_INC_persistent(stats, name, value) do {\
 	if ((stats)->enabled == POBJ_STATS_ENABLED_PERSISTENT ||\
 	(stats)->enabled == POBJ_STATS_ENABLED_BOTH)\
-		util_fetch_and_add64((&(stats)->persistent->name), (value));\
+		util_fetch_and_add64((&STATS_SHARD(stats)->persistent.name),\
+		(value));\
 } while (0)
 
 #define STATS_SUB(stats, type, name, value) do {\
@@ -53,31 +98,56 @@ struct stats {
 #define STATS_SUB_transient(stats, name, value) do {\
 	if ((stats)->enabled == POBJ_STATS_ENABLED_TRANSIENT ||\
 	(stats)->enabled == POBJ_STATS_ENABLED_BOTH)\
-		util_fetch_and_sub64((&(stats)->transient->name), (value));\
+		util_fetch_and_sub64((&STATS_SHARD(stats)->transient.name),\
+		(value));\
 } while (0)
 
 #define STATS_SUB_persistent(stats, name, value) do {\
 	if ((stats)->enabled == POBJ_STATS_ENABLED_PERSISTENT ||\
 	(stats)->enabled == POBJ_STATS_ENABLED_BOTH)\
-		util_fetch_and_sub64((&(stats)->persistent->name), (value));\
+		util_fetch_and_sub64((&STATS_SHARD(stats)->persistent.name),\
+		(value));\
 } while (0)
 
+/*
+ * STATS_SET -- sets the base value of the counter and clears its shards, this
+ *	isn't atomic with respect to the concurrent updates of the counter
+ */
 #define STATS_SET(stats, type, name, value) do {\
 	STATS_SET_##type(stats, name, value);\
 } while (0)
 
+#define STATS_SET_SHARDS(stats, type, name, value) do {\
+	for (unsigned _i = 0; _i < STATS_SHARDS; ++_i)\
+		util_atomic_store_explicit64(\
+		(&(stats)->shards[_i].type.name), 0,\
+		memory_order_relaxed);\
+	util_atomic_store_explicit64((&(stats)->type->name),\
+		(value), memory_order_release);\
+} while (0)
+
 #define STATS_SET_transient(stats, name, value) do {\
 	if ((stats)->enabled == POBJ_STATS_ENABLED_TRANSIENT ||\
 	(stats)->enabled == POBJ_STATS_ENABLED_BOTH)\
-		util_atomic_store_explicit64((&(stats)->transient->name),\
-		(value), memory_order_release);\
+		STATS_SET_SHARDS(stats, transient, name, value);\
 } while (0)
 
 #define STATS_SET_persistent(stats, name, value) do {\
 	if ((stats)->enabled == POBJ_STATS_ENABLED_PERSISTENT ||\
 	(stats)->enabled == POBJ_STATS_ENABLED_BOTH)\
-		util_atomic_store_explicit64((&(stats)->persistent->name),\
-		(value), memory_order_release);\
+		STATS_SET_SHARDS(stats, persistent, name, value);\
+} while (0)
+
+/*
+ * STATS_LATENCY_START -- returns the start time of an operation, zero if the
+ *	latencies aren't recorded
+ */
+#define STATS_LATENCY_START(stats)\
+	((stats)->latency_enabled ? latency_now() : 0)
+
+#define STATS_LATENCY_END(stats, op, start) do {\
+	if ((start) != 0)\
+		latency_record((stats)->latency, (op), (start));\
 } while (0)
 
 #define STATS_CTL_LEAF(type, name)\
@@ -93,6 +163,13 @@ static int CTL_READ_HANDLER(type##_##name)(void *ctx,\
 	uint64_t *argv = arg;\
 	util_atomic_load_explicit64(&pop->stats->type->varname,\
 		argv, memory_order_acquire);\
+	for (unsigned i = 0; i < STATS_SHARDS; ++i) {\
+		uint64_t v;\
+		util_atomic_load_explicit64(\
+			&pop->stats->shards[i].type.varname,\
+			&v, memory_order_relaxed);\
+		*argv += v;\
+	}\
 	return 0;\
 }
 
@@ -6,6 +6,7 @@
  */
 
 #include <inttypes.h>
+#include <sched.h>
 
 #include "obj.h"
 #include "out.h"
@@ -612,6 +613,549 @@ pmemobj_cond_wait(PMEMobjpool *pop, PMEMcond *condp,
 	return os_cond_wait(cond, mutex);
 }
 
+/*
+ * Number of failed attempts to take a held spinlock after which the waiting
+ * thread yields the processor.
+ */
+#define SPINLOCK_SPINS 128
+
+/*
+ * spin_pause -- (internal) called by a thread waiting for a lock, yields the
+ *	processor every SPINLOCK_SPINS calls
+ */
+static inline void
+spin_pause(unsigned *spins)
+{
+	if (++(*spins) == SPINLOCK_SPINS) {
+		sched_yield();
+		*spins = 0;
+	}
+}
+
+/*
+ * spinlock_try -- (internal) takes the spinlock if it isn't held
+ *
+ * Returns 1 if the lock was taken, 0 otherwise.
+ */
+static inline int
+spinlock_try(PMEMobjpool *pop, PMEMspinlock_internal *lockip, uint64_t locked)
+{
+	uint64_t state;
+	util_atomic_load_explicit64(&lockip->state, &state,
+		memory_order_relaxed);
+	if (state == locked)
+		return 0;
+
+	if (unlikely(state != pop->run_id)) {
+		LOG(5, "PMEMspinlock %p pop->run_id %" PRIu64
+			" state %" PRIu64, lockip, pop->run_id, state);
+
+		VALGRIND_REMOVE_PMEM_MAPPING(lockip, sizeof(*lockip));
+	}
+
+	if (!util_bool_compare_and_swap64(&lockip->state, state, locked))
+		return 0;
+
+	VALGRIND_ANNOTATE_HAPPENS_AFTER(&lockip->state);
+
+	return 1;
+}
+
+/*
+ * pmemobj_spinlock_zero -- zero-initialize a pmem resident spinlock
+ *
+ * This function is not MT safe.
+ */
+void
+pmemobj_spinlock_zero(PMEMobjpool *pop, PMEMspinlock *lockp)
+{
+	LOG(3, "pop %p spinlock %p", pop, lockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(lockp));
+
+	PMEMspinlock_internal *lockip = (PMEMspinlock_internal *)lockp;
+	lockip->state = 0;
+	pmemops_persist(&pop->p_ops, &lockip->state, sizeof(lockip->state));
+}
+
+/*
+ * pmemobj_spinlock_lock -- lock a pmem resident spinlock
+ *
+ * The lock is taken with a single compare-and-swap if it's not held, which
+ * also implicitly reinitializes a lock last used in another run of the pool.
+ * Otherwise the calling thread spins until the lock is released.
+ */
+int
+pmemobj_spinlock_lock(PMEMobjpool *pop, PMEMspinlock *lockp)
+{
+	LOG(3, "pop %p spinlock %p", pop, lockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(lockp));
+
+	COMPILE_ERROR_ON(sizeof(PMEMspinlock) != sizeof(PMEMspinlock_internal));
+
+	PMEMspinlock_internal *lockip = (PMEMspinlock_internal *)lockp;
+	ASSERTeq((uintptr_t)&lockip->state % util_alignof(uint64_t), 0);
+
+	uint64_t locked = PMEMSPINLOCK_LOCKED(pop->run_id);
+	unsigned spins = 0;
+
+	while (!spinlock_try(pop, lockip, locked))
+		spin_pause(&spins);
+
+	return 0;
+}
+
+/*
+ * pmemobj_spinlock_trylock -- trylock a pmem resident spinlock
+ */
+int
+pmemobj_spinlock_trylock(PMEMobjpool *pop, PMEMspinlock *lockp)
+{
+	LOG(3, "pop %p spinlock %p", pop, lockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(lockp));
+
+	PMEMspinlock_internal *lockip = (PMEMspinlock_internal *)lockp;
+	ASSERTeq((uintptr_t)&lockip->state % util_alignof(uint64_t), 0);
+
+	if (!spinlock_try(pop, lockip, PMEMSPINLOCK_LOCKED(pop->run_id)))
+		return EBUSY;
+
+	return 0;
+}
+
+/*
+ * pmemobj_spinlock_unlock -- unlock a pmem resident spinlock
+ */
+int
+pmemobj_spinlock_unlock(PMEMobjpool *pop, PMEMspinlock *lockp)
+{
+	LOG(3, "pop %p spinlock %p", pop, lockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(lockp));
+
+	PMEMspinlock_internal *lockip = (PMEMspinlock_internal *)lockp;
+
+	uint64_t state;
+	util_atomic_load_explicit64(&lockip->state, &state,
+		memory_order_relaxed);
+	if (state != PMEMSPINLOCK_LOCKED(pop->run_id))
+		return EPERM;
+
+	VALGRIND_ANNOTATE_HAPPENS_BEFORE(&lockip->state);
+	util_atomic_store_explicit64(&lockip->state, pop->run_id,
+		memory_order_release);
+
+	return 0;
+}
+
+/*
+ * Readers of a PMEMsrwlock don't write to the lock. Each of them publishes
+ * the offset of the lock in its row of the reader indicators of the pool,
+ * which live in DRAM and are indexed by thread. A writer sets the writer flag
+ * in the lock, which stops new readers, and waits until none of the rows
+ * holds the offset of the lock. Readers which find their row full count
+ * themselves in the state of the lock instead.
+ */
+#define SRWLOCK_ROWS 64
+#define SRWLOCK_ROW_ENTRIES 8
+
+#define SRWLOCK_WRITER 1ULL /* the writer flag */
+#define SRWLOCK_READER 2ULL /* a reader counted in the state of the lock */
+
+struct srwlock_row {
+	volatile uint64_t entries[SRWLOCK_ROW_ENTRIES];
+};
+
+struct srwlock_readers {
+	struct srwlock_row rows[SRWLOCK_ROWS];
+};
+
+static uint64_t Srwlock_nthreads;
+static __thread uint64_t Srwlock_thread_id;
+
+/*
+ * srwlock_thread_id -- (internal) returns the nonzero id of the calling thread
+ */
+static inline uint64_t
+srwlock_thread_id(void)
+{
+	if (unlikely(Srwlock_thread_id == 0))
+		Srwlock_thread_id = util_fetch_and_add64(&Srwlock_nthreads, 1)
+			+ 1;
+
+	return Srwlock_thread_id;
+}
+
+/*
+ * srwlock_readers -- (internal) returns the reader indicators of the pool,
+ *	allocates them on first use
+ */
+static struct srwlock_readers *
+srwlock_readers(PMEMobjpool *pop)
+{
+	struct srwlock_readers *readers = pop->srwlock_readers;
+	if (likely(readers != NULL))
+		return readers;
+
+	readers = util_aligned_malloc(CACHELINE_SIZE, sizeof(*readers));
+	if (readers == NULL) {
+		ERR("!util_aligned_malloc");
+		return NULL;
+	}
+	memset(readers, 0, sizeof(*readers));
+
+	if (!util_bool_compare_and_swap64(&pop->srwlock_readers, NULL,
+			readers)) {
+		util_aligned_free(readers);
+		readers = pop->srwlock_readers;
+	}
+
+	return readers;
+}
+
+/*
+ * srwlock_readers_delete -- frees the reader indicators of a pool
+ */
+void
+srwlock_readers_delete(struct srwlock_readers *readers)
+{
+	util_aligned_free(readers);
+}
+
+/*
+ * srwlock_row -- (internal) returns the row of the calling thread
+ */
+static inline struct srwlock_row *
+srwlock_row(struct srwlock_readers *readers)
+{
+	return &readers->rows[(srwlock_thread_id() - 1) % SRWLOCK_ROWS];
+}
+
+/*
+ * srwlock_row_insert -- (internal) publishes a reader of the lock in the row,
+ *	returns NULL if the row is full
+ */
+static volatile uint64_t *
+srwlock_row_insert(struct srwlock_row *row, uint64_t off)
+{
+	for (unsigned i = 0; i < SRWLOCK_ROW_ENTRIES; ++i) {
+		volatile uint64_t *entry = &row->entries[i];
+		if (*entry == 0 && util_bool_compare_and_swap64(entry, 0, off))
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+ * srwlock_row_remove -- (internal) removes a reader of the lock from the row
+ */
+static int
+srwlock_row_remove(struct srwlock_row *row, uint64_t off)
+{
+	for (unsigned i = 0; i < SRWLOCK_ROW_ENTRIES; ++i) {
+		volatile uint64_t *entry = &row->entries[i];
+		if (*entry == off &&
+				util_bool_compare_and_swap64(entry, off, 0))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * srwlock_init -- (internal) initializes the volatile part of a srwlock
+ */
+static int
+srwlock_init(void *lock, void *arg)
+{
+	PMEMsrwlock_internal *srwlockip = lock;
+	srwlockip->pmemsrwlock.state = 0;
+	srwlockip->pmemsrwlock.owner = 0;
+
+	return 0;
+}
+
+/*
+ * get_srwlock -- (internal) atomically initializes a srwlock on its first use
+ *	in this run of the pool
+ */
+static inline int
+get_srwlock(PMEMobjpool *pop, PMEMsrwlock_internal *srwlockip)
+{
+	if (likely(srwlockip->pmemsrwlock.runid == pop->run_id))
+		return 0;
+
+	volatile uint64_t *runid = &srwlockip->pmemsrwlock.runid;
+
+	LOG(5, "PMEMsrwlock %p pop->run_id %" PRIu64
+		" pmemsrwlock.runid %" PRIu64, srwlockip, pop->run_id, *runid);
+
+	ASSERTeq((uintptr_t)runid % util_alignof(uint64_t), 0);
+
+	COMPILE_ERROR_ON(sizeof(PMEMsrwlock) != sizeof(PMEMsrwlock_internal));
+
+	VALGRIND_REMOVE_PMEM_MAPPING(srwlockip, _POBJ_CL_SIZE);
+
+	if (_get_value(pop->run_id, runid, srwlockip, NULL, srwlock_init) < 0)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * srwlock_add_reader -- (internal) counts a reader in the state of the lock
+ *	unless the writer flag is set
+ */
+static int
+srwlock_add_reader(volatile uint64_t *state)
+{
+	uint64_t s;
+	while (((s = *state) & SRWLOCK_WRITER) == 0) {
+		if (util_bool_compare_and_swap64(state, s, s + SRWLOCK_READER))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * srwlock_rdlock -- (internal) takes the read lock, waits for the writer to
+ *	leave only if requested
+ */
+static int
+srwlock_rdlock(PMEMobjpool *pop, PMEMsrwlock_internal *srwlockip, int wait)
+{
+	if (get_srwlock(pop, srwlockip))
+		return EINVAL;
+
+	struct srwlock_readers *readers = srwlock_readers(pop);
+	if (readers == NULL)
+		return ENOMEM;
+
+	struct srwlock_row *row = srwlock_row(readers);
+	uint64_t off = (uint64_t)((uintptr_t)srwlockip - (uintptr_t)pop);
+	volatile uint64_t *state = &srwlockip->pmemsrwlock.state;
+	unsigned spins = 0;
+
+	for (;;) {
+		volatile uint64_t *entry = srwlock_row_insert(row, off);
+		if (entry != NULL) {
+			/* the reader was published with a full barrier */
+			if ((*state & SRWLOCK_WRITER) == 0)
+				break;
+
+			*entry = 0;
+		} else if (srwlock_add_reader(state)) {
+			break;
+		}
+
+		if (!wait)
+			return EBUSY;
+
+		while (*state & SRWLOCK_WRITER)
+			spin_pause(&spins);
+	}
+
+	VALGRIND_ANNOTATE_HAPPENS_AFTER(srwlockip);
+
+	return 0;
+}
+
+/*
+ * srwlock_drain -- (internal) waits for the readers of the lock to leave,
+ *	returns 0 if there are readers and waiting wasn't requested
+ */
+static int
+srwlock_drain(struct srwlock_readers *readers, volatile uint64_t *state,
+	uint64_t off, int wait)
+{
+	unsigned spins = 0;
+
+	while (*state != SRWLOCK_WRITER) {
+		if (!wait)
+			return 0;
+		spin_pause(&spins);
+	}
+
+	for (unsigned r = 0; r < SRWLOCK_ROWS; ++r) {
+		struct srwlock_row *row = &readers->rows[r];
+		for (unsigned i = 0; i < SRWLOCK_ROW_ENTRIES; ++i) {
+			while (row->entries[i] == off) {
+				if (!wait)
+					return 0;
+				spin_pause(&spins);
+			}
+		}
+	}
+
+	return 1;
+}
+
+/*
+ * srwlock_wrlock -- (internal) takes the write lock, waits for the other
+ *	holders of the lock to leave only if requested
+ */
+static int
+srwlock_wrlock(PMEMobjpool *pop, PMEMsrwlock_internal *srwlockip, int wait)
+{
+	if (get_srwlock(pop, srwlockip))
+		return EINVAL;
+
+	struct srwlock_readers *readers = srwlock_readers(pop);
+	if (readers == NULL)
+		return ENOMEM;
+
+	uint64_t off = (uint64_t)((uintptr_t)srwlockip - (uintptr_t)pop);
+	volatile uint64_t *state = &srwlockip->pmemsrwlock.state;
+	unsigned spins = 0;
+
+	/* the writer flag stops new readers and writers */
+	for (;;) {
+		uint64_t s = *state;
+		if ((s & SRWLOCK_WRITER) == 0) {
+			if (util_bool_compare_and_swap64(state, s,
+					s | SRWLOCK_WRITER))
+				break;
+			continue;
+		}
+
+		if (!wait)
+			return EBUSY;
+		spin_pause(&spins);
+	}
+
+	if (!srwlock_drain(readers, state, off, wait)) {
+		util_fetch_and_and64(state, ~SRWLOCK_WRITER);
+		return EBUSY;
+	}
+
+	srwlockip->pmemsrwlock.owner = srwlock_thread_id();
+
+	VALGRIND_ANNOTATE_HAPPENS_AFTER(srwlockip);
+
+	return 0;
+}
+
+/*
+ * pmemobj_srwlock_zero -- zero-initialize a pmem resident srwlock
+ *
+ * This function is not MT safe.
+ */
+void
+pmemobj_srwlock_zero(PMEMobjpool *pop, PMEMsrwlock *srwlockp)
+{
+	LOG(3, "pop %p srwlock %p", pop, srwlockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(srwlockp));
+
+	PMEMsrwlock_internal *srwlockip = (PMEMsrwlock_internal *)srwlockp;
+	srwlockip->pmemsrwlock.runid = 0;
+	pmemops_persist(&pop->p_ops, &srwlockip->pmemsrwlock.runid,
+				sizeof(srwlockip->pmemsrwlock.runid));
+}
+
+/*
+ * pmemobj_srwlock_rdlock -- rdlock a pmem resident srwlock
+ */
+int
+pmemobj_srwlock_rdlock(PMEMobjpool *pop, PMEMsrwlock *srwlockp)
+{
+	LOG(3, "pop %p srwlock %p", pop, srwlockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(srwlockp));
+
+	return srwlock_rdlock(pop, (PMEMsrwlock_internal *)srwlockp, 1);
+}
+
+/*
+ * pmemobj_srwlock_tryrdlock -- tryrdlock a pmem resident srwlock
+ */
+int
+pmemobj_srwlock_tryrdlock(PMEMobjpool *pop, PMEMsrwlock *srwlockp)
+{
+	LOG(3, "pop %p srwlock %p", pop, srwlockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(srwlockp));
+
+	return srwlock_rdlock(pop, (PMEMsrwlock_internal *)srwlockp, 0);
+}
+
+/*
+ * pmemobj_srwlock_wrlock -- wrlock a pmem resident srwlock
+ */
+int
+pmemobj_srwlock_wrlock(PMEMobjpool *pop, PMEMsrwlock *srwlockp)
+{
+	LOG(3, "pop %p srwlock %p", pop, srwlockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(srwlockp));
+
+	return srwlock_wrlock(pop, (PMEMsrwlock_internal *)srwlockp, 1);
+}
+
+/*
+ * pmemobj_srwlock_trywrlock -- trywrlock a pmem resident srwlock
+ */
+int
+pmemobj_srwlock_trywrlock(PMEMobjpool *pop, PMEMsrwlock *srwlockp)
+{
+	LOG(3, "pop %p srwlock %p", pop, srwlockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(srwlockp));
+
+	return srwlock_wrlock(pop, (PMEMsrwlock_internal *)srwlockp, 0);
+}
+
+/*
+ * pmemobj_srwlock_unlock -- unlock a pmem resident srwlock
+ *
+ * The write lock is released if it's held by the calling thread, otherwise
+ * a reader of the lock is removed.
+ */
+int
+pmemobj_srwlock_unlock(PMEMobjpool *pop, PMEMsrwlock *srwlockp)
+{
+	LOG(3, "pop %p srwlock %p", pop, srwlockp);
+
+	ASSERTeq(pop, pmemobj_pool_by_ptr(srwlockp));
+
+	PMEMsrwlock_internal *srwlockip = (PMEMsrwlock_internal *)srwlockp;
+	if (get_srwlock(pop, srwlockip))
+		return EINVAL;
+
+	volatile uint64_t *state = &srwlockip->pmemsrwlock.state;
+
+	if ((*state & SRWLOCK_WRITER) &&
+			srwlockip->pmemsrwlock.owner == srwlock_thread_id()) {
+		srwlockip->pmemsrwlock.owner = 0;
+		VALGRIND_ANNOTATE_HAPPENS_BEFORE(srwlockip);
+		util_fetch_and_and64(state, ~SRWLOCK_WRITER);
+		return 0;
+	}
+
+	VALGRIND_ANNOTATE_HAPPENS_BEFORE(srwlockip);
+
+	struct srwlock_readers *readers = pop->srwlock_readers;
+	uint64_t off = (uint64_t)((uintptr_t)srwlockip - (uintptr_t)pop);
+	if (readers != NULL && srwlock_row_remove(srwlock_row(readers), off))
+		return 0;
+
+	/*
+	 * A thread which found its row full may have removed the entry of
+	 * another reader, who is then counted in the state instead.
+	 */
+	uint64_t s;
+	while ((s = *state) >= SRWLOCK_READER) {
+		if (util_bool_compare_and_swap64(state, s, s - SRWLOCK_READER))
+			return 0;
+	}
+
+	return EPERM;
+}
+
 /*
  * pmemobj_volatile -- atomically initialize, record and return a
  *	generic value
@@ -73,6 +73,30 @@ typedef union padded_pmemcond {
 #define PMEMcond_bsd_cond_p pmemcond.cond_u.bsd_u.bsd_cond_p
 #define PMEMcond_next pmemcond.cond_u.bsd_u.next
 
+/*
+ * The state of a PMEMspinlock is the run id of the pool when it is unlocked
+ * and the run id with the lowest bit set when it is locked. Because the run
+ * id is always even and changes on every open, any other value means that
+ * the lock was last used in another run and is unlocked.
+ */
+typedef union pmemspinlock {
+	char padding[8];
+	uint64_t state;
+} PMEMspinlock_internal;
+#define PMEMSPINLOCK_LOCKED(run_id) ((run_id) | 1)
+
+typedef union padded_pmemsrwlock {
+	char padding[_POBJ_CL_SIZE];
+	struct {
+		uint64_t runid;
+		uint64_t state; /* writer flag and the readers counted in the lock */
+		uint64_t owner; /* id of the thread holding the write lock */
+	} pmemsrwlock;
+} PMEMsrwlock_internal;
+
+struct srwlock_readers;
+void srwlock_readers_delete(struct srwlock_readers *readers);
+
 /*
  * pmemobj_mutex_lock_nofail -- pmemobj_mutex_lock variant that never
  * fails from caller perspective. If pmemobj_mutex_lock failed, this function
@@ -13,6 +13,7 @@
 #include "obj.h"
 #include "out.h"
 #include "pmalloc.h"
+#include "sys_util.h"
 #include "tx.h"
 #include "valgrind_internal.h"
 #include "memops.h"
@@ -34,8 +35,40 @@ struct tx {
 
 	struct ravl *ranges;
 
+	/* snapshot tracker of transactions that add many ranges */
+	struct tx_line *lines;
+	size_t lines_capacity;
+	size_t nlines;
+	size_t nadds; /* number of ranges added through the ranges tree */
+
+	int redo; /* writes are buffered and applied through the redo log */
+	struct ravl *redo_writes;
+	size_t redo_nbytes; /* redo log space required by the buffered writes */
+
+	/* writes to objects allocated by the transaction are staged in DRAM */
+	int write_combine;
+	struct ravl *wc_allocs; /* objects whose writes can be staged */
+	struct ravl *wc_writes; /* staged writes, copied to pmem on commit */
+
+	/* the outermost commit is started, but its lane isn't released yet */
+	int commit_pending;
+	int grouped; /* the transaction joined the group commit */
+	int group_done; /* flushed and drained by the group, under its lock */
+
+	uint64_t latency_start; /* start of the outermost transaction */
+
 	VEC(, struct pobj_action) actions;
 	VEC(, struct user_buffer_def) redo_userbufs;
+
+	/* savepoints, oldest first */
+	VEC(, struct pobj_tx_savepoint *) savepoints;
+	/* allocations freed after a savepoint, cancelled on commit */
+	VEC(, size_t) freed_actions;
+
+	/* sorted ranges and snapshots collected by pmemobj_tx_add_ranges */
+	VEC(, struct tx_range_def) add_ranges;
+	VEC(, struct user_buffer_def) snapshots;
+	int defer_snapshots;
 	size_t redo_userbufs_capacity;
 
 	pmemobj_tx_callback stage_callback;
@@ -58,6 +91,20 @@ get_tx()
 	return &tx;
 }
 
+/*
+ * tx_group -- committing transactions of the pool which wait for a shared
+ *	drain, one of the waiting threads flushes the ranges of all of them
+ */
+VEC(tx_batch, struct tx *);
+
+struct tx_group {
+	os_mutex_t lock;
+	os_cond_t cond;
+	struct tx_batch pending; /* joined, not taken by a leader yet */
+	struct tx_batch flushing; /* owned by the current leader */
+	int leader; /* a thread is flushing a batch */
+};
+
 struct tx_lock_data {
 	union {
 		PMEMmutex *mutex;
@@ -99,114 +146,1000 @@ tx_range_def_cmp(const void *lhs, const void *rhs)
 	else if (l->offset < r->offset)
 		return -1;
 
-	return 0;
+	return 0;
+}
+
+/*
+ * pobj_tx_savepoint -- the state of a transaction which can be restored with
+ *	pmemobj_tx_rollback_to
+ */
+struct pobj_tx_savepoint {
+	struct operation_marker undo; /* end of the undo log */
+	size_t nactions;
+	size_t nfreed;
+	size_t nadds;
+	int first_snapshot;
+
+	VEC(, struct tx_range_def) ranges; /* copy of the ranges tree */
+	int ranges_oom;
+
+	/*
+	 * The contents, as of the savepoint, of the ranges snapshotted before
+	 * it and added again after it. They can't be logged in the undo log,
+	 * which must restore the older contents if the transaction aborts.
+	 */
+	struct ravl *copies;
+};
+
+/*
+ * tx_redo_def -- a range of persistent memory written in a redo transaction,
+ *	along with its new content
+ */
+struct tx_redo_def {
+	uint64_t offset;
+	uint64_t size;
+	char *data;
+};
+
+/*
+ * tx_redo_def_cmp -- compares two buffered writes
+ */
+static int
+tx_redo_def_cmp(const void *lhs, const void *rhs)
+{
+	const struct tx_redo_def *l = lhs;
+	const struct tx_redo_def *r = rhs;
+
+	if (l->offset > r->offset)
+		return 1;
+	else if (l->offset < r->offset)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * tx_params_new -- creates a new transactional parameters instance and fills it
+ *	with default values.
+ */
+struct tx_parameters *
+tx_params_new(void)
+{
+	struct tx_parameters *tx_params = Malloc(sizeof(*tx_params));
+	if (tx_params == NULL)
+		return NULL;
+
+	tx_params->cache_size = TX_DEFAULT_RANGE_CACHE_SIZE;
+	tx_params->snapshot_tracker_threshold =
+		TX_DEFAULT_SNAPSHOT_TRACKER_THRESHOLD;
+	tx_params->snapshot_compress_threshold = 0;
+	tx_params->undo_prealloc = 0;
+	tx_params->redo_prealloc = 0;
+	tx_params->group_commit = 0;
+
+	struct tx_group *group = Malloc(sizeof(*group));
+	if (group == NULL) {
+		Free(tx_params);
+		return NULL;
+	}
+
+	util_mutex_init(&group->lock);
+	util_cond_init(&group->cond);
+	VEC_INIT(&group->pending);
+	VEC_INIT(&group->flushing);
+	group->leader = 0;
+	tx_params->group = group;
+
+	return tx_params;
+}
+
+/*
+ * tx_params_delete -- deletes transactional parameters instance
+ */
+void
+tx_params_delete(struct tx_parameters *tx_params)
+{
+	struct tx_group *group = tx_params->group;
+
+	VEC_DELETE(&group->pending);
+	VEC_DELETE(&group->flushing);
+	util_cond_destroy(&group->cond);
+	util_mutex_destroy(&group->lock);
+	Free(group);
+
+	Free(tx_params);
+}
+
+static void
+obj_tx_abort(int errnum, int user);
+
+/*
+ * obj_tx_fail_err -- (internal) pmemobj_tx_abort variant that returns
+ * error code
+ */
+static inline int
+obj_tx_fail_err(int errnum, uint64_t flags)
+{
+	if ((flags & POBJ_FLAG_TX_NO_ABORT) == 0)
+		obj_tx_abort(errnum, 0);
+	errno = errnum;
+	return errnum;
+}
+
+/*
+ * obj_tx_fail_null -- (internal) pmemobj_tx_abort variant that returns
+ * null PMEMoid
+ */
+static inline PMEMoid
+obj_tx_fail_null(int errnum, uint64_t flags)
+{
+	if ((flags & POBJ_FLAG_TX_NO_ABORT) == 0)
+		obj_tx_abort(errnum, 0);
+	errno = errnum;
+	return OID_NULL;
+}
+
+/* ASSERT_IN_TX -- checks whether there's open transaction */
+#define ASSERT_IN_TX(tx) do {\
+	if ((tx)->stage == TX_STAGE_NONE)\
+		FATAL("%s called outside of transaction", __func__);\
+} while (0)
+
+/* ASSERT_TX_STAGE_WORK -- checks whether current transaction stage is WORK */
+#define ASSERT_TX_STAGE_WORK(tx) do {\
+	if ((tx)->stage != TX_STAGE_WORK)\
+		FATAL("%s called in invalid stage %d", __func__, (tx)->stage);\
+} while (0)
+
+/*
+ * tx_action_reserve -- (internal) reserve space for the given number of actions
+ */
+static int
+tx_action_reserve(struct tx *tx, size_t n)
+{
+	size_t entries_size = (VEC_SIZE(&tx->actions) + n) *
+		sizeof(struct ulog_entry_val) + tx->redo_nbytes;
+
+	/* take the provided user buffers into account when reserving */
+	entries_size -= MIN(tx->redo_userbufs_capacity, entries_size);
+
+	if (operation_reserve(tx->lane->external, entries_size) != 0)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * tx_action_add -- (internal) reserve space and add a new tx action
+ */
+static struct pobj_action *
+tx_action_add(struct tx *tx)
+{
+	if (tx_action_reserve(tx, 1) != 0)
+		return NULL;
+
+	VEC_INC_BACK(&tx->actions);
+
+	return &VEC_BACK(&tx->actions);
+}
+
+/*
+ * tx_action_remove -- (internal) remove last tx action
+ */
+static void
+tx_action_remove(struct tx *tx)
+{
+	VEC_POP_BACK(&tx->actions);
+}
+
+/*
+ * tx_action_cancel_alloc -- (internal) cancels the allocation of an object
+ *	freed in the same transaction
+ *
+ * An object allocated before the newest savepoint can still be brought back
+ * by a rollback, so its reservation is cancelled only on commit.
+ */
+static int
+tx_action_cancel_alloc(struct tx *tx, struct pobj_action *action)
+{
+	size_t pos = (size_t)(action - VEC_ARR(&tx->actions));
+
+	if (VEC_SIZE(&tx->savepoints) != 0 &&
+	    pos < VEC_BACK(&tx->savepoints)->nactions)
+		return VEC_PUSH_BACK(&tx->freed_actions, pos);
+
+	palloc_cancel(&tx->pop->heap, action, 1);
+	VEC_ERASE_BY_PTR(&tx->actions, action);
+
+	return 0;
+}
+
+/*
+ * tx_action_pos_cmp -- (internal) compares positions of actions, descending
+ */
+static int
+tx_action_pos_cmp(const void *lhs, const void *rhs)
+{
+	size_t l = *(const size_t *)lhs;
+	size_t r = *(const size_t *)rhs;
+
+	if (l < r)
+		return 1;
+	else if (l > r)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * tx_cancel_freed_actions -- (internal) cancels the allocations freed after
+ *	a savepoint
+ */
+static void
+tx_cancel_freed_actions(struct tx *tx)
+{
+	/* erasing from the back keeps the remaining positions valid */
+	qsort(VEC_ARR(&tx->freed_actions), VEC_SIZE(&tx->freed_actions),
+		sizeof(size_t), tx_action_pos_cmp);
+
+	size_t pos;
+	VEC_FOREACH(pos, &tx->freed_actions) {
+		struct pobj_action *action = VEC_GET(&tx->actions, pos);
+		palloc_cancel(&tx->pop->heap, action, 1);
+		VEC_ERASE_BY_PTR(&tx->actions, action);
+	}
+
+	VEC_CLEAR(&tx->freed_actions);
+}
+
+/*
+ * tx_line -- a cacheline of persistent memory, along with a bitmap of its
+ *	bytes that are known to be covered by the snapshot ranges
+ */
+struct tx_line {
+	uint64_t key; /* index of the cacheline plus one, zero if unused */
+	uint64_t mask;
+};
+
+#define TX_LINE_SIZE 64 /* number of bytes tracked by a single bitmap */
+#define TX_LINES_MIN_CAPACITY 64
+#define TX_LINES_MAX_RANGE 4096 /* larger ranges are never tracked */
+
+/*
+ * tx_lines_clear -- (internal) discards the snapshot tracker
+ */
+static void
+tx_lines_clear(struct tx *tx)
+{
+	Free(tx->lines);
+	tx->lines = NULL;
+	tx->lines_capacity = 0;
+	tx->nlines = 0;
+}
+
+/*
+ * tx_lines_slot -- (internal) returns the slot of the snapshot tracker which
+ *	either holds the given cacheline or is the empty one it belongs in
+ */
+static struct tx_line *
+tx_lines_slot(struct tx_line *lines, size_t capacity, uint64_t key)
+{
+	size_t mask = capacity - 1;
+	size_t i = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+
+	while (lines[i].key != 0 && lines[i].key != key)
+		i = (i + 1) & mask;
+
+	return &lines[i];
+}
+
+/*
+ * tx_lines_grow -- (internal) doubles the capacity of the snapshot tracker
+ */
+static int
+tx_lines_grow(struct tx *tx)
+{
+	size_t capacity = tx->lines_capacity == 0 ?
+		TX_LINES_MIN_CAPACITY : tx->lines_capacity * 2;
+
+	struct tx_line *lines = Zalloc(capacity * sizeof(*lines));
+	if (lines == NULL)
+		return -1;
+
+	for (size_t i = 0; i < tx->lines_capacity; ++i) {
+		struct tx_line *line = &tx->lines[i];
+		if (line->key != 0)
+			*tx_lines_slot(lines, capacity, line->key) = *line;
+	}
+
+	Free(tx->lines);
+	tx->lines = lines;
+	tx->lines_capacity = capacity;
+
+	return 0;
+}
+
+/*
+ * tx_line_bits -- (internal) returns the bitmap of the bytes of a cacheline
+ *	that are within the <offset, end) range
+ */
+static uint64_t
+tx_line_bits(uint64_t line, uint64_t offset, uint64_t end)
+{
+	uint64_t lstart = line * TX_LINE_SIZE;
+	uint64_t first = MAX(offset, lstart) - lstart;
+	uint64_t nbits = MIN(end, lstart + TX_LINE_SIZE) - lstart - first;
+
+	if (nbits == TX_LINE_SIZE)
+		return UINT64_MAX;
+
+	return ((1ULL << nbits) - 1) << first;
+}
+
+/*
+ * tx_lines_covered -- (internal) checks whether the range is known to be
+ *	entirely covered by the snapshot ranges of the transaction
+ */
+static int
+tx_lines_covered(struct tx *tx, uint64_t offset, uint64_t size)
+{
+	if (tx->nlines == 0 || size == 0 || size > TX_LINES_MAX_RANGE)
+		return 0;
+
+	uint64_t end = offset + size;
+	for (uint64_t l = offset / TX_LINE_SIZE; l * TX_LINE_SIZE < end; ++l) {
+		struct tx_line *line = tx_lines_slot(tx->lines,
+			tx->lines_capacity, l + 1);
+		uint64_t bits = tx_line_bits(l, offset, end);
+		if ((line->mask & bits) != bits)
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * tx_lines_mark -- (internal) records that the range is covered by the
+ *	snapshot ranges of the transaction
+ *
+ * The tracker only accelerates the lookups in the ranges tree, so running
+ * out of memory here isn't an error, the range simply remains untracked.
+ */
+static void
+tx_lines_mark(struct tx *tx, uint64_t offset, uint64_t size)
+{
+	if (size > TX_LINES_MAX_RANGE)
+		return;
+
+	uint64_t end = offset + size;
+	for (uint64_t l = offset / TX_LINE_SIZE; l * TX_LINE_SIZE < end; ++l) {
+		/* keep the load factor of the tracker below 50% */
+		if ((tx->nlines + 1) * 2 > tx->lines_capacity &&
+			tx_lines_grow(tx) != 0)
+			return;
+
+		struct tx_line *line = tx_lines_slot(tx->lines,
+			tx->lines_capacity, l + 1);
+		if (line->key == 0) {
+			line->key = l + 1;
+			tx->nlines++;
+		}
+		line->mask |= tx_line_bits(l, offset, end);
+	}
+}
+
+/*
+ * tx_redo_entry_size -- (internal) returns the size of the redo log entry
+ *	of a buffered write
+ */
+static size_t
+tx_redo_entry_size(size_t size)
+{
+	return ALIGN_UP(sizeof(struct ulog_entry_buf) + size, CACHELINE_SIZE);
+}
+
+/*
+ * tx_redo_def_free -- (internal) frees the data of a buffered write
+ */
+static void
+tx_redo_def_free(void *data, void *arg)
+{
+	struct tx_redo_def *def = data;
+
+	Free(def->data);
+}
+
+/*
+ * tx_savepoint_delete -- (internal) frees the savepoint
+ */
+static void
+tx_savepoint_delete(struct pobj_tx_savepoint *sp)
+{
+	if (sp->copies != NULL)
+		ravl_delete_cb(sp->copies, tx_redo_def_free, NULL);
+	VEC_DELETE(&sp->ranges);
+	Free(sp);
+}
+
+/*
+ * tx_savepoint_copy_gap -- (internal) copies the current contents of a range
+ *	of persistent memory into the savepoint
+ */
+static int
+tx_savepoint_copy_gap(struct tx *tx, struct pobj_tx_savepoint *sp,
+	uint64_t offset, uint64_t size)
+{
+	struct tx_redo_def def = {offset, size, Malloc(size)};
+	if (def.data == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	pmdk_asan_memcpy(def.data, OBJ_OFF_TO_PTR(tx->pop, offset), size);
+
+	if (ravl_emplace_copy(sp->copies, &def) != 0) {
+		Free(def.data);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * tx_savepoint_copy -- (internal) copies the parts of a range not yet copied
+ *	into the savepoint
+ */
+static int
+tx_savepoint_copy(struct tx *tx, struct pobj_tx_savepoint *sp,
+	uint64_t offset, uint64_t end)
+{
+	struct tx_redo_def search = {offset, 0, NULL};
+	struct ravl_node *n = ravl_find(sp->copies, &search,
+		RAVL_PREDICATE_LESS_EQUAL);
+	if (n != NULL) {
+		struct tx_redo_def *def = ravl_data(n);
+		offset = MAX(offset, MIN(end, def->offset + def->size));
+	}
+
+	while (offset < end) {
+		search.offset = offset;
+		n = ravl_find(sp->copies, &search,
+			RAVL_PREDICATE_GREATER_EQUAL);
+
+		uint64_t gap_end = end;
+		uint64_t next = end;
+		if (n != NULL) {
+			struct tx_redo_def *def = ravl_data(n);
+			gap_end = MIN(end, def->offset);
+			next = MIN(end, def->offset + def->size);
+		}
+
+		if (gap_end > offset && tx_savepoint_copy_gap(tx, sp, offset,
+				gap_end - offset) != 0)
+			return -1;
+
+		offset = next;
+	}
+
+	return 0;
+}
+
+/*
+ * tx_savepoint_add -- (internal) preserves the contents, as of the newest
+ *	savepoint, of the parts of the added range snapshotted before it
+ */
+static int
+tx_savepoint_add(struct tx *tx, const struct tx_range_def *args)
+{
+	struct pobj_tx_savepoint *sp = VEC_BACK(&tx->savepoints);
+	uint64_t end = args->offset + args->size;
+
+	/* find the first range ending after the beginning of the added one */
+	size_t lo = 0;
+	size_t hi = VEC_SIZE(&sp->ranges);
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		struct tx_range_def *r = VEC_GET(&sp->ranges, mid);
+		if (r->offset + r->size <= args->offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (size_t i = lo; i < VEC_SIZE(&sp->ranges); ++i) {
+		struct tx_range_def *r = VEC_GET(&sp->ranges, i);
+		if (r->offset >= end)
+			break;
+
+		if (tx_savepoint_copy(tx, sp, MAX(r->offset, args->offset),
+				MIN(r->offset + r->size, end)) != 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * tx_savepoint_restore_copy -- (internal) restores a range copied into
+ *	a savepoint
+ */
+static void
+tx_savepoint_restore_copy(void *data, void *arg)
+{
+	PMEMobjpool *pop = arg;
+	struct tx_redo_def *def = data;
+
+	pmemops_memcpy(&pop->p_ops, OBJ_OFF_TO_PTR(pop, def->offset),
+		def->data, def->size, PMEMOBJ_F_MEM_NODRAIN);
+}
+
+/*
+ * tx_savepoints_truncate -- (internal) deletes all but the given number of
+ *	the oldest savepoints
+ */
+static void
+tx_savepoints_truncate(struct tx *tx, size_t n)
+{
+	while (VEC_SIZE(&tx->savepoints) > n) {
+		tx_savepoint_delete(VEC_BACK(&tx->savepoints));
+		VEC_POP_BACK(&tx->savepoints);
+	}
+}
+
+/*
+ * tx_wc_clear -- (internal) discards all staged writes
+ */
+static void
+tx_wc_clear(struct tx *tx)
+{
+	if (tx->wc_writes != NULL)
+		ravl_delete_cb(tx->wc_writes, tx_redo_def_free, NULL);
+	if (tx->wc_allocs != NULL)
+		ravl_delete(tx->wc_allocs);
+
+	tx->wc_writes = NULL;
+	tx->wc_allocs = NULL;
+}
+
+/*
+ * tx_redo_clear -- (internal) discards all buffered writes
+ */
+static void
+tx_redo_clear(struct tx *tx)
+{
+	if (tx->redo_writes != NULL)
+		ravl_delete_cb(tx->redo_writes, tx_redo_def_free, NULL);
+
+	tx->redo_writes = NULL;
+	tx->redo_nbytes = 0;
+}
+
+/*
+ * tx_redo_first -- (internal) returns the first buffered write that might
+ *	overlap, or be adjacent to, the given offset
+ */
+static struct ravl_node *
+tx_redo_first(struct ravl *writes, uint64_t offset)
+{
+	struct tx_redo_def search = {offset, 0, NULL};
+
+	struct ravl_node *n = ravl_find(writes, &search,
+		RAVL_PREDICATE_LESS_EQUAL);
+	if (n == NULL)
+		n = ravl_find(writes, &search, RAVL_PREDICATE_GREATER);
+
+	return n;
+}
+
+/*
+ * tx_redo_next -- (internal) returns the buffered write that follows the
+ *	given one
+ */
+static struct ravl_node *
+tx_redo_next(struct ravl *writes, const struct tx_redo_def *def)
+{
+	return ravl_find(writes, def, RAVL_PREDICATE_GREATER);
+}
+
+/*
+ * tx_redo_copy -- (internal) copies data between the buffered writes and
+ *	a range of persistent memory, only the parts that overlap are copied
+ */
+static void
+tx_redo_copy(struct ravl *writes, uint64_t offset, char *buf, size_t size,
+	int to_redo)
+{
+	if (writes == NULL)
+		return;
+
+	uint64_t end = offset + size;
+
+	for (struct ravl_node *n = tx_redo_first(writes, offset); n != NULL;
+			n = tx_redo_next(writes, ravl_data(n))) {
+		struct tx_redo_def *def = ravl_data(n);
+		if (def->offset >= end)
+			break;
+
+		uint64_t from = MAX(def->offset, offset);
+		uint64_t to = MIN(def->offset + def->size, end);
+		if (from >= to)
+			continue;
+
+		char *redo = def->data + (from - def->offset);
+		char *user = buf + (from - offset);
+		if (to_redo)
+			memcpy(redo, user, to - from);
+		else
+			memcpy(user, redo, to - from);
+	}
+}
+
+/*
+ * tx_redo_insert -- (internal) buffers a write, merging it with all of the
+ *	overlapping and adjacent writes, so that buffered ranges never overlap
+ *
+ * If nbytes isn't NULL, it's kept up to date with the size of the redo log
+ * entries of the buffered writes.
+ */
+static int
+tx_redo_insert(struct ravl **writesp, size_t *nbytes, uint64_t offset,
+	const void *src, size_t size)
+{
+	if (*writesp == NULL) {
+		*writesp = ravl_new_sized(tx_redo_def_cmp,
+			sizeof(struct tx_redo_def));
+		if (*writesp == NULL)
+			return -1;
+	}
+
+	struct ravl *writes = *writesp;
+	uint64_t end = offset + size;
+	struct tx_redo_def search = {offset, 0, NULL};
+
+	struct ravl_node *n = ravl_find(writes, &search,
+		RAVL_PREDICATE_LESS_EQUAL);
+	struct tx_redo_def *f = n ? ravl_data(n) : NULL;
+	if (f != NULL && f->offset + f->size < offset)
+		f = NULL;
+
+	/* the write is entirely inside of an already buffered range */
+	if (f != NULL && f->offset + f->size >= end) {
+		memcpy(f->data + (offset - f->offset), src, size);
+		return 0;
+	}
+
+	uint64_t moffset = f ? f->offset : offset;
+	uint64_t mend = end;
+
+	/* the last range that might overlap the end of the write */
+	search.offset = end;
+	n = ravl_find(writes, &search, RAVL_PREDICATE_LESS_EQUAL);
+	struct tx_redo_def *l = n ? ravl_data(n) : NULL;
+	if (l != NULL && l->offset >= moffset)
+		mend = MAX(mend, l->offset + l->size);
+
+	char *data = Malloc(mend - moffset);
+	if (data == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	/*
+	 * Fold all of the ranges covered by the merged one into it. The first
+	 * of them is reused for the merged range, the rest are removed.
+	 */
+	struct tx_redo_def *first = NULL;
+	search.offset = moffset;
+	while ((n = ravl_find(writes, &search,
+			RAVL_PREDICATE_GREATER_EQUAL)) != NULL) {
+		struct tx_redo_def def = *(struct tx_redo_def *)ravl_data(n);
+		if (def.offset + def.size > mend)
+			break;
+
+		memcpy(data + (def.offset - moffset), def.data, def.size);
+		if (nbytes != NULL)
+			*nbytes -= tx_redo_entry_size(def.size);
+		search.offset = def.offset + def.size;
+
+		if (first == NULL) {
+			first = ravl_data(n);
+		} else {
+			Free(def.data);
+			ravl_remove(writes, n);
+		}
+	}
+
+	memcpy(data + (offset - moffset), src, size);
+
+	struct tx_redo_def merged = {moffset, mend - moffset, data};
+	if (first != NULL) {
+		Free(first->data);
+		*first = merged;
+	} else if (ravl_emplace_copy(writes, &merged) != 0) {
+		Free(data);
+		return -1;
+	}
+
+	if (nbytes != NULL)
+		*nbytes += tx_redo_entry_size(merged.size);
+
+	return 0;
+}
+
+/*
+ * tx_range_overlaps -- (internal) checks if any part of the range is already
+ *	a part of the transaction, either snapshotted or freshly allocated
+ */
+static int
+tx_range_overlaps(struct tx *tx, uint64_t offset, size_t size)
+{
+	struct tx_range_def search = {offset, 0, 0};
+
+	struct ravl_node *n = ravl_find(tx->ranges, &search,
+		RAVL_PREDICATE_LESS_EQUAL);
+	if (n != NULL) {
+		struct tx_range_def *r = ravl_data(n);
+		if (r->offset + r->size > offset)
+			return 1;
+	}
+
+	n = ravl_find(tx->ranges, &search, RAVL_PREDICATE_GREATER);
+	if (n == NULL)
+		return 0;
+
+	struct tx_range_def *r = ravl_data(n);
+
+	return r->offset < offset + size;
+}
+
+/*
+ * tx_redo_write -- (internal) buffers a write in a redo transaction, the range
+ *	must not overlap any of the ranges of the transaction
+ */
+static int
+tx_redo_write(struct tx *tx, struct tx_range_def *args, const void *src)
+{
+	if (args->size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR("write size too large");
+		return obj_tx_fail_err(EINVAL, args->flags);
+	}
+
+	if (args->offset < tx->pop->heap_offset ||
+		(args->offset + args->size) >
+		(tx->pop->heap_offset + tx->pop->heap_size)) {
+		ERR("object outside of heap");
+		return obj_tx_fail_err(EINVAL, args->flags);
+	}
+
+	if (args->size == 0)
+		return 0;
+
+	if (tx_redo_insert(&tx->redo_writes, &tx->redo_nbytes, args->offset,
+	    src, args->size) != 0 ||
+	    tx_action_reserve(tx, 0) != 0) {
+		ERR("out of memory");
+		return obj_tx_fail_err(ENOMEM, args->flags);
+	}
+
+	return 0;
+}
+
+/*
+ * tx_wc_alloc_add -- (internal) makes the writes to an object allocated by
+ *	the transaction eligible for staging
+ *
+ * Running out of memory here isn't an error, the writes to the object are
+ * simply made in place.
+ */
+static void
+tx_wc_alloc_add(struct tx *tx, const struct tx_range_def *r)
+{
+	if (tx->wc_allocs == NULL) {
+		tx->wc_allocs = ravl_new_sized(tx_range_def_cmp,
+			sizeof(struct tx_range_def));
+		if (tx->wc_allocs == NULL)
+			return;
+	}
+
+	ravl_emplace_copy(tx->wc_allocs, r);
 }
 
 /*
- * tx_params_new -- creates a new transactional parameters instance and fills it
- *	with default values.
+ * tx_wc_covered -- (internal) checks whether the range lies entirely within
+ *	a single object allocated by the transaction
  */
-struct tx_parameters *
-tx_params_new(void)
+static int
+tx_wc_covered(struct tx *tx, uint64_t offset, uint64_t size)
 {
-	struct tx_parameters *tx_params = Malloc(sizeof(*tx_params));
-	if (tx_params == NULL)
-		return NULL;
+	if (tx->wc_allocs == NULL)
+		return 0;
 
-	tx_params->cache_size = TX_DEFAULT_RANGE_CACHE_SIZE;
+	struct tx_range_def search = {offset, size, 0};
+	struct ravl_node *n = ravl_find(tx->wc_allocs, &search,
+		RAVL_PREDICATE_LESS_EQUAL);
+	if (n == NULL)
+		return 0;
 
-	return tx_params;
+	struct tx_range_def *r = ravl_data(n);
+
+	return size <= r->size && offset - r->offset <= r->size - size;
 }
 
 /*
- * tx_params_delete -- deletes transactional parameters instance
+ * tx_wc_write -- (internal) stages a write to an object allocated by the
+ *	transaction
+ *
+ * If the write can't be staged it's made in place instead, the staged data
+ * for the same range is then kept in sync since it's applied on commit.
  */
-void
-tx_params_delete(struct tx_parameters *tx_params)
+static void
+tx_wc_write(struct tx *tx, const struct tx_range_def *args, const void *src)
 {
-	Free(tx_params);
-}
+	if (tx_redo_insert(&tx->wc_writes, NULL, args->offset, src,
+	    args->size) == 0)
+		return;
 
-static void
-obj_tx_abort(int errnum, int user);
+	memcpy(OBJ_OFF_TO_PTR(tx->pop, args->offset), src, args->size);
+	tx_redo_copy(tx->wc_writes, args->offset, (char *)src, args->size, 1);
+}
 
 /*
- * obj_tx_fail_err -- (internal) pmemobj_tx_abort variant that returns
- * error code
+ * tx_wc_evict -- (internal) stops staging the writes that overlap the range
+ *
+ * Staged data outside of the range is written in place, and so is the data
+ * within it if keep is set, otherwise that part is discarded.
  */
-static inline int
-obj_tx_fail_err(int errnum, uint64_t flags)
+static void
+tx_wc_evict(struct tx *tx, uint64_t offset, uint64_t size, int keep)
 {
-	if ((flags & POBJ_FLAG_TX_NO_ABORT) == 0)
-		obj_tx_abort(errnum, 0);
-	errno = errnum;
-	return errnum;
+	if (tx->wc_writes == NULL)
+		return;
+
+	uint64_t end = offset + size;
+
+	struct ravl_node *n = tx_redo_first(tx->wc_writes, offset);
+	while (n != NULL) {
+		struct tx_redo_def def = *(struct tx_redo_def *)ravl_data(n);
+		if (def.offset >= end)
+			break;
+
+		uint64_t def_end = def.offset + def.size;
+		if (def_end > offset) {
+			char *ptr = OBJ_OFF_TO_PTR(tx->pop, def.offset);
+			if (keep) {
+				memcpy(ptr, def.data, def.size);
+			} else {
+				if (def.offset < offset)
+					memcpy(ptr, def.data,
+						offset - def.offset);
+				if (def_end > end)
+					memcpy(ptr + (end - def.offset),
+						def.data + (end - def.offset),
+						def_end - end);
+			}
+
+			ravl_remove(tx->wc_writes, n);
+			Free(def.data);
+		}
+
+		n = tx_redo_next(tx->wc_writes, &def);
+	}
 }
 
 /*
- * obj_tx_fail_null -- (internal) pmemobj_tx_abort variant that returns
- * null PMEMoid
+ * tx_wc_alloc_remove -- (internal) stops staging the writes to an object
+ *	which is being freed, its staged data is discarded
  */
-static inline PMEMoid
-obj_tx_fail_null(int errnum, uint64_t flags)
+static void
+tx_wc_alloc_remove(struct tx *tx, uint64_t offset, uint64_t size)
 {
-	if ((flags & POBJ_FLAG_TX_NO_ABORT) == 0)
-		obj_tx_abort(errnum, 0);
-	errno = errnum;
-	return OID_NULL;
+	if (tx->wc_allocs == NULL)
+		return;
+
+	struct tx_range_def search = {offset, size, 0};
+	struct ravl_node *n = ravl_find(tx->wc_allocs, &search,
+		RAVL_PREDICATE_EQUAL);
+	if (n != NULL)
+		ravl_remove(tx->wc_allocs, n);
+
+	tx_wc_evict(tx, offset, size, 0);
 }
 
-/* ASSERT_IN_TX -- checks whether there's open transaction */
-#define ASSERT_IN_TX(tx) do {\
-	if ((tx)->stage == TX_STAGE_NONE)\
-		FATAL("%s called outside of transaction", __func__);\
-} while (0)
+/*
+ * tx_wc_copy_range -- (internal) copies one staged write to pmem
+ */
+static void
+tx_wc_copy_range(void *data, void *arg)
+{
+	PMEMobjpool *pop = arg;
+	struct tx_redo_def *def = data;
 
-/* ASSERT_TX_STAGE_WORK -- checks whether current transaction stage is WORK */
-#define ASSERT_TX_STAGE_WORK(tx) do {\
-	if ((tx)->stage != TX_STAGE_WORK)\
-		FATAL("%s called in invalid stage %d", __func__, (tx)->stage);\
-} while (0)
+	pmemops_memcpy(&pop->p_ops, OBJ_OFF_TO_PTR(pop, def->offset),
+		def->data, def->size,
+		PMEMOBJ_F_MEM_NONTEMPORAL | PMEMOBJ_F_MEM_NODRAIN);
+}
 
 /*
- * tx_action_reserve -- (internal) reserve space for the given number of actions
+ * tx_wc_flush_gaps -- (internal) flushes the parts of the range which weren't
+ *	written by non-temporal copies of the staged data
  */
-static int
-tx_action_reserve(struct tx *tx, size_t n)
+static void
+tx_wc_flush_gaps(struct tx *tx, uint64_t offset, uint64_t size)
 {
-	size_t entries_size = (VEC_SIZE(&tx->actions) + n) *
-		sizeof(struct ulog_entry_val);
+	PMEMobjpool *pop = tx->pop;
+	struct ravl *writes = tx->wc_writes;
+	uint64_t pos = offset;
+	uint64_t end = offset + size;
+
+	for (struct ravl_node *n = tx_redo_first(writes, offset); n != NULL;
+			n = tx_redo_next(writes, ravl_data(n))) {
+		struct tx_redo_def *def = ravl_data(n);
+		if (def->offset >= end)
+			break;
 
-	/* take the provided user buffers into account when reserving */
-	entries_size -= MIN(tx->redo_userbufs_capacity, entries_size);
+		uint64_t def_end = def->offset + def->size;
+		if (def_end <= pos)
+			continue;
 
-	if (operation_reserve(tx->lane->external, entries_size) != 0)
-		return -1;
+		if (def->offset > pos)
+			pmemops_xflush(&pop->p_ops, OBJ_OFF_TO_PTR(pop, pos),
+				def->offset - pos, PMEMOBJ_F_RELAXED);
 
-	return 0;
+		pos = def_end;
+	}
+
+	if (pos < end)
+		pmemops_xflush(&pop->p_ops, OBJ_OFF_TO_PTR(pop, pos),
+			end - pos, PMEMOBJ_F_RELAXED);
 }
 
+struct tx_redo_log_args {
+	struct tx *tx;
+	int ret;
+};
+
 /*
- * tx_action_add -- (internal) reserve space and add a new tx action
+ * tx_redo_log_range -- (internal) adds a single buffered write to the
+ *	redo log
  */
-static struct pobj_action *
-tx_action_add(struct tx *tx)
+static void
+tx_redo_log_range(void *data, void *arg)
 {
-	if (tx_action_reserve(tx, 1) != 0)
-		return NULL;
+	struct tx_redo_def *def = data;
+	struct tx_redo_log_args *args = arg;
+	struct tx *tx = args->tx;
 
-	VEC_INC_BACK(&tx->actions);
+	if (args->ret != 0)
+		return;
 
-	return &VEC_BACK(&tx->actions);
+	args->ret = operation_add_buffer(tx->lane->external,
+		OBJ_OFF_TO_PTR(tx->pop, def->offset), def->data, def->size,
+		ULOG_OPERATION_BUF_CPY);
 }
 
 /*
- * tx_action_remove -- (internal) remove last tx action
+ * tx_redo_log -- (internal) adds all of the buffered writes to the redo log
+ *	of the lane and reserves the space for the entries of the actions
+ *	that are going to follow them
  */
-static void
-tx_action_remove(struct tx *tx)
+static int
+tx_redo_log(struct tx *tx)
 {
-	VEC_POP_BACK(&tx->actions);
+	if (tx->redo_writes == NULL)
+		return 0;
+
+	struct operation_context *ctx = tx->lane->external;
+
+	struct tx_redo_log_args args = {tx, 0};
+	ravl_foreach(tx->redo_writes, tx_redo_log_range, &args);
+	if (args.ret != 0)
+		return -1;
+
+	size_t entries_size = operation_get_persistent_size(ctx) +
+		VEC_SIZE(&tx->actions) * sizeof(struct ulog_entry_val);
+	entries_size -= MIN(tx->redo_userbufs_capacity, entries_size);
+
+	return operation_reserve(ctx, entries_size);
 }
 
 /*
@@ -300,6 +1233,9 @@ tx_remove_range(struct txr *tx_ranges, void *begin, void *end)
  * If the snapshot contains any PMEM locks that are held by the current
  * transaction, they won't be overwritten with the saved data to avoid changing
  * their state.  Those locks will be released in tx_end().
+ *
+ * The range is either a copy of the snapshotted data or, for runs of zeroes
+ * elided from compressed snapshots, a fill entry.
  */
 static void
 tx_restore_range(PMEMobjpool *pop, struct tx *tx, struct ulog_entry_buf *range)
@@ -338,6 +1274,7 @@ tx_restore_range(PMEMobjpool *pop, struct tx *tx, struct ulog_entry_buf *range)
 	ASSERT(!PMDK_SLIST_EMPTY(&tx_ranges));
 
 	void *dst_ptr = OBJ_OFF_TO_PTR(pop, range_offset);
+	int fill = ulog_entry_type(&range->base) == ULOG_OPERATION_BUF_SET;
 
 	while (!PMDK_SLIST_EMPTY(&tx_ranges)) {
 		txr = PMDK_SLIST_FIRST(&tx_ranges);
@@ -348,7 +1285,11 @@ tx_restore_range(PMEMobjpool *pop, struct tx *tx, struct ulog_entry_buf *range)
 				(char *)txr->begin - (char *)dst_ptr];
 		ASSERT((char *)txr->end >= (char *)txr->begin);
 		size_t size = (size_t)((char *)txr->end - (char *)txr->begin);
-		pmemops_memcpy(&pop->p_ops, txr->begin, src, size, 0);
+		if (fill)
+			pmemops_memset(&pop->p_ops, txr->begin, *range->data,
+				size, 0);
+		else
+			pmemops_memcpy(&pop->p_ops, txr->begin, src, size, 0);
 		Free(txr);
 	}
 }
@@ -364,6 +1305,7 @@ tx_undo_entry_apply(struct ulog_entry_base *e, void *arg,
 
 	switch (ulog_entry_type(e)) {
 		case ULOG_OPERATION_BUF_CPY:
+		case ULOG_OPERATION_BUF_SET:
 			eb = (struct ulog_entry_buf *)e;
 
 			tx_restore_range(p_ops->base, get_tx(), eb);
@@ -371,7 +1313,6 @@ tx_undo_entry_apply(struct ulog_entry_base *e, void *arg,
 		case ULOG_OPERATION_AND:
 		case ULOG_OPERATION_OR:
 		case ULOG_OPERATION_SET:
-		case ULOG_OPERATION_BUF_SET:
 		default:
 			ASSERT(0);
 	}
@@ -399,9 +1340,14 @@ tx_abort_set(PMEMobjpool *pop, struct lane *lane)
 static void
 tx_flush_range(void *data, void *ctx)
 {
-	PMEMobjpool *pop = ctx;
+	struct tx *tx = ctx;
+	PMEMobjpool *pop = tx->pop;
 	struct tx_range_def *range = data;
-	if (!(range->flags & POBJ_FLAG_NO_FLUSH)) {
+	if (range->flags & POBJ_FLAG_NO_FLUSH) {
+		/* nothing to flush */
+	} else if (tx->wc_writes != NULL) {
+		tx_wc_flush_gaps(tx, range->offset, range->size);
+	} else {
 		pmemops_xflush(&pop->p_ops, OBJ_OFF_TO_PTR(pop, range->offset),
 				range->size, PMEMOBJ_F_RELAXED);
 	}
@@ -430,9 +1376,18 @@ tx_pre_commit(struct tx *tx)
 {
 	LOG(5, NULL);
 
+	/*
+	 * Staged writes are copied with non-temporal stores, which don't
+	 * have to be flushed, only the rest of the ranges is.
+	 */
+	if (tx->wc_writes != NULL)
+		ravl_foreach(tx->wc_writes, tx_wc_copy_range, tx->pop);
+
 	/* Flush all regions and destroy the whole tree. */
-	ravl_delete_cb(tx->ranges, tx_flush_range, tx->pop);
+	ravl_delete_cb(tx->ranges, tx_flush_range, tx);
 	tx->ranges = NULL;
+
+	tx_lines_clear(tx);
 }
 
 /*
@@ -447,10 +1402,14 @@ tx_abort(PMEMobjpool *pop, struct lane *lane)
 
 	tx_abort_set(pop, lane);
 
+	tx_redo_clear(tx);
+	tx_wc_clear(tx);
 	ravl_delete_cb(tx->ranges, tx_clean_range, pop);
 	palloc_cancel(&pop->heap,
 		VEC_ARR(&tx->actions), VEC_SIZE(&tx->actions));
 	tx->ranges = NULL;
+
+	tx_lines_clear(tx);
 }
 
 /*
@@ -581,6 +1540,7 @@ tx_alloc_common(struct tx *tx, size_t size, type_num_t type_num,
 	}
 
 	PMEMobjpool *pop = tx->pop;
+	uint64_t start = STATS_LATENCY_START(pop->stats);
 
 	struct pobj_action *action = tx_action_add(tx);
 	if (action == NULL)
@@ -601,6 +1561,11 @@ tx_alloc_common(struct tx *tx, size_t size, type_num_t type_num,
 	if (tx_lane_ranges_insert_def(pop, tx, &r) != 0)
 		goto err_oom;
 
+	if (tx->write_combine)
+		tx_wc_alloc_add(tx, &r);
+
+	STATS_LATENCY_END(pop->stats, LATENCY_ALLOC, start);
+
 	return retoid;
 
 err_oom:
@@ -648,6 +1613,9 @@ tx_realloc_common(struct tx *tx, PMEMoid oid, size_t size, uint64_t type_num,
 
 	size_t copy_size = old_size < size ? old_size : size;
 
+	/* the new object is constructed from the data of the old one */
+	tx_wc_evict(tx, oid.off, old_size, 1);
+
 	PMEMoid new_obj = tx_alloc_common(tx, size, (type_num_t)type_num,
 			constructor_realloc, COPY_ARGS(flags, ptr, copy_size));
 
@@ -744,6 +1712,11 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 
 		VEC_INIT(&tx->actions);
 		VEC_INIT(&tx->redo_userbufs);
+		VEC_INIT(&tx->savepoints);
+		VEC_INIT(&tx->freed_actions);
+		VEC_INIT(&tx->add_ranges);
+		VEC_INIT(&tx->snapshots);
+		tx->defer_snapshots = 0;
 		tx->redo_userbufs_capacity = 0;
 		PMDK_SLIST_INIT(&tx->tx_entries);
 		PMDK_SLIST_INIT(&tx->tx_locks);
@@ -754,8 +1727,19 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 		tx->pop = pop;
 
 		tx->first_snapshot = 1;
+		tx->nadds = 0;
+
+		tx->redo = 0;
+		tx->redo_writes = NULL;
+		tx->redo_nbytes = 0;
+
+		tx->write_combine = 0;
+		tx->wc_allocs = NULL;
+		tx->wc_writes = NULL;
 
 		tx->user_data = NULL;
+
+		tx->latency_start = STATS_LATENCY_START(pop->stats);
 	} else {
 		FATAL("Invalid stage %d to begin new transaction", tx->stage);
 	}
@@ -802,6 +1786,13 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 
 			tx->stage_callback = cb;
 			tx->stage_callback_arg = arg;
+		} else if (param_type == TX_PARAM_REDO) {
+			/* nested transactions inherit the outermost flavor */
+			if (PMDK_SLIST_NEXT(txd, tx_entry) == NULL)
+				tx->redo = 1;
+		} else if (param_type == TX_PARAM_WRITE_COMBINE) {
+			if (PMDK_SLIST_NEXT(txd, tx_entry) == NULL)
+				tx->write_combine = 1;
 		} else {
 			err = add_to_tx_and_lock(tx, param_type,
 				va_arg(argp, void *));
@@ -913,6 +1904,9 @@ obj_tx_abort(int errnum, int user)
 
 	ASSERT(tx->lane != NULL);
 
+	if (tx->commit_pending)
+		FATAL("transaction aborted after pmemobj_tx_commit_async");
+
 	if (errnum == 0)
 		errnum = ECANCELED;
 
@@ -971,6 +1965,151 @@ tx_post_commit(struct tx *tx)
 	operation_finish(tx->lane->undo, 0);
 }
 
+/*
+ * tx_group_join -- (internal) queues the pre-commit phase of the transaction
+ *	to be done by the group commit
+ */
+static void
+tx_group_join(struct tx *tx)
+{
+	struct tx_group *group = tx->pop->tx_params->group;
+
+	util_mutex_lock(&group->lock);
+
+	tx->group_done = 0;
+	int ret = VEC_PUSH_BACK(&group->pending, tx);
+
+	util_mutex_unlock(&group->lock);
+
+	if (ret != 0) {
+		/* the transaction can still commit on its own */
+		tx_pre_commit(tx);
+		pmemops_drain(&tx->pop->p_ops);
+		return;
+	}
+
+	tx->grouped = 1;
+}
+
+/*
+ * tx_group_wait -- (internal) waits until the pre-commit phase of the
+ *	transaction is done by the group commit
+ *
+ * The first waiting thread becomes the leader, which flushes the ranges of all
+ * of the transactions queued so far and issues a single drain for them. The
+ * transactions queued in the meantime are handled by the next leader.
+ */
+static void
+tx_group_wait(struct tx *tx)
+{
+	struct tx_group *group = tx->pop->tx_params->group;
+
+	util_mutex_lock(&group->lock);
+
+	while (!tx->group_done) {
+		if (group->leader) {
+			os_cond_wait(&group->cond, &group->lock);
+			continue;
+		}
+
+		group->leader = 1;
+
+		struct tx_batch batch = group->pending;
+		group->pending = group->flushing;
+		group->flushing = batch;
+
+		util_mutex_unlock(&group->lock);
+
+		struct tx *member;
+		VEC_FOREACH(member, &group->flushing)
+			tx_pre_commit(member);
+
+		pmemops_drain(&tx->pop->p_ops);
+
+		util_mutex_lock(&group->lock);
+
+		VEC_FOREACH(member, &group->flushing)
+			member->group_done = 1;
+		VEC_CLEAR(&group->flushing);
+
+		group->leader = 0;
+		os_cond_broadcast(&group->cond);
+	}
+
+	util_mutex_unlock(&group->lock);
+
+	tx->grouped = 0;
+}
+
+/*
+ * tx_commit_start -- (internal) runs the commit of the outermost transaction
+ *	up to its pre-commit phase, which is either done right away or queued
+ *	for the group commit
+ */
+static int
+tx_commit_start(struct tx *tx, int group)
+{
+	operation_start(tx->lane->external);
+
+	/*
+	 * Buffered writes have to be logged first, this is the last
+	 * point at which the transaction can still be aborted.
+	 */
+	if (tx_redo_log(tx) != 0) {
+		ERR("cannot log the buffered writes");
+		operation_cancel(tx->lane->external);
+		return -1;
+	}
+
+	if (group) {
+		tx_group_join(tx);
+	} else {
+		/* pre-commit phase */
+		tx_pre_commit(tx);
+
+		pmemops_drain(&tx->pop->p_ops);
+	}
+
+	tx->commit_pending = 1;
+
+	return 0;
+}
+
+/*
+ * tx_commit_finish -- (internal) finishes the commit of the outermost
+ *	transaction started by tx_commit_start
+ */
+static void
+tx_commit_finish(struct tx *tx)
+{
+	PMEMobjpool *pop = tx->pop;
+
+	if (tx->grouped)
+		tx_group_wait(tx);
+
+	tx->commit_pending = 0;
+
+	struct user_buffer_def *userbuf;
+	VEC_FOREACH_BY_PTR(userbuf, &tx->redo_userbufs)
+		operation_add_user_buffer(tx->lane->external, userbuf);
+
+	tx_cancel_freed_actions(tx);
+
+	palloc_publish(&pop->heap, VEC_ARR(&tx->actions),
+		VEC_SIZE(&tx->actions), tx->lane->external);
+
+	tx_redo_clear(tx);
+	tx_wc_clear(tx);
+
+	tx_post_commit(tx);
+
+	lane_release(pop);
+
+	tx->lane = NULL;
+
+	STATS_LATENCY_END(pop->stats, LATENCY_TX_COMMIT, tx->latency_start);
+}
+
 /*
  * pmemobj_tx_commit -- commits current transaction
  */
@@ -985,44 +2124,89 @@ pmemobj_tx_commit(void)
 	ASSERT_IN_TX(tx);
 	ASSERT_TX_STAGE_WORK(tx);
 
-	/* WORK */
+	/* the commit might have been started by pmemobj_tx_commit_async */
+	if (!tx->commit_pending) {
+		/* WORK */
+		obj_tx_callback(tx);
+
+		ASSERT(tx->lane != NULL);
+
+		struct tx_data *txd = PMDK_SLIST_FIRST(&tx->tx_entries);
+
+		/* only the outermost transaction is committed */
+		if (PMDK_SLIST_NEXT(txd, tx_entry) == NULL &&
+				tx_commit_start(tx,
+				tx->pop->tx_params->group_commit) != 0) {
+			PMEMOBJ_API_END();
+			obj_tx_abort(ENOMEM, 0);
+			return;
+		}
+	}
+
+	if (tx->commit_pending)
+		tx_commit_finish(tx);
+
+	tx->stage = TX_STAGE_ONCOMMIT;
+
+	/* ONCOMMIT */
 	obj_tx_callback(tx);
+	PMEMOBJ_API_END();
+}
 
-	ASSERT(tx->lane != NULL);
+/*
+ * pmemobj_tx_commit_async -- starts the commit of current transaction, which
+ *	shares the drain with the commits of other threads
+ */
+void
+pmemobj_tx_commit_async(void)
+{
+	LOG(3, NULL);
 
-	struct tx_data *txd = PMDK_SLIST_FIRST(&tx->tx_entries);
+	struct tx *tx = get_tx();
 
-	if (PMDK_SLIST_NEXT(txd, tx_entry) == NULL) {
-		/* this is the outermost transaction */
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
 
-		PMEMobjpool *pop = tx->pop;
+	if (tx->commit_pending)
+		return;
 
-		/* pre-commit phase */
-		tx_pre_commit(tx);
+	struct tx_data *txd = PMDK_SLIST_FIRST(&tx->tx_entries);
+	if (PMDK_SLIST_NEXT(txd, tx_entry) != NULL) {
+		/* nested transactions have nothing to wait for */
+		pmemobj_tx_commit();
+		return;
+	}
 
-		pmemops_drain(&pop->p_ops);
+	PMEMOBJ_API_START();
 
-		operation_start(tx->lane->external);
+	/* WORK */
+	obj_tx_callback(tx);
 
-		struct user_buffer_def *userbuf;
-		VEC_FOREACH_BY_PTR(userbuf, &tx->redo_userbufs)
-			operation_add_user_buffer(tx->lane->external, userbuf);
+	ASSERT(tx->lane != NULL);
 
-		palloc_publish(&pop->heap, VEC_ARR(&tx->actions),
-			VEC_SIZE(&tx->actions), tx->lane->external);
+	if (tx_commit_start(tx, 1) != 0) {
+		PMEMOBJ_API_END();
+		obj_tx_abort(ENOMEM, 0);
+		return;
+	}
 
-		tx_post_commit(tx);
+	PMEMOBJ_API_END();
+}
 
-		lane_release(pop);
+/*
+ * pmemobj_tx_wait -- completes the commit started by pmemobj_tx_commit_async
+ */
+void
+pmemobj_tx_wait(void)
+{
+	LOG(3, NULL);
 
-		tx->lane = NULL;
-	}
+	struct tx *tx = get_tx();
 
-	tx->stage = TX_STAGE_ONCOMMIT;
+	if (tx->stage != TX_STAGE_WORK || !tx->commit_pending)
+		return;
 
-	/* ONCOMMIT */
-	obj_tx_callback(tx);
-	PMEMOBJ_API_END();
+	pmemobj_tx_commit();
 }
 
 /*
@@ -1063,6 +2247,11 @@ pmemobj_tx_end(void)
 		tx->stage = TX_STAGE_NONE;
 		VEC_DELETE(&tx->actions);
 		VEC_DELETE(&tx->redo_userbufs);
+		tx_savepoints_truncate(tx, 0);
+		VEC_DELETE(&tx->savepoints);
+		VEC_DELETE(&tx->freed_actions);
+		VEC_DELETE(&tx->add_ranges);
+		VEC_DELETE(&tx->snapshots);
 
 		if (tx->stage_callback) {
 			pmemobj_tx_callback cb = tx->stage_callback;
@@ -1115,6 +2304,178 @@ pmemobj_tx_process(void)
 	}
 }
 
+/*
+ * tx_savepoint_copy_range -- (internal) copies a range of the transaction into
+ *	the savepoint
+ */
+static void
+tx_savepoint_copy_range(void *data, void *arg)
+{
+	struct pobj_tx_savepoint *sp = arg;
+	struct tx_range_def *range = data;
+
+	if (!sp->ranges_oom && VEC_PUSH_BACK(&sp->ranges, *range) != 0)
+		sp->ranges_oom = 1;
+}
+
+/*
+ * pmemobj_tx_savepoint -- marks the current state of the transaction
+ */
+struct pobj_tx_savepoint *
+pmemobj_tx_savepoint(void)
+{
+	LOG(3, NULL);
+
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	uint64_t flags = tx_abort_on_failure_flag(tx);
+
+	if (tx->redo) {
+		ERR("savepoints are not supported in redo transactions");
+		obj_tx_fail_err(ENOTSUP, flags);
+		return NULL;
+	}
+
+	if (tx->write_combine) {
+		ERR("savepoints are not supported in write-combining "
+			"transactions");
+		obj_tx_fail_err(ENOTSUP, flags);
+		return NULL;
+	}
+
+	PMEMOBJ_API_START();
+
+	struct pobj_tx_savepoint *sp = Malloc(sizeof(*sp));
+	if (sp == NULL) {
+		ERR("!Malloc");
+		goto err;
+	}
+
+	VEC_INIT(&sp->ranges);
+	sp->ranges_oom = 0;
+	sp->copies = ravl_new_sized(tx_redo_def_cmp,
+		sizeof(struct tx_redo_def));
+	if (sp->copies == NULL)
+		goto err_delete;
+
+	ravl_foreach(tx->ranges, tx_savepoint_copy_range, sp);
+	if (sp->ranges_oom)
+		goto err_delete;
+
+	if (VEC_PUSH_BACK(&tx->savepoints, sp) != 0)
+		goto err_delete;
+
+	operation_get_marker(tx->lane->undo, &sp->undo);
+	sp->nactions = VEC_SIZE(&tx->actions);
+	sp->nfreed = VEC_SIZE(&tx->freed_actions);
+	sp->nadds = tx->nadds;
+	sp->first_snapshot = tx->first_snapshot;
+
+	PMEMOBJ_API_END();
+	return sp;
+
+err_delete:
+	tx_savepoint_delete(sp);
+err:
+	PMEMOBJ_API_END();
+	obj_tx_fail_err(ENOMEM, flags);
+	return NULL;
+}
+
+/*
+ * pmemobj_tx_rollback_to -- reverts the changes made in the transaction after
+ *	the given savepoint
+ */
+int
+pmemobj_tx_rollback_to(struct pobj_tx_savepoint *sp)
+{
+	LOG(3, "sp %p", sp);
+
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	uint64_t flags = tx_abort_on_failure_flag(tx);
+
+	size_t pos;
+	VEC_FOREACH_BY_POS(pos, &tx->savepoints) {
+		if (*VEC_GET(&tx->savepoints, pos) == sp)
+			break;
+	}
+
+	if (pos == VEC_SIZE(&tx->savepoints)) {
+		ERR("invalid savepoint");
+		return obj_tx_fail_err(EINVAL, flags);
+	}
+
+	PMEMOBJ_API_START();
+
+	/*
+	 * The copies of older savepoints take precedence, and the snapshots
+	 * taken after the savepoint override all of them.
+	 */
+	for (size_t i = VEC_SIZE(&tx->savepoints); i > pos; --i) {
+		struct pobj_tx_savepoint *s = *VEC_GET(&tx->savepoints, i - 1);
+		ravl_foreach(s->copies, tx_savepoint_restore_copy, tx->pop);
+	}
+	pmemops_drain(&tx->pop->p_ops);
+
+	ravl_foreach(sp->copies, tx_redo_def_free, NULL);
+	ravl_clear(sp->copies);
+
+	/*
+	 * The copies were already restored, so the transaction can't continue
+	 * with the changes after the savepoint only partially reverted.
+	 */
+	if (operation_rollback_to(tx->lane->undo, &sp->undo,
+	    tx_undo_entry_apply, NULL) != 0) {
+		PMEMOBJ_API_END();
+		ERR("out of memory");
+		return obj_tx_fail_err(ENOMEM, 0);
+	}
+
+	palloc_cancel(&tx->pop->heap, VEC_GET(&tx->actions, sp->nactions),
+		VEC_SIZE(&tx->actions) - sp->nactions);
+	while (VEC_SIZE(&tx->actions) > sp->nactions)
+		tx_action_remove(tx);
+
+	while (VEC_SIZE(&tx->freed_actions) > sp->nfreed)
+		VEC_POP_BACK(&tx->freed_actions);
+
+	tx->nadds = sp->nadds;
+	tx->first_snapshot = sp->first_snapshot;
+	tx_lines_clear(tx);
+
+	int ret = 0;
+	ravl_clear(tx->ranges);
+
+	struct tx_range_def *range;
+	VEC_FOREACH_BY_PTR(range, &sp->ranges) {
+		ret = tx_lane_ranges_insert_def(tx->pop, tx, range);
+		if (ret != 0)
+			break;
+	}
+
+	tx_savepoints_truncate(tx, pos + 1);
+
+	PMEMOBJ_API_END();
+
+	/*
+	 * Without all of its ranges, the transaction could snapshot the same
+	 * memory twice, so it can't continue.
+	 */
+	if (ret != 0) {
+		ERR("out of memory");
+		return obj_tx_fail_err(ENOMEM, 0);
+	}
+
+	return 0;
+}
+
 /*
  * vg_verify_initialized -- when executed under Valgrind verifies that
  *   the buffer has been initialized; explicit check at snapshotting time,
@@ -1148,6 +2509,54 @@ vg_verify_initialized(PMEMobjpool *pop, const struct tx_range_def *def)
 #endif
 }
 
+/*
+ * tx_add_snapshot_compressed -- (internal) logs a snapshot, with the long runs
+ *	of zeroed cachelines replaced by fill entries
+ *
+ * Each fill entry takes up a single cacheline of the log, so runs shorter than
+ * TX_SNAPSHOT_ZERO_RUN_MIN, which would split the copied data into more
+ * entries for little gain, are copied as usual.
+ */
+static int
+tx_add_snapshot_compressed(struct tx *tx, char *ptr, size_t size)
+{
+	struct operation_context *ctx = tx->lane->undo;
+	char *end = ptr + size;
+	char *copy = ptr; /* the beginning of the data not logged yet */
+	char *line = (char *)ALIGN_UP((uintptr_t)ptr, CACHELINE_SIZE);
+
+	while (line + TX_SNAPSHOT_ZERO_RUN_MIN <= end) {
+		if (!pmdk_asan_is_zeroed(line, CACHELINE_SIZE)) {
+			line += CACHELINE_SIZE;
+			continue;
+		}
+
+		char *run = line;
+		do {
+			line += CACHELINE_SIZE;
+		} while (line + CACHELINE_SIZE <= end &&
+			pmdk_asan_is_zeroed(line, CACHELINE_SIZE));
+
+		if ((size_t)(line - run) < TX_SNAPSHOT_ZERO_RUN_MIN)
+			continue;
+
+		if (run != copy && operation_add_buffer(ctx, copy, copy,
+		    (size_t)(run - copy), ULOG_OPERATION_BUF_CPY) != 0)
+			return -1;
+
+		if (operation_add_fill(ctx, run, 0, (size_t)(line - run)) != 0)
+			return -1;
+
+		copy = line;
+	}
+
+	if (copy == end)
+		return 0;
+
+	return operation_add_buffer(ctx, copy, copy, (size_t)(end - copy),
+		ULOG_OPERATION_BUF_CPY);
+}
+
 /*
  * pmemobj_tx_add_snapshot -- (internal) creates a variably sized snapshot
  */
@@ -1186,6 +2595,15 @@ pmemobj_tx_add_snapshot(struct tx *tx, struct tx_range_def *snapshot)
 		tx->first_snapshot = 0;
 	}
 
+	size_t threshold = tx->pop->tx_params->snapshot_compress_threshold;
+	if (threshold != 0 && snapshot->size >= threshold)
+		return tx_add_snapshot_compressed(tx, ptr, snapshot->size);
+
+	if (tx->defer_snapshots) {
+		struct user_buffer_def buf = {ptr, snapshot->size};
+		return VEC_PUSH_BACK(&tx->snapshots, buf);
+	}
+
 	return operation_add_buffer(tx->lane->undo, ptr, ptr, snapshot->size,
 		ULOG_OPERATION_BUF_CPY);
 }
@@ -1228,6 +2646,19 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 		return obj_tx_fail_err(EINVAL, args->flags);
 	}
 
+	if (VEC_SIZE(&tx->savepoints) != 0 && tx_savepoint_add(tx, args) != 0) {
+		ERR("out of memory");
+		return obj_tx_fail_err(ENOMEM, args->flags);
+	}
+
+	/*
+	 * Transactions which add many, often overlapping, ranges track the
+	 * snapshotted bytes per cacheline, so that repeated additions are
+	 * recognized without walking the ranges tree.
+	 */
+	if (tx_lines_covered(tx, args->offset, args->size))
+		return 0;
+
 	int ret = 0;
 
 	/*
@@ -1279,6 +2710,7 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 				ASSERTeq(rend, fprev->offset);
 				fprev->offset -= r.size;
 				fprev->size += r.size;
+				pmemobj_tx_merge_flags(fprev, &r);
 			} else {
 				/*
 				 * If we don't have anything adjacent, create
@@ -1357,26 +2789,232 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 			r.size -= overlap;
 			pmemobj_tx_merge_flags(f, args);
 		} else {
-			ASSERT(0);
+			ASSERT(0);
+		}
+
+		nprev = n;
+	}
+
+	if (ret != 0) {
+		ERR("out of memory");
+		return obj_tx_fail_err(ENOMEM, args->flags);
+	}
+
+	/*
+	 * Only ranges without POBJ_XADD_NO_FLUSH are tracked, because adding
+	 * a range that lacks the flag clears it from the overlapping ones.
+	 */
+	size_t threshold = tx->pop->tx_params->snapshot_tracker_threshold;
+	if (threshold != 0 && ++tx->nadds >= threshold &&
+		!(args->flags & POBJ_XADD_NO_FLUSH))
+		tx_lines_mark(tx, args->offset, args->size);
+
+	return 0;
+}
+
+/*
+ * pmemobj_tx_add_range_direct -- adds persistent memory range into the
+ *					transaction
+ */
+int
+pmemobj_tx_add_range_direct_no_asan(const void *ptr, size_t size)
+{
+	LOG(3, NULL);
+
+	PMEMOBJ_API_START();
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	int ret;
+
+	uint64_t flags = tx_abort_on_failure_flag(tx);
+
+	if (!OBJ_PTR_FROM_POOL(tx->pop, ptr)) {
+		ERR("object outside of pool");
+		ret = obj_tx_fail_err(EINVAL, flags);
+		PMEMOBJ_API_END();
+		return ret;
+	}
+
+	struct tx_range_def args = {
+		.offset = (uint64_t)((char *)ptr - (char *)tx->pop),
+		.size = size,
+		.flags = flags,
+	};
+
+	ret = pmemobj_tx_add_common(tx, &args);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_tx_xadd_range_direct -- adds persistent memory range into the
+ *					transaction
+ */
+int
+pmemobj_tx_xadd_range_direct_no_asan(const void *ptr, size_t size, uint64_t flags)
+{
+	LOG(3, NULL);
+
+	PMEMOBJ_API_START();
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	int ret;
+
+	flags |= tx_abort_on_failure_flag(tx);
+
+	if (flags & ~POBJ_XADD_VALID_FLAGS) {
+		ERR("unknown flags 0x%" PRIx64, flags
+			& ~POBJ_XADD_VALID_FLAGS);
+		ret = obj_tx_fail_err(EINVAL, flags);
+		PMEMOBJ_API_END();
+		return ret;
+	}
+
+	if (!OBJ_PTR_FROM_POOL(tx->pop, ptr)) {
+		ERR("object outside of pool");
+		ret = obj_tx_fail_err(EINVAL, flags);
+		PMEMOBJ_API_END();
+		return ret;
+	}
+
+	struct tx_range_def args = {
+		.offset = (uint64_t)((char *)ptr - (char *)tx->pop),
+		.size = size,
+		.flags = flags,
+	};
+
+	ret = pmemobj_tx_add_common(tx, &args);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_tx_add_ranges -- adds a series of persistent memory ranges into the
+ *	transaction
+ */
+int
+pmemobj_tx_add_ranges_no_asan(const struct pobj_tx_range *ranges,
+	size_t nranges)
+{
+	LOG(3, "nranges %zu", nranges);
+
+	PMEMOBJ_API_START();
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	int ret = 0;
+
+	/*
+	 * A failure aborts the transaction unless the range which caused it
+	 * has the NO_ABORT flag.
+	 */
+	uint64_t tx_flags = tx_abort_on_failure_flag(tx);
+
+	VEC_CLEAR(&tx->add_ranges);
+	for (size_t i = 0; i < nranges; ++i) {
+		const struct pobj_tx_range *r = &ranges[i];
+		uint64_t flags = tx_flags | (r->flags & POBJ_XADD_NO_ABORT);
+
+		if (r->flags & ~POBJ_XADD_VALID_FLAGS) {
+			ERR("unknown flags 0x%" PRIx64, r->flags
+				& ~POBJ_XADD_VALID_FLAGS);
+			ret = obj_tx_fail_err(EINVAL, flags);
+			PMEMOBJ_API_END();
+			return ret;
+		}
+
+		if (!OBJ_PTR_FROM_POOL(tx->pop, r->ptr)) {
+			ERR("object outside of pool");
+			ret = obj_tx_fail_err(EINVAL, flags);
+			PMEMOBJ_API_END();
+			return ret;
+		}
+
+		if (r->size == 0)
+			continue;
+
+		struct tx_range_def def = {
+			.offset = (uint64_t)((char *)r->ptr - (char *)tx->pop),
+			.size = r->size,
+			.flags = r->flags | tx_flags,
+		};
+
+		if (VEC_PUSH_BACK(&tx->add_ranges, def) != 0) {
+			ERR("out of memory");
+			ret = obj_tx_fail_err(ENOMEM, flags);
+			PMEMOBJ_API_END();
+			return ret;
+		}
+	}
+
+	/* overlapping and adjacent ranges with equal flags are merged */
+	qsort(VEC_ARR(&tx->add_ranges), VEC_SIZE(&tx->add_ranges),
+		sizeof(struct tx_range_def), tx_range_def_cmp);
+
+	size_t nmerged = 0;
+	struct tx_range_def *def;
+	VEC_FOREACH_BY_PTR(def, &tx->add_ranges) {
+		struct tx_range_def *last = nmerged == 0 ? NULL :
+			VEC_GET(&tx->add_ranges, nmerged - 1);
+		if (last != NULL && last->flags == def->flags &&
+			def->offset <= last->offset + last->size) {
+			last->size = MAX(last->offset + last->size,
+				def->offset + def->size) - last->offset;
+		} else {
+			*VEC_GET(&tx->add_ranges, nmerged++) = *def;
 		}
+	}
 
-		nprev = n;
+	/*
+	 * The snapshots are only collected while the ranges are added, so that
+	 * they can be logged at once. Neither of the steps may abort midway,
+	 * because the transaction has to be left in a consistent state first.
+	 */
+	uint64_t fail_flags = 0;
+	tx->defer_snapshots = 1;
+	VEC_CLEAR(&tx->snapshots);
+	for (size_t i = 0; i < nmerged; ++i) {
+		def = VEC_GET(&tx->add_ranges, i);
+		fail_flags = def->flags;
+		def->flags |= POBJ_XADD_NO_ABORT;
+		ret = pmemobj_tx_add_common(tx, def);
+		if (ret != 0)
+			break;
 	}
+	tx->defer_snapshots = 0;
 
-	if (ret != 0) {
+	/*
+	 * The collected snapshots belong to ranges which are already part of
+	 * the transaction, so they have to be logged even after a failure.
+	 */
+	if (VEC_SIZE(&tx->snapshots) != 0 &&
+		operation_add_buffers(tx->lane->undo, VEC_ARR(&tx->snapshots),
+		VEC_SIZE(&tx->snapshots), ULOG_OPERATION_BUF_CPY) != 0) {
 		ERR("out of memory");
-		return obj_tx_fail_err(ENOMEM, args->flags);
+		ret = obj_tx_fail_err(ENOMEM, 0);
+	} else if (ret != 0) {
+		ret = obj_tx_fail_err(ret, fail_flags);
 	}
 
-	return 0;
+	PMEMOBJ_API_END();
+	return ret;
 }
 
 /*
- * pmemobj_tx_add_range_direct -- adds persistent memory range into the
- *					transaction
+ * pmemobj_tx_write -- writes data to persistent memory within the transaction
  */
 int
-pmemobj_tx_add_range_direct_no_asan(const void *ptr, size_t size)
+pmemobj_tx_write_no_asan(void *ptr, const void *src, size_t size)
 {
 	LOG(3, NULL);
 
@@ -1403,18 +3041,40 @@ pmemobj_tx_add_range_direct_no_asan(const void *ptr, size_t size)
 		.flags = flags,
 	};
 
-	ret = pmemobj_tx_add_common(tx, &args);
+	if (tx->write_combine && size != 0 &&
+	    tx_wc_covered(tx, args.offset, size)) {
+		tx_wc_write(tx, &args, src);
+		ret = 0;
+	} else if (tx->redo && !tx_range_overlaps(tx, args.offset, size)) {
+		ret = tx_redo_write(tx, &args, src);
+	} else {
+		/*
+		 * Ranges that are already in the transaction, most notably
+		 * objects allocated by it, may be modified in place, and
+		 * buffered data would overwrite those modifications on commit.
+		 * So a redo write which overlaps them, even partially, has its
+		 * remaining part snapshotted and is made in place as well.
+		 * Buffered data for the same range, if any, is kept in sync
+		 * since it's applied on commit.
+		 */
+		ret = pmemobj_tx_add_common(tx, &args);
+		if (ret == 0) {
+			memcpy(ptr, src, size);
+			tx_redo_copy(tx->redo_writes, args.offset,
+				(char *)src, size, 1);
+		}
+	}
 
 	PMEMOBJ_API_END();
 	return ret;
 }
 
 /*
- * pmemobj_tx_xadd_range_direct -- adds persistent memory range into the
- *					transaction
+ * pmemobj_tx_read -- reads persistent memory within the transaction,
+ *	including the writes buffered by it
  */
 int
-pmemobj_tx_xadd_range_direct_no_asan(const void *ptr, size_t size, uint64_t flags)
+pmemobj_tx_read_no_asan(const void *ptr, void *dst, size_t size)
 {
 	LOG(3, NULL);
 
@@ -1424,32 +3084,19 @@ pmemobj_tx_xadd_range_direct_no_asan(const void *ptr, size_t size, uint64_t flag
 	ASSERT_IN_TX(tx);
 	ASSERT_TX_STAGE_WORK(tx);
 
-	int ret;
-
-	flags |= tx_abort_on_failure_flag(tx);
-
-	if (flags & ~POBJ_XADD_VALID_FLAGS) {
-		ERR("unknown flags 0x%" PRIx64, flags
-			& ~POBJ_XADD_VALID_FLAGS);
-		ret = obj_tx_fail_err(EINVAL, flags);
-		PMEMOBJ_API_END();
-		return ret;
-	}
+	int ret = 0;
 
 	if (!OBJ_PTR_FROM_POOL(tx->pop, ptr)) {
 		ERR("object outside of pool");
-		ret = obj_tx_fail_err(EINVAL, flags);
+		ret = obj_tx_fail_err(EINVAL, tx_abort_on_failure_flag(tx));
 		PMEMOBJ_API_END();
 		return ret;
 	}
 
-	struct tx_range_def args = {
-		.offset = (uint64_t)((char *)ptr - (char *)tx->pop),
-		.size = size,
-		.flags = flags,
-	};
-
-	ret = pmemobj_tx_add_common(tx, &args);
+	uint64_t offset = (uint64_t)((char *)ptr - (char *)tx->pop);
+	memcpy(dst, ptr, size);
+	tx_redo_copy(tx->redo_writes, offset, dst, size, 0);
+	tx_redo_copy(tx->wc_writes, offset, dst, size, 0);
 
 	PMEMOBJ_API_END();
 	return ret;
@@ -1849,6 +3496,7 @@ pmemobj_tx_xfree_no_asan(PMEMoid oid, uint64_t flags)
 	ASSERT(OBJ_OID_IS_VALID(pop, oid));
 
 	PMEMOBJ_API_START();
+	uint64_t start = STATS_LATENCY_START(pop->stats);
 
 	struct pobj_action *action;
 
@@ -1864,13 +3512,25 @@ pmemobj_tx_xfree_no_asan(PMEMoid oid, uint64_t flags)
 		VEC_FOREACH_BY_PTR(action, &tx->actions) {
 			if (action->type == POBJ_ACTION_TYPE_HEAP &&
 				action->heap.offset == oid.off) {
+				size_t usable_size = action->heap.usable_size;
+				if (tx_action_cancel_alloc(tx, action) != 0) {
+					int ret = obj_tx_fail_err(ENOMEM,
+						flags);
+					PMEMOBJ_API_END();
+					return ret;
+				}
+
+				tx_wc_alloc_remove(tx, oid.off, usable_size);
+
 				struct tx_range_def *r = ravl_data(n);
 				void *ptr = OBJ_OFF_TO_PTR(pop, r->offset);
 				VALGRIND_SET_CLEAN(ptr, r->size);
 				VALGRIND_REMOVE_FROM_TX(ptr, r->size);
 				ravl_remove(tx->ranges, n);
-				palloc_cancel(&pop->heap, action, 1);
-				VEC_ERASE_BY_PTR(&tx->actions, action);
+				/* the object no longer covers its range */
+				tx_lines_clear(tx);
+				STATS_LATENCY_END(pop->stats, LATENCY_FREE,
+					start);
 				PMEMOBJ_API_END();
 				return 0;
 			}
@@ -1886,6 +3546,7 @@ pmemobj_tx_xfree_no_asan(PMEMoid oid, uint64_t flags)
 
 	palloc_defer_free(&pop->heap, oid.off, action);
 
+	STATS_LATENCY_END(pop->stats, LATENCY_FREE, start);
 	PMEMOBJ_API_END();
 	return 0;
 }
@@ -2386,9 +4047,324 @@ static const struct ctl_node CTL_NODE(post_commit)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * CTL_READ_HANDLER(tracker_threshold) -- returns the number of ranges added
+ *	in a transaction after which the snapshot tracker is used
+ */
+static int
+CTL_READ_HANDLER(tracker_threshold)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)pop->tx_params->snapshot_tracker_threshold;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(tracker_threshold) -- sets the number of ranges added
+ *	in a transaction after which the snapshot tracker is used
+ */
+static int
+CTL_WRITE_HANDLER(tracker_threshold)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in < 0) {
+		errno = EINVAL;
+		ERR("invalid snapshot tracker threshold, must not be negative");
+		return -1;
+	}
+
+	pop->tx_params->snapshot_tracker_threshold = (size_t)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(tracker_threshold) =
+	CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(compress_threshold) -- returns the size of a snapshot
+ *	from which its runs of zeroes are compressed
+ */
+static int
+CTL_READ_HANDLER(compress_threshold)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)pop->tx_params->snapshot_compress_threshold;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(compress_threshold) -- sets the size of a snapshot
+ *	from which its runs of zeroes are compressed
+ */
+static int
+CTL_WRITE_HANDLER(compress_threshold)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	long long arg_in = *(long long *)arg;
+
+	if (arg_in < 0) {
+		errno = EINVAL;
+		ERR("invalid snapshot compression threshold, "
+			"must not be negative");
+		return -1;
+	}
+
+	/* the fill entries can't be recovered by older versions */
+	features_t f_ulog_fill = FEAT_INCOMPAT(ULOG_FILL);
+	if (arg_in != 0 && obj_feature_enable(pop, f_ulog_fill) != 0)
+		return -1;
+
+	pop->tx_params->snapshot_compress_threshold = (size_t)arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(compress_threshold) =
+	CTL_ARG_LONG_LONG;
+
+static const struct ctl_node CTL_NODE(snapshot)[] = {
+	CTL_LEAF_RW(tracker_threshold),
+	CTL_LEAF_RW(compress_threshold),
+
+	CTL_NODE_END
+};
+
+/*
+ * tx_ctl_lane_prealloc -- (internal) validates the capacity of the logs
+ *	preallocated in every lane, stores it and extends the logs
+ */
+static int
+tx_ctl_lane_prealloc(PMEMobjpool *pop, enum ctl_query_source source,
+	size_t *capacity, long long arg_in)
+{
+	if (arg_in < 0 || arg_in > (long long)PMEMOBJ_MAX_ALLOC_SIZE) {
+		errno = EINVAL;
+		ERR("invalid log capacity, must be between 0 and max alloc "
+			"size");
+		return -1;
+	}
+
+	*capacity = (size_t)arg_in;
+
+	/*
+	 * Values loaded from the configuration are applied once the pool
+	 * is fully opened.
+	 */
+	if (source == CTL_QUERY_CONFIG_INPUT)
+		return 0;
+
+	return lane_prealloc(pop);
+}
+
+/*
+ * CTL_READ_HANDLER(undo_prealloc) -- returns the capacity of the undo log
+ *	preallocated in every lane
+ */
+static int
+CTL_READ_HANDLER(undo_prealloc)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)pop->tx_params->undo_prealloc;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(undo_prealloc) -- sets and preallocates the capacity of
+ *	the undo log in every lane
+ */
+static int
+CTL_WRITE_HANDLER(undo_prealloc)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	return tx_ctl_lane_prealloc(pop, source,
+		&pop->tx_params->undo_prealloc, *(long long *)arg);
+}
+
+static const struct ctl_argument CTL_ARG(undo_prealloc) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(redo_prealloc) -- returns the capacity of the external
+ *	redo log preallocated in every lane
+ */
+static int
+CTL_READ_HANDLER(redo_prealloc)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)pop->tx_params->redo_prealloc;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(redo_prealloc) -- sets and preallocates the capacity of
+ *	the external redo log in every lane
+ */
+static int
+CTL_WRITE_HANDLER(redo_prealloc)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	return tx_ctl_lane_prealloc(pop, source,
+		&pop->tx_params->redo_prealloc, *(long long *)arg);
+}
+
+static const struct ctl_argument CTL_ARG(redo_prealloc) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(assignment) -- returns how the lanes are assigned to
+ *	threads
+ */
+static int
+CTL_READ_HANDLER(assignment)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	enum pobj_lane_assignment *arg_out = arg;
+
+	*arg_out = pop->lanes_desc.assignment;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(assignment) -- sets how the lanes are assigned to threads
+ */
+static int
+CTL_WRITE_HANDLER(assignment)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	enum pobj_lane_assignment arg_in = *(enum pobj_lane_assignment *)arg;
+
+	if (arg_in != POBJ_LANE_ASSIGNMENT_THREAD &&
+	    arg_in != POBJ_LANE_ASSIGNMENT_CPU) {
+		errno = EINVAL;
+		ERR("invalid lane assignment");
+		return -1;
+	}
+
+	pop->lanes_desc.assignment = arg_in;
+
+	return 0;
+}
+
+/*
+ * tx_lane_assignment_parser -- parses the lane assignment mode
+ */
+static int
+tx_lane_assignment_parser(const void *arg, void *dest, size_t dest_size)
+{
+	const char *vstr = arg;
+	enum pobj_lane_assignment *assignment = dest;
+	ASSERTeq(dest_size, sizeof(enum pobj_lane_assignment));
+
+	if (strcmp(vstr, "thread") == 0) {
+		*assignment = POBJ_LANE_ASSIGNMENT_THREAD;
+	} else if (strcmp(vstr, "cpu") == 0) {
+		*assignment = POBJ_LANE_ASSIGNMENT_CPU;
+	} else {
+		ERR("invalid lane assignment");
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(assignment) = {
+	.dest_size = sizeof(enum pobj_lane_assignment),
+	.parsers = {
+		CTL_ARG_PARSER(sizeof(enum pobj_lane_assignment),
+			tx_lane_assignment_parser),
+		CTL_ARG_PARSER_END
+	}
+};
+
+/*
+ * CTL_READ_HANDLER(group) -- returns whether the commits are grouped
+ */
+static int
+CTL_READ_HANDLER(group)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = pop->tx_params->group_commit;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(group) -- enables or disables grouping of the commits
+ */
+static int
+CTL_WRITE_HANDLER(group)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	pop->tx_params->group_commit = arg_in;
+
+	return 0;
+}
+
+static const struct ctl_argument CTL_ARG(group) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(commit)[] = {
+	CTL_LEAF_RW(group),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(lane)[] = {
+	CTL_LEAF_RW(undo_prealloc),
+	CTL_LEAF_RW(redo_prealloc),
+	CTL_LEAF_RW(assignment),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(tx)[] = {
 	CTL_CHILD(debug),
 	CTL_CHILD(cache),
+	CTL_CHILD(snapshot),
+	CTL_CHILD(lane),
+	CTL_CHILD(commit),
 	CTL_CHILD(post_commit),
 
 	CTL_NODE_END
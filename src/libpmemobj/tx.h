@@ -17,6 +17,8 @@ extern "C" {
 #endif
 
 #define TX_DEFAULT_RANGE_CACHE_SIZE (1 << 15)
+#define TX_DEFAULT_SNAPSHOT_TRACKER_THRESHOLD 64
+#define TX_SNAPSHOT_ZERO_RUN_MIN (4 * CACHELINE_SIZE)
 #define TX_DEFAULT_RANGE_CACHE_THRESHOLD (1 << 12)
 
 #define TX_RANGE_MASK (8ULL - 1)
@@ -32,8 +34,16 @@ extern "C" {
 #define TX_INTENT_LOG_BUFFER_OVERHEAD sizeof(struct ulog)
 #define TX_INTENT_LOG_ENTRY_OVERHEAD sizeof(struct ulog_entry_val)
 
+struct tx_group;
+
 struct tx_parameters {
 	size_t cache_size;
+	size_t snapshot_tracker_threshold; /* 0 disables the tracker */
+	size_t snapshot_compress_threshold; /* 0 disables the compression */
+	size_t undo_prealloc; /* undo log capacity kept by every lane */
+	size_t redo_prealloc; /* redo log capacity kept by every lane */
+	int group_commit; /* commits share the drain of concurrent ones */
+	struct tx_group *group; /* commits waiting for the shared drain */
 };
 
 /*
@@ -65,6 +75,13 @@ int
 pmemobj_tx_add_range_direct_no_asan(const void *ptr, size_t size);
 int
 pmemobj_tx_xadd_range_direct_no_asan(const void *ptr, size_t size, uint64_t flags);
+int
+pmemobj_tx_add_ranges_no_asan(const struct pobj_tx_range *ranges,
+	size_t nranges);
+int
+pmemobj_tx_write_no_asan(void *ptr, const void *src, size_t size);
+int
+pmemobj_tx_read_no_asan(const void *ptr, void *dst, size_t size);
 
 #ifdef __cplusplus
 }
@@ -85,6 +85,8 @@ ulog_entry_size(const struct ulog_entry_base *entry)
 		case ULOG_OPERATION_SET:
 			return sizeof(struct ulog_entry_val);
 		case ULOG_OPERATION_BUF_SET:
+			return CACHELINE_ALIGN(
+				sizeof(struct ulog_entry_buf) + 1);
 		case ULOG_OPERATION_BUF_CPY:
 			eb = (struct ulog_entry_buf *)entry;
 			return CACHELINE_ALIGN(
@@ -217,6 +219,25 @@ ulog_capacity(struct ulog *ulog, size_t ulog_base_bytes,
 	return capacity;
 }
 
+/*
+ * ulog_by_capacity -- returns the last ulog needed for the given capacity,
+ *	or the last ulog if the entire chain is smaller than that
+ */
+struct ulog *
+ulog_by_capacity(struct ulog *ulog, size_t ulog_base_bytes,
+	size_t capacity, const struct pmem_ops *p_ops)
+{
+	size_t total = ulog_base_bytes;
+	struct ulog *next;
+
+	while (total < capacity && (next = ulog_next(ulog, p_ops)) != NULL) {
+		ulog = next;
+		total += ulog->capacity;
+	}
+
+	return ulog;
+}
+
 /*
  * ulog_rebuild_next_vec -- rebuilds the vector of next entries
  */
@@ -231,13 +252,14 @@ ulog_rebuild_next_vec(struct ulog *ulog, struct ulog_next *next,
 }
 
 /*
- * ulog_reserve -- reserves new capacity in the ulog
+ * ulog_reserve -- reserves new capacity in the ulog, the logs it allocates
+ *	are at least extend_size bytes large
  */
 int
 ulog_reserve(struct ulog *ulog,
 	size_t ulog_base_nbytes, size_t gen_num,
 	int auto_reserve, size_t *new_capacity,
-	ulog_extend_fn extend, struct ulog_next *next,
+	ulog_extend_fn extend, size_t extend_size, struct ulog_next *next,
 	const struct pmem_ops *p_ops)
 {
 	if (!auto_reserve) {
@@ -256,7 +278,8 @@ ulog_reserve(struct ulog *ulog,
 	}
 
 	while (capacity < *new_capacity) {
-		if (extend(p_ops->base, &ulog->next, gen_num) != 0)
+		if (extend(p_ops->base, &ulog->next, gen_num,
+		    extend_size) != 0)
 			return -1;
 		VEC_PUSH_BACK(next, ulog->next);
 		ulog = ulog_next(ulog, p_ops);
@@ -401,27 +424,33 @@ ulog_entry_val_create(struct ulog *ulog, size_t offset, uint64_t *dest,
 
 /*
  * ulog_clobber_entry -- zeroes out a single log entry header
+ *
+ * With PMEMOBJ_F_MEM_NODRAIN in flags, the caller is responsible for the drain.
  */
 void
 ulog_clobber_entry(const struct ulog_entry_base *e,
-	const struct pmem_ops *p_ops)
+	const struct pmem_ops *p_ops, unsigned flags)
 {
 	static const size_t aligned_entry_size =
 		CACHELINE_ALIGN(sizeof(struct ulog_entry_base));
 
 	VALGRIND_ADD_TO_TX(e, aligned_entry_size);
 	pmemops_memset(p_ops, (char *)e, 0, aligned_entry_size,
-		PMEMOBJ_F_MEM_NONTEMPORAL);
+		PMEMOBJ_F_MEM_NONTEMPORAL | flags);
 	VALGRIND_REMOVE_FROM_TX(e, aligned_entry_size);
 }
 
 /*
  * ulog_entry_buf_create -- atomically creates a buffer entry in the log
+ *
+ * With PMEMOBJ_F_MEM_NODRAIN in flags, the caller is responsible for the drain.
+ * For ULOG_OPERATION_BUF_SET, src points to the single fill byte.
  */
 struct ulog_entry_buf *
 ulog_entry_buf_create(struct ulog *ulog, size_t offset, uint64_t gen_num,
 		uint64_t *dest, const void *src, uint64_t size,
-		ulog_operation_type type, const struct pmem_ops *p_ops)
+		ulog_operation_type type, const struct pmem_ops *p_ops,
+		unsigned flags)
 {
 	struct ulog_entry_buf *e =
 		(struct ulog_entry_buf *)(ulog->data + offset);
@@ -447,6 +476,9 @@ ulog_entry_buf_create(struct ulog *ulog, size_t offset, uint64_t gen_num,
 	b->size = size;
 	b->checksum = 0;
 
+	if (type == ULOG_OPERATION_BUF_SET)
+		size = 1;
+
 	size_t bdatasize = CACHELINE_SIZE - sizeof(struct ulog_entry_buf);
 	size_t ncopy = MIN(size, bdatasize);
 	pmdk_asan_memcpy(b->data, src, ncopy); // We do an asan-exempt memcpy here, because we use tx_add to add changes to the persistent shadow memory, which is marked inaccessible in the shadow memory.
@@ -501,7 +533,8 @@ ulog_entry_buf_create(struct ulog *ulog, size_t offset, uint64_t gen_num,
 		PMEMOBJ_F_MEM_NODRAIN | PMEMOBJ_F_MEM_NONTEMPORAL);
 	VALGRIND_REMOVE_FROM_TX(e, CACHELINE_SIZE);
 
-	pmemops_drain(p_ops);
+	if (!(flags & PMEMOBJ_F_MEM_NODRAIN))
+		pmemops_drain(p_ops);
 
 	/*
 	 * Allow having uninitialized data in the buffer - this requires marking
@@ -520,6 +553,45 @@ ulog_entry_buf_create(struct ulog *ulog, size_t offset, uint64_t gen_num,
 	return e;
 }
 
+/*
+ * ulog_entry_buf_create_transient -- creates a buffer entry in a DRAM
+ *	resident log, such as the shadow copy of a redo log
+ *
+ * The entry, including its checksum, is identical to the one created by
+ * ulog_entry_buf_create, so that the log can later be stored as a whole.
+ * The header of the entry that follows is zeroed.
+ * For ULOG_OPERATION_BUF_SET, src points to the single fill byte.
+ */
+struct ulog_entry_buf *
+ulog_entry_buf_create_transient(struct ulog *ulog, size_t offset,
+		uint64_t gen_num, uint64_t *dest, const void *src,
+		uint64_t size, ulog_operation_type type,
+		const struct pmem_ops *p_ops)
+{
+	struct ulog_entry_buf *e =
+		(struct ulog_entry_buf *)(ulog->data + offset);
+	size_t ndata = type == ULOG_OPERATION_BUF_SET ? 1 : size;
+	size_t entry_size = CACHELINE_ALIGN(sizeof(*e) + ndata);
+
+	e->base.offset = (uint64_t)(dest) - (uint64_t)p_ops->base;
+	e->base.offset |= ULOG_OPERATION(type);
+	e->size = size;
+	e->checksum = 0;
+
+	memcpy(e->data, src, ndata);
+	memset(e->data + ndata, 0, entry_size - sizeof(*e) - ndata);
+
+	e->checksum = util_checksum_compute(e, entry_size, &e->checksum, 0);
+	e->checksum = util_checksum_seq(&gen_num, sizeof(gen_num),
+		e->checksum);
+
+	struct ulog_entry_base *next =
+		(struct ulog_entry_base *)((char *)e + entry_size);
+	next->offset = 0;
+
+	return e;
+}
+
 /*
  * ulog_entry_apply -- applies modifications of a single ulog entry
  */
@@ -709,7 +781,7 @@ ulog_clobber(struct ulog *dest, struct ulog_next *next,
  */
 int
 ulog_clobber_data(struct ulog *ulog_first,
-	size_t nbytes, size_t ulog_base_nbytes,
+	size_t nbytes, size_t ulog_base_nbytes, size_t keep_nbytes,
 	struct ulog_next *next, ulog_free_fn ulog_free,
 	ulog_rm_user_buffer_fn user_buff_remove,
 	const struct pmem_ops *p_ops, unsigned flags)
@@ -766,10 +838,25 @@ ulog_clobber_data(struct ulog *ulog_first,
 		 * each transaction is an acceptable overhead for the average
 		 * case.
 		 */
-		if (flags & ULOG_FREE_AFTER_FIRST)
+		if (flags & ULOG_FREE_AFTER_FIRST) {
 			u = ulog_first;
-		else
+		} else {
 			u = ulog_second;
+		}
+
+		/*
+		 * The logs preallocated for the lane are kept as well, and so
+		 * their gen_nums have to follow the first ulog, just like the
+		 * one of the second ulog.
+		 */
+		struct ulog *last = u == ulog_second &&
+			!(flags & ULOG_ANY_USER_BUFFER) ?
+			ulog_by_capacity(ulog_first, ulog_base_nbytes,
+				keep_nbytes, p_ops) : u;
+		while (u != NULL && u != last && last != ulog_first) {
+			u = ulog_next(u, p_ops);
+			ulog_inc_gen_num(u, NULL);
+		}
 	}
 
 	if (u == NULL)
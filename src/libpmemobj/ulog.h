@@ -76,6 +76,7 @@ typedef uint64_t ulog_operation_type;
 #define ULOG_OPERATION_SET		(0b000ULL << 61ULL)
 #define ULOG_OPERATION_AND		(0b001ULL << 61ULL)
 #define ULOG_OPERATION_OR		(0b010ULL << 61ULL)
+/* only the fill byte of a buffer set entry is stored in the log */
 #define ULOG_OPERATION_BUF_SET		(0b101ULL << 61ULL)
 #define ULOG_OPERATION_BUF_CPY		(0b110ULL << 61ULL)
 
@@ -89,7 +90,8 @@ typedef uint64_t ulog_operation_type;
 #define ULOG_ANY_USER_BUFFER (1U << 2)
 
 typedef int (*ulog_check_offset_fn)(void *ctx, uint64_t offset);
-typedef int (*ulog_extend_fn)(void *, uint64_t *, uint64_t);
+/* the last argument is the minimum capacity of the new log, 0 by default */
+typedef int (*ulog_extend_fn)(void *, uint64_t *, uint64_t, size_t);
 typedef int (*ulog_entry_cb)(struct ulog_entry_base *e, void *arg,
 	const struct pmem_ops *p_ops);
 typedef void (*ulog_free_fn)(void *base, uint64_t *next);
@@ -102,6 +104,8 @@ void ulog_construct(uint64_t offset, size_t capacity, uint64_t gen_num,
 
 size_t ulog_capacity(struct ulog *ulog, size_t ulog_base_bytes,
 	const struct pmem_ops *p_ops);
+struct ulog *ulog_by_capacity(struct ulog *ulog, size_t ulog_base_bytes,
+	size_t capacity, const struct pmem_ops *p_ops);
 void ulog_rebuild_next_vec(struct ulog *ulog, struct ulog_next *next,
 	const struct pmem_ops *p_ops);
 
@@ -111,7 +115,7 @@ int ulog_foreach_entry(struct ulog *ulog,
 int ulog_reserve(struct ulog *ulog,
 	size_t ulog_base_nbytes, size_t gen_num,
 	int auto_reserve, size_t *new_capacity_bytes,
-	ulog_extend_fn extend, struct ulog_next *next,
+	ulog_extend_fn extend, size_t extend_size, struct ulog_next *next,
 	const struct pmem_ops *p_ops);
 
 void ulog_store(struct ulog *dest,
@@ -125,12 +129,12 @@ int ulog_free_next(struct ulog *u, const struct pmem_ops *p_ops,
 void ulog_clobber(struct ulog *dest, struct ulog_next *next,
 	const struct pmem_ops *p_ops);
 int ulog_clobber_data(struct ulog *dest,
-	size_t nbytes, size_t ulog_base_nbytes,
+	size_t nbytes, size_t ulog_base_nbytes, size_t keep_nbytes,
 	struct ulog_next *next, ulog_free_fn ulog_free,
 	ulog_rm_user_buffer_fn user_buff_remove,
 	const struct pmem_ops *p_ops, unsigned flags);
 void ulog_clobber_entry(const struct ulog_entry_base *e,
-	const struct pmem_ops *p_ops);
+	const struct pmem_ops *p_ops, unsigned flags);
 
 void ulog_process(struct ulog *ulog, ulog_check_offset_fn check,
 	const struct pmem_ops *p_ops);
@@ -150,6 +154,12 @@ struct ulog_entry_val *ulog_entry_val_create(struct ulog *ulog,
 
 struct ulog_entry_buf *
 ulog_entry_buf_create(struct ulog *ulog, size_t offset,
+	uint64_t gen_num, uint64_t *dest, const void *src, uint64_t size,
+	ulog_operation_type type, const struct pmem_ops *p_ops,
+	unsigned flags);
+
+struct ulog_entry_buf *
+ulog_entry_buf_create_transient(struct ulog *ulog, size_t offset,
 	uint64_t gen_num, uint64_t *dest, const void *src, uint64_t size,
 	ulog_operation_type type, const struct pmem_ops *p_ops);
 
@@ -66,6 +66,43 @@ prefault_fun(int prefault, fun get_func, fun set_func)
 		ret = get_func(NULL, "prefault.at_create", &arg_read);
 		UT_ASSERTeq(ret, 0);
 		UT_ASSERTeq(arg_read, 1);
+	} else if (prefault == 3) { /* prefault at open in many threads */
+		prefault_fun(1, get_func, set_func);
+
+		arg_read = -1;
+		ret = get_func(NULL, "prefault.threads", &arg_read);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERTeq(arg_read, 1);
+
+		arg = -1;
+		ret = set_func(NULL, "prefault.threads", &arg);
+		UT_ASSERTeq(ret, -1);
+		UT_ASSERTeq(errno, EINVAL);
+
+		arg = 4;
+		ret = set_func(NULL, "prefault.threads", &arg);
+		UT_ASSERTeq(ret, 0);
+
+		arg_read = -1;
+		ret = get_func(NULL, "prefault.threads", &arg_read);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERTeq(arg_read, 4);
+
+		ssize_t granularity = 0;
+		ret = set_func(NULL, "prefault.granularity", &granularity);
+		UT_ASSERTeq(ret, -1);
+		UT_ASSERTeq(errno, EINVAL);
+
+		/* not a multiple of the page size */
+		granularity = 100 * 1024 + 1;
+		ret = set_func(NULL, "prefault.granularity", &granularity);
+		UT_ASSERTeq(ret, 0);
+
+		ssize_t granularity_read = -1;
+		ret = get_func(NULL, "prefault.granularity",
+			&granularity_read);
+		UT_ASSERTeq(ret, 0);
+		UT_ASSERTeq(granularity_read, granularity);
 	}
 }
 /*
@@ -164,7 +201,7 @@ test_log(const char *path, int open)
 }
 
 #define USAGE() do {\
-	UT_FATAL("usage: %s file-name type(obj/blk/log) prefault(0/1/2) "\
+	UT_FATAL("usage: %s file-name type(obj/blk/log) prefault(0/1/2/3) "\
 			"open(0/1)", argv[0]);\
 } while (0)
 
@@ -234,6 +234,45 @@ test_many_sets(PMEMobjpool *pop, size_t n)
 	FREE(act);
 }
 
+#define BULK_ACTIONS 1000
+
+static void
+test_bulk(PMEMobjpool *pop, size_t n)
+{
+	struct pobj_action *act = (struct pobj_action *)
+		MALLOC(sizeof(struct pobj_action) * n);
+	PMEMoid *oid = (PMEMoid *)
+		MALLOC(sizeof(PMEMoid) * n);
+
+	int ret = pmemobj_xreserve_bulk(pop, act, oid, n, 64, 0,
+		POBJ_XALLOC_ZERO);
+	UT_ASSERTeq(ret, 0);
+
+	for (size_t i = 0; i < n; ++i) {
+		UT_ASSERT(!OID_IS_NULL(oid[i]));
+		if (i != 0)
+			UT_ASSERTne(oid[i].off, oid[i - 1].off);
+	}
+
+	UT_ASSERTeq(pmemobj_publish(pop, act, n), 0);
+
+	for (size_t i = 0; i < n; ++i)
+		pmemobj_defer_free(pop, oid[i], &act[i]);
+
+	UT_ASSERTeq(pmemobj_publish(pop, act, n), 0);
+
+	ret = pmemobj_xreserve_bulk(pop, act, NULL, n, 64, 0, 0);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_cancel(pop, act, n);
+
+	ret = pmemobj_xreserve_bulk(pop, act, oid, n, 64, 0, UINT64_MAX);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	FREE(oid);
+	FREE(act);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -342,6 +381,7 @@ main(int argc, char *argv[])
 
 	test_many(pop, POBJ_MAX_ACTIONS * 2);
 	test_many_sets(pop, POBJ_MAX_ACTIONS * 2);
+	test_bulk(pop, BULK_ACTIONS);
 
 	test_duplicate(pop);
 
@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_addr_map.c -- unit test for the direct-mapped address ranges
+ */
+
+#include <errno.h>
+
+#include "addr_map.h"
+#include "unittest.h"
+
+#define KB (1ULL << 10)
+#define MB (1ULL << 20)
+#define GB (1ULL << 30)
+
+#define BASE (64 * GB)
+#define STEP (64 * KB)
+
+#define TEST_VAL(x) ((void *)((uintptr_t)(x) + 1))
+
+struct range {
+	uintptr_t addr;
+	size_t size;
+	int mapped;
+};
+
+/*
+ * ranges -- pools of different sizes placed back to back, with and without
+ *	gaps, sharing entries and crossing a GiB boundary
+ */
+static struct range Ranges[] = {
+	{BASE + 4 * KB, 9 * MB + 4 * KB, 0},
+	{BASE + 9 * MB + 8 * KB, 2 * MB, 0},
+	{BASE + 11 * MB + 8 * KB, 16 * MB, 0},
+	{BASE + 28 * MB, 2 * MB, 0},
+	{BASE + GB - 3 * MB - 32 * KB, 5 * MB, 0},
+	{BASE + GB + 2 * MB + 32 * KB, 300 * MB, 0},
+};
+
+#define NRANGES ARRAY_SIZE(Ranges)
+
+/*
+ * check -- checks the lookup of addresses around all of the ranges, an
+ *	address in a mapped range has to find it, the candidates returned for
+ *	any other address can't contain the address
+ */
+static void
+check(struct addr_map *m)
+{
+	for (uintptr_t a = BASE - 4 * MB; a < BASE + GB + 310 * MB; a += STEP) {
+		for (int d = -1; d <= 1; ++d) {
+			uintptr_t addr = a + (uintptr_t)d;
+			void *v = addr_map_get(m, addr);
+			size_t i;
+
+			for (i = 0; i < NRANGES; ++i) {
+				struct range *r = &Ranges[i];
+				if (addr >= r->addr && addr < r->addr + r->size)
+					break;
+			}
+
+			if (i < NRANGES && Ranges[i].mapped) {
+				UT_ASSERTeq(v, TEST_VAL(i));
+			} else if (v != NULL) {
+				size_t j = (size_t)((uintptr_t)v - 1);
+				UT_ASSERT(j < NRANGES);
+				UT_ASSERT(Ranges[j].mapped);
+				UT_ASSERTne(j, i);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < NRANGES; ++i) {
+		struct range *r = &Ranges[i];
+		if (!r->mapped)
+			continue;
+
+		UT_ASSERTeq(addr_map_get(m, r->addr), TEST_VAL(i));
+		UT_ASSERTeq(addr_map_get(m, r->addr + r->size - 1),
+			TEST_VAL(i));
+	}
+}
+
+/*
+ * map_insert -- inserts the range into the map
+ */
+static void
+map_insert(struct addr_map *m, size_t i)
+{
+	struct range *r = &Ranges[i];
+	UT_ASSERTeq(addr_map_insert(m, r->addr, r->size, TEST_VAL(i)), 0);
+	r->mapped = 1;
+}
+
+/*
+ * map_remove -- removes the range from the map
+ */
+static void
+map_remove(struct addr_map *m, size_t i)
+{
+	struct range *r = &Ranges[i];
+	UT_ASSERTeq(addr_map_remove(m, r->addr, r->size, TEST_VAL(i)), 0);
+	r->mapped = 0;
+}
+
+/*
+ * test_empty -- nothing is found in an empty map
+ */
+static void
+test_empty(void)
+{
+	struct addr_map *m = addr_map_new();
+	UT_ASSERTne(m, NULL);
+
+	UT_ASSERTeq(addr_map_get(m, 0), NULL);
+	UT_ASSERTeq(addr_map_get(m, BASE), NULL);
+	UT_ASSERTeq(addr_map_get(m, UINTPTR_MAX), NULL);
+	check(m);
+
+	addr_map_delete(m);
+}
+
+/*
+ * test_insert_remove -- inserts and removes the ranges in different orders
+ */
+static void
+test_insert_remove(void)
+{
+	struct addr_map *m = addr_map_new();
+	UT_ASSERTne(m, NULL);
+
+	for (size_t i = 0; i < NRANGES; ++i) {
+		map_insert(m, i);
+		check(m);
+	}
+
+	/* every other range, the neighbours remain intact */
+	for (size_t i = 0; i < NRANGES; i += 2) {
+		map_remove(m, i);
+		check(m);
+	}
+
+	for (size_t i = NRANGES; i > 0; --i) {
+		if (!Ranges[i - 1].mapped)
+			map_insert(m, i - 1);
+		check(m);
+	}
+
+	for (size_t i = NRANGES; i > 0; --i) {
+		map_remove(m, i - 1);
+		check(m);
+	}
+
+	addr_map_delete(m);
+}
+
+/*
+ * test_invalid -- ranges which overlap, are too small or too high aren't
+ *	inserted, ranges which aren't in the map can't be removed
+ */
+static void
+test_invalid(void)
+{
+	struct addr_map *m = addr_map_new();
+	UT_ASSERTne(m, NULL);
+
+	map_insert(m, 0);
+	map_insert(m, 1);
+
+	UT_ASSERTeq(addr_map_insert(m, BASE + 9 * MB, 4 * MB, TEST_VAL(9)),
+		EEXIST);
+	UT_ASSERTeq(addr_map_insert(m, BASE, 2 * MB, TEST_VAL(9)), EEXIST);
+	UT_ASSERTeq(addr_map_insert(m, BASE + 64 * MB, MB, TEST_VAL(9)),
+		ERANGE);
+	UT_ASSERTeq(addr_map_insert(m, UINTPTR_MAX - 4 * MB, 2 * MB,
+		TEST_VAL(9)), ERANGE);
+	UT_ASSERTeq(addr_map_insert(m, UINTPTR_MAX - MB, 2 * MB,
+		TEST_VAL(9)), ERANGE);
+	check(m);
+
+	UT_ASSERTeq(addr_map_remove(m, BASE + 64 * MB, 4 * MB, TEST_VAL(9)),
+		ENOENT);
+	UT_ASSERTeq(addr_map_remove(m, Ranges[0].addr, Ranges[0].size,
+		TEST_VAL(1)), ENOENT);
+	UT_ASSERTeq(addr_map_remove(m, BASE + 64 * MB, MB, TEST_VAL(9)),
+		ENOENT);
+	check(m);
+
+	map_remove(m, 0);
+	map_remove(m, 1);
+	check(m);
+
+	addr_map_delete(m);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_addr_map");
+
+	test_empty();
+	test_insert_remove();
+	test_invalid();
+
+	DONE(NULL);
+}
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_ctl_chunk_align.c -- tests for the heap.chunk_align ctl entry point
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "obj_ctl_chunk_align"
+
+#define CHUNK_SIZE (256 * 1024)
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define NALLOCS 8
+
+static PMEMobjpool *pop;
+
+static void
+test_fail(void)
+{
+	ssize_t align = -1;
+	int ret = pmemobj_ctl_set(pop, "heap.chunk_align", &align);
+	UT_ASSERTeq(ret, -1);
+
+	align = 3 * CHUNK_SIZE; /* not a power of two */
+	ret = pmemobj_ctl_set(pop, "heap.chunk_align", &align);
+	UT_ASSERTeq(ret, -1);
+
+	align = CHUNK_SIZE; /* not larger than a chunk */
+	ret = pmemobj_ctl_set(pop, "heap.chunk_align", &align);
+	UT_ASSERTeq(ret, -1);
+
+	ret = pmemobj_ctl_get(pop, "heap.chunk_align", &align);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(align, 0);
+}
+
+static void
+test_aligned_allocs(void)
+{
+	ssize_t align = HUGE_PAGE_SIZE;
+	int ret = pmemobj_ctl_set(pop, "heap.chunk_align", &align);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "heap.chunk_align", &align);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(align, HUGE_PAGE_SIZE);
+
+	PMEMoid oids[NALLOCS];
+
+	/* shift the beginning of free space by an odd number of chunks */
+	ret = pmemobj_alloc(pop, &oids[0], CHUNK_SIZE * 2, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	for (int i = 1; i < NALLOCS; ++i) {
+		ret = pmemobj_alloc(pop, &oids[i], HUGE_PAGE_SIZE + CHUNK_SIZE,
+			0, NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+
+		/* the object begins in the first chunk of an aligned region */
+		uintptr_t addr = (uintptr_t)pmemobj_direct(oids[i]);
+		UT_ASSERT(addr % HUGE_PAGE_SIZE < CHUNK_SIZE);
+	}
+
+	for (int i = 0; i < NALLOCS; ++i)
+		pmemobj_free(&oids[i]);
+
+	align = 0;
+	ret = pmemobj_ctl_set(pop, "heap.chunk_align", &align);
+	UT_ASSERTeq(ret, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_chunk_align");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 10,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	test_fail();
+	test_aligned_allocs();
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_ctl_compactor.c -- tests for the heap.compactor ctl entry points
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "obj_ctl_compactor"
+
+#define BACKGROUND_PASSES 3
+
+static PMEMobjpool *pop;
+
+static os_mutex_t lock;
+static os_cond_t cond;
+static unsigned ncalls;
+
+/*
+ * root_enum_ptrs -- pointer enumeration callback of the root object, doesn't
+ *	report any pointers, so nothing is ever relocated
+ */
+static void
+root_enum_ptrs(PMEMobjpool *p, PMEMoid oid,
+	pobj_compactor_visit_fn visit, void *visit_arg, void *arg)
+{
+	UT_ASSERTeq(p, pop);
+	UT_ASSERTeq(arg, &ncalls);
+	UT_ASSERT(!OID_IS_NULL(oid));
+
+	PMEMoid null_oid = OID_NULL;
+	visit(&null_oid, visit_arg);
+
+	os_mutex_lock(&lock);
+	ncalls++;
+	os_cond_signal(&cond);
+	os_mutex_unlock(&lock);
+}
+
+static void
+test_config(void)
+{
+	ssize_t val = 0;
+	int ret = pmemobj_ctl_set(pop, "heap.compactor.interval_ms", &val);
+	UT_ASSERTeq(ret, -1);
+
+	ret = pmemobj_ctl_set(pop, "heap.compactor.max_runs", &val);
+	UT_ASSERTeq(ret, -1);
+
+	val = -1;
+	ret = pmemobj_ctl_set(pop, "heap.compactor.max_runs", &val);
+	UT_ASSERTeq(ret, -1);
+
+	ret = pmemobj_ctl_get(pop, "heap.compactor.interval_ms", &val);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(val, 1000);
+
+	ret = pmemobj_ctl_get(pop, "heap.compactor.max_runs", &val);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(val, 16);
+
+	val = 1;
+	ret = pmemobj_ctl_set(pop, "heap.compactor.interval_ms", &val);
+	UT_ASSERTeq(ret, 0);
+
+	val = 4;
+	ret = pmemobj_ctl_set(pop, "heap.compactor.max_runs", &val);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "heap.compactor.max_runs", &val);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(val, 4);
+
+	int enabled = 1;
+	ret = pmemobj_ctl_get(pop, "heap.compactor.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(enabled, 0);
+}
+
+static void
+test_handler(void)
+{
+	struct pobj_compactor_type_desc desc;
+	int ret = pmemobj_ctl_get(pop, "heap.compactor.type.0.handler", &desc);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(desc.enum_ptrs, NULL);
+
+	desc.enum_ptrs = root_enum_ptrs;
+	desc.arg = &ncalls;
+	ret = pmemobj_ctl_set(pop, "heap.compactor.type.0.handler", &desc);
+	UT_ASSERTeq(ret, 0);
+
+	memset(&desc, 0, sizeof(desc));
+	ret = pmemobj_ctl_get(pop, "heap.compactor.type.0.handler", &desc);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(desc.enum_ptrs, root_enum_ptrs);
+	UT_ASSERTeq(desc.arg, &ncalls);
+}
+
+static void
+test_run(void)
+{
+	uint64_t ticks;
+	int ret = pmemobj_ctl_get(pop, "heap.compactor.ticks", &ticks);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(ticks, 0);
+
+	struct pobj_defrag_result result;
+	ret = pmemobj_ctl_exec(pop, "heap.compactor.run", &result);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(result.relocated, 0);
+	UT_ASSERTne(ncalls, 0);
+
+	ret = pmemobj_ctl_exec(pop, "heap.compactor.run", NULL);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "heap.compactor.ticks", &ticks);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(ticks, 2);
+
+	uint64_t relocated;
+	ret = pmemobj_ctl_get(pop, "heap.compactor.relocated", &relocated);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(relocated, 0);
+
+	uint64_t reclaimed;
+	ret = pmemobj_ctl_get(pop, "heap.compactor.reclaimed", &reclaimed);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(reclaimed, 0);
+}
+
+static void
+test_background(void)
+{
+	os_mutex_lock(&lock);
+	unsigned target = ncalls + BACKGROUND_PASSES;
+	os_mutex_unlock(&lock);
+
+	int enabled = 1;
+	int ret = pmemobj_ctl_set(pop, "heap.compactor.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	/* enabling an already running compactor is a no-op */
+	ret = pmemobj_ctl_set(pop, "heap.compactor.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	os_mutex_lock(&lock);
+	while (ncalls < target)
+		os_cond_wait(&cond, &lock);
+	os_mutex_unlock(&lock);
+
+	enabled = 0;
+	ret = pmemobj_ctl_set(pop, "heap.compactor.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "heap.compactor.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(enabled, 0);
+
+	uint64_t ticks;
+	ret = pmemobj_ctl_get(pop, "heap.compactor.ticks", &ticks);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(ticks >= 2 + BACKGROUND_PASSES);
+
+	/* once unregistered, the handler is no longer called */
+	struct pobj_compactor_type_desc desc = {NULL, NULL};
+	ret = pmemobj_ctl_set(pop, "heap.compactor.type.0.handler", &desc);
+	UT_ASSERTeq(ret, 0);
+
+	unsigned prev_ncalls = ncalls;
+	ret = pmemobj_ctl_exec(pop, "heap.compactor.run", NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(ncalls, prev_ncalls);
+
+	/* leave the compactor running, closing the pool must stop it */
+	enabled = 1;
+	ret = pmemobj_ctl_set(pop, "heap.compactor.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_compactor");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	os_mutex_init(&lock);
+	os_cond_init(&cond);
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	PMEMoid root = pmemobj_root(pop, sizeof(PMEMoid));
+	UT_ASSERT(!OID_IS_NULL(root));
+
+	test_config();
+	test_handler();
+	test_run();
+	test_background();
+
+	pmemobj_close(pop);
+
+	os_cond_destroy(&cond);
+	os_mutex_destroy(&lock);
+
+	DONE(NULL);
+}
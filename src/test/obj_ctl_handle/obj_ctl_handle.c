@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_ctl_handle.c -- tests for the compiled ctl queries
+ */
+
+#include "unittest.h"
+
+#define OBJECT_SIZE 128
+
+static PMEMobjpool *pop;
+
+/*
+ * compile -- compiles the entry point, which has to exist
+ */
+static struct pobj_ctl_handle *
+compile(PMEMobjpool *p, const char *name)
+{
+	struct pobj_ctl_handle *h = pmemobj_ctl_compile(p, name);
+	UT_ASSERTne(h, NULL);
+
+	return h;
+}
+
+/*
+ * test_global -- the handle of a global entry point is compiled without
+ *	a pool
+ */
+static void
+test_global(void)
+{
+	struct pobj_ctl_handle *h = compile(NULL, "prefault.at_open");
+
+	int enabled = 1;
+	UT_ASSERTeq(pmemobj_ctl_set_h(h, &enabled), 0);
+
+	enabled = 0;
+	UT_ASSERTeq(pmemobj_ctl_get(NULL, "prefault.at_open", &enabled), 0);
+	UT_ASSERTeq(enabled, 1);
+
+	enabled = 0;
+	UT_ASSERTeq(pmemobj_ctl_set(NULL, "prefault.at_open", &enabled), 0);
+
+	enabled = 1;
+	UT_ASSERTeq(pmemobj_ctl_get_h(h, &enabled), 0);
+	UT_ASSERTeq(enabled, 0);
+
+	pmemobj_ctl_handle_free(h);
+}
+
+/*
+ * test_pool -- the handle of an entry point of the pool sees the current
+ *	value on every query
+ */
+static void
+test_pool(void)
+{
+	struct pobj_ctl_handle *enabled = compile(pop, "stats.enabled");
+	struct pobj_ctl_handle *allocated =
+		compile(pop, "stats.heap.curr_allocated");
+
+	int e = 1;
+	UT_ASSERTeq(pmemobj_ctl_set_h(enabled, &e), 0);
+
+	for (unsigned i = 0; i < 4; ++i) {
+		PMEMoid oid;
+		UT_ASSERTeq(pmemobj_alloc(pop, &oid, OBJECT_SIZE, 0,
+			NULL, NULL), 0);
+
+		uint64_t by_handle = 0;
+		uint64_t by_name = 1;
+		UT_ASSERTeq(pmemobj_ctl_get_h(allocated, &by_handle), 0);
+		UT_ASSERTeq(pmemobj_ctl_get(pop, "stats.heap.curr_allocated",
+			&by_name), 0);
+		UT_ASSERTeq(by_handle, by_name);
+		UT_ASSERTne(by_handle, 0);
+	}
+
+	/* read-only entry points can't be written through a handle either */
+	uint64_t value = 0;
+	UT_ASSERTeq(pmemobj_ctl_set_h(allocated, &value), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	pmemobj_ctl_handle_free(allocated);
+	pmemobj_ctl_handle_free(enabled);
+}
+
+/*
+ * test_indexed -- the indexes are resolved when the handle is compiled
+ */
+static void
+test_indexed(void)
+{
+	struct pobj_ctl_handle *create = compile(pop, "heap.arena.create");
+
+	unsigned arena_id = 0;
+	UT_ASSERTeq(pmemobj_ctl_exec_h(create, &arena_id), 0);
+	UT_ASSERTne(arena_id, 0);
+
+	/* runnable entry points can't be read */
+	UT_ASSERTeq(pmemobj_ctl_get_h(create, &arena_id), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	pmemobj_ctl_handle_free(create);
+
+	struct pobj_ctl_handle *first = compile(pop, "heap.arena.1.size");
+
+	char name[64];
+	SNPRINTF(name, sizeof(name), "heap.arena.%u.size", arena_id);
+	struct pobj_ctl_handle *created = compile(pop, name);
+
+	size_t size_by_handle;
+	size_t size_by_name;
+
+	UT_ASSERTeq(pmemobj_ctl_get_h(first, &size_by_handle), 0);
+	UT_ASSERTeq(pmemobj_ctl_get(pop, "heap.arena.1.size", &size_by_name),
+		0);
+	UT_ASSERTeq(size_by_handle, size_by_name);
+
+	UT_ASSERTeq(pmemobj_ctl_get_h(created, &size_by_handle), 0);
+	UT_ASSERTeq(pmemobj_ctl_get(pop, name, &size_by_name), 0);
+	UT_ASSERTeq(size_by_handle, size_by_name);
+
+	pmemobj_ctl_handle_free(created);
+	pmemobj_ctl_handle_free(first);
+
+	/* indexes out of range are detected when the handle is queried */
+	struct pobj_ctl_handle *invalid = compile(pop, "heap.arena.1000.size");
+	UT_ASSERTeq(pmemobj_ctl_get_h(invalid, &size_by_handle), -1);
+	pmemobj_ctl_handle_free(invalid);
+}
+
+/*
+ * test_invalid -- only the leaves of the tree can be compiled
+ */
+static void
+test_invalid(void)
+{
+	UT_ASSERTeq(pmemobj_ctl_compile(pop, "stats.nonexistent"), NULL);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(pmemobj_ctl_compile(pop, "stats.heap"), NULL);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(pmemobj_ctl_compile(pop, NULL), NULL);
+	UT_ASSERTeq(errno, EINVAL);
+
+	/* the entry points of the pool aren't found without the pool */
+	UT_ASSERTeq(pmemobj_ctl_compile(NULL, "stats.enabled"), NULL);
+	UT_ASSERTeq(errno, EINVAL);
+
+	int arg;
+	UT_ASSERTeq(pmemobj_ctl_get_h(NULL, &arg), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	pmemobj_ctl_handle_free(NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_handle");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	test_global();
+
+	if ((pop = pmemobj_create(path, "ctl", PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	test_pool();
+	test_indexed();
+	test_invalid();
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_ctl_heap_stats.c -- tests for the stats.heap.class, stats.heap.arena
+ *	and stats.heap.zone ctl entry points
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "obj_ctl_heap_stats"
+
+#define NOBJS 1000
+#define OBJ_SIZE 64
+
+static PMEMobjpool *pop;
+static PMEMoid oids[NOBJS];
+
+/*
+ * class_stat -- reads a single statistic of an allocation class
+ */
+static uint64_t
+class_stat(unsigned class_id, const char *name)
+{
+	char query[128];
+	SNPRINTF(query, sizeof(query), "stats.heap.class.%u.%s",
+		class_id, name);
+
+	uint64_t value;
+	int ret = pmemobj_ctl_get(pop, query, &value);
+	UT_ASSERTeq(ret, 0);
+
+	return value;
+}
+
+/*
+ * arena_stat -- reads a single statistic of an arena
+ */
+static uint64_t
+arena_stat(unsigned arena_id, const char *name)
+{
+	char query[128];
+	SNPRINTF(query, sizeof(query), "stats.heap.arena.%u.%s",
+		arena_id, name);
+
+	uint64_t value;
+	int ret = pmemobj_ctl_get(pop, query, &value);
+	UT_ASSERTeq(ret, 0);
+
+	return value;
+}
+
+static void
+test_invalid(void)
+{
+	uint64_t value;
+	int ret = pmemobj_ctl_get(pop, "stats.heap.class.255.allocs", &value);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ERANGE);
+
+	ret = pmemobj_ctl_get(pop, "stats.heap.class.200.allocs", &value);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ENOENT);
+
+	ret = pmemobj_ctl_get(pop, "stats.heap.arena.0.allocs", &value);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ERANGE);
+
+	ret = pmemobj_ctl_get(pop, "stats.heap.zone.1000.fill", &value);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ERANGE);
+
+	value = 1;
+	ret = pmemobj_ctl_set(pop, "stats.heap.zone.0.fill", &value);
+	UT_ASSERTeq(ret, -1);
+}
+
+static void
+test_class(unsigned class_id)
+{
+	UT_ASSERTeq(class_stat(class_id, "allocs"), 0);
+	UT_ASSERTeq(class_stat(class_id, "runs"), 0);
+	UT_ASSERTeq(class_stat(class_id, "fill"), 0);
+
+	for (int i = 0; i < NOBJS; ++i) {
+		int ret = pmemobj_xalloc(pop, &oids[i], OBJ_SIZE, 0,
+			POBJ_CLASS_ID(class_id), NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	UT_ASSERTeq(class_stat(class_id, "allocs"), NOBJS);
+
+	uint64_t runs = class_stat(class_id, "runs");
+	UT_ASSERTne(runs, 0);
+	UT_ASSERT(class_stat(class_id, "free_runs") < runs);
+
+	uint64_t fill = class_stat(class_id, "fill");
+	UT_ASSERT(fill > 0 && fill <= 100);
+
+	/* only contended acquisitions are counted, this test is serial */
+	UT_ASSERTeq(class_stat(class_id, "contention"), 0);
+
+	for (int i = 0; i < NOBJS; ++i)
+		pmemobj_free(&oids[i]);
+
+	UT_ASSERT(class_stat(class_id, "fill") < fill);
+
+	/* the recycler depth can't exceed the number of runs in the heap */
+	UT_ASSERT(class_stat(class_id, "recycler_runs") <=
+		class_stat(class_id, "runs"));
+}
+
+static void
+test_arena(void)
+{
+	unsigned arena_id;
+	int ret = pmemobj_ctl_get(pop, "heap.thread.arena_id", &arena_id);
+	UT_ASSERTeq(ret, 0);
+
+	UT_ASSERT(arena_stat(arena_id, "threads") >= 1);
+	UT_ASSERT(arena_stat(arena_id, "allocs") >= NOBJS);
+	UT_ASSERTeq(arena_stat(arena_id, "contention"), 0);
+
+	uint64_t huge_cached = arena_stat(arena_id, "huge_cached");
+	UT_ASSERTeq(huge_cached % (256 * 1024), 0);
+}
+
+static void
+test_zone(void)
+{
+	uint64_t fill;
+	int ret = pmemobj_ctl_get(pop, "stats.heap.zone.0.fill", &fill);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(fill > 0 && fill <= 100);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_heap_stats");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	struct pobj_alloc_class_desc desc;
+	desc.header_type = POBJ_HEADER_COMPACT;
+	desc.unit_size = 1000;
+	desc.units_per_block = 200;
+	desc.alignment = 0;
+
+	int ret = pmemobj_ctl_set(pop, "heap.alloc_class.new.desc", &desc);
+	UT_ASSERTeq(ret, 0);
+
+	test_invalid();
+	test_class(desc.class_id);
+	test_arena();
+	test_zone();
+
+	pmemobj_close(pop);
+
+	/* zones used before the pool was reopened are examined as well */
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	test_zone();
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_ctl_latency.c -- tests for the latency histograms of the statistics
+ *	module
+ */
+
+#include <inttypes.h>
+
+#include "unittest.h"
+
+#define THREADS 4
+#define OPS 100
+
+#define JSON_SIZE 4096
+
+static const char *Ops[] = {"tx_commit", "alloc", "free", "persist"};
+
+struct summary {
+	uint64_t count;
+	uint64_t mean;
+	uint64_t max;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t p999;
+};
+
+static PMEMobjpool *pop;
+static uint64_t Word;
+
+/*
+ * get -- reads the value of the histogram of the operation
+ */
+static uint64_t
+get(const char *op, const char *name)
+{
+	char query[64];
+	SNPRINTF(query, sizeof(query), "stats.latency.%s.%s", op, name);
+
+	uint64_t value = UINT64_MAX;
+	UT_ASSERTeq(pmemobj_ctl_get(pop, query, &value), 0);
+
+	return value;
+}
+
+/*
+ * summarize -- reads all of the values of the histogram of the operation
+ *	and checks whether they are consistent
+ */
+static void
+summarize(const char *op, struct summary *s)
+{
+	s->count = get(op, "count");
+	s->mean = get(op, "mean");
+	s->max = get(op, "max");
+	s->p50 = get(op, "p50");
+	s->p90 = get(op, "p90");
+	s->p99 = get(op, "p99");
+	s->p999 = get(op, "p999");
+
+	if (s->count == 0) {
+		UT_ASSERTeq(s->mean, 0);
+		UT_ASSERTeq(s->max, 0);
+		UT_ASSERTeq(s->p999, 0);
+		return;
+	}
+
+	UT_ASSERT(s->max > 0);
+	UT_ASSERT(s->mean <= s->max);
+	UT_ASSERT(s->p50 <= s->p90);
+	UT_ASSERT(s->p90 <= s->p99);
+	UT_ASSERT(s->p99 <= s->p999);
+	UT_ASSERT(s->p999 <= s->max);
+}
+
+/*
+ * set_enabled -- starts or stops recording the latencies
+ */
+static void
+set_enabled(int enabled)
+{
+	UT_ASSERTeq(pmemobj_ctl_set(pop, "stats.latency.enabled", &enabled),
+		0);
+
+	int ret = !enabled;
+	UT_ASSERTeq(pmemobj_ctl_get(pop, "stats.latency.enabled", &ret), 0);
+	UT_ASSERTeq(ret, enabled);
+}
+
+/*
+ * do_ops -- performs operations of all of the recorded kinds
+ */
+static void
+do_ops(unsigned n)
+{
+	for (unsigned i = 0; i < n; ++i) {
+		PMEMoid oid;
+		UT_ASSERTeq(pmemobj_alloc(pop, &oid, 64, 0, NULL, NULL), 0);
+
+		TX_BEGIN(pop) {
+			pmemobj_tx_free(oid);
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+
+		Word = i;
+		pmemobj_persist(pop, &Word, sizeof(Word));
+	}
+}
+
+/*
+ * persister -- persists the word in a loop
+ */
+static void *
+persister(void *arg)
+{
+	uint64_t word = 0;
+
+	for (unsigned i = 0; i < OPS; ++i) {
+		word = i;
+		pmemobj_persist(pop, &word, sizeof(word));
+	}
+
+	return NULL;
+}
+
+/*
+ * test_disabled -- nothing is recorded until enabled
+ */
+static void
+test_disabled(void)
+{
+	int enabled = 1;
+	UT_ASSERTeq(pmemobj_ctl_get(pop, "stats.latency.enabled", &enabled),
+		0);
+	UT_ASSERTeq(enabled, 0);
+
+	do_ops(OPS);
+
+	for (size_t i = 0; i < ARRAY_SIZE(Ops); ++i) {
+		struct summary s;
+		summarize(Ops[i], &s);
+		UT_ASSERTeq(s.count, 0);
+	}
+}
+
+/*
+ * test_record -- all of the operations are recorded once enabled, and
+ *	aren't once disabled again
+ */
+static void
+test_record(void)
+{
+	struct summary before[ARRAY_SIZE(Ops)];
+	struct summary after[ARRAY_SIZE(Ops)];
+
+	set_enabled(1);
+
+	for (size_t i = 0; i < ARRAY_SIZE(Ops); ++i)
+		summarize(Ops[i], &before[i]);
+
+	do_ops(OPS);
+
+	for (size_t i = 0; i < ARRAY_SIZE(Ops); ++i) {
+		summarize(Ops[i], &after[i]);
+		UT_ASSERT(after[i].count >= before[i].count + OPS);
+	}
+
+	/* persists of the threads are counted, whichever shard they use */
+	os_thread_t threads[THREADS];
+	for (unsigned i = 0; i < THREADS; ++i)
+		THREAD_CREATE(&threads[i], NULL, persister, NULL);
+	for (unsigned i = 0; i < THREADS; ++i)
+		THREAD_JOIN(&threads[i], NULL);
+
+	UT_ASSERTeq(get("persist", "count"), after[3].count + THREADS * OPS);
+
+	set_enabled(0);
+
+	for (size_t i = 0; i < ARRAY_SIZE(Ops); ++i)
+		summarize(Ops[i], &before[i]);
+
+	do_ops(OPS);
+
+	for (size_t i = 0; i < ARRAY_SIZE(Ops); ++i) {
+		summarize(Ops[i], &after[i]);
+		UT_ASSERTeq(after[i].count, before[i].count);
+	}
+}
+
+/*
+ * test_json -- exports the histograms, the document is truncated to the
+ *	size of the buffer
+ */
+static void
+test_json(void)
+{
+	char buf[JSON_SIZE];
+	struct pobj_latency_json json = {buf, sizeof(buf), 0};
+
+	UT_ASSERTeq(pmemobj_ctl_get(pop, "stats.latency.json", &json), 0);
+	UT_ASSERTeq(json.len, strlen(buf));
+	UT_ASSERTeq(buf[0], '{');
+	UT_ASSERTeq(buf[json.len - 1], '}');
+
+	for (size_t i = 0; i < ARRAY_SIZE(Ops); ++i) {
+		char key[64];
+		SNPRINTF(key, sizeof(key), "\"%s\":{\"count\":%" PRIu64 ",",
+			Ops[i], get(Ops[i], "count"));
+		UT_ASSERTne(strstr(buf, key), NULL);
+	}
+
+	char small[16];
+	struct pobj_latency_json trunc = {small, sizeof(small), 0};
+
+	UT_ASSERTeq(pmemobj_ctl_get(pop, "stats.latency.json", &trunc), 0);
+	UT_ASSERTeq(trunc.len, json.len);
+	UT_ASSERTeq(strlen(small), sizeof(small) - 1);
+	UT_ASSERTeq(strncmp(small, buf, sizeof(small) - 1), 0);
+
+	/* only the length is returned without a buffer */
+	struct pobj_latency_json len = {NULL, 0, 0};
+
+	UT_ASSERTeq(pmemobj_ctl_get(pop, "stats.latency.json", &len), 0);
+	UT_ASSERTeq(len.len, json.len);
+
+	struct pobj_latency_json invalid = {NULL, 1, 0};
+
+	UT_ASSERTeq(pmemobj_ctl_get(pop, "stats.latency.json", &invalid), -1);
+	UT_ASSERTeq(errno, EINVAL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_latency");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, "ctl", PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	test_disabled();
+	test_record();
+	test_json();
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
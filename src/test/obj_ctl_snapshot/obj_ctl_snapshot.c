@@ -0,0 +1,257 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_ctl_snapshot.c -- tests for the snapshot.create ctl entry point
+ *
+ * usage: obj_ctl_snapshot file-name snapshot-prefix
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "snapshot"
+#define THREADS 4
+#define SNAPSHOTS 4
+
+struct root {
+	uint64_t value;
+	uint64_t pairs[THREADS][2];
+};
+
+static PMEMobjpool *pop;
+static int Stop;
+
+/*
+ * snapshot_name -- returns the path of the snapshot with the given suffix
+ */
+static void
+snapshot_name(char *buf, size_t size, const char *prefix, const char *suffix)
+{
+	SNPRINTF(buf, size, "%s.%s", prefix, suffix);
+}
+
+/*
+ * snapshot -- creates the snapshot using the given method
+ */
+static int
+snapshot(const char *path, enum pobj_snapshot_method method,
+	enum pobj_snapshot_method *used)
+{
+	struct pobj_snapshot s = {path, method, POBJ_SNAPSHOT_METHOD_ANY};
+
+	int ret = pmemobj_ctl_exec(pop, "snapshot.create", &s);
+	if (ret == 0 && used != NULL)
+		*used = s.used;
+
+	return ret;
+}
+
+/*
+ * check_value -- opens the pool and checks the value in its root
+ */
+static void
+check_value(const char *path, uint64_t value)
+{
+	PMEMobjpool *p = pmemobj_open(path, LAYOUT);
+	if (p == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	struct root *r = pmemobj_direct(pmemobj_root(p, sizeof(*r)));
+	UT_ASSERTeq(r->value, value);
+
+	/* every snapshot contains whole transactions only */
+	for (unsigned i = 0; i < THREADS; ++i)
+		UT_ASSERTeq(r->pairs[i][0], r->pairs[i][1]);
+
+	pmemobj_close(p);
+}
+
+/*
+ * writer -- updates both of the values of its pair in every transaction
+ */
+static void *
+writer(void *arg)
+{
+	unsigned idx = *(unsigned *)arg;
+	struct root *r = pmemobj_direct(pmemobj_root(pop, sizeof(*r)));
+
+	int stop = 0;
+	for (uint64_t i = 1; !stop; ++i) {
+		TX_BEGIN(pop) {
+			pmemobj_tx_add_range_direct(r->pairs[idx],
+				sizeof(r->pairs[idx]));
+			r->pairs[idx][0] = i;
+			r->pairs[idx][1] = i;
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+
+		util_atomic_load_explicit32(&Stop, &stop,
+			memory_order_acquire);
+	}
+
+	return NULL;
+}
+
+/*
+ * test_methods -- creates the snapshots using all of the methods
+ */
+static void
+test_methods(const char *prefix)
+{
+	char path[PATH_MAX];
+	enum pobj_snapshot_method used;
+
+	snapshot_name(path, sizeof(path), prefix, "any");
+	UT_ASSERTeq(snapshot(path, POBJ_SNAPSHOT_METHOD_ANY, &used), 0);
+	UT_ASSERTne(used, POBJ_SNAPSHOT_METHOD_ANY);
+
+	snapshot_name(path, sizeof(path), prefix, "copy");
+	UT_ASSERTeq(snapshot(path, POBJ_SNAPSHOT_METHOD_COPY, &used), 0);
+	UT_ASSERTeq(used, POBJ_SNAPSHOT_METHOD_COPY);
+
+	/* reflinks aren't supported by every file system */
+	snapshot_name(path, sizeof(path), prefix, "reflink");
+	if (snapshot(path, POBJ_SNAPSHOT_METHOD_REFLINK, &used) == 0) {
+		UT_ASSERTeq(used, POBJ_SNAPSHOT_METHOD_REFLINK);
+	} else {
+		UT_ASSERTeq(os_access(path, F_OK), -1);
+		UT_ASSERTeq(snapshot(path, POBJ_SNAPSHOT_METHOD_COPY, NULL),
+			0);
+	}
+}
+
+/*
+ * test_concurrent -- creates the snapshots while the pool is modified
+ */
+static void
+test_concurrent(const char *prefix)
+{
+	os_thread_t threads[THREADS];
+	unsigned idx[THREADS];
+
+	for (unsigned i = 0; i < THREADS; ++i) {
+		idx[i] = i;
+		THREAD_CREATE(&threads[i], NULL, writer, &idx[i]);
+	}
+
+	char path[PATH_MAX];
+	for (unsigned i = 0; i < SNAPSHOTS; ++i) {
+		char suffix[16];
+		SNPRINTF(suffix, sizeof(suffix), "mt%u", i);
+		snapshot_name(path, sizeof(path), prefix, suffix);
+
+		UT_ASSERTeq(snapshot(path, POBJ_SNAPSHOT_METHOD_ANY, NULL), 0);
+	}
+
+	util_atomic_store_explicit32(&Stop, 1, memory_order_release);
+
+	for (unsigned i = 0; i < THREADS; ++i)
+		THREAD_JOIN(&threads[i], NULL);
+}
+
+/*
+ * test_invalid -- the snapshots which can't be created
+ */
+static void
+test_invalid(const char *prefix)
+{
+	char path[PATH_MAX];
+
+	/* existing files aren't overwritten */
+	snapshot_name(path, sizeof(path), prefix, "any");
+	UT_ASSERTeq(snapshot(path, POBJ_SNAPSHOT_METHOD_ANY, NULL), -1);
+	UT_ASSERTeq(errno, EEXIST);
+
+	UT_ASSERTeq(snapshot(NULL, POBJ_SNAPSHOT_METHOD_ANY, NULL), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(pmemobj_ctl_exec(pop, "snapshot.create", NULL), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	/* the lane of the transaction would never be released */
+	snapshot_name(path, sizeof(path), prefix, "tx");
+	TX_BEGIN(pop) {
+		UT_ASSERTeq(snapshot(path, POBJ_SNAPSHOT_METHOD_ANY, NULL),
+			-1);
+		UT_ASSERTeq(errno, EBUSY);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(os_access(path, F_OK), -1);
+
+	/* the snapshot has the UUID of the pool, which is open */
+	snapshot_name(path, sizeof(path), prefix, "any");
+	UT_ASSERTeq(pmemobj_open(path, LAYOUT), NULL);
+}
+
+/*
+ * test_cow -- the changes of a pool opened with copy_on_write.at_open are
+ *	never in the file, so it can't be snapshotted
+ */
+static void
+test_cow(const char *path, const char *prefix)
+{
+	int cow = 1;
+	UT_ASSERTeq(pmemobj_ctl_set(NULL, "copy_on_write.at_open", &cow), 0);
+
+	pop = pmemobj_open(path, LAYOUT);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	char spath[PATH_MAX];
+	snapshot_name(spath, sizeof(spath), prefix, "cow");
+	UT_ASSERTeq(snapshot(spath, POBJ_SNAPSHOT_METHOD_ANY, NULL), -1);
+	UT_ASSERTeq(errno, ENOTSUP);
+	UT_ASSERTeq(os_access(spath, F_OK), -1);
+
+	pmemobj_close(pop);
+
+	cow = 0;
+	UT_ASSERTeq(pmemobj_ctl_set(NULL, "copy_on_write.at_open", &cow), 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_snapshot");
+
+	if (argc != 3)
+		UT_FATAL("usage: %s file-name snapshot-prefix", argv[0]);
+
+	const char *path = argv[1];
+	const char *prefix = argv[2];
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	struct root *r = pmemobj_direct(pmemobj_root(pop, sizeof(*r)));
+	r->value = 1;
+	pmemobj_persist(pop, &r->value, sizeof(r->value));
+
+	test_methods(prefix);
+	test_concurrent(prefix);
+	test_invalid(prefix);
+
+	/* the changes made after the snapshots aren't in them */
+	r->value = 2;
+	pmemobj_persist(pop, &r->value, sizeof(r->value));
+
+	pmemobj_close(pop);
+
+	check_value(path, 2);
+
+	const char *suffixes[] = {"any", "copy", "reflink",
+		"mt0", "mt1", "mt2", "mt3"};
+	char spath[PATH_MAX];
+	for (size_t i = 0; i < ARRAY_SIZE(suffixes); ++i) {
+		snapshot_name(spath, sizeof(spath), prefix, suffixes[i]);
+		check_value(spath, 1);
+	}
+
+	test_cow(path, prefix);
+
+	DONE(NULL);
+}
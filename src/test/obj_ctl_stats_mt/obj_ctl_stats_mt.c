@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_ctl_stats_mt.c -- tests for the statistics updated by many threads
+ *
+ * There are more threads than shards of the counters, so some of the shards
+ * are shared.
+ */
+
+#include "unittest.h"
+
+#define THREADS 24
+#define OBJECTS 32
+#define OBJECT_SIZE 128
+
+static PMEMobjpool *pop;
+static PMEMoid Oids[THREADS][OBJECTS];
+
+/*
+ * get -- reads the statistic
+ */
+static uint64_t
+get(const char *name)
+{
+	uint64_t value = UINT64_MAX;
+	UT_ASSERTeq(pmemobj_ctl_get(pop, name, &value), 0);
+
+	return value;
+}
+
+/*
+ * allocator -- allocates the objects of the thread
+ */
+static void *
+allocator(void *arg)
+{
+	unsigned idx = *(unsigned *)arg;
+
+	for (unsigned i = 0; i < OBJECTS; ++i)
+		UT_ASSERTeq(pmemobj_alloc(pop, &Oids[idx][i], OBJECT_SIZE, 0,
+			NULL, NULL), 0);
+
+	return NULL;
+}
+
+/*
+ * releaser -- frees the objects of the thread
+ */
+static void *
+releaser(void *arg)
+{
+	unsigned idx = *(unsigned *)arg;
+
+	for (unsigned i = 0; i < OBJECTS; ++i)
+		pmemobj_free(&Oids[idx][i]);
+
+	return NULL;
+}
+
+/*
+ * run -- runs the function in all of the threads
+ */
+static void
+run(void *(*func)(void *))
+{
+	os_thread_t threads[THREADS];
+	unsigned idx[THREADS];
+
+	for (unsigned i = 0; i < THREADS; ++i) {
+		idx[i] = i;
+		THREAD_CREATE(&threads[i], NULL, func, &idx[i]);
+	}
+
+	for (unsigned i = 0; i < THREADS; ++i)
+		THREAD_JOIN(&threads[i], NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ctl_stats_mt");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, "ctl", PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	int enabled = 1;
+	UT_ASSERTeq(pmemobj_ctl_set(pop, "stats.enabled", &enabled), 0);
+
+	uint64_t allocated = get("stats.heap.curr_allocated");
+	uint64_t run_allocated = get("stats.heap.run_allocated");
+
+	run(allocator);
+
+	/* every allocation is at least as large as the requested size */
+	uint64_t all_allocated = get("stats.heap.curr_allocated");
+	UT_ASSERT(all_allocated >=
+		allocated + THREADS * OBJECTS * OBJECT_SIZE);
+	UT_ASSERTeq(get("stats.heap.run_allocated") - run_allocated,
+		all_allocated - allocated);
+
+	run(releaser);
+
+	/* the frees of each thread are counted in the shard of the thread */
+	UT_ASSERTeq(get("stats.heap.curr_allocated"), allocated);
+	UT_ASSERTeq(get("stats.heap.run_allocated"), run_allocated);
+
+	run(allocator);
+	UT_ASSERTeq(get("stats.heap.curr_allocated"), all_allocated);
+
+	pmemobj_close(pop);
+
+	/* the persistent statistic was folded into the pool */
+	pop = pmemobj_open(path, "ctl");
+	UT_ASSERTne(pop, NULL);
+
+	UT_ASSERTeq(get("stats.heap.curr_allocated"), all_allocated);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
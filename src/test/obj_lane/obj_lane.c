@@ -164,6 +164,78 @@ test_lane_hold_release(void)
 	FREE(mock_ulog);
 }
 
+/*
+ * mock_pop_by_cpu -- (internal) creates a pool mock with lanes assigned by
+ *	CPU and divided into two groups
+ */
+static struct mock_pop *
+mock_pop_by_cpu(struct lane *lanes, struct operation_context *ctx)
+{
+	for (int i = 0; i < MAX_MOCK_LANES; ++i) {
+		lanes[i].layout = MOCK_LAYOUT;
+		lanes[i].internal = ctx;
+		lanes[i].external = ctx;
+		lanes[i].undo = ctx;
+	}
+
+	struct mock_pop *pop = MALLOC(sizeof(struct mock_pop));
+
+	pop->p.nlanes = MAX_MOCK_LANES;
+	pop->p.lanes_desc.runtime_nlanes = MAX_MOCK_LANES;
+	pop->p.lanes_desc.lane = lanes;
+	pop->p.lanes_desc.next_lane_idx = 0;
+	pop->p.lanes_desc.assignment = POBJ_LANE_ASSIGNMENT_CPU;
+	pop->p.lanes_desc.ncpu_groups = 2;
+
+	pop->p.lanes_desc.lane_locks = CALLOC(OBJ_NLANES, sizeof(uint64_t));
+	pop->p.lanes_offset = (uint64_t)&pop->l - (uint64_t)&pop->p;
+	pop->p.uuid_lo = 654321;
+	base_ptr = &pop->p;
+
+	return pop;
+}
+
+/*
+ * test_lane_hold_by_cpu -- lanes assigned by CPU are stolen from the other
+ *	groups once the lanes of the current CPU are taken
+ */
+static void
+test_lane_hold_by_cpu(void)
+{
+	struct ulog *mock_ulog = ZALLOC(SIZEOF_ULOG(1024));
+	struct pmem_ops p_ops;
+	struct operation_context *ctx = operation_new(mock_ulog, 1024,
+		NULL, NULL, &p_ops, LOG_TYPE_REDO);
+
+	struct lane lanes[MAX_MOCK_LANES];
+	struct mock_pop *pop = mock_pop_by_cpu(lanes, ctx);
+	uint64_t *locks = pop->p.lanes_desc.lane_locks;
+
+	for (unsigned free_idx = 0; free_idx < MAX_MOCK_LANES; ++free_idx) {
+		for (unsigned i = 0; i < MAX_MOCK_LANES; ++i)
+			locks[i] = i != free_idx;
+
+		struct lane *lane;
+		unsigned idx = lane_hold(&pop->p, &lane);
+		UT_ASSERTeq(idx, free_idx);
+		UT_ASSERTeq(lane, &lanes[free_idx]);
+		UT_ASSERTeq(locks[free_idx], 1);
+
+		/* nested holds keep the lane */
+		UT_ASSERTeq(lane_hold(&pop->p, NULL), free_idx);
+		lane_release(&pop->p);
+		UT_ASSERTeq(locks[free_idx], 1);
+
+		lane_release(&pop->p);
+		UT_ASSERTeq(locks[free_idx], 0);
+	}
+
+	FREE(pop->p.lanes_desc.lane_locks);
+	FREE(pop);
+	operation_delete(ctx);
+	FREE(mock_ulog);
+}
+
 static void
 test_lane_sizes(void)
 {
@@ -205,6 +277,68 @@ test_separate_thread(void *arg)
 	return NULL;
 }
 
+#define NTHREADS_BY_CPU 8
+#define NOPS_BY_CPU 10000
+
+static unsigned Lane_owners[MAX_MOCK_LANES];
+
+/*
+ * test_hold_by_cpu_thread -- child thread which repeatedly holds lanes
+ *	assigned by CPU and checks that no other thread holds the same lane
+ */
+static void *
+test_hold_by_cpu_thread(void *arg)
+{
+	PMEMobjpool *pop = arg;
+
+	for (int i = 0; i < NOPS_BY_CPU; ++i) {
+		unsigned idx = lane_hold(pop, NULL);
+		UT_ASSERT(idx < MAX_MOCK_LANES);
+
+		UT_ASSERTeq(util_fetch_and_add32(&Lane_owners[idx], 1), 0);
+		UT_ASSERTeq(util_fetch_and_sub32(&Lane_owners[idx], 1), 1);
+
+		lane_release(pop);
+	}
+
+	return NULL;
+}
+
+/*
+ * test_lane_hold_by_cpu_mt -- more threads than lanes assigned by CPU
+ */
+static void
+test_lane_hold_by_cpu_mt(void)
+{
+	struct ulog *mock_ulog = ZALLOC(SIZEOF_ULOG(1024));
+	struct pmem_ops p_ops;
+	struct operation_context *ctx = operation_new(mock_ulog, 1024,
+		NULL, NULL, &p_ops, LOG_TYPE_REDO);
+
+	struct lane lanes[MAX_MOCK_LANES];
+	struct mock_pop *pop = mock_pop_by_cpu(lanes, ctx);
+
+	lane_info_boot();
+
+	os_thread_t threads[NTHREADS_BY_CPU];
+	for (int i = 0; i < NTHREADS_BY_CPU; ++i)
+		THREAD_CREATE(&threads[i], NULL, test_hold_by_cpu_thread,
+			&pop->p);
+
+	for (int i = 0; i < NTHREADS_BY_CPU; ++i)
+		THREAD_JOIN(&threads[i], NULL);
+
+	for (int i = 0; i < MAX_MOCK_LANES; ++i)
+		UT_ASSERTeq(pop->p.lanes_desc.lane_locks[i], 0);
+
+	lane_info_destroy();
+
+	FREE(pop->p.lanes_desc.lane_locks);
+	FREE(pop);
+	operation_delete(ctx);
+	FREE(mock_ulog);
+}
+
 /*
  * test_lane_info_destroy_in_separate_thread -- lane info boot from one thread
  *	and lane info destroy from another
@@ -302,12 +436,14 @@ main(int argc, char *argv[])
 		/* single thread scenarios */
 		test_lane_boot_cleanup_ok();
 		test_lane_hold_release();
+		test_lane_hold_by_cpu();
 		test_lane_sizes();
 		break;
 	case 'm':
 		/* multithreaded scenarios */
 		test_lane_info_destroy_in_separate_thread();
 		test_lane_cleanup_in_separate_thread();
+		test_lane_hold_by_cpu_mt();
 		break;
 	case 'f':
 		/* fault injection */
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_lane_recovery.c -- unit test for the recovery of many lanes
+ *
+ * usage: obj_lane_recovery file c|o [recovery-threads]
+ *
+ * The 'c' command interrupts a large transaction in each of several threads,
+ * so that the undo logs of many lanes, including their extensions, have to
+ * be replayed by the 'o' command.
+ */
+
+#include "unittest.h"
+#include "valgrind_internal.h"
+#if VG_PMEMCHECK_ENABLED
+#define VALGRIND_PMEMCHECK_END_TX VALGRIND_PMC_END_TX
+#else
+#define VALGRIND_PMEMCHECK_END_TX
+#endif
+
+#define LAYOUT "obj_lane_recovery"
+
+#define NTHREADS 8
+#define OBJ_SIZE (128 * 1024) /* requires extending the undo log */
+
+struct root {
+	PMEMoid objs[NTHREADS];
+};
+
+static PMEMobjpool *pop;
+
+static os_mutex_t lock;
+static os_cond_t modified_cond;
+static os_cond_t never_cond;
+static unsigned nmodified;
+
+/*
+ * obj_value -- returns the committed value of the given object
+ */
+static unsigned char
+obj_value(unsigned i)
+{
+	return (unsigned char)(i + 1);
+}
+
+/*
+ * crash_worker -- modifies an object in a transaction which is never finished
+ */
+static void *
+crash_worker(void *arg)
+{
+	unsigned i = *(unsigned *)arg;
+	struct root *r = pmemobj_direct(pmemobj_root(pop, sizeof(*r)));
+	void *data = pmemobj_direct(r->objs[i]);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(r->objs[i], 0, OBJ_SIZE);
+		memset(data, 0xff, OBJ_SIZE);
+		pmemobj_persist(pop, data, OBJ_SIZE);
+		VALGRIND_PMEMCHECK_END_TX;
+
+		/* keep the lane until the process exits */
+		os_mutex_lock(&lock);
+		nmodified++;
+		os_cond_signal(&modified_cond);
+		while (1)
+			os_cond_wait(&never_cond, &lock);
+	} TX_END
+
+	return NULL;
+}
+
+/*
+ * test_crash -- interrupts a transaction in each of the threads
+ */
+static void
+test_crash(const char *path)
+{
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 4,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	struct root *r = pmemobj_direct(pmemobj_root(pop, sizeof(*r)));
+	for (unsigned i = 0; i < NTHREADS; ++i) {
+		int ret = pmemobj_alloc(pop, &r->objs[i], OBJ_SIZE, 0,
+			NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+		pmemobj_memset_persist(pop, pmemobj_direct(r->objs[i]),
+			obj_value(i), OBJ_SIZE);
+	}
+	pmemobj_persist(pop, r, sizeof(*r));
+
+	os_mutex_init(&lock);
+	os_cond_init(&modified_cond);
+	os_cond_init(&never_cond);
+
+	os_thread_t threads[NTHREADS];
+	unsigned args[NTHREADS];
+	for (unsigned i = 0; i < NTHREADS; ++i) {
+		args[i] = i;
+		THREAD_CREATE(&threads[i], NULL, crash_worker, &args[i]);
+	}
+
+	os_mutex_lock(&lock);
+	while (nmodified != NTHREADS)
+		os_cond_wait(&modified_cond, &lock);
+
+	exit(0); /* simulate a crash */
+}
+
+/*
+ * test_recovery -- opens the pool with the given number of recovery threads
+ *	and checks that all of the transactions were rolled back
+ */
+static void
+test_recovery(const char *path, int nthreads)
+{
+	int value = 0;
+	int ret = pmemobj_ctl_set(NULL, "recovery.threads", &value);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = pmemobj_ctl_set(NULL, "recovery.threads", &nthreads);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(NULL, "recovery.threads", &value);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(value, nthreads);
+
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	struct root *r = pmemobj_direct(pmemobj_root(pop, sizeof(*r)));
+	for (unsigned i = 0; i < NTHREADS; ++i) {
+		unsigned char *data = pmemobj_direct(r->objs[i]);
+		for (size_t j = 0; j < OBJ_SIZE; ++j)
+			UT_ASSERTeq(data[j], obj_value(i));
+
+		/* the recovered lanes can be used again */
+		TX_BEGIN(pop) {
+			pmemobj_tx_add_range(r->objs[i], 0, OBJ_SIZE);
+			memset(data, 0, OBJ_SIZE);
+			pmemobj_tx_abort(ECANCELED);
+		} TX_END
+
+		UT_ASSERTeq(data[OBJ_SIZE - 1], obj_value(i));
+	}
+
+	pmemobj_close(pop);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_lane_recovery");
+
+	if (argc < 3)
+		UT_FATAL("usage: %s file c|o [recovery-threads]", argv[0]);
+
+	const char *path = argv[1];
+
+	if (argv[2][0] == 'c') {
+		test_crash(path);
+	} else if (argv[2][0] == 'o') {
+		if (argc != 4)
+			UT_FATAL("missing number of recovery threads");
+		test_recovery(path, atoi(argv[3]));
+	} else {
+		UT_FATAL("invalid command: %s", argv[2]);
+	}
+
+	DONE(NULL);
+}
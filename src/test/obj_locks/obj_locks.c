@@ -2,7 +2,8 @@
 /* Copyright 2016-2020, Intel Corporation */
 
 /*
- * obj_locks.c -- unit test for PMEMmutex, PMEMrwlock and PMEMcond
+ * obj_locks.c -- unit test for PMEMmutex, PMEMrwlock, PMEMcond, PMEMspinlock
+ * and PMEMsrwlock
  */
 #include <sys/param.h>
 #include <string.h>
@@ -12,7 +13,9 @@
 
 #define LAYOUT_NAME "obj_locks"
 #define NUM_THREADS 16
-#define MAX_FUNC 5
+#define MAX_FUNC 9
+#define SRWLOCK_LOOPS 1000
+#define NUM_SRWLOCKS 16
 
 TOID_DECLARE(struct locks, 0);
 
@@ -21,6 +24,9 @@ struct locks {
 	PMEMmutex mtx;
 	PMEMrwlock rwlk;
 	PMEMcond cond;
+	PMEMspinlock spin;
+	PMEMsrwlock srwlk;
+	int pair[2];
 	int data;
 };
 
@@ -132,9 +138,79 @@ do_cond_broadcast(void *arg)
 	return NULL;
 }
 
+/*
+ * do_spinlock_lock -- lock and unlock the spinlock
+ */
+static void *
+do_spinlock_lock(void *arg)
+{
+	struct thread_args *t = (struct thread_args *)arg;
+	struct locks *lock = D_RW(t->lock);
+	pmemobj_spinlock_lock(lock->pop, &lock->spin);
+	lock->data++;
+	pmemobj_persist(lock->pop, &lock->data, sizeof(lock->data));
+	pmemobj_spinlock_unlock(lock->pop, &lock->spin);
+	return NULL;
+}
+
+/*
+ * do_srwlock_wrlock -- lock and unlock the write srwlock
+ */
+static void *
+do_srwlock_wrlock(void *arg)
+{
+	struct thread_args *t = (struct thread_args *)arg;
+	struct locks *lock = D_RW(t->lock);
+	pmemobj_srwlock_wrlock(lock->pop, &lock->srwlk);
+	lock->data++;
+	pmemobj_persist(lock->pop, &lock->data, sizeof(lock->data));
+	pmemobj_srwlock_unlock(lock->pop, &lock->srwlk);
+	return NULL;
+}
+
+/*
+ * do_srwlock_rdlock -- lock and unlock the read srwlock
+ */
+static void *
+do_srwlock_rdlock(void *arg)
+{
+	struct thread_args *t = (struct thread_args *)arg;
+	struct locks *lock = D_RW(t->lock);
+	pmemobj_srwlock_rdlock(lock->pop, &lock->srwlk);
+	pmemobj_srwlock_unlock(lock->pop, &lock->srwlk);
+	return NULL;
+}
+
+/*
+ * do_srwlock_mixed -- half of the threads update both elements of the pair
+ * under the write srwlock, the other half checks them under the read srwlock
+ */
+static void *
+do_srwlock_mixed(void *arg)
+{
+	struct thread_args *t = (struct thread_args *)arg;
+	struct locks *lock = D_RW(t->lock);
+	for (int i = 0; i < SRWLOCK_LOOPS; ++i) {
+		if (t->t_id % 2) {
+			pmemobj_srwlock_rdlock(lock->pop, &lock->srwlk);
+			UT_ASSERTeq(lock->pair[0], lock->pair[1]);
+			pmemobj_srwlock_unlock(lock->pop, &lock->srwlk);
+		} else {
+			pmemobj_srwlock_wrlock(lock->pop, &lock->srwlk);
+			lock->pair[0]++;
+			lock->pair[1]++;
+			pmemobj_srwlock_unlock(lock->pop, &lock->srwlk);
+		}
+	}
+
+	return do_srwlock_wrlock(arg);
+}
+
 static fn_lock do_lock[MAX_FUNC] = {do_mutex_lock, do_rwlock_wrlock,
 				do_rwlock_rdlock, do_cond_signal,
-				do_cond_broadcast};
+				do_cond_broadcast, do_spinlock_lock,
+				do_srwlock_wrlock, do_srwlock_rdlock,
+				do_srwlock_mixed};
 
 /*
  * do_lock_init -- initialize all types of locks
@@ -145,6 +221,10 @@ do_lock_init(struct locks *lock)
 	pmemobj_mutex_zero(lock->pop, &lock->mtx);
 	pmemobj_rwlock_zero(lock->pop, &lock->rwlk);
 	pmemobj_cond_zero(lock->pop, &lock->cond);
+	pmemobj_spinlock_zero(lock->pop, &lock->spin);
+	pmemobj_srwlock_zero(lock->pop, &lock->srwlk);
+	lock->pair[0] = 0;
+	lock->pair[1] = 0;
 }
 
 /*
@@ -172,6 +252,81 @@ do_lock_mt(TOID(struct locks) lock, unsigned f_num)
 					(D_RO(lock)->data == 0));
 }
 
+struct reopen_root {
+	PMEMspinlock spin;
+	PMEMsrwlock srwlk[NUM_SRWLOCKS];
+};
+
+/*
+ * test_srwlock -- check the try variants and the unlocking of a srwlock, take
+ * more read locks than fit in the reader indicators of a thread
+ */
+static void
+test_srwlock(PMEMobjpool *pop, struct reopen_root *root)
+{
+	UT_ASSERTeq(pmemobj_srwlock_unlock(pop, &root->srwlk[0]), EPERM);
+
+	for (int i = 0; i < NUM_SRWLOCKS; ++i) {
+		UT_ASSERTeq(pmemobj_srwlock_rdlock(pop, &root->srwlk[i]), 0);
+		UT_ASSERTeq(pmemobj_srwlock_tryrdlock(pop, &root->srwlk[i]),
+			0);
+	}
+
+	for (int i = 0; i < NUM_SRWLOCKS; ++i) {
+		UT_ASSERTeq(pmemobj_srwlock_trywrlock(pop, &root->srwlk[i]),
+			EBUSY);
+		UT_ASSERTeq(pmemobj_srwlock_unlock(pop, &root->srwlk[i]), 0);
+		UT_ASSERTeq(pmemobj_srwlock_unlock(pop, &root->srwlk[i]), 0);
+		UT_ASSERTeq(pmemobj_srwlock_unlock(pop, &root->srwlk[i]),
+			EPERM);
+	}
+
+	UT_ASSERTeq(pmemobj_srwlock_trywrlock(pop, &root->srwlk[0]), 0);
+	UT_ASSERTeq(pmemobj_srwlock_tryrdlock(pop, &root->srwlk[0]), EBUSY);
+	UT_ASSERTeq(pmemobj_srwlock_trywrlock(pop, &root->srwlk[0]), EBUSY);
+	UT_ASSERTeq(pmemobj_srwlock_unlock(pop, &root->srwlk[0]), 0);
+	UT_ASSERTeq(pmemobj_srwlock_unlock(pop, &root->srwlk[0]), EPERM);
+}
+
+/*
+ * test_reopen -- check that locks left locked are unlocked after the pool is
+ * reopened
+ */
+static void
+test_reopen(PMEMobjpool *pop, const char *path)
+{
+	struct reopen_root *root =
+		pmemobj_direct(pmemobj_root(pop, sizeof(*root)));
+
+	test_srwlock(pop, root);
+
+	UT_ASSERTeq(pmemobj_spinlock_unlock(pop, &root->spin), EPERM);
+	UT_ASSERTeq(pmemobj_spinlock_trylock(pop, &root->spin), 0);
+	UT_ASSERTeq(pmemobj_spinlock_trylock(pop, &root->spin), EBUSY);
+
+	UT_ASSERTeq(pmemobj_srwlock_wrlock(pop, &root->srwlk[0]), 0);
+	UT_ASSERTeq(pmemobj_srwlock_rdlock(pop, &root->srwlk[1]), 0);
+
+	pmemobj_close(pop);
+
+	if ((pop = pmemobj_open(path, LAYOUT_NAME)) == NULL)
+		UT_FATAL("!pmemobj_open");
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(*root)));
+
+	UT_ASSERTeq(pmemobj_spinlock_trylock(pop, &root->spin), 0);
+	UT_ASSERTeq(pmemobj_spinlock_unlock(pop, &root->spin), 0);
+	UT_ASSERTeq(pmemobj_spinlock_unlock(pop, &root->spin), EPERM);
+
+	for (int i = 0; i < 2; ++i) {
+		UT_ASSERTeq(pmemobj_srwlock_trywrlock(pop, &root->srwlk[i]),
+			0);
+		UT_ASSERTeq(pmemobj_srwlock_unlock(pop, &root->srwlk[i]), 0);
+	}
+
+	pmemobj_close(pop);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -195,6 +350,7 @@ main(int argc, char *argv[])
 
 	POBJ_FREE(&lock);
 
-	pmemobj_close(pop);
+	test_reopen(pop, argv[1]);
+
 	DONE(NULL);
 }
@@ -51,7 +51,8 @@ redo_log_constructor(void *ctx, void *ptr, size_t usable_size, void *arg)
 }
 
 static int
-pmalloc_redo_extend(void *base, uint64_t *redo, uint64_t gen_num)
+pmalloc_redo_extend(void *base, uint64_t *redo, uint64_t gen_num,
+	size_t min_size)
 {
 	size_t s = SIZEOF_ALIGNED_ULOG(TEST_ENTRIES);
 
@@ -91,7 +92,7 @@ test_set_entries(PMEMobjpool *pop,
 			break;
 			case FAIL_MODIFY_NEXT:
 				pmalloc_redo_extend(pop,
-					&object->redo.next, 0);
+					&object->redo.next, 0, 0);
 			break;
 			case FAIL_MODIFY_VALUE:
 				object->redo.data[16] += 8;
@@ -156,6 +157,24 @@ test_same_twice(struct operation_context *ctx, struct test_object *object)
 	operation_cancel(ctx);
 }
 
+static void
+test_redo_buffer_set(struct operation_context *ctx, struct test_object *object)
+{
+	operation_start(ctx);
+
+	int c = 0xab;
+
+	operation_add_buffer(ctx,
+		&object->values, &c, sizeof(*object->values) * TEST_VALUES,
+		ULOG_OPERATION_BUF_SET);
+
+	operation_process(ctx);
+	operation_finish(ctx, 0);
+
+	for (size_t i = 0; i < TEST_VALUES; ++i)
+		UT_ASSERTeq(object->values[i], 0xabababababababab);
+}
+
 static void
 test_redo(PMEMobjpool *pop, struct test_object *object)
 {
@@ -193,6 +212,8 @@ test_redo(PMEMobjpool *pop, struct test_object *object)
 	clear_test_values(object);
 	test_same_twice(ctx, object);
 	clear_test_values(object);
+	test_redo_buffer_set(ctx, object);
+	clear_test_values(object);
 	operation_delete(ctx);
 
 	/*
@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_replica_async.c -- unit test for the asynchronous replica writers
+ *
+ * usage: obj_replica_async poolset replica-file...
+ *
+ * Every replica of the pool set has to consist of a single part.
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "obj_replica_async"
+
+#define THREADS 4
+#define LOOPS 64
+#define WORDS 64
+#define BUF_SIZE 4096
+
+struct root {
+	uint64_t slots[THREADS][WORDS]; /* transactions */
+	unsigned char bufs[THREADS][BUF_SIZE]; /* memcpy_persist */
+	unsigned char areas[THREADS][BUF_SIZE]; /* memset, drain */
+	uint64_t words[THREADS][WORDS]; /* stores, flush, drain */
+};
+
+static PMEMobjpool *pop;
+static struct root *root;
+
+/*
+ * buf_byte -- returns the byte copied to the buffer in the iteration
+ */
+static unsigned char
+buf_byte(unsigned idx, uint64_t i, size_t off)
+{
+	return (unsigned char)(idx * 31 + i * 7 + off);
+}
+
+/*
+ * area_byte -- returns the byte the area is set to in the iteration
+ */
+static unsigned char
+area_byte(unsigned idx, uint64_t i)
+{
+	return (unsigned char)(idx * 17 + i);
+}
+
+/*
+ * writer -- modifies the parts of the root object that belong to the thread
+ *	through all of the ways that reach the replicas
+ */
+static void *
+writer(void *arg)
+{
+	unsigned idx = *(unsigned *)arg;
+	unsigned char src[BUF_SIZE];
+
+	for (uint64_t i = 1; i <= LOOPS; ++i) {
+		TX_BEGIN(pop) {
+			pmemobj_tx_add_range_direct(root->slots[idx],
+				sizeof(root->slots[idx]));
+			for (unsigned w = 0; w < WORDS; ++w)
+				root->slots[idx][w] = i;
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+
+		for (size_t off = 0; off < BUF_SIZE; ++off)
+			src[off] = buf_byte(idx, i, off);
+		pmemobj_memcpy_persist(pop, root->bufs[idx], src, BUF_SIZE);
+
+		pmemobj_memset(pop, root->areas[idx], area_byte(idx, i),
+			BUF_SIZE, PMEMOBJ_F_MEM_NODRAIN);
+		pmemobj_drain(pop);
+
+		for (unsigned w = 0; w < WORDS; ++w)
+			root->words[idx][w] = i * w;
+		pmemobj_flush(pop, root->words[idx], sizeof(root->words[idx]));
+		pmemobj_drain(pop);
+	}
+
+	return NULL;
+}
+
+/*
+ * check_root -- checks the final contents of the root object
+ */
+static void
+check_root(const struct root *r)
+{
+	for (unsigned idx = 0; idx < THREADS; ++idx) {
+		for (unsigned w = 0; w < WORDS; ++w) {
+			UT_ASSERTeq(r->slots[idx][w], LOOPS);
+			UT_ASSERTeq(r->words[idx][w], (uint64_t)LOOPS * w);
+		}
+
+		for (size_t off = 0; off < BUF_SIZE; ++off) {
+			UT_ASSERTeq(r->bufs[idx][off],
+				buf_byte(idx, LOOPS, off));
+			UT_ASSERTeq(r->areas[idx][off],
+				area_byte(idx, LOOPS));
+		}
+	}
+}
+
+/*
+ * check_replica -- checks the root object in the file of the replica
+ */
+static void
+check_replica(const char *path, uint64_t root_off)
+{
+	struct root *r = MALLOC(sizeof(*r));
+
+	int fd = OPEN(path, O_RDONLY);
+	LSEEK(fd, (os_off_t)root_off, SEEK_SET);
+	UT_ASSERTeq(READ(fd, r, sizeof(*r)), sizeof(*r));
+	CLOSE(fd);
+
+	check_root(r);
+
+	FREE(r);
+}
+
+/*
+ * test_ctl -- reads and sets the replica.async switch
+ */
+static void
+test_ctl(int enable)
+{
+	int async = !enable;
+	UT_ASSERTeq(pmemobj_ctl_set(NULL, "replica.async", &enable), 0);
+	UT_ASSERTeq(pmemobj_ctl_get(NULL, "replica.async", &async), 0);
+	UT_ASSERTeq(async, enable);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_replica_async");
+
+	if (argc < 3)
+		UT_FATAL("usage: %s poolset replica-file...", argv[0]);
+
+	const char *path = argv[1];
+
+	test_ctl(1);
+
+	if ((pop = pmemobj_create(path, LAYOUT, 0, S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	PMEMoid oid = pmemobj_root(pop, sizeof(struct root));
+	root = pmemobj_direct(oid);
+	uint64_t root_off = oid.off;
+
+	os_thread_t threads[THREADS];
+	unsigned idx[THREADS];
+
+	for (unsigned i = 0; i < THREADS; ++i) {
+		idx[i] = i;
+		THREAD_CREATE(&threads[i], NULL, writer, &idx[i]);
+	}
+
+	for (unsigned i = 0; i < THREADS; ++i)
+		THREAD_JOIN(&threads[i], NULL);
+
+	check_root(root);
+
+	pmemobj_close(pop);
+
+	/* all of the replicas got all of the writes */
+	for (int i = 2; i < argc; ++i)
+		check_replica(argv[i], root_off);
+
+	/* the synchronous replication still works with the same pool */
+	test_ctl(0);
+
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+	check_root(root);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
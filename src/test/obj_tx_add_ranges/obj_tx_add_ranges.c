@@ -0,0 +1,278 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_tx_add_ranges.c -- unit test for pmemobj_tx_add_ranges
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "obj_tx_add_ranges"
+
+#define NFIELDS 512
+#define NBLOCKS 64
+#define BLK_SIZE 4096 /* all of the blocks require extending the undo log */
+
+struct root {
+	uint64_t fields[NFIELDS];
+	unsigned char blocks[NBLOCKS][BLK_SIZE];
+};
+
+static PMEMobjpool *pop;
+static struct root *root;
+
+/*
+ * set_fields -- sets the fields to their indexes plus the value
+ */
+static void
+set_fields(uint64_t value)
+{
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(root->fields,
+			sizeof(root->fields));
+		for (uint64_t i = 0; i < NFIELDS; ++i)
+			root->fields[i] = i + value;
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+/*
+ * check_fields -- checks that the fields are set to their indexes plus the
+ *	value
+ */
+static void
+check_fields(uint64_t value)
+{
+	for (uint64_t i = 0; i < NFIELDS; ++i)
+		UT_ASSERTeq(root->fields[i], i + value);
+}
+
+/*
+ * test_scattered -- adds unsorted, overlapping and adjacent ranges, including
+ *	ones which are already part of the transaction
+ */
+static void
+test_scattered(int abort)
+{
+	set_fields(0);
+
+	static const size_t idx[] = {300, 7, 8, 9, 100, 5, 301, 7, 400, 200};
+	static const size_t len[] = {10, 1, 1, 1, 50, 3, 20, 2, 1, 1};
+	size_t n = sizeof(idx) / sizeof(idx[0]);
+	struct pobj_tx_range ranges[sizeof(idx) / sizeof(idx[0])];
+
+	for (size_t i = 0; i < n; ++i) {
+		ranges[i].ptr = &root->fields[idx[i]];
+		ranges[i].size = len[i] * sizeof(uint64_t);
+		ranges[i].flags = 0;
+	}
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(&root->fields[120], 100);
+		UT_ASSERTeq(pmemobj_tx_add_ranges(ranges, n), 0);
+
+		for (size_t i = 0; i < n; ++i) {
+			for (size_t j = 0; j < len[i]; ++j)
+				root->fields[idx[i] + j] = 0;
+		}
+
+		if (abort)
+			pmemobj_tx_abort(ECANCELED);
+	} TX_ONABORT {
+		UT_ASSERT(abort);
+	} TX_ONCOMMIT {
+		UT_ASSERT(!abort);
+	} TX_END
+
+	if (abort) {
+		check_fields(0);
+		return;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		for (size_t j = 0; j < len[i]; ++j)
+			UT_ASSERTeq(root->fields[idx[i] + j], 0);
+	}
+	UT_ASSERTeq(root->fields[4], 4);
+	UT_ASSERTeq(root->fields[10], 10);
+	UT_ASSERTeq(root->fields[321], 321);
+}
+
+/*
+ * test_flags -- ranges with different flags aren't merged
+ */
+static void
+test_flags(void)
+{
+	set_fields(0);
+
+	struct pobj_tx_range ranges[] = {
+		{&root->fields[0], 8 * sizeof(uint64_t), 0},
+		{&root->fields[8], 8 * sizeof(uint64_t),
+			POBJ_XADD_NO_SNAPSHOT},
+		{&root->fields[16], 8 * sizeof(uint64_t), 0},
+	};
+
+	TX_BEGIN(pop) {
+		UT_ASSERTeq(pmemobj_tx_add_ranges(ranges, 3), 0);
+		for (uint64_t i = 0; i < 24; ++i)
+			root->fields[i] = 1000;
+		pmemobj_tx_abort(ECANCELED);
+	} TX_END
+
+	for (uint64_t i = 0; i < 24; ++i)
+		UT_ASSERTeq(root->fields[i], i >= 8 && i < 16 ? 1000 : i);
+}
+
+/*
+ * test_large -- adds ranges which don't fit in the undo log of the lane
+ */
+static void
+test_large(int abort)
+{
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(root->blocks, sizeof(root->blocks));
+		memset(root->blocks, 0, sizeof(root->blocks));
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	struct pobj_tx_range ranges[NBLOCKS / 2];
+	for (size_t i = 0; i < NBLOCKS / 2; ++i) {
+		/* every other block, back to front */
+		ranges[i].ptr = root->blocks[NBLOCKS - 2 * i - 1];
+		ranges[i].size = BLK_SIZE;
+		ranges[i].flags = 0;
+	}
+
+	TX_BEGIN(pop) {
+		UT_ASSERTeq(pmemobj_tx_add_ranges(ranges, NBLOCKS / 2), 0);
+		for (size_t i = 0; i < NBLOCKS / 2; ++i)
+			memset(root->blocks[2 * i + 1], 0xab, BLK_SIZE);
+
+		if (abort)
+			pmemobj_tx_abort(ECANCELED);
+	} TX_ONABORT {
+		UT_ASSERT(abort);
+	} TX_ONCOMMIT {
+		UT_ASSERT(!abort);
+	} TX_END
+
+	for (size_t i = 0; i < NBLOCKS; ++i) {
+		unsigned char c = (i % 2 == 1 && !abort) ? 0xab : 0;
+		UT_ASSERTeq(root->blocks[i][0], c);
+		UT_ASSERTeq(root->blocks[i][BLK_SIZE - 1], c);
+	}
+}
+
+/*
+ * test_savepoint -- ranges added after a savepoint are rolled back
+ */
+static void
+test_savepoint(void)
+{
+	set_fields(0);
+
+	struct pobj_tx_range ranges[] = {
+		{&root->fields[0], 4 * sizeof(uint64_t), 0},
+		{&root->fields[2], 4 * sizeof(uint64_t), 0},
+	};
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(&root->fields[4], sizeof(uint64_t));
+		root->fields[4] = 44;
+
+		struct pobj_tx_savepoint *sp = pmemobj_tx_savepoint();
+		UT_ASSERTeq(pmemobj_tx_add_ranges(ranges, 2), 0);
+		for (uint64_t i = 0; i < 6; ++i)
+			root->fields[i] = 1000;
+
+		UT_ASSERTeq(pmemobj_tx_rollback_to(sp), 0);
+		UT_ASSERTeq(root->fields[3], 3);
+		UT_ASSERTeq(root->fields[4], 44);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(root->fields[0], 0);
+	UT_ASSERTeq(root->fields[4], 44);
+	UT_ASSERTeq(root->fields[5], 5);
+}
+
+/*
+ * test_invalid -- invalid ranges fail the call, the transaction is aborted
+ *	unless the invalid range has the NO_ABORT flag
+ */
+static void
+test_invalid(void)
+{
+	set_fields(0);
+
+	uint64_t outside = 0;
+	struct pobj_tx_range ranges[] = {
+		{&root->fields[0], sizeof(uint64_t), 0},
+		{&root->fields[1], sizeof(uint64_t), 0},
+		{&outside, sizeof(outside), POBJ_XADD_NO_ABORT},
+	};
+
+	TX_BEGIN(pop) {
+		UT_ASSERTeq(pmemobj_tx_add_ranges(ranges, 3), EINVAL);
+		UT_ASSERTeq(errno, EINVAL);
+
+		ranges[2].ptr = &root->fields[2];
+		ranges[2].flags = UINT64_MAX;
+		UT_ASSERTeq(pmemobj_tx_add_ranges(ranges, 3), EINVAL);
+
+		ranges[2].flags = POBJ_XADD_NO_ABORT;
+		UT_ASSERTeq(pmemobj_tx_add_ranges(ranges, 3), 0);
+		UT_ASSERTeq(pmemobj_tx_add_ranges(NULL, 0), 0);
+		root->fields[1] = 1000;
+	} TX_ONCOMMIT {
+		UT_ASSERTeq(root->fields[1], 1000);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	/* the flag of another range doesn't prevent the abort */
+	ranges[1].flags = POBJ_XADD_NO_ABORT;
+	ranges[2].ptr = &outside;
+	ranges[2].flags = 0;
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_ranges(ranges, 3);
+		UT_ASSERT(0);
+	} TX_ONABORT {
+		UT_ASSERTeq(errno, EINVAL);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_add_ranges");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 4,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(*root)));
+
+	test_scattered(0);
+	test_scattered(1);
+	test_flags();
+	test_large(0);
+	test_large(1);
+	test_savepoint();
+	test_invalid();
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
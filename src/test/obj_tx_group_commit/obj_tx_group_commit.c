@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_tx_group_commit.c -- unit test for group commit of transactions
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "obj_tx_group_commit"
+
+#define THREADS 8
+#define LOOPS 64
+#define SLOT_WORDS 8 /* 64 bytes */
+
+#define TYPE_NUM 1
+
+struct root {
+	uint64_t slots[THREADS][SLOT_WORDS];
+	PMEMoid objs[THREADS];
+};
+
+static PMEMobjpool *pop;
+static struct root *root;
+
+/*
+ * set_slot -- sets all of the words of the slot to the value
+ */
+static void
+set_slot(unsigned idx, uint64_t value)
+{
+	pmemobj_tx_add_range_direct(root->slots[idx],
+		sizeof(root->slots[idx]));
+	for (int i = 0; i < SLOT_WORDS; ++i)
+		root->slots[idx][i] = value;
+}
+
+/*
+ * check_slot -- checks that all of the words of the slot are set to the value
+ */
+static void
+check_slot(unsigned idx, uint64_t value)
+{
+	for (int i = 0; i < SLOT_WORDS; ++i)
+		UT_ASSERTeq(root->slots[idx][i], value);
+}
+
+/*
+ * commit_sync -- updates the slot of the thread in transactions committed
+ *	with pmemobj_tx_commit
+ */
+static void *
+commit_sync(void *arg)
+{
+	unsigned idx = *(unsigned *)arg;
+
+	for (uint64_t i = 1; i <= LOOPS; ++i) {
+		TX_BEGIN(pop) {
+			set_slot(idx, i);
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+
+		check_slot(idx, i);
+	}
+
+	return NULL;
+}
+
+/*
+ * commit_async -- updates the slot of the thread and allocates an object in
+ *	transactions committed with pmemobj_tx_commit_async
+ */
+static void *
+commit_async(void *arg)
+{
+	unsigned idx = *(unsigned *)arg;
+
+	for (uint64_t i = 1; i <= LOOPS; ++i) {
+		volatile int committed = 0;
+
+		TX_BEGIN(pop) {
+			set_slot(idx, i);
+
+			pmemobj_tx_add_range_direct(&root->objs[idx],
+				sizeof(PMEMoid));
+			if (!OID_IS_NULL(root->objs[idx]))
+				pmemobj_tx_free(root->objs[idx]);
+			root->objs[idx] = pmemobj_tx_alloc(sizeof(uint64_t),
+				TYPE_NUM);
+
+			pmemobj_tx_commit_async();
+
+			/* the commit isn't completed yet */
+			UT_ASSERTeq(pmemobj_tx_stage(), TX_STAGE_WORK);
+
+			/*
+			 * every other transaction is completed by TX_END,
+			 * which then runs the TX_ONCOMMIT block
+			 */
+			if (i % 2 == 0) {
+				pmemobj_tx_wait();
+				UT_ASSERTeq(pmemobj_tx_stage(),
+					TX_STAGE_ONCOMMIT);
+			}
+		} TX_ONCOMMIT {
+			committed = 1;
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+
+		UT_ASSERTeq(committed, i % 2);
+		check_slot(idx, i);
+	}
+
+	return NULL;
+}
+
+/*
+ * run_threads -- runs the function in all of the threads and checks their
+ *	slots afterwards
+ */
+static void
+run_threads(void *(*func)(void *))
+{
+	os_thread_t threads[THREADS];
+	unsigned idx[THREADS];
+
+	for (unsigned i = 0; i < THREADS; ++i) {
+		idx[i] = i;
+		THREAD_CREATE(&threads[i], NULL, func, &idx[i]);
+	}
+
+	for (unsigned i = 0; i < THREADS; ++i)
+		THREAD_JOIN(&threads[i], NULL);
+
+	for (unsigned i = 0; i < THREADS; ++i)
+		check_slot(i, LOOPS);
+}
+
+/*
+ * reset_slots -- zeroes all of the slots
+ */
+static void
+reset_slots(void)
+{
+	TX_BEGIN(pop) {
+		for (unsigned i = 0; i < THREADS; ++i)
+			set_slot(i, 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+/*
+ * test_ctl -- reads and sets the group commit switch
+ */
+static void
+test_ctl(int enable)
+{
+	int group = !enable;
+	UT_ASSERTeq(pmemobj_ctl_set(pop, "tx.commit.group", &enable), 0);
+	UT_ASSERTeq(pmemobj_ctl_get(pop, "tx.commit.group", &group), 0);
+	UT_ASSERTeq(group, enable);
+}
+
+/*
+ * test_nested -- pmemobj_tx_commit_async in a nested transaction commits it
+ *	right away, pmemobj_tx_wait without a started commit does nothing
+ */
+static void
+test_nested(void)
+{
+	pmemobj_tx_wait();
+
+	TX_BEGIN(pop) {
+		set_slot(0, 1);
+
+		TX_BEGIN(pop) {
+			set_slot(1, 1);
+			pmemobj_tx_commit_async();
+			UT_ASSERTeq(pmemobj_tx_stage(), TX_STAGE_ONCOMMIT);
+			pmemobj_tx_wait();
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+
+		pmemobj_tx_wait();
+		UT_ASSERTeq(pmemobj_tx_stage(), TX_STAGE_WORK);
+
+		pmemobj_tx_commit_async();
+		pmemobj_tx_commit_async();
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_slot(0, 1);
+	check_slot(1, 1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_group_commit");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 4,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(*root)));
+
+	test_ctl(1);
+	run_threads(commit_sync);
+	reset_slots();
+
+	test_ctl(0);
+	run_threads(commit_sync);
+	reset_slots();
+
+	run_threads(commit_async);
+	test_nested();
+
+	pmemobj_close(pop);
+
+	/* the data is persistent */
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(*root)));
+
+	for (unsigned i = 2; i < THREADS; ++i)
+		check_slot(i, LOOPS);
+
+	unsigned n = 0;
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		if (pmemobj_type_num(oid) == TYPE_NUM)
+			n++;
+	}
+	UT_ASSERTeq(n, THREADS);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
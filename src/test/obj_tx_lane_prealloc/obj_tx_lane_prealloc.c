@@ -0,0 +1,334 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_tx_lane_prealloc.c -- tests for the preallocation of lane logs
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "obj_tx_lane_prealloc"
+
+#define OBJ_SIZE (64 * 1024)
+#define SNAPSHOT_SIZE (48 * 1024) /* requires extending the undo log */
+#define NALLOCS 100 /* requires extending the redo log */
+
+#define UNDO_PREALLOC (128 * 1024)
+#define REDO_PREALLOC (16 * 1024)
+
+#define NLANES "4"
+#define NTHREADS 4
+#define CONFIG "tx.lane.undo_prealloc=131072;tx.lane.redo_prealloc=16384"
+
+static PMEMobjpool *pop;
+static PMEMoid oid;
+static int Stop;
+
+struct extensions {
+	uint64_t undo;
+	uint64_t redo;
+};
+
+/*
+ * get_extensions -- reads the number of log extensions of the pool
+ */
+static void
+get_extensions(struct extensions *e)
+{
+	int ret = pmemobj_ctl_get(pop, "stats.tx.undo_extensions", &e->undo);
+	UT_ASSERTeq(ret, 0);
+	ret = pmemobj_ctl_get(pop, "stats.tx.redo_extensions", &e->redo);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * tx_large_snapshot -- snapshots and modifies a large part of the object,
+ *	aborting the transaction if requested
+ */
+static void
+tx_large_snapshot(unsigned char value, int abort)
+{
+	unsigned char *data = pmemobj_direct(oid);
+	unsigned char prev = data[0];
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(oid, 0, SNAPSHOT_SIZE);
+		memset(data, value, SNAPSHOT_SIZE);
+		if (abort)
+			pmemobj_tx_abort(ECANCELED);
+	} TX_ONABORT {
+		UT_ASSERT(abort);
+	} TX_ONCOMMIT {
+		UT_ASSERT(!abort);
+	} TX_END
+
+	unsigned char expected = abort ? prev : value;
+	for (size_t i = 0; i < SNAPSHOT_SIZE; ++i)
+		UT_ASSERTeq(data[i], expected);
+}
+
+/*
+ * tx_many_allocs -- allocates and frees many objects in transactions
+ */
+static void
+tx_many_allocs(void)
+{
+	PMEMoid oids[NALLOCS];
+
+	TX_BEGIN(pop) {
+		for (int i = 0; i < NALLOCS; ++i)
+			oids[i] = pmemobj_tx_alloc(64, 1);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	TX_BEGIN(pop) {
+		for (int i = 0; i < NALLOCS; ++i)
+			pmemobj_tx_free(oids[i]);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+/*
+ * test_ctl -- the preallocation is disabled by default and invalid values are
+ *	rejected
+ */
+static void
+test_ctl(void)
+{
+	long long value;
+	int ret = pmemobj_ctl_get(pop, "tx.lane.undo_prealloc", &value);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(value, 0);
+
+	ret = pmemobj_ctl_get(pop, "tx.lane.redo_prealloc", &value);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(value, 0);
+
+	value = -1;
+	ret = pmemobj_ctl_set(pop, "tx.lane.undo_prealloc", &value);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = pmemobj_ctl_set(pop, "tx.lane.redo_prealloc", &value);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+}
+
+/*
+ * test_no_prealloc -- without the preallocation, every large transaction
+ *	extends its logs
+ */
+static void
+test_no_prealloc(void)
+{
+	struct extensions before;
+	struct extensions after;
+
+	/* the first extension of the undo log is kept anyway */
+	tx_large_snapshot(1, 0);
+
+	get_extensions(&before);
+	tx_large_snapshot(2, 0);
+	tx_many_allocs();
+	get_extensions(&after);
+
+	UT_ASSERT(after.undo > before.undo);
+	UT_ASSERT(after.redo > before.redo);
+}
+
+/*
+ * test_steady_state -- once the logs are preallocated, the transactions which
+ *	fit in them don't allocate any log space
+ */
+static void
+test_steady_state(void)
+{
+	struct extensions before;
+	struct extensions after;
+
+	get_extensions(&before);
+
+	for (unsigned char i = 0; i < 4; ++i) {
+		tx_large_snapshot(i, 0);
+		tx_large_snapshot((unsigned char)(i + 0x10), 1);
+		tx_many_allocs();
+	}
+
+	get_extensions(&after);
+
+	UT_ASSERTeq(after.undo, before.undo);
+	UT_ASSERTeq(after.redo, before.redo);
+}
+
+/*
+ * test_prealloc -- setting the preallocation extends the logs immediately
+ */
+static void
+test_prealloc(void)
+{
+	struct extensions before;
+	struct extensions after;
+
+	get_extensions(&before);
+
+	long long value = UNDO_PREALLOC;
+	int ret = pmemobj_ctl_set(pop, "tx.lane.undo_prealloc", &value);
+	UT_ASSERTeq(ret, 0);
+
+	value = REDO_PREALLOC;
+	ret = pmemobj_ctl_set(pop, "tx.lane.redo_prealloc", &value);
+	UT_ASSERTeq(ret, 0);
+
+	get_extensions(&after);
+	UT_ASSERT(after.undo > before.undo);
+	UT_ASSERT(after.redo > before.redo);
+
+	test_steady_state();
+}
+
+/*
+ * test_busy -- the logs can't be preallocated by a thread which holds a lane,
+ *	it would wait for itself
+ */
+static void
+test_busy(void)
+{
+	TX_BEGIN(pop) {
+		long long value = UNDO_PREALLOC;
+		int ret = pmemobj_ctl_set(pop, "tx.lane.undo_prealloc",
+			&value);
+		UT_ASSERTeq(ret, -1);
+		UT_ASSERTeq(errno, EBUSY);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+/*
+ * allocator -- runs transactions until stopped
+ */
+static void *
+allocator(void *arg)
+{
+	int stop = 0;
+	while (!stop) {
+		tx_many_allocs();
+		util_atomic_load_explicit32(&Stop, &stop,
+			memory_order_acquire);
+	}
+
+	return NULL;
+}
+
+/*
+ * test_concurrent -- the logs of the lanes used by other threads are
+ *	preallocated once the lanes are released
+ */
+static void
+test_concurrent(void)
+{
+	os_thread_t threads[NTHREADS];
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		THREAD_CREATE(&threads[i], NULL, allocator, NULL);
+
+	struct extensions before;
+	struct extensions after;
+
+	get_extensions(&before);
+
+	long long value = UNDO_PREALLOC * 2;
+	int ret = pmemobj_ctl_set(pop, "tx.lane.undo_prealloc", &value);
+	UT_ASSERTeq(ret, 0);
+
+	value = REDO_PREALLOC * 2;
+	ret = pmemobj_ctl_set(pop, "tx.lane.redo_prealloc", &value);
+	UT_ASSERTeq(ret, 0);
+
+	get_extensions(&after);
+	UT_ASSERT(after.undo > before.undo);
+	UT_ASSERT(after.redo > before.redo);
+
+	util_atomic_store_explicit32(&Stop, 1, memory_order_release);
+
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		THREAD_JOIN(&threads[i], NULL);
+
+	/* the capacity kept between the transactions is lowered back */
+	value = UNDO_PREALLOC;
+	ret = pmemobj_ctl_set(pop, "tx.lane.undo_prealloc", &value);
+	UT_ASSERTeq(ret, 0);
+
+	value = REDO_PREALLOC;
+	ret = pmemobj_ctl_set(pop, "tx.lane.redo_prealloc", &value);
+	UT_ASSERTeq(ret, 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_lane_prealloc");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	/* limit the pool space taken by the preallocated logs */
+	UT_ASSERTeq(os_setenv("PMEMOBJ_NLANES", NLANES, 1), 0);
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 4,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	int ret = pmemobj_zalloc(pop, &oid, OBJ_SIZE, 0);
+	if (ret != 0)
+		UT_FATAL("!pmemobj_zalloc");
+
+	test_ctl();
+	test_no_prealloc();
+	test_prealloc();
+	test_busy();
+	test_concurrent();
+
+	pmemobj_close(pop);
+
+	/* the preallocated logs are kept in the pool between its openings */
+	UT_ASSERTeq(os_setenv("PMEMOBJ_CONF", CONFIG, 1), 0);
+
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	long long value;
+	ret = pmemobj_ctl_get(pop, "tx.lane.undo_prealloc", &value);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(value, UNDO_PREALLOC);
+
+	oid = POBJ_FIRST_TYPE_NUM(pop, 0);
+	test_steady_state();
+
+	pmemobj_close(pop);
+
+	/* the logs requested by the configuration are extended at create */
+	UNLINK(path);
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 4,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	struct extensions e;
+	get_extensions(&e);
+	UT_ASSERTne(e.undo, 0);
+	UT_ASSERTne(e.redo, 0);
+
+	ret = pmemobj_zalloc(pop, &oid, OBJ_SIZE, 0);
+	if (ret != 0)
+		UT_FATAL("!pmemobj_zalloc");
+
+	test_steady_state();
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
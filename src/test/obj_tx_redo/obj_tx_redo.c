@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_tx_redo.c -- unit test for redo transactions and pmemobj_tx_write
+ */
+
+#include "unittest.h"
+
+#define LAYOUT_NAME "obj_tx_redo"
+
+#define DATA_SIZE 8192 /* spans multiple redo log extensions */
+
+struct root {
+	uint64_t values[8];
+	unsigned char data[DATA_SIZE];
+};
+
+static PMEMobjpool *pop;
+static struct root *root;
+
+/*
+ * tx_write_value -- writes a single value within the transaction
+ */
+static void
+tx_write_value(uint64_t *ptr, uint64_t value)
+{
+	int ret = pmemobj_tx_write(ptr, &value, sizeof(value));
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * tx_read_value -- reads a single value within the transaction
+ */
+static uint64_t
+tx_read_value(const uint64_t *ptr)
+{
+	uint64_t value;
+	int ret = pmemobj_tx_read(ptr, &value, sizeof(value));
+	UT_ASSERTeq(ret, 0);
+
+	return value;
+}
+
+/*
+ * test_commit -- buffered writes are visible to reads within the
+ *	transaction, but only reach persistent memory on commit
+ */
+static void
+test_commit(void)
+{
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO, TX_PARAM_NONE) {
+		tx_write_value(&root->values[0], 1);
+		tx_write_value(&root->values[1], 2);
+
+		UT_ASSERTeq(root->values[0], 0);
+		UT_ASSERTeq(root->values[1], 0);
+
+		UT_ASSERTeq(tx_read_value(&root->values[0]), 1);
+		UT_ASSERTeq(tx_read_value(&root->values[1]), 2);
+		UT_ASSERTeq(tx_read_value(&root->values[2]), 0);
+
+		/* a nested transaction inherits the redo flavor */
+		TX_BEGIN(pop) {
+			tx_write_value(&root->values[2], 3);
+			UT_ASSERTeq(root->values[2], 0);
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(root->values[0], 1);
+	UT_ASSERTeq(root->values[1], 2);
+	UT_ASSERTeq(root->values[2], 3);
+}
+
+/*
+ * test_abort -- buffered writes are discarded on abort
+ */
+static void
+test_abort(void)
+{
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO, TX_PARAM_NONE) {
+		tx_write_value(&root->values[0], 10);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(root->values[0], 1);
+}
+
+/*
+ * test_merge -- overlapping and adjacent writes are merged, with the most
+ *	recent data taking precedence
+ */
+static void
+test_merge(void)
+{
+	uint64_t values[8];
+	for (uint64_t i = 0; i < 8; ++i)
+		values[i] = 100 + i;
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO, TX_PARAM_NONE) {
+		/* disjoint ranges, bridged by a write covering both */
+		tx_write_value(&root->values[1], 1000);
+		tx_write_value(&root->values[5], 1000);
+		pmemobj_tx_write(&root->values[0], values,
+			sizeof(uint64_t) * 7);
+
+		/* adjacent on the right, then inside of a buffered range */
+		tx_write_value(&root->values[7], 107);
+		tx_write_value(&root->values[3], 42);
+
+		uint64_t read[8];
+		pmemobj_tx_read(root->values, read, sizeof(read));
+		for (uint64_t i = 0; i < 8; ++i)
+			UT_ASSERTeq(read[i], i == 3 ? 42 : 100 + i);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	for (uint64_t i = 0; i < 8; ++i)
+		UT_ASSERTeq(root->values[i], i == 3 ? 42 : 100 + i);
+}
+
+/*
+ * test_large -- a write larger than a single redo log
+ */
+static void
+test_large(void)
+{
+	unsigned char *buf = MALLOC(DATA_SIZE);
+	for (size_t i = 0; i < DATA_SIZE; ++i)
+		buf[i] = (unsigned char)(i % 251);
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO, TX_PARAM_NONE) {
+		pmemobj_tx_write(root->data + 1, buf, DATA_SIZE - 1);
+		pmemobj_tx_write(root->values, buf, sizeof(root->values));
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(memcmp(root->data + 1, buf, DATA_SIZE - 1), 0);
+	UT_ASSERTeq(memcmp(root->values, buf, sizeof(root->values)), 0);
+
+	FREE(buf);
+}
+
+/*
+ * test_alloc -- writes to objects allocated within the transaction
+ */
+static void
+test_alloc(void)
+{
+	PMEMoid oid = OID_NULL;
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO, TX_PARAM_NONE) {
+		oid = pmemobj_tx_zalloc(sizeof(uint64_t) * 2, 1);
+		uint64_t *obj = pmemobj_direct(oid);
+
+		tx_write_value(&obj[0], 5);
+		UT_ASSERTeq(tx_read_value(&obj[0]), 5);
+		UT_ASSERTeq(tx_read_value(&obj[1]), 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(((uint64_t *)pmemobj_direct(oid))[0], 5);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_free(oid);
+	} TX_END
+}
+
+/*
+ * test_overlap -- writes which partially overlap the snapshotted ranges
+ *	don't overwrite the later in-place modifications of those ranges
+ */
+static void
+test_overlap(void)
+{
+	uint64_t before[8];
+	memcpy(before, root->values, sizeof(before));
+
+	uint64_t values[3] = {200, 201, 202};
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO, TX_PARAM_NONE) {
+		/* overlaps the end of one range and the start of another */
+		pmemobj_tx_add_range_direct(&root->values[2],
+			sizeof(uint64_t) * 2);
+		pmemobj_tx_add_range_direct(&root->values[5],
+			sizeof(uint64_t) * 2);
+		pmemobj_tx_write(&root->values[3], values, sizeof(values));
+
+		root->values[3] = 300;
+		root->values[5] = 301;
+
+		UT_ASSERTeq(tx_read_value(&root->values[3]), 300);
+		UT_ASSERTeq(tx_read_value(&root->values[4]), 201);
+		UT_ASSERTeq(tx_read_value(&root->values[5]), 301);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(root->values[3], 300);
+	UT_ASSERTeq(root->values[4], 201);
+	UT_ASSERTeq(root->values[5], 301);
+
+	memcpy(before, root->values, sizeof(before));
+
+	/* the part outside of the ranges is snapshotted as well */
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO, TX_PARAM_NONE) {
+		pmemobj_tx_add_range_direct(&root->values[2],
+			sizeof(uint64_t) * 2);
+		pmemobj_tx_write(&root->values[3], values, sizeof(values));
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(memcmp(root->values, before, sizeof(before)), 0);
+}
+
+/*
+ * test_undo -- pmemobj_tx_write in a regular transaction
+ */
+static void
+test_undo(void)
+{
+	TX_BEGIN(pop) {
+		tx_write_value(&root->values[0], 7);
+		UT_ASSERTeq(root->values[0], 7);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_END
+
+	UT_ASSERTne(root->values[0], 7);
+
+	TX_BEGIN(pop) {
+		tx_write_value(&root->values[0], 7);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(root->values[0], 7);
+}
+
+/*
+ * test_invalid -- writes outside of the heap fail
+ */
+static void
+test_invalid(void)
+{
+	uint64_t value = 0;
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO, TX_PARAM_NONE) {
+		pmemobj_tx_set_failure_behavior(POBJ_TX_FAILURE_RETURN);
+
+		int ret = pmemobj_tx_write(&value, &value, sizeof(value));
+		UT_ASSERTne(ret, 0);
+		UT_ASSERTeq(errno, EINVAL);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_redo");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s [file]", argv[0]);
+
+	const char *path = argv[1];
+
+	pop = pmemobj_create(path, LAYOUT_NAME, PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create");
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+	UT_ASSERTne(root, NULL);
+
+	test_commit();
+	test_abort();
+	test_merge();
+	test_undo();
+	test_alloc();
+	test_overlap();
+	test_invalid();
+	test_large();
+
+	pmemobj_close(pop);
+
+	/* the committed data survives reopening the pool */
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open");
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+	for (size_t i = 1; i < DATA_SIZE; ++i)
+		UT_ASSERTeq(root->data[i], (unsigned char)((i - 1) % 251));
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
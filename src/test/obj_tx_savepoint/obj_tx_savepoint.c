@@ -0,0 +1,329 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_tx_savepoint.c -- unit test for pmemobj_tx_savepoint and
+ *	pmemobj_tx_rollback_to
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "obj_tx_savepoint"
+
+#define NVALUES 64
+#define LARGE_SIZE (64 * 1024) /* requires extending the undo log */
+
+#define TYPE_NUM 1
+
+struct root {
+	uint64_t a[NVALUES];
+	uint64_t b[NVALUES];
+	unsigned char large[LARGE_SIZE];
+};
+
+static PMEMobjpool *pop;
+static struct root *root;
+
+/*
+ * set_values -- adds the array to the transaction and fills it with the value
+ */
+static void
+set_values(uint64_t *values, uint64_t value)
+{
+	pmemobj_tx_add_range_direct(values, sizeof(uint64_t) * NVALUES);
+	for (int i = 0; i < NVALUES; ++i)
+		values[i] = value;
+}
+
+/*
+ * check_values -- checks that the array is filled with the value
+ */
+static void
+check_values(const uint64_t *values, uint64_t value)
+{
+	for (int i = 0; i < NVALUES; ++i)
+		UT_ASSERTeq(values[i], value);
+}
+
+/*
+ * reset -- sets both arrays to zero
+ */
+static void
+reset(void)
+{
+	TX_BEGIN(pop) {
+		set_values(root->a, 0);
+		set_values(root->b, 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+/*
+ * count_objects -- returns the number of allocated objects of the test type
+ */
+static unsigned
+count_objects(void)
+{
+	unsigned n = 0;
+	PMEMoid oid;
+	for (oid = pmemobj_first(pop); !OID_IS_NULL(oid);
+			oid = pmemobj_next(oid)) {
+		if (pmemobj_type_num(oid) == TYPE_NUM)
+			n++;
+	}
+
+	return n;
+}
+
+/*
+ * test_rollback -- only the changes made after the savepoint are reverted,
+ *	including the ones to ranges snapshotted before it
+ */
+static void
+test_rollback(void)
+{
+	reset();
+
+	TX_BEGIN(pop) {
+		set_values(root->a, 1);
+
+		struct pobj_tx_savepoint *sp = pmemobj_tx_savepoint();
+		UT_ASSERTne(sp, NULL);
+
+		set_values(root->b, 2);
+		set_values(root->a, 3);
+
+		UT_ASSERTeq(pmemobj_tx_rollback_to(sp), 0);
+		check_values(root->a, 1);
+		check_values(root->b, 0);
+
+		set_values(root->b, 4);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_values(root->a, 1);
+	check_values(root->b, 4);
+}
+
+/*
+ * test_abort -- aborting the transaction reverts the changes made both before
+ *	and after the savepoint, with or without a rollback
+ */
+static void
+test_abort(int rollback)
+{
+	reset();
+
+	TX_BEGIN(pop) {
+		set_values(root->a, 1);
+
+		struct pobj_tx_savepoint *sp = pmemobj_tx_savepoint();
+		UT_ASSERTne(sp, NULL);
+
+		set_values(root->a, 2);
+		set_values(root->b, 2);
+
+		if (rollback) {
+			UT_ASSERTeq(pmemobj_tx_rollback_to(sp), 0);
+			check_values(root->a, 1);
+			check_values(root->b, 0);
+			set_values(root->b, 3);
+		}
+
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_values(root->a, 0);
+	check_values(root->b, 0);
+}
+
+/*
+ * test_nested -- a rollback to an older savepoint reverts the changes made
+ *	after all of the newer ones and invalidates them
+ */
+static void
+test_nested(void)
+{
+	reset();
+
+	TX_BEGIN(pop) {
+		struct pobj_tx_savepoint *sp1 = pmemobj_tx_savepoint();
+		set_values(root->a, 1);
+
+		struct pobj_tx_savepoint *sp2 = pmemobj_tx_savepoint();
+		set_values(root->a, 2);
+		set_values(root->b, 2);
+
+		UT_ASSERTeq(pmemobj_tx_rollback_to(sp2), 0);
+		check_values(root->a, 1);
+		check_values(root->b, 0);
+
+		/* the savepoint can be used again */
+		set_values(root->a, 3);
+		UT_ASSERTeq(pmemobj_tx_rollback_to(sp2), 0);
+		check_values(root->a, 1);
+
+		set_values(root->b, 4);
+
+		/* a nested transaction shares the savepoints */
+		TX_BEGIN(pop) {
+			set_values(root->a, 5);
+			UT_ASSERTeq(pmemobj_tx_rollback_to(sp1), 0);
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+
+		check_values(root->a, 0);
+		check_values(root->b, 0);
+
+		pmemobj_tx_set_failure_behavior(POBJ_TX_FAILURE_RETURN);
+		UT_ASSERTne(pmemobj_tx_rollback_to(sp2), 0);
+		UT_ASSERTeq(errno, EINVAL);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+/*
+ * test_alloc_free -- the allocations and frees made after the savepoint are
+ *	reverted
+ */
+static void
+test_alloc_free(void)
+{
+	unsigned nobjs = count_objects();
+	PMEMoid before = OID_NULL;
+	PMEMoid freed = OID_NULL;
+
+	TX_BEGIN(pop) {
+		before = pmemobj_tx_alloc(64, TYPE_NUM);
+		freed = pmemobj_tx_alloc(64, TYPE_NUM);
+
+		struct pobj_tx_savepoint *sp = pmemobj_tx_savepoint();
+
+		pmemobj_tx_alloc(64, TYPE_NUM);
+		pmemobj_tx_free(before);
+
+		UT_ASSERTeq(pmemobj_tx_rollback_to(sp), 0);
+
+		/* freed after the savepoint, without a rollback */
+		pmemobj_tx_free(freed);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(count_objects(), nobjs + 1);
+	UT_ASSERTeq(pmemobj_type_num(before), TYPE_NUM);
+
+	/* an existing object freed after the savepoint is kept */
+	TX_BEGIN(pop) {
+		struct pobj_tx_savepoint *sp = pmemobj_tx_savepoint();
+		pmemobj_tx_free(before);
+		UT_ASSERTeq(pmemobj_tx_rollback_to(sp), 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(count_objects(), nobjs + 1);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_free(before);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(count_objects(), nobjs);
+}
+
+/*
+ * test_large -- rolls back snapshots which extend the undo log, repeatedly
+ */
+static void
+test_large(void)
+{
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(root->large, LARGE_SIZE);
+		memset(root->large, 0, LARGE_SIZE);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	TX_BEGIN(pop) {
+		set_values(root->a, 1);
+		struct pobj_tx_savepoint *sp = pmemobj_tx_savepoint();
+
+		for (unsigned char i = 1; i < 4; ++i) {
+			pmemobj_tx_add_range_direct(root->large, LARGE_SIZE);
+			memset(root->large, i, LARGE_SIZE);
+			UT_ASSERTeq(pmemobj_tx_rollback_to(sp), 0);
+			UT_ASSERT(util_is_zeroed(root->large, LARGE_SIZE));
+		}
+
+		pmemobj_tx_add_range_direct(root->large, LARGE_SIZE / 2);
+		memset(root->large, 0xc, LARGE_SIZE / 2);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_values(root->a, 1);
+	for (size_t i = 0; i < LARGE_SIZE; ++i)
+		UT_ASSERTeq(root->large[i], i < LARGE_SIZE / 2 ? 0xc : 0);
+}
+
+/*
+ * test_redo -- savepoints are not supported in redo transactions
+ */
+static void
+test_redo(void)
+{
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO, TX_PARAM_NONE) {
+		pmemobj_tx_set_failure_behavior(POBJ_TX_FAILURE_RETURN);
+		UT_ASSERTeq(pmemobj_tx_savepoint(), NULL);
+		UT_ASSERTeq(errno, ENOTSUP);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_savepoint");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 4,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(*root)));
+
+	test_rollback();
+	test_abort(0);
+	test_abort(1);
+	test_nested();
+	test_alloc_free();
+	test_large();
+	test_redo();
+
+	pmemobj_close(pop);
+
+	/* nothing is left to be recovered */
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(*root)));
+	check_values(root->a, 1);
+	UT_ASSERTeq(root->large[0], 0xc);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_tx_snapshot_compress.c -- unit test for compressed snapshots
+ *
+ * usage: obj_tx_snapshot_compress file t|c|o
+ *
+ * The 't' command runs the transactional tests, the 'c' command interrupts
+ * a transaction with a compressed snapshot, which is then recovered by the
+ * 'o' command.
+ */
+
+#include "unittest.h"
+#include "pool_hdr.h"
+#include "valgrind_internal.h"
+#if VG_PMEMCHECK_ENABLED
+#define VALGRIND_PMEMCHECK_END_TX VALGRIND_PMC_END_TX
+#else
+#define VALGRIND_PMEMCHECK_END_TX
+#endif
+
+#define LAYOUT "obj_tx_snapshot_compress"
+
+#define DATA_SIZE (256 * 1024) /* requires extending the undo log */
+#define BLOCK 4096
+#define THRESHOLD 1024
+
+struct root {
+	unsigned char data[DATA_SIZE];
+};
+
+static PMEMobjpool *pop;
+static struct root *root;
+
+/*
+ * pattern -- returns the initial value of the byte, the data consists mostly
+ *	of zeroes, with both long and short runs between the nonzero parts
+ */
+static unsigned char
+pattern(size_t i)
+{
+	size_t in = i % BLOCK;
+
+	if (in < 100 || (in >= 1000 && in < 1100) || (in >= 1200 && in < 1210))
+		return (unsigned char)(i % 251 + 1);
+
+	return 0;
+}
+
+/*
+ * init -- creates the pool, enables the compression and fills the data
+ */
+static void
+init(const char *path)
+{
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 4,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	ssize_t threshold = THRESHOLD;
+	UT_ASSERTeq(pmemobj_ctl_set(pop, "tx.snapshot.compress_threshold",
+		&threshold), 0);
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(*root)));
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(root->data, DATA_SIZE);
+		for (size_t i = 0; i < DATA_SIZE; ++i)
+			root->data[i] = pattern(i);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+/*
+ * check -- checks that the data is either intact or overwritten with the byte
+ *	in the given range
+ */
+static void
+check(size_t off, size_t size, int c)
+{
+	for (size_t i = 0; i < DATA_SIZE; ++i) {
+		if (i >= off && i < off + size)
+			UT_ASSERTeq(root->data[i], c);
+		else
+			UT_ASSERTeq(root->data[i], pattern(i));
+	}
+}
+
+/*
+ * test_ctl -- reads and validates the threshold
+ */
+static void
+test_ctl(void)
+{
+	ssize_t threshold;
+	UT_ASSERTeq(pmemobj_ctl_get(pop, "tx.snapshot.compress_threshold",
+		&threshold), 0);
+	UT_ASSERTeq(threshold, THRESHOLD);
+
+	threshold = -1;
+	UT_ASSERTne(pmemobj_ctl_set(pop, "tx.snapshot.compress_threshold",
+		&threshold), 0);
+	UT_ASSERTeq(errno, EINVAL);
+}
+
+/*
+ * test_abort -- a compressed snapshot, which starts and ends in the middle of
+ *	a cacheline, restores the data on abort
+ */
+static void
+test_abort(void)
+{
+	size_t off = 3;
+	size_t size = DATA_SIZE - 8;
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(root->data + off, size);
+		memset(root->data + off, 0xab, size);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check(0, 0, 0);
+}
+
+/*
+ * test_commit -- compressed snapshots don't affect the committed data
+ */
+static void
+test_commit(void)
+{
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(root->data + BLOCK, BLOCK * 2);
+		memset(root->data + BLOCK, 0xab, BLOCK * 2);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check(BLOCK, BLOCK * 2, 0xab);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(root->data + BLOCK, BLOCK * 2);
+		for (size_t i = BLOCK; i < BLOCK * 3; ++i)
+			root->data[i] = pattern(i);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check(0, 0, 0);
+}
+
+/*
+ * test_ranges -- small ranges and ranges added with pmemobj_tx_add_ranges
+ *	are restored as well
+ */
+static void
+test_ranges(void)
+{
+	struct pobj_tx_range ranges[] = {
+		{root->data + BLOCK * 10, BLOCK * 4, 0},
+		{root->data + BLOCK * 20 + 50, 100, 0},
+		{root->data + BLOCK * 30, BLOCK * 8, 0},
+	};
+
+	TX_BEGIN(pop) {
+		UT_ASSERTeq(pmemobj_tx_add_ranges(ranges, 3), 0);
+		for (int i = 0; i < 3; ++i)
+			memset((void *)ranges[i].ptr, 0xcd, ranges[i].size);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check(0, 0, 0);
+}
+
+/*
+ * test_crash -- exits in the middle of a transaction with a compressed
+ *	snapshot
+ */
+static void
+test_crash(const char *path)
+{
+	init(path);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(root->data, DATA_SIZE);
+		memset(root->data, 0xef, DATA_SIZE);
+		pmemobj_persist(pop, root->data, DATA_SIZE);
+
+		VALGRIND_PMEMCHECK_END_TX;
+
+		exit(0); /* simulate a crash */
+	} TX_END
+}
+
+/*
+ * test_recovery -- checks that the snapshot was restored on open
+ */
+static void
+test_recovery(const char *path)
+{
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(*root)));
+	check(0, 0, 0);
+
+	pmemobj_close(pop);
+}
+
+/*
+ * test_feature -- enabling the compression marks the pool with the ULOG_FILL
+ *	incompat feature, which doesn't prevent it from being opened again
+ */
+static void
+test_feature(const char *path)
+{
+	struct pool_hdr hdr;
+	int fd = OPEN(path, O_RDONLY);
+	UT_ASSERTeq(READ(fd, &hdr, sizeof(hdr)), sizeof(hdr));
+	CLOSE(fd);
+
+	UT_ASSERTne(le32toh(hdr.features.incompat) & POOL_FEAT_ULOG_FILL, 0);
+
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	pmemobj_close(pop);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_snapshot_compress");
+
+	if (argc != 3)
+		UT_FATAL("usage: %s file t|c|o", argv[0]);
+
+	const char *path = argv[1];
+
+	if (argv[2][0] == 't') {
+		init(path);
+		test_ctl();
+		test_abort();
+		test_commit();
+		test_ranges();
+		pmemobj_close(pop);
+		test_feature(path);
+	} else if (argv[2][0] == 'c') {
+		test_crash(path);
+	} else if (argv[2][0] == 'o') {
+		test_recovery(path);
+	} else {
+		UT_FATAL("invalid command: %s", argv[2]);
+	}
+
+	DONE(NULL);
+}
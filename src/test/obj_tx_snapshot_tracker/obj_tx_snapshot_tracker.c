@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_tx_snapshot_tracker.c -- tests for the snapshot tracker used by
+ *	transactions which add many ranges
+ */
+
+#include "unittest.h"
+#include "rand.h"
+
+#define LAYOUT "obj_tx_snapshot_tracker"
+
+#define OBJ_SIZE 8192
+#define NADDS 2000
+#define MAX_RANGE 200
+
+static PMEMobjpool *pop;
+static PMEMoid oid;
+static unsigned char pattern[OBJ_SIZE];
+
+/*
+ * set_threshold -- sets the number of ranges after which the tracker is used
+ */
+static void
+set_threshold(long long threshold)
+{
+	int ret = pmemobj_ctl_set(pop, "tx.snapshot.tracker_threshold",
+		&threshold);
+	UT_ASSERTeq(ret, 0);
+}
+
+/*
+ * add_random_ranges -- adds many small, overlapping ranges of the object into
+ *	the transaction and modifies them
+ */
+static void
+add_random_ranges(rng_t *rng)
+{
+	unsigned char *data = pmemobj_direct(oid);
+
+	for (int i = 0; i < NADDS; ++i) {
+		size_t size = rnd64_r(rng) % MAX_RANGE + 1;
+		size_t off = rnd64_r(rng) % (OBJ_SIZE - size);
+
+		/* repeat some of the additions, like B-tree splits do */
+		int repeats = (int)(rnd64_r(rng) % 3) + 1;
+		for (int r = 0; r < repeats; ++r)
+			pmemobj_tx_add_range(oid, off, size);
+
+		memset(data + off, i & 0xff, size);
+	}
+}
+
+static void
+test_ctl(void)
+{
+	long long threshold;
+	int ret = pmemobj_ctl_get(pop, "tx.snapshot.tracker_threshold",
+		&threshold);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(threshold, 64);
+
+	threshold = -1;
+	ret = pmemobj_ctl_set(pop, "tx.snapshot.tracker_threshold", &threshold);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	set_threshold(0);
+	ret = pmemobj_ctl_get(pop, "tx.snapshot.tracker_threshold",
+		&threshold);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(threshold, 0);
+}
+
+/*
+ * test_abort -- every byte modified in the transaction must be restored on
+ *	abort, regardless of the tracker configuration
+ */
+static void
+test_abort(long long threshold, unsigned seed)
+{
+	set_threshold(threshold);
+
+	rng_t rng;
+	randomize_r(&rng, seed);
+
+	TX_BEGIN(pop) {
+		add_random_ranges(&rng);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(memcmp(pmemobj_direct(oid), pattern, OBJ_SIZE), 0);
+}
+
+/*
+ * test_commit -- the modifications persist after commit and a subsequent
+ *	transaction doesn't use the stale tracker of the previous one
+ */
+static void
+test_commit(unsigned seed)
+{
+	set_threshold(1);
+
+	rng_t rng;
+	randomize_r(&rng, seed);
+
+	TX_BEGIN(pop) {
+		add_random_ranges(&rng);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	memcpy(pattern, pmemobj_direct(oid), OBJ_SIZE);
+
+	test_abort(1, seed + 1);
+}
+
+/*
+ * test_flags -- a range added without POBJ_XADD_NO_FLUSH over one with the
+ *	flag goes through the ranges tree, and the nested transactions share
+ *	the tracker of the outermost one
+ */
+static void
+test_flags(void)
+{
+	set_threshold(1);
+
+	unsigned char *data = pmemobj_direct(oid);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_xadd_range(oid, 0, 128, POBJ_XADD_NO_FLUSH);
+		pmemobj_tx_add_range(oid, 64, 128);
+		pmemobj_tx_add_range(oid, 0, 64);
+		memset(data, 0xab, 192);
+
+		TX_BEGIN(pop) {
+			pmemobj_tx_add_range(oid, 32, 64);
+			pmemobj_tx_add_range(oid, 192, 64);
+			memset(data + 192, 0xcd, 64);
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(memcmp(data, pattern, OBJ_SIZE), 0);
+}
+
+/*
+ * test_free -- freeing an object allocated in the transaction invalidates the
+ *	tracked ranges
+ */
+static void
+test_free(void)
+{
+	set_threshold(1);
+
+	TX_BEGIN(pop) {
+		PMEMoid tmp = pmemobj_tx_zalloc(OBJ_SIZE, 1);
+		pmemobj_tx_add_range(tmp, 0, 64);
+		pmemobj_tx_add_range(tmp, 0, 64);
+		pmemobj_tx_free(tmp);
+
+		pmemobj_tx_add_range(oid, 0, 64);
+		memset(pmemobj_direct(oid), 0xef, 64);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(memcmp(pmemobj_direct(oid), pattern, OBJ_SIZE), 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_snapshot_tracker");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 4,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	for (size_t i = 0; i < OBJ_SIZE; ++i)
+		pattern[i] = (unsigned char)(i % 251);
+
+	int ret = pmemobj_alloc(pop, &oid, OBJ_SIZE, 0, NULL, NULL);
+	if (ret != 0)
+		UT_FATAL("!pmemobj_alloc");
+	pmemobj_memcpy_persist(pop, pmemobj_direct(oid), pattern, OBJ_SIZE);
+
+	test_ctl();
+	test_abort(0, 1);
+	test_abort(1, 1);
+	test_abort(64, 2);
+	test_commit(3);
+	test_flags();
+	test_free();
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,335 @@
+// SPDX-License-Identifier: BSD-3-Clause
+/* Copyright 2020, Intel Corporation */
+
+/*
+ * obj_tx_write_combine.c -- unit test for write-combining transactions
+ */
+
+#include "unittest.h"
+
+#define LAYOUT "obj_tx_write_combine"
+
+#define OBJ_SIZE 4096
+#define NOBJS 4
+
+#define TYPE_NUM 1
+
+struct root {
+	PMEMoid objs[NOBJS];
+	uint64_t value;
+};
+
+static PMEMobjpool *pop;
+static struct root *root;
+
+/*
+ * fill -- writes the byte to the part of the object through pmemobj_tx_write
+ */
+static void
+fill(void *ptr, int c, size_t size)
+{
+	unsigned char buf[OBJ_SIZE];
+	memset(buf, c, size);
+	UT_ASSERTeq(pmemobj_tx_write(ptr, buf, size), 0);
+}
+
+/*
+ * check -- checks that the part of the object is filled with the byte
+ */
+static void
+check(const void *ptr, int c, size_t size)
+{
+	const unsigned char *p = ptr;
+	for (size_t i = 0; i < size; ++i)
+		UT_ASSERTeq(p[i], c);
+}
+
+/*
+ * check_read -- like check, but reads the object through pmemobj_tx_read
+ */
+static void
+check_read(const void *ptr, int c, size_t size)
+{
+	unsigned char buf[OBJ_SIZE];
+	UT_ASSERTeq(pmemobj_tx_read(ptr, buf, size), 0);
+	check(buf, c, size);
+}
+
+/*
+ * count_objects -- returns the number of allocated objects of the test type
+ */
+static unsigned
+count_objects(void)
+{
+	unsigned n = 0;
+	PMEMoid oid;
+	for (oid = pmemobj_first(pop); !OID_IS_NULL(oid);
+			oid = pmemobj_next(oid)) {
+		if (pmemobj_type_num(oid) == TYPE_NUM)
+			n++;
+	}
+
+	return n;
+}
+
+/*
+ * free_objs -- frees all of the objects
+ */
+static void
+free_objs(void)
+{
+	TX_BEGIN(pop) {
+		for (int i = 0; i < NOBJS; ++i) {
+			if (OID_IS_NULL(root->objs[i]))
+				continue;
+
+			pmemobj_tx_add_range_direct(&root->objs[i],
+				sizeof(PMEMoid));
+			pmemobj_tx_free(root->objs[i]);
+			root->objs[i] = OID_NULL;
+		}
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(count_objects(), 0);
+}
+
+/*
+ * test_commit -- writes to new objects are staged until commit
+ */
+static void
+test_commit(void)
+{
+	TX_BEGIN_PARAM(pop, TX_PARAM_WRITE_COMBINE, TX_PARAM_NONE) {
+		pmemobj_tx_add_range_direct(root->objs, sizeof(root->objs));
+		for (int i = 0; i < NOBJS; ++i) {
+			root->objs[i] = pmemobj_tx_zalloc(OBJ_SIZE, TYPE_NUM);
+			char *p = pmemobj_direct(root->objs[i]);
+
+			/* overlapping and adjacent writes */
+			fill(p, 0xa, OBJ_SIZE / 2);
+			fill(p + OBJ_SIZE / 4, 0xb, OBJ_SIZE / 2);
+			fill(p + OBJ_SIZE * 3 / 4, 0xc, OBJ_SIZE / 4);
+
+			/* the data isn't in the object yet */
+			check(p, 0, OBJ_SIZE);
+
+			check_read(p, 0xa, OBJ_SIZE / 4);
+			check_read(p + OBJ_SIZE / 4, 0xb, OBJ_SIZE / 2);
+			check_read(p + OBJ_SIZE * 3 / 4, 0xc, OBJ_SIZE / 4);
+		}
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	for (int i = 0; i < NOBJS; ++i) {
+		char *p = pmemobj_direct(root->objs[i]);
+		check(p, 0xa, OBJ_SIZE / 4);
+		check(p + OBJ_SIZE / 4, 0xb, OBJ_SIZE / 2);
+		check(p + OBJ_SIZE * 3 / 4, 0xc, OBJ_SIZE / 4);
+	}
+
+	free_objs();
+}
+
+/*
+ * test_abort -- staged writes are discarded along with the objects
+ */
+static void
+test_abort(void)
+{
+	TX_BEGIN_PARAM(pop, TX_PARAM_WRITE_COMBINE, TX_PARAM_NONE) {
+		PMEMoid oid = pmemobj_tx_alloc(OBJ_SIZE, TYPE_NUM);
+		fill(pmemobj_direct(oid), 0xa, OBJ_SIZE);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(count_objects(), 0);
+}
+
+/*
+ * test_existing -- writes to objects which existed before the transaction
+ *	are made in place
+ */
+static void
+test_existing(int abort)
+{
+	TX_BEGIN_PARAM(pop, TX_PARAM_WRITE_COMBINE, TX_PARAM_NONE) {
+		pmemobj_tx_add_range_direct(&root->value, sizeof(root->value));
+		root->value = 1;
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_WRITE_COMBINE, TX_PARAM_NONE) {
+		uint64_t value = 2;
+		pmemobj_tx_write(&root->value, &value, sizeof(value));
+		UT_ASSERTeq(root->value, 2);
+
+		if (abort)
+			pmemobj_tx_abort(ECANCELED);
+	} TX_END
+
+	UT_ASSERTeq(root->value, abort ? 1 : 2);
+}
+
+/*
+ * test_free -- staged writes to an object freed in the same transaction are
+ *	discarded, the ones to other objects are kept
+ */
+static void
+test_free(void)
+{
+	TX_BEGIN_PARAM(pop, TX_PARAM_WRITE_COMBINE, TX_PARAM_NONE) {
+		pmemobj_tx_add_range_direct(root->objs, sizeof(root->objs));
+		for (int i = 0; i < NOBJS; ++i) {
+			root->objs[i] = pmemobj_tx_zalloc(OBJ_SIZE, TYPE_NUM);
+			fill(pmemobj_direct(root->objs[i]), 0x10 + i, OBJ_SIZE);
+		}
+
+		pmemobj_tx_free(root->objs[1]);
+		root->objs[1] = OID_NULL;
+
+		/* the object can be written again after being allocated */
+		root->objs[1] = pmemobj_tx_zalloc(OBJ_SIZE, TYPE_NUM);
+		char *p = pmemobj_direct(root->objs[1]);
+		fill(p, 0x20, OBJ_SIZE / 2);
+		check_read(p + OBJ_SIZE / 2, 0, OBJ_SIZE / 2);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(count_objects(), NOBJS);
+	for (int i = 0; i < NOBJS; ++i) {
+		char *p = pmemobj_direct(root->objs[i]);
+		if (i == 1) {
+			check(p, 0x20, OBJ_SIZE / 2);
+			check(p + OBJ_SIZE / 2, 0, OBJ_SIZE / 2);
+		} else {
+			check(p, 0x10 + i, OBJ_SIZE);
+		}
+	}
+
+	free_objs();
+}
+
+/*
+ * test_realloc -- staged writes are carried over to the reallocated object
+ */
+static void
+test_realloc(void)
+{
+	TX_BEGIN_PARAM(pop, TX_PARAM_WRITE_COMBINE, TX_PARAM_NONE) {
+		pmemobj_tx_add_range_direct(root->objs, sizeof(root->objs));
+		root->objs[0] = pmemobj_tx_zalloc(OBJ_SIZE / 2, TYPE_NUM);
+		fill(pmemobj_direct(root->objs[0]), 0xa, OBJ_SIZE / 2);
+
+		root->objs[0] = pmemobj_tx_zrealloc(root->objs[0], OBJ_SIZE,
+			TYPE_NUM);
+		char *p = pmemobj_direct(root->objs[0]);
+		check_read(p, 0xa, OBJ_SIZE / 2);
+		fill(p + OBJ_SIZE / 2, 0xb, OBJ_SIZE / 2);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	UT_ASSERTeq(count_objects(), 1);
+	char *p = pmemobj_direct(root->objs[0]);
+	check(p, 0xa, OBJ_SIZE / 2);
+	check(p + OBJ_SIZE / 2, 0xb, OBJ_SIZE / 2);
+
+	free_objs();
+}
+
+/*
+ * test_nested -- only the outermost transaction decides whether the writes
+ *	are staged
+ */
+static void
+test_nested(void)
+{
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(root->objs, sizeof(root->objs));
+		root->objs[0] = pmemobj_tx_zalloc(OBJ_SIZE, TYPE_NUM);
+
+		TX_BEGIN_PARAM(pop, TX_PARAM_WRITE_COMBINE, TX_PARAM_NONE) {
+			char *p = pmemobj_direct(root->objs[0]);
+			fill(p, 0xa, OBJ_SIZE);
+			check(p, 0xa, OBJ_SIZE);
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check(pmemobj_direct(root->objs[0]), 0xa, OBJ_SIZE);
+
+	free_objs();
+}
+
+/*
+ * test_savepoint -- savepoints are not supported in write-combining
+ *	transactions
+ */
+static void
+test_savepoint(void)
+{
+	TX_BEGIN_PARAM(pop, TX_PARAM_WRITE_COMBINE, TX_PARAM_NONE) {
+		pmemobj_tx_set_failure_behavior(POBJ_TX_FAILURE_RETURN);
+		UT_ASSERTeq(pmemobj_tx_savepoint(), NULL);
+		UT_ASSERTeq(errno, ENOTSUP);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_write_combine");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 4,
+			S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(*root)));
+
+	test_commit();
+	test_abort();
+	test_existing(0);
+	test_existing(1);
+	test_free();
+	test_realloc();
+	test_nested();
+	test_savepoint();
+
+	/* the data is persistent */
+	TX_BEGIN_PARAM(pop, TX_PARAM_WRITE_COMBINE, TX_PARAM_NONE) {
+		pmemobj_tx_add_range_direct(root->objs, sizeof(root->objs));
+		root->objs[0] = pmemobj_tx_alloc(OBJ_SIZE, TYPE_NUM);
+		fill(pmemobj_direct(root->objs[0]), 0xd, OBJ_SIZE);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	pmemobj_close(pop);
+
+	if ((pop = pmemobj_open(path, LAYOUT)) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	root = pmemobj_direct(pmemobj_root(pop, sizeof(*root)));
+	check(pmemobj_direct(root->objs[0]), 0xd, OBJ_SIZE);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -1973,6 +1973,31 @@ function require_no_asan() {
 	esac
 }
 
+#
+# require_no_asan_pmemobj - continue script execution only if libpmemobj does
+#	NOT require libasan
+#
+# libpmemobj built with ASan wraps the pool creation, which does not support
+# pool sets, so tests using them have to be skipped.
+#
+function require_no_asan_pmemobj() {
+	case "$BUILD"
+	in
+	debug)
+		require_no_asan_for ../../debug/libpmemobj.so
+		;;
+	nondebug)
+		require_no_asan_for ../../nondebug/libpmemobj.so
+		;;
+	static-debug)
+		require_no_asan_for ../../debug/libpmemobj.a
+		;;
+	static-nondebug)
+		require_no_asan_for ../../nondebug/libpmemobj.a
+		;;
+	esac
+}
+
 #
 # require_tty - continue script execution only if standard output is a terminal
 #